@@ -18,6 +18,16 @@
 // Topics MQTT
 #define TOPIC_REQUEST "holter/upload-request"
 #define TOPIC_RESPONSE "holter/upload-url/esp32-holter-001"
+#define TOPIC_LIVE "holter/live/esp32-holter-001"  // Streaming en vivo (opcional)
+#define TOPIC_TELEMETRY "holter/telemetry/esp32-holter-001"  // Métricas del equipo (opcional)
+
+// ============================================================================
+// CIFRADO DE SESIONES (opcional)
+// Clave AES-256 del equipo, 64 dígitos hex: openssl rand -hex 32
+// La misma clave va en DEVICE_KEYS de la Lambda 2, bajo DEVICE_KEY_ID
+// ============================================================================
+// #define DEVICE_KEY_HEX "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+// #define DEVICE_KEY_ID 1
 
 // ============================================================================
 // CERTIFICADO ROOT CA (Amazon Root CA 1)
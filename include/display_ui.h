@@ -5,6 +5,7 @@
 #include <XSpaceBioV10.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
+#include "holter_capture.h"
 
 // ============================================================================
 // MODOS DE PANTALLA
@@ -17,7 +18,8 @@ enum DisplayMode {
   DISP_CONFIRM_UPLOAD,    // Confirmación: "Subir a AWS?"
   DISP_UPLOADING,         // Mostrando progreso de upload
   DISP_MESSAGE,           // Mensaje temporal
-  DISP_ERROR              // Pantalla de error
+  DISP_ERROR,             // Pantalla de error
+  DISP_MODE_COUNT
 };
 
 // ============================================================================
@@ -29,19 +31,53 @@ struct BatteryInfo {
   int percentage;
 };
 
+// ============================================================================
+// MÉTRICAS
+// ============================================================================
+
+// Acumulados por modo desde el arranque (tiempos en us)
+struct DisplayModeStats {
+  uint32_t frames;
+  uint32_t unchanged;          // Frames sin nada que enviar
+  uint32_t bytes;              // Bytes en el bus I2C (datos, comandos y direcciones)
+  uint32_t render_us;          // Dibujo en el framebuffer
+  uint32_t flush_us;           // Comparación y envío de lo que cambió
+  uint32_t max_us;             // Peor frame (dibujo + envío)
+  uint32_t partial;            // Frames cortados por el presupuesto (el resto salió en el siguiente)
+  uint32_t active_ms;          // Tiempo en el modo (frames / active_ms = fps)
+};
+
+// Trazo ECG de la pantalla idle
+struct DisplayTraceStats {
+  uint32_t samples;            // Muestras recibidas de la captura
+  uint32_t columns;            // Columnas min/max armadas
+  uint32_t columns_drawn;      // Columnas dibujadas desplazando el trazo
+  uint32_t redraws;            // Trazos redibujados completos (entrada a idle, recentrado, atraso)
+  uint64_t push_cycles;        // Ciclos de CPU de display_pushSample() en la captura
+  uint32_t push_cycles_max;
+};
+
+struct DisplayStats {
+  DisplayModeStats modes[DISP_MODE_COUNT];
+  DisplayTraceStats trace;
+  uint32_t bus_hz;             // Reloj del I2C (compartido con el IMU)
+  uint32_t late_frames;        // Frames que salieron con más de un intervalo de atraso
+};
+
 // ============================================================================
 // INTERFACE PÚBLICA
 // ============================================================================
 
 /**
- * Inicializa el módulo de display (OLED, botones, pines)
- * Debe ser llamado en setup()
+ * Inicializa el módulo de display (OLED, botones, pines) y arranca la tarea
+ * que dibuja (núcleo 0, prioridad mínima)
+ * Debe ser llamado en setup(), después de holter_init() (lock del I2C)
  */
 void display_init(XSpaceBioV10Board* bioBoard);
 
 /**
- * Actualiza la pantalla según el modo actual
- * Debe ser llamado periódicamente en loop()
+ * Despierta la tarea de dibujo para que revise si toca un frame
+ * Ya no hace falta llamarla en loop(): se conserva por compatibilidad
  */
 void display_update();
 
@@ -91,15 +127,41 @@ void display_clear();
 void display_forceUpdate();
 
 /**
- * Obtiene la información actual de la batería
+ * Obtiene la información de la batería de la última lectura (no toca el ADC)
  */
 BatteryInfo display_getBattery();
 
+/**
+ * Lee la batería si pasaron BATTERY_SAMPLE_MS desde la última lectura
+ * La llama la captura entre muestras: el ADC es el mismo del ECG y así
+ * nunca se lo disputa otro núcleo. Sin captura la lee la tarea de dibujo.
+ */
+void display_sampleBattery();
+
 /**
  * Dibuja el icono de batería en la posición especificada
  */
 void display_drawBatteryIcon(int x, int y, int percentage);
 
+/**
+ * Obtiene las métricas de dibujo y envío por modo
+ */
+DisplayStats display_getStats();
+
+/**
+ * Imprime las métricas por modo por Serial: frames, bytes por frame y
+ * tiempo de dibujo y de envío
+ */
+void display_printStats();
+
+/**
+ * Entrega una muestra al trazo de la pantalla idle (derivación II)
+ * Llamado por la captura en cada muestra: acumula mínimo y máximo y cada
+ * TRACE_SAMPLES_PER_COLUMN muestras deja una columna en un ring. No dibuja
+ * ni toca el I2C.
+ */
+void display_pushSample(const ECGSample& sample);
+
 /**
  * Establece el valor de ECG a mostrar en pantalla idle
  */
@@ -0,0 +1,62 @@
+#ifndef HOLTER_BENCH_H
+#define HOLTER_BENCH_H
+
+#include "holter_segment.h"
+
+// Microbenchmarks de los kernels de captura y upload: cada uno es una
+// iteración del trabajo que el firmware hace por muestra, por buffer de la
+// SD o por segmento, llamando a las mismas funciones que el firmware. Los
+// corren dos arneses con la misma tabla:
+//   - host: tools/kernel_bench.cpp con Google Benchmark
+//   - ESP32: src/bench_main.cpp (env:bench), con el contador de ciclos
+// Los dos emiten el JSON de Google Benchmark; tools/bench_compare.py compara
+// dos corridas. No depende de Arduino (el almacenamiento y el ADC van por la HAL).
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define BENCH_BLOCK_SIZE SEGMENT_BLOCK_SIZE
+#define BENCH_SAMPLE_RATE_HZ 250
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+enum BenchUnit : uint8_t {
+  BENCH_PER_SAMPLE,            // Una iteración por muestra (250 por segundo)
+  BENCH_PER_BLOCK,             // Una por buffer de BENCH_BLOCK_SIZE
+  BENCH_PER_SEGMENT            // Una por segmento de 15 s
+};
+
+struct BenchKernel {
+  const char* name;            // El del TRACE_SCOPE del mismo tramo, si lo hay
+  uint8_t unit;                // BenchUnit
+  uint32_t bytes;              // Bytes procesados por iteración (0 = no aplica)
+  bool (*setup)();             // false: no disponible en este equipo, se saltea
+  void (*run)();               // Una iteración
+  void (*teardown)();          // Opcional
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Kernels comunes al host y al ESP32
+ */
+const BenchKernel* holter_bench_kernels(size_t* count);
+
+/**
+ * Acumulador de los resultados de los kernels: leerlo impide que el
+ * compilador descarte el trabajo medido
+ */
+uint32_t holter_bench_sink();
+
+/**
+ * Buffer de BENCH_BLOCK_SIZE con muestras de ECG sintético (semilla fija),
+ * para los kernels que procesan bloques de la sesión
+ */
+uint8_t* holter_bench_signalBlock();
+
+#endif // HOLTER_BENCH_H
@@ -5,34 +5,28 @@
 #include <XSpaceBioV10.h>
 #include <XSpaceV21.h>
 #include <SD.h>
+#include "holter_format.h"
 
 // ============================================================================
 // ESTRUCTURAS DE DATOS
 // ============================================================================
 
-struct FileHeader {
-  uint32_t magic;              // 0x45434744 = "ECGD"
-  uint16_t version;
-  uint16_t device_id;
-  uint32_t session_id;
-  uint32_t timestamp_start;
-  uint16_t ecg_sample_rate;
-  uint16_t imu_sample_rate;
-  uint32_t num_ecg_samples;
-  uint32_t num_imu_samples;
-} __attribute__((packed));
-
-struct ECGSample {
-  int16_t derivation_I;
-  int16_t derivation_II;
-  int16_t derivation_III;
-} __attribute__((packed));
-
-struct IMUSample {
-  int16_t accel_x;
-  int16_t accel_y;
-  int16_t accel_z;
-} __attribute__((packed));
+struct CaptureStats {
+  uint32_t bytes_written;      // Bytes escritos a SD por el escritor en segundo plano
+  uint32_t write_max_us;       // Peor tiempo de una escritura a SD
+  uint32_t sd_wait_max_us;     // Peor espera por el lock de SD (p.ej. lectura del upload)
+  uint32_t buffer_waits;       // Veces que el muestreo esperó un buffer libre
+  uint32_t segments;           // Segmentos cerrados desde el arranque
+  uint32_t captured_ms;        // Tiempo muestreando (segmentos cerrados)
+  uint32_t wall_ms;            // Tiempo desde el primer segmento: duty cycle = captured / wall
+  uint32_t gap_last_ms;        // Sin muestrear entre el último segmento y el siguiente
+  uint32_t gap_max_ms;
+  float last_rate_hz;          // Muestras por segundo del último segmento cerrado
+  uint32_t first_sample_us;    // micros() de la primera muestra desde el arranque
+  uint32_t first_write_us;     // micros() de las primeras muestras escritas en la SD
+  uint32_t ram_samples;        // Muestras tomadas antes de esa escritura
+  uint32_t sd_mount_ms;
+};
 
 // ============================================================================
 // INTERFACE PÚBLICA
@@ -40,13 +34,21 @@ struct IMUSample {
 
 /**
  * Inicializa el módulo de captura (SD Card, IMU)
- * Debe ser llamado en setup()
+ * Debe ser llamado en setup(). La SD se monta en segundo plano: no bloquea
  */
 void holter_init(XSpaceBioV10Board* bioBoard, XSpaceV21Board* v21Board);
 
+/**
+ * Espera a que termine el montaje de la SD iniciado por holter_init()
+ * @return true si la SD quedó disponible
+ */
+bool holter_waitForSD();
+
 /**
  * Inicia una sesión de captura de ECG + IMU
- * Crea archivo en SD y comienza a grabar
+ * Crea archivo en SD y comienza a grabar. Si la SD todavía se está montando
+ * el muestreo arranca igual en RAM (doble buffer, ~10 s) y el archivo se
+ * abre en cuanto la SD esté lista
  */
 bool holter_startCapture();
 
@@ -67,6 +69,13 @@ void holter_stopCapture();
  */
 bool holter_isCapturing();
 
+/**
+ * Tiempo que falta para la próxima muestra ECG, en microsegundos
+ * La tarea de captura duerme ese tiempo entre ráfagas en lugar de ceder de a
+ * un tick, así el idle puede bajar la frecuencia o entrar en light sleep
+ */
+uint32_t holter_getNextSampleDelayUs();
+
 /**
  * Obtiene el progreso de la captura actual
  * @return Valor entre 0.0 y 1.0 (0% a 100%)
@@ -93,15 +102,79 @@ unsigned long holter_getECGSampleCount();
  */
 unsigned long holter_getIMUSampleCount();
 
+/**
+ * Grabación en curso: timestamp de su primer segmento (0 = ninguna)
+ * Cada sesión de captura es un segmento; se numeran desde 0 mientras la
+ * captura rota sin interrupciones
+ */
+uint32_t holter_getRecordingID();
+
+/**
+ * Número del segmento que se está capturando dentro de la grabación
+ */
+uint32_t holter_getSegmentIndex();
+
+/**
+ * Path en SD de un segmento: "/session_<grabación>_s<NNNN>.bin"
+ */
+String holter_segmentFilename(uint32_t recording, uint32_t segment);
+
+/**
+ * Extrae grabación y segmento de un path de segmento
+ * @return false si no tiene ese formato (p.ej. sesiones "/session_<ts>.bin" antiguas)
+ */
+bool holter_parseSegmentFilename(const char* filename, uint32_t* recording, uint32_t* segment);
+
 /**
  * Verifica si la SD Card está disponible
  */
 bool holter_isSDAvailable();
 
+/**
+ * Vuelve a montar la SD sin reiniciar el equipo (recuperación de errores)
+ * @return true si la SD quedó disponible
+ */
+bool holter_remountSD();
+
+/**
+ * Cierra el último segmento y desmonta la SD (antes de deep sleep)
+ * Llamar con la captura detenida
+ */
+void holter_unmountSD();
+
 /**
  * Verifica si el IMU está disponible
  */
 bool holter_isIMUAvailable();
 
+/**
+ * Toma el acceso exclusivo a la SD (compartida por captura, cola y upload)
+ * Es recursivo. Los accesos largos deben partirse en bloques cortos para no
+ * demorar la escritura de la captura.
+ */
+void holter_sdLock();
+
+/**
+ * Libera el acceso a la SD tomado con holter_sdLock()
+ */
+void holter_sdUnlock();
+
+/**
+ * Toma el bus I2C (pantalla e IMU)
+ * Se toma por transacción: la pantalla lo suelta cada ~0.8 ms a 400 kHz,
+ * así una lectura del IMU desde la captura nunca espera un frame entero.
+ */
+void holter_i2cLock();
+
+/**
+ * Libera el bus I2C tomado con holter_i2cLock()
+ */
+void holter_i2cUnlock();
+
+/**
+ * Obtiene las métricas de escritura a SD de la captura
+ */
+CaptureStats holter_getCaptureStats();
+
 #endif
 
@@ -0,0 +1,105 @@
+#ifndef HOLTER_CATALOG_H
+#define HOLTER_CATALOG_H
+
+#include <Arduino.h>
+#include "holter_catalog_store.h"
+
+// Catálogo de sesiones en la SD (/catalog.dat, ver holter_catalog_store.h).
+// La captura registra cada segmento al abrirlo y al cerrarlo, el upload y la
+// cola registran los cambios de estado. Con el catálogo válido, recuperar lo
+// pendiente o saber si un segmento sigue en la SD no necesita listar la raíz;
+// solo se reconstruye desde el directorio si falta o está corrupto.
+//
+// Todas las funciones toman el lock de la SD (recursivo): se pueden llamar
+// con la SD tomada, y con la cola tomada (orden: cola, después SD).
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Borrados acumulados que disparan la compactación al cargar
+#define CATALOG_COMPACT_DELETED 1024
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct CatalogStats {
+  uint32_t records;
+  uint32_t runs;               // Corridas en RAM
+  uint32_t counts[CATALOG_STATES];
+  uint32_t bytes[CATALOG_STATES];
+  uint32_t load_ms;            // Última carga (o reconstrucción)
+  uint32_t rebuilds;           // Desde el arranque
+  bool valid;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Carga el catálogo desde la SD (y lo compacta si acumuló muchos borrados)
+ * Lo llama holter_queue_init(), también tras remontar la SD
+ * @return CATALOG_OK, o el motivo por el que hay que reconstruirlo
+ */
+CatalogStatus holter_catalog_init();
+
+/**
+ * Empieza un catálogo vacío para reconstruirlo desde el directorio
+ */
+bool holter_catalog_reset();
+
+/**
+ * Registra un segmento que se está por crear (estado RECORDING)
+ */
+bool holter_catalog_begin(uint32_t recordingId, uint32_t segment, uint32_t timeStart);
+
+/**
+ * Registra el cierre de un segmento (estado COMPLETE)
+ * @param dataCrc CRC32 de lo que sigue a los headers (0 = desconocido)
+ */
+bool holter_catalog_complete(uint32_t recordingId, uint32_t segment, uint32_t size,
+                             uint32_t dataCrc, uint32_t timeEnd);
+
+/**
+ * Agrega registros al final con una sola apertura del archivo
+ * (reconstrucción desde el directorio, por lotes)
+ * @return false si alguno no se pudo escribir
+ */
+bool holter_catalog_addBatch(CatalogRecord* records, size_t count);
+
+/**
+ * Cambia el estado de una sesión por su nombre de archivo
+ * @return false si no es un segmento o no está en el catálogo
+ */
+bool holter_catalog_setState(const char* filename, CatalogState state);
+
+/**
+ * Busca un segmento sin tocar el directorio de la SD
+ */
+bool holter_catalog_find(uint32_t recordingId, uint32_t segment, CatalogRecord* record);
+
+/**
+ * Recorre los registros cuyo estado esté en stateMask, del más viejo al más
+ * nuevo. *cursor empieza en 0.
+ * @return false al terminar
+ */
+bool holter_catalog_next(uint32_t* cursor, uint32_t stateMask, CatalogRecord* record);
+
+/**
+ * ¿Hay un catálogo cargado y utilizable?
+ */
+bool holter_catalog_isValid();
+
+/**
+ * Obtiene los contadores del catálogo
+ */
+CatalogStats holter_catalog_getStats();
+
+/**
+ * Imprime el resumen por estado por Serial
+ */
+void holter_catalog_printStatus();
+
+#endif // HOLTER_CATALOG_H
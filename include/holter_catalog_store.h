@@ -0,0 +1,188 @@
+#ifndef HOLTER_CATALOG_STORE_H
+#define HOLTER_CATALOG_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Catálogo de sesiones en un archivo: un registro de 32 bytes por segmento
+// con su estado, tamaño, CRC y rango de tiempo. Los registros se agregan al
+// final cuando se abre un segmento y después se actualizan en su lugar; como
+// son de 32 bytes alineados a 32, cada actualización cae dentro de un solo
+// sector de la SD y el CRC del registro detecta la que quedó a medio escribir.
+//
+// En RAM solo quedan los contadores por estado y las corridas de segmentos
+// consecutivos de cada grabación: buscar un segmento es recorrer unas pocas
+// corridas y leer un registro, sin listar el directorio raíz de la SD.
+// No depende de Arduino: lo usan el firmware (holter_catalog.cpp) y el
+// benchmark del host (tools/catalog_bench.cpp).
+//
+// Archivo: CatalogHeader | CatalogRecord[0] | CatalogRecord[1] | ...
+// Enteros little endian (los del ESP32 y los del host).
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define CATALOG_VERSION 1
+#define CATALOG_MAGIC 0x31544143       // "CAT1"
+#define CATALOG_RECORD_SIZE 32
+
+#ifndef CATALOG_MAX_RUNS
+#define CATALOG_MAX_RUNS 64            // 1 KB; lo que no entra se busca en el archivo
+#endif
+
+#define CATALOG_READ_RECORDS 16        // Registros por lectura (un sector)
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+enum CatalogState : uint8_t {
+  CATALOG_RECORDING = 1,       // Segmento abierto por la captura
+  CATALOG_COMPLETE = 2,        // Cerrado, pendiente de subir
+  CATALOG_UPLOADING = 3,       // PUT en curso
+  CATALOG_UPLOADED = 4,        // Confirmado por S3, todavía en la SD
+  CATALOG_DELETED = 5,         // Ya no está en la SD
+  CATALOG_STATES
+};
+
+#define CATALOG_MASK(state) (1u << (state))
+#define CATALOG_PENDING_MASK (CATALOG_MASK(CATALOG_RECORDING) | \
+                              CATALOG_MASK(CATALOG_COMPLETE) | \
+                              CATALOG_MASK(CATALOG_UPLOADING))
+
+enum CatalogStatus {
+  CATALOG_OK,
+  CATALOG_MISSING,             // Sin archivo o vacío
+  CATALOG_CORRUPT              // Header o algún registro inválido: hay que reconstruirlo
+};
+
+struct CatalogHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t created;            // Unix timestamp de la última reconstrucción
+  uint8_t reserved[16];
+  uint32_t crc;                // CRC32 de los 28 bytes anteriores
+} __attribute__((packed));
+
+struct CatalogRecord {
+  uint32_t recording_id;
+  uint32_t segment;
+  uint32_t size;               // Bytes del archivo al cerrarlo
+  uint32_t data_crc;           // CRC32 de lo que sigue a los headers (0 = desconocido)
+  uint32_t time_start;         // Unix timestamp de la primera muestra
+  uint32_t time_end;           // Unix timestamp del cierre (0 = abierto o desconocido)
+  uint8_t state;               // CatalogState
+  uint8_t reserved[3];
+  uint32_t crc;                // CRC32 de los 28 bytes anteriores
+} __attribute__((packed));
+
+static_assert(sizeof(CatalogHeader) == CATALOG_RECORD_SIZE, "header del tamaño de un registro");
+static_assert(sizeof(CatalogRecord) == CATALOG_RECORD_SIZE, "registros alineados a sectores");
+
+// Segmentos consecutivos de una grabación guardados en registros consecutivos
+struct CatalogRun {
+  uint32_t recording_id;
+  uint32_t first_segment;
+  uint32_t first_index;
+  uint32_t count;
+};
+
+// ============================================================================
+// ALMACENAMIENTO
+// ============================================================================
+
+// Acceso por offset al archivo del catálogo: la SD en el firmware, un
+// archivo común en el host. write() vuelve con los datos ya persistidos.
+class CatalogFile {
+public:
+  virtual ~CatalogFile() {}
+  virtual bool read(uint32_t offset, void* data, size_t len) = 0;
+  virtual bool write(uint32_t offset, const void* data, size_t len) = 0;
+  virtual uint32_t size() = 0;
+};
+
+// ============================================================================
+// CATÁLOGO
+// ============================================================================
+
+class SessionCatalog {
+public:
+  explicit SessionCatalog(CatalogFile& file) : file(file) {}
+  
+  /**
+   * Lee el archivo completo: valida cada registro y arma los contadores y
+   * las corridas. Bytes sueltos al final (un registro agregado a medias) se
+   * ignoran y el próximo registro los pisa.
+   */
+  CatalogStatus load();
+  
+  /**
+   * Empieza un catálogo vacío sobre un archivo vacío (o truncado)
+   */
+  bool create(uint32_t now);
+  
+  /**
+   * Busca un segmento
+   * @return Índice del registro, -1 si no está
+   */
+  int32_t find(uint32_t recordingId, uint32_t segment, CatalogRecord* record);
+  
+  /**
+   * Guarda un registro: lo actualiza en su lugar si el segmento ya estaba,
+   * si no lo agrega al final. Completa el CRC del registro.
+   * @return Índice del registro, -1 si no se pudo escribir
+   */
+  int32_t put(CatalogRecord* record);
+  
+  /**
+   * Agrega un registro al final sin buscarlo antes (reconstrucción: el
+   * directorio no repite nombres)
+   */
+  int32_t add(CatalogRecord* record);
+  
+  /**
+   * Siguiente registro desde *cursor (inclusive) cuyo estado esté en
+   * stateMask (CATALOG_MASK). Empieza por el primer registro vivo.
+   * @return false al llegar al final; si no, *cursor queda después del registro
+   */
+  bool next(uint32_t* cursor, uint32_t stateMask, CatalogRecord* record);
+  
+  /**
+   * Copia a out los registros que no están borrados, con un header nuevo.
+   * Después hay que reemplazar el archivo y volver a cargarlo.
+   */
+  bool compact(CatalogFile& out, uint32_t now);
+  
+  uint32_t records() const { return recordCount; }
+  uint32_t count(CatalogState state) const { return counts[state]; }
+  uint32_t bytes(CatalogState state) const { return stateBytes[state]; }
+  uint32_t firstLive() const { return liveStart; }
+  uint32_t runs() const { return runCount; }
+
+private:
+  bool readRecords(uint32_t index, CatalogRecord* records, uint32_t count);
+  bool writeRecord(uint32_t index, CatalogRecord* record);
+  void account(const CatalogRecord& record, int direction);
+  void index(const CatalogRecord& record, uint32_t position);
+  int32_t scan(uint32_t end, uint32_t recordingId, uint32_t segment, CatalogRecord* record);
+  void advanceLive();
+  void reset();
+  
+  CatalogFile& file;
+  uint32_t recordCount = 0;
+  uint32_t counts[CATALOG_STATES] = {0};
+  uint32_t stateBytes[CATALOG_STATES] = {0};
+  uint32_t liveStart = 0;              // Antes de este índice todo está borrado
+  CatalogRun runList[CATALOG_MAX_RUNS];
+  uint32_t runCount = 0;
+  uint32_t indexedFrom = 0;            // Registros anteriores sin corrida en RAM
+};
+
+/**
+ * Valida un registro leído del archivo
+ */
+bool catalog_recordValid(const CatalogRecord& record);
+
+#endif // HOLTER_CATALOG_STORE_H
@@ -0,0 +1,101 @@
+#ifndef HOLTER_CBOR_H
+#define HOLTER_CBOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Codificador/decodificador CBOR mínimo (RFC 8949) para los mensajes de
+// control MQTT. Escribe sobre un buffer del llamador y lee en el lugar
+// (los textos apuntan al payload): ninguna de las dos clases pide memoria.
+// Solo longitudes definidas y enteros de hasta 32 bits (con signo al
+// escribir). No depende de Arduino.
+
+// ============================================================================
+// ESCRITURA
+// ============================================================================
+
+class CborWriter {
+public:
+  CborWriter(uint8_t* buffer, size_t capacity);
+  
+  void map(uint32_t pairs);
+  void array(uint32_t items);
+  void uint(uint32_t value);
+  void integer(int32_t value);
+  void text(const char* value);
+  void text(const char* value, size_t length);
+  void boolean(bool value);
+  
+  /**
+   * Bytes escritos. Si el buffer no alcanzó, ok() es false y el mensaje no sirve
+   */
+  size_t size() const { return length; }
+  bool ok() const { return !overflow; }
+
+private:
+  void head(uint8_t major, uint32_t value);
+  void put(const uint8_t* data, size_t count);
+  
+  uint8_t* buffer;
+  size_t capacity;
+  size_t length;
+  bool overflow;
+};
+
+// ============================================================================
+// LECTURA
+// ============================================================================
+
+enum CborType {
+  CBOR_UINT,
+  CBOR_NEGINT,
+  CBOR_BYTES,
+  CBOR_TEXT,
+  CBOR_ARRAY,
+  CBOR_MAP,
+  CBOR_SIMPLE,       // bool, null, float
+  CBOR_END,          // No quedan datos
+  CBOR_INVALID
+};
+
+class CborReader {
+public:
+  CborReader(const uint8_t* data, size_t length);
+  
+  /**
+   * Tipo del siguiente elemento, sin consumirlo
+   */
+  CborType peekType() const;
+  
+  bool readUint(uint32_t* value);
+  bool readBool(bool* value);
+  
+  /**
+   * Texto sin copiar: *value apunta al payload y NO termina en '\0'
+   */
+  bool readText(const char** value, size_t* length);
+  
+  bool readMap(uint32_t* pairs);
+  bool readArray(uint32_t* items);
+  
+  /**
+   * Salta un elemento completo (incluye el contenido de mapas y arrays)
+   */
+  bool skip();
+  
+  /**
+   * false si algún read falló (tipo inesperado o mensaje truncado)
+   */
+  bool ok() const { return !error; }
+
+private:
+  bool readHead(uint8_t* major, uint64_t* value);
+  bool skipItem(int depth);
+  
+  const uint8_t* data;
+  size_t length;
+  size_t position;
+  bool error;
+};
+
+#endif // HOLTER_CBOR_H
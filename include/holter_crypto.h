@@ -0,0 +1,73 @@
+#ifndef HOLTER_CRYPTO_H
+#define HOLTER_CRYPTO_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+// Extensión del header de sesión cuando el archivo está cifrado: va justo
+// después del FileHeader (versión 2) o del SessionInfo (versión 3 con
+// SESSION_FLAG_ENCRYPTED)
+// Solo se cifran las muestras: los headers quedan en claro para que
+// stopCapture() pueda actualizar los contadores en su lugar
+struct EncryptionHeader {
+  uint32_t magic;              // 0x31434E45 = "ENC1"
+  uint8_t algorithm;           // 1 = AES-256-CTR
+  uint8_t key_id;              // Clave del equipo usada para envolver (DEVICE_KEY_ID)
+  uint16_t reserved;
+  uint8_t iv[16];              // Contador inicial: nonce aleatorio (8) + 0 (8, big endian)
+  uint8_t wrapped_key[40];     // Clave de sesión envuelta con la del equipo (RFC 3394)
+} __attribute__((packed));
+
+#define ENCRYPTION_MAGIC 0x31434E45
+#define ENCRYPTION_AES256_CTR 1
+
+struct CryptoStats {
+  uint32_t sessions;           // Claves de sesión generadas
+  uint32_t bytes_encrypted;
+  uint32_t encrypt_us;         // Tiempo total cifrando en el escritor de SD
+  uint32_t block_max_us;       // Peor buffer cifrado
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Carga la clave del equipo (DEVICE_KEY_HEX en aws_config.h), siembra el
+ * generador de claves de sesión y mide el costo de cifrado por buffer. Sin
+ * clave configurada las sesiones no se cifran
+ * Debe ser llamado en setup() antes de holter_init(): la semilla usa el SAR ADC
+ */
+void holter_crypto_init();
+
+/**
+ * Verifica si las sesiones nuevas se guardan cifradas
+ */
+bool holter_crypto_isEnabled();
+
+/**
+ * Genera la clave de sesión y el IV, y completa la extensión del header
+ * @return false si no se pudo preparar el cifrado
+ */
+bool holter_crypto_beginSession(EncryptionHeader* header);
+
+/**
+ * Cifra en el lugar los siguientes len bytes de muestras de la sesión
+ * Lo llama el escritor de SD, nunca el muestreo
+ */
+void holter_crypto_apply(uint8_t* data, size_t len);
+
+/**
+ * Descarta la clave de sesión (después del último buffer escrito)
+ */
+void holter_crypto_endSession();
+
+/**
+ * Obtiene el costo acumulado del cifrado
+ */
+CryptoStats holter_crypto_getStats();
+
+#endif // HOLTER_CRYPTO_H
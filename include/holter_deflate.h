@@ -0,0 +1,130 @@
+#ifndef HOLTER_DEFLATE_H
+#define HOLTER_DEFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compresor deflate (RFC 1951) con envoltura zlib (RFC 1950) y memoria acotada.
+// No depende de Arduino: el mismo código se compila en el host para el
+// benchmark (tools/deflate_bench.cpp).
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#ifndef DEFLATE_WINDOW_BITS
+#define DEFLATE_WINDOW_BITS 11                  // Ventana de 2 KB
+#endif
+
+#ifndef DEFLATE_BLOCK_BYTES
+#define DEFLATE_BLOCK_BYTES 2048                // Bytes de entrada por bloque Huffman
+#endif
+
+#ifndef DEFLATE_MAX_CHAIN
+#define DEFLATE_MAX_CHAIN 32                    // Candidatos revisados por búsqueda
+#endif
+
+#if DEFLATE_WINDOW_BITS < 9 || DEFLATE_WINDOW_BITS > 14
+#error "DEFLATE_WINDOW_BITS debe estar entre 9 y 14 (posiciones de 16 bits)"
+#endif
+
+#define DEFLATE_WINDOW_SIZE (1 << DEFLATE_WINDOW_BITS)
+#define DEFLATE_HASH_BITS DEFLATE_WINDOW_BITS
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+
+// Máximo de bytes por llamada a write() para que la salida quede acotada
+#define DEFLATE_MAX_WRITE 512
+
+// Máximo de bytes que una llamada a write() (≤ DEFLATE_MAX_WRITE) o finish()
+// entrega al sink: un bloque nunca cuesta más que 9 bits por byte de entrada
+#define DEFLATE_MAX_BURST (((DEFLATE_BLOCK_BYTES + 258) * 9) / 8 + 640)
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+/**
+ * Recibe la salida comprimida por bloques a medida que se genera
+ */
+typedef void (*DeflateSink)(const uint8_t* data, size_t len, void* context);
+
+class DeflateEncoder {
+public:
+  /**
+   * Reinicia el encoder y emite la cabecera zlib
+   * El mismo objeto se puede reutilizar para varios streams
+   */
+  void begin(DeflateSink sink, void* context);
+  
+  /**
+   * Comprime len bytes (len ≤ DEFLATE_MAX_WRITE)
+   */
+  void write(const uint8_t* data, size_t len);
+  
+  /**
+   * Vacía lo pendiente, cierra el último bloque y escribe el Adler-32
+   */
+  void finish();
+  
+  /**
+   * Bytes entregados al sink desde begin()
+   */
+  size_t totalOut() const { return outTotal; }
+
+private:
+  struct HuffSym {
+    uint16_t key;
+    uint16_t sym;
+  };
+  
+  void process(bool flush);
+  void slide();
+  int findMatch(size_t pos, size_t avail, int* distance);
+  void insertHash(size_t pos);
+  void addLiteral(uint8_t value);
+  void addMatch(int length, int distance);
+  void flushBlock(bool final);
+  void buildLengths(const uint16_t* freq, int count, uint8_t* lengths, int maxLength);
+  void buildCodes(const uint8_t* lengths, int count, uint16_t* codes);
+  void emitTokens();
+  void putBits(uint32_t value, int count);
+  void alignToByte();
+  void putByte(uint8_t value);
+  void flushOutput();
+  
+  DeflateSink sink;
+  void* sinkContext;
+  
+  // Ventana deslizante: 2 ventanas, la primera mitad es el historial
+  uint8_t window[2 * DEFLATE_WINDOW_SIZE];
+  size_t windowEnd;
+  size_t position;
+  uint16_t head[DEFLATE_HASH_SIZE];            // Posición + 1 (0 = vacío)
+  uint16_t prev[DEFLATE_WINDOW_SIZE];
+  
+  // Bloque en curso (literal: dist = 0; match: lit = largo - 3)
+  uint8_t tokenLit[DEFLATE_BLOCK_BYTES];
+  uint16_t tokenDist[DEFLATE_BLOCK_BYTES];
+  size_t tokenCount;
+  size_t blockBytes;
+  uint16_t litFreq[286];
+  uint16_t distFreq[30];
+  
+  // Tablas Huffman del bloque que se está emitiendo
+  uint8_t litLengths[288];
+  uint16_t litCodes[288];
+  uint8_t distLengths[30];
+  uint16_t distCodes[30];
+  HuffSym scratch[288];
+  
+  // Salida
+  uint32_t bitBuffer;
+  int bitCount;
+  uint8_t out[256];
+  size_t outLength;
+  size_t outTotal;
+  uint32_t adlerA;
+  uint32_t adlerB;
+};
+
+#endif // HOLTER_DEFLATE_H
@@ -0,0 +1,77 @@
+#ifndef HOLTER_EVENTS_H
+#define HOLTER_EVENTS_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define EVENT_QUEUE_LENGTH 16
+
+// Botón de la placa (GPIO0, activo en bajo): lo leen la pantalla y el loop principal
+#define EVENT_BUTTON_PIN 0
+
+// Rebotes: se ignoran flancos más cercanos que esto al último click válido
+#define EVENT_BUTTON_DEBOUNCE_MS 200
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+enum HolterEventType {
+  EVT_SEGMENT_CLOSED,          // param: índice del segmento cerrado
+  EVT_CAPTURE_STOPPED,         // La captura se detuvo (grabación programada completa o error)
+  EVT_UPLOAD_DONE,             // param: 1 = cola drenada, 0 = error
+  EVT_BUTTON                   // param: clicks acumulados desde el arranque
+};
+
+struct HolterEvent {
+  HolterEventType type;
+  uint32_t param;
+  uint32_t timestamp_us;       // micros() al publicarlo
+};
+
+struct EventStats {
+  uint32_t posted;
+  uint32_t dropped;            // Cola llena: el evento se perdió
+  uint32_t button_clicks;
+  uint32_t button_bounces;     // Flancos descartados por el debounce
+  uint32_t latency_max_us;     // Del post a la entrega en holter_events_wait()
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Crea la cola de eventos y engancha la interrupción del botón
+ * Llamar en setup() antes de crear las tareas que publican eventos
+ */
+void holter_events_init();
+
+/**
+ * Publica un evento para el loop principal (desde una tarea, no bloquea)
+ * @return false si la cola estaba llena
+ */
+bool holter_events_post(HolterEventType type, uint32_t param = 0);
+
+/**
+ * Bloquea hasta el próximo evento o hasta timeoutMs
+ * El loop principal duerme aquí en lugar de sondear con delay()
+ * @return true si llegó un evento
+ */
+bool holter_events_wait(HolterEvent* event, uint32_t timeoutMs);
+
+/**
+ * Clicks válidos del botón desde el arranque (contados en la interrupción)
+ * Cada consumidor guarda el último valor visto para detectar clicks nuevos
+ */
+uint32_t holter_events_getButtonClicks();
+
+/**
+ * Obtiene los contadores de la cola y del botón
+ */
+EventStats holter_events_getStats();
+
+#endif // HOLTER_EVENTS_H
@@ -0,0 +1,118 @@
+#ifndef HOLTER_FORMAT_H
+#define HOLTER_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Formato de los archivos de sesión y conversión de las muestras del ECG.
+// No depende de Arduino: lo usan el firmware (holter_capture.cpp), la
+// captura en el host (env:native, src/native_main.cpp) y las herramientas.
+//
+// Archivo: FileHeader | SessionInfo (v3) | EncryptionHeader (si está
+// cifrado) | ECGSample[num_ecg_samples] | MetricsTrailer + snapshot (opcional)
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define SESSION_MAGIC 0x45434744       // "ECGD"
+#define SESSION_VERSION 3
+#define SESSION_ECG_RATE_HZ 250
+
+// Offsets en el archivo para actualizar al cerrar el segmento
+#define SESSION_OFFSET_NUM_ECG 20
+#define SESSION_OFFSET_NUM_IMU 24
+
+// Cadena analógica: salida del AD8232 centrada en 1.65 V con ganancia 1100,
+// muestras int16 con 6553.6 cuentas por mV (±5 mV)
+#define ECG_ADC_OFFSET_V 1.65f
+#define ECG_FRONTEND_GAIN 1100.0f
+#define ECG_COUNTS_PER_MV 6553.6f
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct FileHeader {
+  uint32_t magic;              // 0x45434744 = "ECGD"
+  uint16_t version;            // 1 = muestras, 2 = EncryptionHeader + muestras, 3 = SessionInfo (+ ...)
+  uint16_t device_id;
+  uint32_t session_id;
+  uint32_t timestamp_start;
+  uint16_t ecg_sample_rate;
+  uint16_t imu_sample_rate;
+  uint32_t num_ecg_samples;
+  uint32_t num_imu_samples;
+} __attribute__((packed));
+
+// Extensión del header en la versión 3, justo después del FileHeader. Los
+// tiempos de arranque (desde el reset) se repiten en cada segmento del arranque
+#define SESSION_FLAG_ENCRYPTED 0x01   // Sigue un EncryptionHeader (holter_crypto.h)
+#define SESSION_FLAG_METRICS 0x02     // Después de las muestras: MetricsTrailer + snapshot
+
+struct SessionInfo {
+  uint32_t flags;              // SESSION_FLAG_*
+  uint32_t first_sample_us;    // Reset → primera muestra (se toma en RAM, sin esperar a la SD)
+  uint32_t first_write_us;     // Reset → primeras muestras escritas en la SD
+  uint32_t ram_samples;        // Muestras tomadas antes de esa primera escritura
+  uint32_t sd_mount_ms;        // Montaje de la SD en segundo plano
+  uint32_t segment_start_ms;   // Reset → primera muestra de este segmento
+} __attribute__((packed));
+
+// Cierre del segmento (versión 3 con SESSION_FLAG_METRICS): el snapshot
+// CBOR de holter_metrics.h al cerrar, en claro aunque las muestras vayan cifradas
+#define METRICS_TRAILER_MAGIC 0x4352544D  // "MTRC"
+
+struct MetricsTrailer {
+  uint32_t magic;
+  uint16_t length;             // Bytes del snapshot que sigue
+} __attribute__((packed));
+
+struct ECGSample {
+  int16_t derivation_I;
+  int16_t derivation_II;
+  int16_t derivation_III;
+} __attribute__((packed));
+
+struct IMUSample {
+  int16_t accel_x;
+  int16_t accel_y;
+  int16_t accel_z;
+} __attribute__((packed));
+
+static_assert(sizeof(FileHeader) == 28, "header de 28 bytes");
+static_assert(SESSION_OFFSET_NUM_ECG == 20 && SESSION_OFFSET_NUM_IMU == 24, "offsets del header");
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Convierte las tensiones de las derivaciones I y II (salidas del AD8232,
+ * en volts) a una muestra; la III se calcula como II - I
+ */
+ECGSample holter_format_ecgSample(float leadI_V, float leadII_V);
+
+/**
+ * Inversa de holter_format_ecgSample() para una derivación: tensión a la
+ * salida del AD8232 que produce ese valor (reproducción de sesiones)
+ */
+float holter_format_leadVolts(int16_t value);
+
+/**
+ * Header inicial de un segmento, con los contadores en 0
+ * @param sessionId Grabación a la que pertenece (timestamp de su primer segmento)
+ * @param timestampStart Unix timestamp del inicio del segmento
+ */
+void holter_format_initHeader(FileHeader* header, uint32_t sessionId, uint32_t timestampStart);
+
+/**
+ * Copia a un bloque de escritura lo que entre de data, desde *index (que
+ * avanza). Una muestra puede quedar partida entre dos bloques: el resto va
+ * al siguiente cuando el llamador vacía este
+ * @return Bytes copiados; si *index llegó a capacity el bloque está lleno
+ */
+size_t holter_format_fillBlock(uint8_t* block, size_t capacity, size_t* index,
+                               const uint8_t* data, size_t len);
+
+#endif // HOLTER_FORMAT_H
@@ -0,0 +1,127 @@
+#ifndef HOLTER_HAL_H
+#define HOLTER_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Capa mínima sobre el hardware: reloj, ADC del ECG, archivos, TCP y el
+// envío de ventanas al SSD1306. Hay dos implementaciones que se eligen al
+// compilar: src/hal_esp32.cpp (firmware) y src/hal_native.cpp (env:native,
+// Linux). La configuración propia de cada una está en holter_hal_esp32.h y
+// holter_hal_native.h.
+//
+// No depende de Arduino: los módulos que solo usan esta interfaz y los
+// headers sin Arduino (holter_format.h, ...) compilan en los dos entornos.
+
+// ============================================================================
+// RELOJ
+// ============================================================================
+
+/**
+ * Microsegundos desde el arranque (da la vuelta a los ~71 min, como micros())
+ */
+uint32_t hal_micros();
+
+/**
+ * Milisegundos desde el arranque
+ */
+uint32_t hal_millis();
+
+/**
+ * Espera us microsegundos. En el host con reloj virtual solo adelanta el
+ * reloj: la captura corre tan rápido como dé la CPU
+ */
+void hal_delayUs(uint32_t us);
+
+// ============================================================================
+// ADC
+// ============================================================================
+
+/**
+ * Prepara la lectura de las derivaciones
+ */
+bool hal_adc_begin();
+
+/**
+ * Lee las derivaciones I y II: tensión a la salida de cada AD8232, en volts
+ * @return false si no hay señal (en el host: terminó la fuente simulada)
+ */
+bool hal_adc_readLeads(float* leadI, float* leadII);
+
+// ============================================================================
+// ALMACENAMIENTO
+// ============================================================================
+
+// Rutas absolutas como en la SD ("/session_..."); en el host cuelgan del
+// directorio configurado
+struct HalFile;
+
+/**
+ * Abre un archivo
+ * @param mode "r" lectura, "w" crea o trunca, "r+" lectura y escritura
+ * @return nullptr si no se pudo
+ */
+HalFile* hal_file_open(const char* path, const char* mode);
+
+size_t hal_file_read(HalFile* file, void* data, size_t len);
+size_t hal_file_write(HalFile* file, const void* data, size_t len);
+bool hal_file_seek(HalFile* file, uint32_t offset);
+uint32_t hal_file_size(HalFile* file);
+
+/**
+ * Persiste lo escrito (FAT y directorio en la SD)
+ */
+void hal_file_flush(HalFile* file);
+
+void hal_file_close(HalFile* file);
+
+bool hal_fs_remove(const char* path);
+bool hal_fs_rename(const char* from, const char* to);
+
+// ============================================================================
+// RED
+// ============================================================================
+
+// Conexión TCP en claro (el TLS del upload queda fuera de esta capa)
+struct HalSocket;
+
+/**
+ * Conecta por TCP
+ * @return nullptr si no se pudo en timeoutMs
+ */
+HalSocket* hal_net_connect(const char* host, uint16_t port, uint32_t timeoutMs);
+
+/**
+ * Envía todo el buffer
+ * @return false si se cortó la conexión
+ */
+bool hal_net_send(HalSocket* socket, const void* data, size_t len);
+
+/**
+ * Recibe lo que haya, esperando hasta timeoutMs a que llegue algo
+ * @return Bytes leídos, 0 si venció el plazo, -1 si se cerró la conexión
+ */
+int hal_net_recv(HalSocket* socket, void* data, size_t len, uint32_t timeoutMs);
+
+void hal_net_close(HalSocket* socket);
+
+// ============================================================================
+// PANTALLA
+// ============================================================================
+
+// SSD1306 de 128x64 en modo de direccionamiento horizontal: la RAM del
+// panel son 8 páginas de 128 columnas, un byte = 8 filas de una columna
+
+/**
+ * Dirección I2C del panel (ya inicializado)
+ */
+bool hal_display_begin(uint8_t address);
+
+/**
+ * Escribe en la página page, columnas [first, last], los last - first + 1
+ * bytes de data
+ * @return Bytes en el bus (comandos, datos, direcciones y bytes de control)
+ */
+uint32_t hal_display_write(uint8_t page, uint8_t first, uint8_t last, const uint8_t* data);
+
+#endif // HOLTER_HAL_H
@@ -0,0 +1,21 @@
+#ifndef HOLTER_HAL_ESP32_H
+#define HOLTER_HAL_ESP32_H
+
+#include <XSpaceBioV10.h>
+#include "holter_hal.h"
+#include "holter_synth.h"
+
+// Configuración de la implementación de holter_hal.h en el ESP32
+
+/**
+ * Placa de la que se leen las derivaciones (la llama holter_init())
+ */
+void hal_esp32_setBioBoard(XSpaceBioV10Board* bioBoard);
+
+/**
+ * Reemplaza la placa por el generador sintético (nullptr: vuelve a la
+ * placa). Se llama antes de arrancar la tarea de captura
+ */
+void hal_esp32_setSynth(EcgSynth* synth);
+
+#endif // HOLTER_HAL_ESP32_H
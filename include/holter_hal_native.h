@@ -0,0 +1,91 @@
+#ifndef HOLTER_HAL_NATIVE_H
+#define HOLTER_HAL_NATIVE_H
+
+#include "holter_hal.h"
+#include "holter_format.h"
+#include "holter_synth.h"
+#include <vector>
+
+// Configuración de la implementación de holter_hal.h en Linux (env:native):
+// el ADC sale de una fuente simulada, los archivos de un directorio, la red
+// son sockets comunes y el panel es una copia de su RAM en memoria.
+
+// ============================================================================
+// FUENTES DEL ADC
+// ============================================================================
+
+// Señal que devuelve hal_adc_readLeads(): una muestra por llamada, en volts
+// a la salida de los AD8232 (la misma escala que lee el ESP32)
+class AdcSource {
+public:
+  virtual ~AdcSource() {}
+  
+  /**
+   * @return false si se terminó la señal
+   */
+  virtual bool next(float* leadI, float* leadII) = 0;
+};
+
+// Reproduce las muestras de un archivo de sesión en claro (versiones 1 y 3)
+class ReplaySource : public AdcSource {
+public:
+  /**
+   * Carga las muestras del archivo
+   * @param loop Al terminar vuelve a empezar en lugar de cortar la señal
+   */
+  bool open(const char* path, bool loop);
+  
+  bool next(float* leadI, float* leadII) override;
+  
+  uint32_t samples() const { return data.size(); }
+
+private:
+  std::vector<ECGSample> data;
+  size_t position = 0;
+  bool loop = false;
+};
+
+// Señal del generador sintético (holter_synth.h): no se termina nunca
+class SynthSource : public AdcSource {
+public:
+  void begin(const SynthConfig& config) { synth.begin(config); }
+  
+  bool next(float* leadI, float* leadII) override;
+  
+  const EcgSynth& generator() const { return synth; }
+
+private:
+  EcgSynth synth;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Fuente del ADC (nullptr: línea de base, 0 mV en las dos derivaciones)
+ */
+void hal_native_setAdcSource(AdcSource* source);
+
+/**
+ * Directorio que hace de raíz de la SD (por defecto el actual)
+ */
+void hal_native_setStorageRoot(const char* dir);
+
+/**
+ * Reloj real en lugar del virtual. Con el virtual (por defecto) el reloj solo
+ * avanza en hal_delayUs(): la captura no espera y corre a la velocidad de la CPU
+ */
+void hal_native_setRealtime(bool realtime);
+
+/**
+ * Guarda el contenido del panel como imagen PBM de 128x64
+ */
+bool hal_native_dumpDisplay(const char* path);
+
+/**
+ * Bytes que habrían pasado por el bus I2C del panel desde el arranque
+ */
+uint64_t hal_native_displayBytes();
+
+#endif // HOLTER_HAL_NATIVE_H
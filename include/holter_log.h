@@ -0,0 +1,209 @@
+#ifndef HOLTER_LOG_H
+#define HOLTER_LOG_H
+
+#include <Arduino.h>
+#include <type_traits>
+
+// Log diferido para los caminos calientes (captura, escritor de SD, upload).
+// La llamada no formatea ni toca la UART: copia el puntero al formato y los
+// argumentos crudos a un ring sin locks y vuelve. Una tarea de prioridad
+// baja los formatea y los escribe después, como texto o como tramas
+// binarias que decodifica tools/log_decode.py con el firmware.elf.
+//
+//   LOG_I("CAPTURE", "Segmento %lu cerrado (%lu muestras)", segment, samples);
+//
+// Los %s se copian al registrar (hasta LOG_MAX_STRING caracteres, el resto
+// se corta y el registro cuenta como truncado), así que sirven para
+// String::c_str() de variables temporales. Los textos largos que hay que ver
+// completos (cuerpos de error del servidor) van directo a Serial. No se
+// admiten anchos con '*' ni %p.
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Nivel de compilación: los logs por encima desaparecen del binario
+// (formato incluido). Se cambia con build_flags = -D HOLTER_LOG_LEVEL=4
+#ifndef HOLTER_LOG_LEVEL
+#define HOLTER_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE 8192           // Potencia de 2
+#define LOG_MAX_RECORD 96            // Formato, marca de tiempo, nivel y argumentos
+#define LOG_MAX_STRING 31
+
+// Trama del modo binario: sync B7 7B | length(2) | registro | crc32(4)
+#define LOG_SYNC0 0xB7
+#define LOG_SYNC1 0x7B
+
+#define LOG_RECORD_TRUNCATED 0x80    // En el byte de nivel: faltan argumentos o se cortó un %s
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+// Registro: fmt(4) | timestamp_us(4) | level(1) | argumentos. Los enteros
+// ocupan 4 bytes (8 con %ll), los %f un float de 4 y los %s longitud(1) + bytes
+struct LogWriter {
+  uint8_t data[LOG_MAX_RECORD];
+  uint16_t len;
+  uint32_t startCycles;
+  
+  void begin(uint8_t level, const char* fmt) {
+    startCycles = ESP.getCycleCount();
+    uint32_t now = (uint32_t)micros();
+    uint32_t address = (uint32_t)(uintptr_t)fmt;
+    memcpy(data, &address, 4);
+    memcpy(data + 4, &now, 4);
+    data[8] = level;
+    len = 9;
+  }
+  
+  void put(const void* value, size_t size) {
+    if (len + size > LOG_MAX_RECORD) {
+      data[8] |= LOG_RECORD_TRUNCATED;
+      return;
+    }
+    memcpy(data + len, value, size);
+    len += size;
+  }
+  
+  void putString(const char* value) {
+    if (value == nullptr) value = "(null)";
+    size_t size = strnlen(value, LOG_MAX_STRING);
+    if (len + 1 + size > LOG_MAX_RECORD) {
+      data[8] |= LOG_RECORD_TRUNCATED;
+      return;
+    }
+    if (size == LOG_MAX_STRING && value[size] != '\0') data[8] |= LOG_RECORD_TRUNCATED;
+    data[len++] = (uint8_t)size;
+    memcpy(data + len, value, size);
+    len += size;
+  }
+};
+
+struct LogStats {
+  uint32_t records;
+  uint32_t dropped;            // Ring lleno: el registro se perdió
+  uint32_t truncated;          // Argumentos que no entraron en LOG_MAX_RECORD o %s cortados
+  uint32_t ring_max_bytes;     // Máximo ocupado del ring
+  uint64_t cycles_total;       // Costo en el llamador: codificar + copiar al ring
+  uint32_t cycles_max;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Arranca la tarea que vacía el ring (núcleo 0, prioridad baja)
+ * Los registros anteriores quedan en el ring y salen apenas arranca.
+ * @param binary true emite tramas para tools/log_decode.py en lugar de texto
+ */
+void holter_log_init(bool binary);
+
+/**
+ * Copia un registro ya codificado al ring. Lo usan las macros LOG_*
+ */
+void holter_log_commit(LogWriter& writer);
+
+/**
+ * Vacía el ring de forma sincrónica (antes de ESP.restart() o deep sleep)
+ */
+void holter_log_flush();
+
+/**
+ * Obtiene los contadores del log y el costo por llamada en ciclos
+ */
+LogStats holter_log_getStats();
+
+/**
+ * Compara el costo de un registro diferido contra formatearlo con snprintf
+ * (en ciclos, promedio de varias vueltas) y lo imprime en el arranque
+ */
+void holter_log_benchmark();
+
+// ============================================================================
+// CODIFICACIÓN DE ARGUMENTOS
+// ============================================================================
+
+inline void logArg(LogWriter& writer, const char* value) {
+  writer.putString(value);
+}
+
+inline void logArg(LogWriter& writer, float value) {
+  writer.put(&value, 4);
+}
+
+inline void logArg(LogWriter& writer, double value) {
+  float narrow = (float)value;
+  writer.put(&narrow, 4);
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+logArg(LogWriter& writer, T value) {
+  if (sizeof(T) > 4) {
+    uint64_t wide = (uint64_t)value;
+    writer.put(&wide, 8);
+  } else {
+    uint32_t word = (uint32_t)value;
+    writer.put(&word, 4);
+  }
+}
+
+template<typename... Args>
+inline void holter_log_write(uint8_t level, const char* fmt, Args... args) {
+  LogWriter writer;
+  writer.begin(level, fmt);
+  int expand[] = { 0, (logArg(writer, args), 0)... };
+  (void)expand;
+  holter_log_commit(writer);
+}
+
+// Solo para que el compilador revise formato y tipos: nunca se ejecuta
+static inline void holter_log_check(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void holter_log_check(const char* fmt, ...) {}
+
+#define HOLTER_LOG(level, tag, fmt, ...) do { \
+    if (0) holter_log_check("[" tag "] " fmt, ##__VA_ARGS__); \
+    holter_log_write(level, "[" tag "] " fmt, ##__VA_ARGS__); \
+  } while (0)
+
+// Nivel apagado: los argumentos siguen revisados (y usados) pero no se
+// evalúan, y el formato no llega al binario
+#define HOLTER_LOG_OFF(tag, fmt, ...) do { \
+    if (0) holter_log_check("[" tag "] " fmt, ##__VA_ARGS__); \
+  } while (0)
+
+#if HOLTER_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(tag, fmt, ...) HOLTER_LOG(LOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_E(tag, fmt, ...) HOLTER_LOG_OFF(tag, fmt, ##__VA_ARGS__)
+#endif
+
+#if HOLTER_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(tag, fmt, ...) HOLTER_LOG(LOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_W(tag, fmt, ...) HOLTER_LOG_OFF(tag, fmt, ##__VA_ARGS__)
+#endif
+
+#if HOLTER_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(tag, fmt, ...) HOLTER_LOG(LOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(tag, fmt, ...) HOLTER_LOG_OFF(tag, fmt, ##__VA_ARGS__)
+#endif
+
+#if HOLTER_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(tag, fmt, ...) HOLTER_LOG(LOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_D(tag, fmt, ...) HOLTER_LOG_OFF(tag, fmt, ##__VA_ARGS__)
+#endif
+
+#endif // HOLTER_LOG_H
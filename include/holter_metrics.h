@@ -0,0 +1,102 @@
+#ifndef HOLTER_METRICS_H
+#define HOLTER_METRICS_H
+
+#include <Arduino.h>
+
+// Registro de métricas del equipo: contadores, gauges e histogramas de
+// buckets fijos. Se actualizan desde cualquier tarea con una operación
+// atómica (sin locks ni memoria dinámica) y se exportan como un snapshot
+// CBOR compacto: se publica en el topic de telemetría y va al final de
+// cada segmento. El orden de los índices es el formato: solo se agrega
+// al final de cada enum (y se sube METRICS_SCHEMA_VERSION si cambia algo).
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define METRICS_SCHEMA_VERSION 1
+#define METRICS_BUCKETS 9            // 8 límites superiores + desborde
+#define METRICS_SNAPSHOT_MAX 512     // Peor caso ~440 bytes (todo en 32 bits)
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+enum MetricCounter {
+  MC_SD_WRITE_ERRORS,          // Escrituras fallidas o parciales del escritor de SD
+  MC_BUFFER_WAITS,             // El muestreo esperó un buffer libre
+  MC_SEGMENTS,                 // Segmentos cerrados
+  MC_UPLOADS_OK,
+  MC_UPLOADS_FAILED,           // Cada uno es un reintento con backoff
+  MC_UPLOAD_BYTES,             // Bytes enviados a S3 (comprimidos)
+  MC_WIFI_JOINS,
+  MC_MQTT_CONNECTS,
+  MC_COUNT
+};
+
+enum MetricGauge {
+  MG_HEAP_FREE,                // Bytes
+  MG_HEAP_MIN,                 // Mínimo histórico del heap libre desde el arranque
+  MG_WIFI_RSSI,                // dBm (0 sin WiFi)
+  MG_QUEUE_DEPTH,              // Sesiones pendientes de subir
+  MG_SEGMENT_RATE_MHZ,         // Frecuencia efectiva del último segmento, en mHz
+  MG_COUNT
+};
+
+enum MetricHistogram {
+  MH_SAMPLE_LATENESS_US,       // Atraso de cada muestra respecto de su turno
+  MH_SD_WRITE_US,              // Escritura (y flush) de un buffer a la SD
+  MH_SD_LOCK_WAIT_US,          // Espera del escritor por el lock de SD
+  MH_UPLOAD_KBPS,              // Throughput de cada PUT exitoso
+  MH_WIFI_RSSI,                // -dBm, muestreado en cada reporte
+  MH_DISPLAY_DRAW_US,          // Un redibujo de la pantalla
+  MH_COUNT
+};
+
+struct MetricsHistogramSnapshot {
+  uint32_t buckets[METRICS_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Suma a un contador (cualquier tarea o núcleo)
+ */
+void holter_metrics_add(MetricCounter counter, uint32_t amount = 1);
+
+/**
+ * Fija el valor actual de un gauge
+ */
+void holter_metrics_set(MetricGauge gauge, int32_t value);
+
+/**
+ * Agrega una observación a un histograma: una búsqueda entre 8 límites y un
+ * incremento atómico, apto para el lazo de muestreo
+ */
+void holter_metrics_observe(MetricHistogram histogram, uint32_t value);
+
+/**
+ * Lee un contador, un gauge o un histograma (para el reporte [PERF])
+ */
+uint32_t holter_metrics_getCounter(MetricCounter counter);
+int32_t holter_metrics_getGauge(MetricGauge gauge);
+MetricsHistogramSnapshot holter_metrics_getHistogram(MetricHistogram histogram);
+
+/**
+ * Límites superiores (inclusive) de los buckets de un histograma
+ */
+const uint32_t* holter_metrics_getBounds(MetricHistogram histogram);
+
+/**
+ * Codifica el snapshot completo (acumulado desde el arranque):
+ *   {0: versión, 1: device_id, 2: uptime_s, 3: [contadores],
+ *    4: [gauges], 5: [[buckets..., count, max], ...]}
+ * @return Bytes escritos, 0 si no entra en capacity
+ */
+size_t holter_metrics_encode(uint8_t* buffer, size_t capacity);
+
+#endif // HOLTER_METRICS_H
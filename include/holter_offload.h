@@ -0,0 +1,38 @@
+#ifndef HOLTER_OFFLOAD_H
+#define HOLTER_OFFLOAD_H
+
+#include <Arduino.h>
+#include "holter_offload_proto.h"
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// El puerto de logs también transporta la descarga (ver holter_offload_proto.h).
+// El buffer de TX deja que una trama entre completa sin bloquear a los logs
+// de las otras tareas, en particular a la de captura
+#define OFFLOAD_BAUD 921600
+#define OFFLOAD_RX_BUFFER 1024
+#define OFFLOAD_TX_BUFFER 4096
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Arranca la tarea que atiende al cliente de descarga por el puerto serie
+ * (tools/offload_client.cpp). Serial ya debe estar iniciado a OFFLOAD_BAUD
+ */
+void holter_offload_init();
+
+/**
+ * Verifica si hay una transferencia en curso
+ */
+bool holter_offload_isActive();
+
+/**
+ * Obtiene los contadores del protocolo
+ */
+OffloadStats holter_offload_getStats();
+
+#endif // HOLTER_OFFLOAD_H
@@ -0,0 +1,273 @@
+#ifndef HOLTER_OFFLOAD_PROTO_H
+#define HOLTER_OFFLOAD_PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Protocolo de descarga de sesiones por USB-serie, para cuando no hay WiFi.
+// Tramas con CRC32 y ventana deslizante (go-back-N) sobre el mismo UART de
+// los logs: el receptor descarta todo lo que no sea una trama válida.
+// No depende de Arduino: lo comparten el firmware (holter_offload.cpp),
+// el cliente de Linux (tools/offload_client.cpp) y el simulador sobre un
+// pty (tools/offload_sim.cpp).
+//
+// Trama: sync A5 5A | type(1) | transfer(1) | seq(4) | length(2) | payload | crc32(4)
+// Enteros little endian. El CRC32 (IEEE) cubre desde type hasta el payload.
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define OFFLOAD_VERSION 1
+
+#define OFFLOAD_SYNC0 0xA5
+#define OFFLOAD_SYNC1 0x5A
+#define OFFLOAD_HEADER_SIZE 10
+#define OFFLOAD_CRC_SIZE 4
+
+#ifndef OFFLOAD_MAX_PAYLOAD
+#define OFFLOAD_MAX_PAYLOAD 1024               // ~1.5% de overhead por trama
+#endif
+
+#ifndef OFFLOAD_WINDOW
+#define OFFLOAD_WINDOW 8                       // Tramas en vuelo sin confirmar
+#endif
+
+#ifndef OFFLOAD_RETRANSMIT_MS
+#define OFFLOAD_RETRANSMIT_MS 400              // Sin confirmaciones: reenviar desde la base
+#endif
+
+#ifndef OFFLOAD_ABANDON_MS
+#define OFFLOAD_ABANDON_MS 5000                // El host desapareció: cerrar la transferencia
+#endif
+
+#define OFFLOAD_MAX_FRAME (OFFLOAD_HEADER_SIZE + OFFLOAD_MAX_PAYLOAD + OFFLOAD_CRC_SIZE)
+
+// ============================================================================
+// MENSAJES
+// ============================================================================
+
+enum OffloadFrameType {
+  // Host -> equipo. transfer identifica la transferencia que abre el comando
+  OFFLOAD_HELLO = 0x01,        // -> OFFLOAD_INFO
+  OFFLOAD_LIST = 0x02,         // -> transferencia con una OffloadEntry por segmento
+  OFFLOAD_GET = 0x03,          // OffloadGet -> transferencia con los bytes pedidos
+  OFFLOAD_ACK = 0x04,          // seq = siguiente trama esperada (acumulativo)
+  OFFLOAD_NAK = 0x05,          // seq = primera trama faltante: reenviar desde ahí
+  OFFLOAD_CANCEL = 0x06,
+  
+  // Equipo -> host
+  OFFLOAD_INFO = 0x81,         // OffloadInfo
+  OFFLOAD_BEGIN = 0x82,        // seq 0: OffloadBegin
+  OFFLOAD_DATA = 0x83,         // seq 1..N: contenido, OFFLOAD_MAX_PAYLOAD por trama
+  OFFLOAD_END = 0x84,          // seq N+1: OffloadEnd
+  OFFLOAD_ERROR = 0x85         // Comando rechazado: código (1) + texto
+};
+
+enum OffloadError {
+  OFFLOAD_ERR_BAD_REQUEST = 1,
+  OFFLOAD_ERR_NOT_FOUND = 2,
+  OFFLOAD_ERR_READ = 3,
+  OFFLOAD_ERR_NO_STORAGE = 4
+};
+
+struct OffloadInfo {
+  uint8_t version;             // OFFLOAD_VERSION
+  uint8_t window;              // OFFLOAD_WINDOW
+  uint16_t max_payload;        // OFFLOAD_MAX_PAYLOAD
+  uint32_t baud;               // Velocidad del UART del equipo
+} __attribute__((packed));
+
+struct OffloadGet {
+  uint32_t recording_id;
+  uint32_t segment;
+  uint32_t offset;             // Primer byte del archivo
+  uint32_t length;             // 0 = hasta el final
+} __attribute__((packed));
+
+struct OffloadBegin {
+  uint32_t total_bytes;        // Contenido de la transferencia (sin tramas)
+} __attribute__((packed));
+
+struct OffloadEnd {
+  uint32_t crc32;              // De todo el contenido, verificación de punta a punta
+} __attribute__((packed));
+
+#define OFFLOAD_ENTRY_OPEN 0x01        // Segmento que se está grabando ahora
+#define OFFLOAD_ENTRY_ENCRYPTED 0x02   // Muestras cifradas (versión 2, o 3 con SESSION_FLAG_ENCRYPTED)
+
+struct OffloadEntry {
+  uint32_t recording_id;
+  uint32_t segment;
+  uint32_t size;               // Bytes del archivo
+  uint32_t timestamp_start;    // Del FileHeader
+  uint32_t num_ecg_samples;    // Del FileHeader (0 si todavía está abierto)
+  uint16_t version;            // Del FileHeader
+  uint16_t flags;              // OFFLOAD_ENTRY_*
+} __attribute__((packed));
+
+// ============================================================================
+// TRAMAS
+// ============================================================================
+
+/**
+ * CRC32 IEEE (el de zlib). Encadenable: crc = offload_crc32(crc, ...), desde 0
+ */
+uint32_t offload_crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+/**
+ * Arma una trama completa en out (al menos OFFLOAD_HEADER_SIZE + len + OFFLOAD_CRC_SIZE)
+ * @return bytes de la trama
+ */
+size_t offload_encodeFrame(uint8_t* out, uint8_t type, uint8_t transfer, uint32_t seq,
+                           const uint8_t* payload, uint16_t len);
+
+struct OffloadFrame {
+  uint8_t type;
+  uint8_t transfer;
+  uint32_t seq;
+  uint16_t length;
+  const uint8_t* payload;      // Válido hasta el siguiente push()
+};
+
+/**
+ * Reconoce tramas en un flujo de bytes con ruido (logs, bytes perdidos):
+ * lo que no tenga sync, longitud y CRC válidos se descarta
+ */
+class OffloadParser {
+public:
+  OffloadParser();
+  
+  /**
+   * @return true si con este byte se completó una trama válida (ver frame())
+   */
+  bool push(uint8_t byte);
+  
+  const OffloadFrame& frame() const { return current; }
+  
+  uint32_t crcErrors() const { return badCrc; }
+  uint32_t skippedBytes() const { return skipped; }
+
+private:
+  enum State { HUNT_SYNC0, HUNT_SYNC1, HEADER, BODY };
+  
+  State state;
+  uint8_t buffer[OFFLOAD_MAX_FRAME];
+  size_t length;
+  size_t expected;
+  OffloadFrame current;
+  uint32_t badCrc;
+  uint32_t skipped;
+};
+
+// ============================================================================
+// EQUIPO
+// ============================================================================
+
+/**
+ * Acceso a los segmentos. Todas las llamadas vienen del mismo hilo
+ */
+class OffloadStorage {
+public:
+  virtual ~OffloadStorage() {}
+  
+  /**
+   * Prepara el listado y devuelve cuántas entradas tiene
+   */
+  virtual bool beginList(uint32_t* count) = 0;
+  
+  /**
+   * Entrada index del listado. Normalmente se piden en orden; tras una
+   * retransmisión el índice puede retroceder
+   */
+  virtual bool listEntry(uint32_t index, OffloadEntry* entry) = 0;
+  
+  virtual bool open(uint32_t recording, uint32_t segment, uint32_t* size) = 0;
+  virtual int read(uint32_t offset, uint8_t* buffer, size_t len) = 0;
+  
+  /**
+   * Cierra el archivo o el listado en curso
+   */
+  virtual void close() = 0;
+};
+
+/**
+ * Enlace serie. read() y write() no deben bloquear por mucho tiempo
+ */
+class OffloadLink {
+public:
+  virtual ~OffloadLink() {}
+  
+  virtual int read(uint8_t* buffer, size_t len) = 0;
+  virtual void write(const uint8_t* data, size_t len) = 0;
+  
+  /**
+   * Bytes que write() acepta sin bloquear (para no enviar tramas a medias
+   * ni retener el UART frente a los logs)
+   */
+  virtual size_t writable() = 0;
+  
+  virtual uint32_t millis() = 0;
+};
+
+struct OffloadStats {
+  uint32_t transfers;          // Comandos LIST/GET atendidos
+  uint32_t frames_sent;
+  uint32_t frames_resent;      // Por NAK o por timeout
+  uint32_t bytes_sent;         // Contenido confirmado por el host
+  uint32_t crc_errors;         // Tramas del host descartadas
+  uint32_t read_errors;
+};
+
+/**
+ * Atiende los comandos del host y envía las transferencias con ventana
+ * deslizante. poll() se llama en un bucle: no bloquea
+ */
+class OffloadServer {
+public:
+  OffloadServer(OffloadStorage* storage, OffloadLink* link, uint32_t baud);
+  
+  void poll();
+  
+  /**
+   * Hay una transferencia en curso (el llamador puede dejar de dormir)
+   */
+  bool busy() const { return active; }
+  
+  OffloadStats stats() const;
+
+private:
+  void handle(const OffloadFrame& frame);
+  void startList(uint8_t transfer);
+  void startGet(uint8_t transfer, const OffloadGet& request);
+  void startTransfer(uint8_t transfer, bool list, uint32_t first, uint32_t total);
+  void finish();
+  void sendError(uint8_t transfer, uint8_t code, const char* message);
+  bool sendFrame(uint32_t seq);
+  size_t fillData(uint32_t seq, uint8_t* out);
+  void send(uint8_t type, uint8_t transfer, uint32_t seq, const uint8_t* payload, uint16_t len);
+  
+  OffloadStorage* storage;
+  OffloadLink* link;
+  uint32_t baud;
+  OffloadParser parser;
+  
+  bool active;
+  bool listing;                // El contenido es el listado, no un archivo
+  uint8_t transfer;
+  uint32_t firstByte;          // Offset en el archivo (o 0 en el listado)
+  uint32_t totalBytes;
+  uint32_t lastSeq;            // seq del OFFLOAD_END
+  uint32_t base;               // Primera trama sin confirmar
+  uint32_t nextSeq;            // Siguiente trama a enviar
+  uint32_t highestSent;        // Para contar retransmisiones
+  uint32_t lastProgress;       // millis() de la última confirmación o reenvío
+  uint32_t lastAck;            // millis() de la última confirmación
+  uint32_t contentCrc;
+  uint32_t crcUpTo;            // Bytes ya incluidos en contentCrc
+  
+  uint8_t frameBuffer[OFFLOAD_MAX_FRAME];
+  OffloadStats counters;
+};
+
+#endif // HOLTER_OFFLOAD_PROTO_H
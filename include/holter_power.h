@@ -0,0 +1,56 @@
+#ifndef HOLTER_POWER_H
+#define HOLTER_POWER_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Escalado de frecuencia: 240 MHz con trabajo, 80 MHz en reposo. No se baja
+// a 40 MHz (XTAL) porque ahí también cae el APB y los drivers de Arduino
+// (SPI de la SD, UART) calculan sus divisores una sola vez
+#define POWER_MAX_FREQ_MHZ 240
+#define POWER_MIN_FREQ_MHZ 80
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct PowerStats {
+  bool pm_enabled;             // El core de Arduino se compiló con CONFIG_PM_ENABLE
+  bool light_sleep;            // Tickless idle + light sleep automático activos
+  float idle_pct[2];           // Tiempo en la tarea idle por núcleo, desde la consulta anterior
+  uint32_t window_ms;          // Duración de esa ventana
+  uint32_t sleep_ticks;        // Ticks dormidos en tickless idle (acumulado)
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Configura el escalado de frecuencia y, si el core lo permite, el light
+ * sleep automático entre ráfagas de muestras. Arranca la medición de carga.
+ * @param lightSleep false deja solo el escalado de frecuencia
+ */
+void holter_power_init(bool lightSleep);
+
+/**
+ * Impide el light sleep mientras un periférico necesita el reloj (la UART
+ * de la descarga por USB pierde lo que llega dormida). Admite anidamiento.
+ */
+void holter_power_holdAwake();
+
+/**
+ * Libera un holter_power_holdAwake()
+ */
+void holter_power_release();
+
+/**
+ * Obtiene la carga de CPU medida desde la llamada anterior
+ * Pensado para un único consumidor periódico (el reporte [PERF])
+ */
+PowerStats holter_power_getStats();
+
+#endif // HOLTER_POWER_H
@@ -0,0 +1,111 @@
+#ifndef HOLTER_QUEUE_H
+#define HOLTER_QUEUE_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define QUEUE_MAX_ENTRIES 64
+#define QUEUE_FILENAME_LEN 40
+#define SYNC_MAX_RECORDINGS 8             // Grabaciones con high-water mark persistente
+
+// Flags de una entrada
+#define QUEUE_FLAG_PRIORITY 0x01   // Sesión marcada: se sube antes que el resto
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct QueueEntry {
+  char filename[QUEUE_FILENAME_LEN];  // Path completo en SD ("/session_<ts>.bin")
+  uint32_t file_size;
+  uint32_t created;                   // Unix timestamp de encolado
+  uint32_t last_attempt;              // Unix timestamp del último intento (0 = nunca)
+  uint32_t next_attempt;              // No reintentar antes de este timestamp
+  uint16_t retries;
+  uint8_t flags;
+  uint8_t state;                      // Uso interno (libre / pendiente)
+};
+
+// Avance de una grabación segmentada (ver holter_getRecordingID()).
+// Un segmento se confirma cuando S3 acepta el PUT: en ese momento se borra de
+// la SD. high_water es el primer segmento que todavía no está en S3, o sea
+// que [0, high_water) ya es durable y contiguo en la nube
+struct RecordingSync {
+  uint32_t recording_id;
+  uint32_t segments_sealed;           // Segmentos cerrados y encolados
+  uint32_t high_water;
+  uint32_t segments_synced;           // Confirmados por S3 (incluye los que están sobre high_water)
+  uint32_t bytes_synced;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Carga la cola persistente desde la SD y recupera sesiones huérfanas
+ * (archivos session_*.bin que no estaban encolados, p.ej. tras un corte de energía)
+ * desde el catálogo de sesiones; la raíz de la SD solo se recorre para
+ * reconstruir el catálogo
+ * Debe ser llamado en setup() después de holter_init()
+ */
+void holter_queue_init();
+
+/**
+ * Encola un archivo para upload. Si ya estaba encolado solo actualiza flags.
+ * @param filename Path completo del archivo en SD
+ * @param flags QUEUE_FLAG_* (0 = normal)
+ * @return true si quedó encolado
+ */
+bool holter_queue_push(const String& filename, uint8_t flags = 0);
+
+/**
+ * Obtiene la siguiente sesión a subir: primero las marcadas, luego la más reciente,
+ * ignorando las que están en espera por backoff
+ * @return true si hay una entrada elegible
+ */
+bool holter_queue_next(QueueEntry* entry);
+
+/**
+ * Lista hasta maxEntries sesiones elegibles en el mismo orden que holter_queue_next()
+ * Permite pedir las URLs de varias sesiones en una sola solicitud
+ * @return Número de entradas escritas en entries
+ */
+int holter_queue_peek(QueueEntry* entries, int maxEntries);
+
+/**
+ * Marca una sesión como subida: la quita de la cola y borra el archivo de la SD
+ * Si es un segmento, avanza el high-water mark de su grabación
+ */
+void holter_queue_markDone(const String& filename);
+
+/**
+ * Registra un intento fallido y programa el reintento con backoff exponencial
+ */
+void holter_queue_markFailed(const String& filename);
+
+/**
+ * Obtiene el avance de sincronización de una grabación
+ * @return false si la grabación no tiene segmentos registrados
+ */
+bool holter_queue_getSync(uint32_t recordingId, RecordingSync* sync);
+
+/**
+ * Número de sesiones pendientes (incluye las que están en backoff)
+ */
+int holter_queue_depth();
+
+/**
+ * Bytes pendientes de subir
+ */
+uint32_t holter_queue_bytesPending();
+
+/**
+ * Imprime el contenido de la cola por Serial
+ */
+void holter_queue_printStatus();
+
+#endif // HOLTER_QUEUE_H
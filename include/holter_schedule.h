@@ -0,0 +1,128 @@
+#ifndef HOLTER_SCHEDULE_H
+#define HOLTER_SCHEDULE_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Programa por defecto (al encender): 5 minutos de grabación cada hora y
+// WiFi solo cada 6 grabaciones, o antes si lo pendiente supera 2 MB
+#define SCHEDULE_RECORD_SEC 300
+#define SCHEDULE_PERIOD_SEC 3600
+#define SCHEDULE_UPLOAD_EVERY 6
+#define SCHEDULE_UPLOAD_BYTES (2UL * 1024 * 1024)
+#define SCHEDULE_WINDOW_MS 180000UL       // Tiempo máximo con WiFi por ventana
+
+// Botón que despierta al equipo (el mismo EVENT_BUTTON_PIN de holter_events.h,
+// GPIO0 = RTC_GPIO11, activo en bajo)
+#define SCHEDULE_BUTTON_PIN 0
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+// Programa de grabaciones. Vive en memoria RTC: un cambio con
+// holter_schedule_setConfig() se mantiene entre ciclos de deep sleep
+struct ScheduleConfig {
+  uint32_t record_sec;         // Duración de cada grabación (se redondea a segmentos enteros)
+  uint32_t period_sec;         // De inicio a inicio de grabación
+  uint32_t upload_every;       // Abrir una ventana de WiFi cada N grabaciones...
+  uint32_t upload_bytes;       // ...o antes si la cola supera estos bytes
+  uint32_t window_ms;
+};
+
+enum WakeReason {
+  WAKE_POWER_ON,               // Encendido, reset o ESP.restart(): estado RTC nuevo
+  WAKE_TIMER,                  // Grabación programada
+  WAKE_BUTTON                  // Grabación a pedido del paciente
+};
+
+struct ScheduleStats {
+  uint32_t cycles;             // Grabaciones completadas desde el encendido
+  uint32_t wakes_timer;
+  uint32_t wakes_button;
+  uint32_t upload_windows;
+  uint32_t cycles_since_upload;
+  uint32_t pending_sessions;   // Cola al dormirse (se conoce sin leer la SD)
+  uint32_t pending_bytes;
+  uint32_t boot_last_ms;       // Fin del deep sleep → inicio de la app (ROM + bootloader, estimado)
+  uint32_t wake_last_ms;       // Fin del deep sleep → primera muestra
+  uint32_t wake_max_ms;
+  uint32_t awake_last_ms;      // Tiempo despierto en el último ciclo
+  uint32_t sleep_last_ms;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Lee la causa del despertar y recupera el estado guardado en RTC
+ * Debe ser lo primero en setup(). Con enabled = false el equipo graba de
+ * forma continua y el resto de las funciones no hacen nada.
+ */
+void holter_schedule_init(bool enabled);
+
+/**
+ * Verifica si las grabaciones programadas con deep sleep están activas
+ */
+bool holter_schedule_isEnabled();
+
+/**
+ * Causa del arranque actual
+ */
+WakeReason holter_schedule_getWakeReason();
+
+/**
+ * Verifica si la grabación de este ciclo ya cumplió record_sec
+ * Llamar al cerrar cada segmento
+ */
+bool holter_schedule_recordingDone();
+
+/**
+ * Decide si este ciclo abre una ventana de WiFi para subir la cola
+ * (cada upload_every grabaciones, cola sobre upload_bytes, o despertar por botón)
+ */
+bool holter_schedule_uploadDue();
+
+/**
+ * Habilita el drenado de la cola hasta window_ms
+ */
+void holter_schedule_openUploadWindow();
+
+/**
+ * Verifica si la tarea de upload puede drenar la cola ahora
+ * Siempre true en modo continuo; en modo programado, solo con la ventana abierta
+ */
+bool holter_schedule_uploadAllowed();
+
+/**
+ * Verifica si la ventana de WiFi abierta ya superó window_ms
+ */
+bool holter_schedule_windowExpired();
+
+/**
+ * Guarda el estado en RTC, desmonta la SD y entra en deep sleep hasta la
+ * próxima grabación programada o el botón. No retorna.
+ * Llamar con la captura detenida y el WiFi apagado.
+ */
+void holter_schedule_sleep();
+
+/**
+ * Obtiene el programa de grabaciones actual
+ */
+ScheduleConfig holter_schedule_getConfig();
+
+/**
+ * Cambia el programa de grabaciones (se conserva en RTC hasta un corte de energía)
+ */
+void holter_schedule_setConfig(const ScheduleConfig& config);
+
+/**
+ * Obtiene contadores y latencias del despertar (persisten en RTC)
+ */
+ScheduleStats holter_schedule_getStats();
+
+#endif // HOLTER_SCHEDULE_H
@@ -0,0 +1,72 @@
+#ifndef HOLTER_SEGMENT_H
+#define HOLTER_SEGMENT_H
+
+#include "holter_format.h"
+#include "holter_hal.h"
+
+// Núcleo de la captura de un segmento, sin Arduino: la muestra (ADC y
+// conversión), el llenado del bloque de escritura y los headers al abrir y
+// cerrar el archivo. Lo usan holter_capture.cpp en el equipo y
+// native_main.cpp en el host (env:native), los dos sobre la HAL, así que el
+// host mide y prueba el mismo código que corre en el equipo.
+//
+// Quedan en holter_capture.cpp, por depender de FreeRTOS o del equipo: el
+// reloj del muestreo, el escritor de SD en segundo plano, el cifrado, el
+// catálogo, el trailer de métricas y la verificación del archivo.
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define SEGMENT_DURATION_SEC 15
+#define SEGMENT_BLOCK_SIZE 8192        // Cada buffer del doble buffer de escritura
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+// Bloque de escritura que llena el muestreo
+struct SegmentBlock {
+  uint8_t* data;
+  size_t capacity;
+  size_t index;                // Bytes ocupados
+};
+
+// Recibe el bloque lleno; al volver debe dejarlo vacío (index en 0, sobre
+// el mismo buffer u otro)
+typedef void (*SegmentFlushFn)(SegmentBlock* block, void* context);
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Una muestra: lee las derivaciones por la HAL y las convierte
+ * @return false si no hay señal (en el host: terminó la fuente simulada)
+ */
+bool holter_segment_readSample(ECGSample* sample);
+
+/**
+ * Agrega bytes al bloque. Cada vez que se llena llama a flush y sigue con
+ * el resto: una muestra puede quedar partida entre dos bloques
+ */
+void holter_segment_append(SegmentBlock* block, const void* data, size_t len,
+                           SegmentFlushFn flush, void* context);
+
+/**
+ * Escribe FileHeader (contadores en 0) y SessionInfo al principio del archivo
+ * @return true si se escribieron completos
+ */
+bool holter_segment_writeHeaders(HalFile* file, uint32_t recording, uint32_t timestamp,
+                                 const SessionInfo* info);
+
+/**
+ * Cierre del segmento: actualiza los contadores del header y reescribe
+ * SessionInfo con los tiempos ya conocidos. Deja el archivo posicionado
+ * después de SessionInfo; no hace flush
+ * @return true si se escribieron completos
+ */
+bool holter_segment_patchHeaders(HalFile* file, uint32_t ecgSamples, uint32_t imuSamples,
+                                 const SessionInfo* info);
+
+#endif // HOLTER_SEGMENT_H
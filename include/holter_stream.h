@@ -0,0 +1,62 @@
+#ifndef HOLTER_STREAM_H
+#define HOLTER_STREAM_H
+
+#include <Arduino.h>
+#include "holter_capture.h"
+
+// Streaming en vivo del ECG por MQTT, en frames de 50 muestras codificadas
+// como deltas. Las muestras se copian a un ring propio (~4 s, 6 bytes por
+// muestra) y los frames se arman desde ahí, no desde los bloques de escritura
+// de la captura: el escritor de la SD los cifra en su lugar (AES-CTR) apenas
+// los recibe, cada 2 s o al llenarse, y la captura los vuelve a llenar en
+// cuanto quedan libres. Sus muestras en claro no duran lo que tarda la red,
+// y una muestra puede quedar partida entre dos bloques.
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct StreamStats {
+  uint32_t frames_sent;
+  uint32_t frames_dropped;     // Frames descartados por atraso o límite de tasa
+  uint32_t samples_dropped;    // Muestras perdidas por ring lleno (red caída o upload en curso)
+  uint32_t bytes_sent;
+  uint32_t publish_max_us;     // Peor tiempo de un publish (back-pressure de la red)
+  uint32_t publish_errors;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+/**
+ * Activa o desactiva el streaming en vivo por MQTT (topic TOPIC_LIVE)
+ * Al activarlo se descarta lo acumulado: se transmite desde la muestra actual
+ */
+void holter_stream_setEnabled(bool enabled);
+
+/**
+ * Verifica si el streaming en vivo está activo
+ */
+bool holter_stream_isEnabled();
+
+/**
+ * Entrega una muestra ECG al ring del streaming
+ * Llamado por la captura en cada muestra. Nunca bloquea: si el ring está
+ * lleno la muestra se descarta y se cuenta en samples_dropped.
+ */
+void holter_stream_pushSample(const ECGSample& sample);
+
+/**
+ * Publica los frames listos (delta-encoded) directamente desde el ring
+ * Debe llamarse desde la tarea de upload (dueña del cliente MQTT).
+ * Conecta WiFi/MQTT si hace falta y descarta frames si va atrasado.
+ */
+void holter_stream_service();
+
+/**
+ * Obtiene las métricas del streaming en vivo
+ */
+StreamStats holter_stream_getStats();
+
+#endif // HOLTER_STREAM_H
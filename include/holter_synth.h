@@ -0,0 +1,169 @@
+#ifndef HOLTER_SYNTH_H
+#define HOLTER_SYNTH_H
+
+#include <stdint.h>
+#include "holter_format.h"
+
+// Generador de ECG sintético de dos derivaciones (I y II; la III la calcula
+// holter_format_ecgSample) con el acelerómetro correspondiente, para probar
+// captura, compresión, detección y upload sin electrodos.
+//
+// Cada latido es el modelo de ECGSYN (McSharry et al., 2003) en forma
+// cerrada: las ondas P, Q, R, S y T son gaussianas alrededor del pico R, con
+// P y T desplazadas según √RR (el QT se acorta con la FC). Los RR salen de
+// un tacograma con componentes LF (0.1 Hz) y HF (respiración) más ruido.
+// Encima: deriva de línea de base, zumbido de red, ruido y, durante una
+// caminata, un artefacto por paso sincronizado con el acelerómetro.
+//
+// Determinista: la misma semilla y configuración dan la misma señal (PRNG
+// propio y sin <random>, cuyas distribuciones cambian entre bibliotecas).
+// Solo float: en el ESP32 el double se emula. No depende de Arduino: lo usan
+// el firmware (hal_esp32.cpp), la captura en el host y tools/synth_sessions.cpp.
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define SYNTH_MAX_EPISODES 8
+#define SYNTH_IMU_RATE_HZ 50              // Como IMU_SAMPLE_RATE_HZ de lambda2.py
+#define SYNTH_ACCEL_COUNTS_PER_G 2048.0f  // ±16 g (ACCEL_SCALE de lambda2.py)
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+enum SynthEpisodeType : uint8_t {
+  SYNTH_AF,                    // Fibrilación auricular: RR irregular, sin P, ondas f
+  SYNTH_PVC,                   // Extrasístoles ventriculares; param = fracción de latidos (0-1)
+  SYNTH_TACHY,                 // Taquicardia sinusal; param = FC en lpm
+  SYNTH_WALK                   // Caminata; param = pasos por minuto. Sube la FC y agrega artefactos
+};
+
+struct SynthEpisode {
+  uint8_t type;                // SynthEpisodeType
+  uint32_t start_s;            // Desde el inicio de la señal
+  uint32_t duration_s;
+  float param;
+};
+
+struct SynthConfig {
+  uint32_t seed = 1;
+  uint16_t sample_rate = SESSION_ECG_RATE_HZ;
+  float heart_rate_bpm = 70.0f;
+  float hrv_sdnn_ms = 40.0f;     // Desvío de los RR en ritmo sinusal
+  float lf_hf_ratio = 1.5f;
+  float respiration_hz = 0.25f;
+  float amplitude = 1.0f;        // Escala de las ondas (R de 1.3 mV en II)
+  float wander_mv = 0.1f;        // Deriva de línea de base (respiración + 0.05 Hz)
+  float mains_hz = 50.0f;        // 50 o 60
+  float mains_mv = 0.02f;
+  float noise_mv = 0.01f;        // Ruido blanco por derivación (desvío)
+  float motion_mv = 0.3f;        // Artefacto por paso durante SYNTH_WALK
+  SynthEpisode episodes[SYNTH_MAX_EPISODES];
+  uint8_t episode_count = 0;
+};
+
+// Tipo de latido, con los símbolos de las anotaciones de MIT-BIH
+#define SYNTH_BEAT_NONE 0
+#define SYNTH_BEAT_NORMAL 'N'
+#define SYNTH_BEAT_PVC 'V'
+
+struct SynthSample {
+  float lead_I_mV;
+  float lead_II_mV;
+  uint8_t beat;                // SYNTH_BEAT_*: el pico R cae en esta muestra
+  bool has_imu;                // Toca muestra del acelerómetro (SYNTH_IMU_RATE_HZ)
+  float accel_g[3];            // x lateral, y vertical (+1 g de pie), z anteroposterior
+};
+
+// ============================================================================
+// GENERADOR
+// ============================================================================
+
+class EcgSynth {
+public:
+  /**
+   * Reinicia la señal con una configuración (se copia)
+   */
+  void begin(const SynthConfig& config);
+  
+  /**
+   * Agrega un episodio a la configuración antes de begin()
+   * @return false si ya hay SYNTH_MAX_EPISODES
+   */
+  static bool addEpisode(SynthConfig* config, SynthEpisodeType type,
+                         uint32_t startS, uint32_t durationS, float param);
+  
+  /**
+   * Siguiente muestra a sample_rate
+   */
+  void next(SynthSample* out);
+  
+  /**
+   * Muestras generadas desde begin()
+   */
+  uint32_t samples() const { return sampleIndex; }
+  
+  /**
+   * Latidos generados hasta ahora, por tipo
+   */
+  uint32_t beats(uint8_t type) const { return type == SYNTH_BEAT_PVC ? pvcBeats : normalBeats; }
+
+private:
+  struct Beat {
+    int32_t r;                 // Muestra del pico R
+    float scale;               // √RR: posición y ancho de P y T
+    float gain;                // Variación de amplitud latido a latido
+    uint8_t type;
+    bool withP;                // Sin P durante la FA
+  };
+  
+  static const int BEAT_WINDOW = 6;
+  
+  uint32_t random();
+  float uniform();
+  float gaussian();
+  bool episodeActive(uint8_t type, float t, float* param) const;
+  float nextRR(float t);
+  void scheduleBeat();
+  void beatWaves(const Beat& beat, int32_t n, float* leadI, float* leadII) const;
+  void walkStep(float t, float* artifact, float* accel);
+  
+  SynthConfig config;
+  uint64_t rngState = 0;
+  uint32_t sampleIndex = 0;
+  float dt = 0;
+  float rrMean = 1.0f;         // Sigue a la FC objetivo con una constante de tiempo
+  float rrFraction = 0;        // Resto al redondear los RR a muestras
+  float lfPhase = 0;
+  float hfPhase = 0;
+  float slowPhase = 0;
+  float mainsPhase = 0;
+  float fibPhase = 0;
+  float stepPhase = 0;
+  float stepAge = 1.0f;        // Segundos desde el último apoyo
+  float stepGain = 1.0f;
+  uint32_t imuDivider = 1;
+  int32_t lookahead = 0;
+  bool leftStep = false;
+  bool pendingCompensation = false;
+  Beat window[BEAT_WINDOW];    // Latidos que pueden tocar la muestra actual
+  int beatCount = 0;
+  uint32_t normalBeats = 0;
+  uint32_t pvcBeats = 0;
+};
+
+/**
+ * Tensión a la salida del AD8232 para una derivación en mV (entrada de
+ * hal_adc_readLeads(); inversa de la escala de holter_format_ecgSample)
+ */
+inline float holter_synth_leadVolts(float mV) {
+  return ECG_ADC_OFFSET_V + mV * (ECG_FRONTEND_GAIN / 1000.0f);
+}
+
+/**
+ * Muestra del acelerómetro en cuentas de SYNTH_ACCEL_COUNTS_PER_G (satura en ±16 g)
+ */
+IMUSample holter_synth_imuSample(const float accel_g[3]);
+
+#endif // HOLTER_SYNTH_H
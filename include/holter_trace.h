@@ -0,0 +1,111 @@
+#ifndef HOLTER_TRACE_H
+#define HOLTER_TRACE_H
+
+#include <Arduino.h>
+
+// Trazas de inicio/fin alrededor de los caminos calientes (lectura del ADC,
+// entrega de buffers, escritura y flush de la SD, mqttClient.loop(), PUT a
+// S3, dibujo de la pantalla). Cada evento va a un ring fijo que se pisa en
+// círculo: al volcarlo queda lo último que pasó, por tarea y por núcleo.
+// tools/trace_to_chrome.py convierte el volcado en JSON para Perfetto.
+//
+//   static void flushBuffer(bool sync) {
+//     TRACE_SCOPE("capture.flushBuffer");
+//     ...
+//   }
+//
+// Con HOLTER_TRACE en 0 (por defecto) las macros no generan código: ni
+// llamadas, ni nombres, ni el ring.
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Se activa con build_flags = -D HOLTER_TRACE=1
+#ifndef HOLTER_TRACE
+#define HOLTER_TRACE 0
+#endif
+
+#define TRACE_RING_EVENTS 4096       // Potencia de 2 (8 bytes por evento)
+#define TRACE_MAX_NAMES 32
+#define TRACE_MAX_TASKS 12
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+// Marca de tiempo en us de esp_timer: común a los dos núcleos y estable con
+// el escalado de frecuencia (el contador de ciclos no lo es)
+struct TraceEvent {
+  uint32_t timestamp_us;
+  uint8_t name;                // Índice en la tabla de nombres
+  char phase;                  // 'B' inicio, 'E' fin, 'I' instantáneo
+  uint8_t task;                // Índice en la tabla de tareas
+  uint8_t core;
+};
+
+struct TraceStats {
+  uint32_t events;             // Registrados desde el arranque (los más viejos se pisan)
+  uint32_t names;
+  uint32_t tasks;
+  uint32_t dumps;
+};
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+#if HOLTER_TRACE
+
+/**
+ * Registra un nombre de traza y devuelve su índice. Lo usan las macros, una
+ * vez por punto de traza; el mismo texto devuelve siempre el mismo índice.
+ */
+uint8_t holter_trace_name(const char* name);
+
+/**
+ * Agrega un evento al ring (cualquier tarea, cualquier núcleo; no bloquea)
+ */
+void holter_trace_record(uint8_t name, char phase);
+
+/**
+ * Vuelca el ring como texto, del evento más viejo al más nuevo. El registro
+ * se pausa mientras dura el volcado.
+ * @param out Serial o un File abierto en la SD
+ * @param label Primera línea del volcado (qué lo disparó)
+ * @return Eventos escritos
+ */
+uint32_t holter_trace_dump(Print& out, const char* label);
+
+/**
+ * Obtiene los contadores de la traza
+ */
+TraceStats holter_trace_getStats();
+
+// Inicio al construir, fin al salir del bloque
+struct HolterTraceScope {
+  uint8_t name;
+  explicit HolterTraceScope(uint8_t name) : name(name) { holter_trace_record(name, 'B'); }
+  ~HolterTraceScope() { holter_trace_record(name, 'E'); }
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+
+#define TRACE_SCOPE(name) \
+  static const uint8_t TRACE_CONCAT(traceName_, __LINE__) = holter_trace_name(name); \
+  HolterTraceScope TRACE_CONCAT(traceScope_, __LINE__)(TRACE_CONCAT(traceName_, __LINE__))
+
+#define TRACE_INSTANT(name) do { \
+    static const uint8_t traceName = holter_trace_name(name); \
+    holter_trace_record(traceName, 'I'); \
+  } while (0)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+
+#endif // HOLTER_TRACE
+
+#endif // HOLTER_TRACE_H
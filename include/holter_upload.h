@@ -21,6 +21,55 @@ enum UploadState {
   UPLOAD_ERROR
 };
 
+// ============================================================================
+// ESTADÍSTICAS DE CONEXIÓN
+// ============================================================================
+
+struct TLSStats {
+  uint32_t mqtt_handshakes;          // Conexiones MQTT nuevas (handshake TLS completo)
+  uint32_t mqtt_reuses;              // Conexiones MQTT reutilizadas
+  uint32_t mqtt_last_handshake_ms;
+  uint32_t mqtt_total_handshake_ms;
+  uint32_t s3_handshakes;            // Conexiones HTTPS nuevas a S3
+  uint32_t s3_reuses;                // PUTs sobre una conexión keep-alive
+  uint32_t s3_last_handshake_ms;
+  uint32_t s3_total_handshake_ms;
+};
+
+struct ConnectStats {
+  uint32_t wifi_fast_joins;          // Conexiones directas (BSSID/canal en caché, sin escaneo)
+  uint32_t wifi_fast_failures;       // Conexiones directas que cayeron al escaneo completo
+  uint32_t wifi_full_joins;          // Conexiones con escaneo + DHCP
+  uint32_t wifi_last_ms;
+  uint32_t ntp_syncs;                // Esperas bloqueantes por NTP (RTC sin hora)
+  uint32_t ntp_skipped;              // Conexiones que usaron la hora del RTC
+  uint32_t first_byte_last_ms;       // Inicio del upload → primer publish MQTT
+  uint32_t first_byte_max_ms;
+};
+
+struct ControlStats {
+  uint32_t requests_cbor;            // Solicitudes de URL enviadas en CBOR
+  uint32_t requests_json;            // Solicitudes de URL enviadas en JSON
+  uint32_t request_last_bytes;
+  uint32_t request_build_us;         // Armado de la última solicitud
+  uint32_t responses_cbor;
+  uint32_t responses_json;
+  uint32_t response_last_bytes;
+  uint32_t response_parse_us;        // Parseo de la última respuesta (incluye guardar las URLs)
+  uint32_t response_parse_max_us;
+  uint32_t parse_errors;
+};
+
+struct UploadStats {
+  uint32_t files_uploaded;
+  uint32_t bytes_uploaded;           // Bytes enviados (comprimidos si UPLOAD_COMPRESSION)
+  uint32_t bytes_raw;                // Tamaño original de las sesiones subidas
+  uint32_t deflate_ms;               // CPU del compresor (ambas pasadas)
+  uint32_t transfer_ms;              // Tiempo total de los PUT exitosos
+  uint32_t last_kbps;                // Throughput del último PUT
+  uint32_t sd_wait_max_us;           // Peor espera por el lock de SD al leer
+};
+
 // ============================================================================
 // INTERFACE PÚBLICA
 // ============================================================================
@@ -33,28 +82,59 @@ void holter_initUpload();
 
 /**
  * Conecta a WiFi
+ * Usa directamente el último AP (BSSID/canal) e IP guardados en RTC y cae al
+ * escaneo completo + DHCP solo si eso falla. No espera NTP si la hora es reciente.
  * @return true si se conectó exitosamente
  */
 bool holter_connectWiFi();
 
 /**
  * Desconecta WiFi para ahorrar energía
+ * Cierra también las conexiones MQTT y S3 persistentes
  */
 void holter_disconnectWiFi();
 
+/**
+ * Conecta WiFi y MQTT si hace falta (reutiliza las conexiones existentes)
+ * Usado por el streaming en vivo fuera de un drenado
+ * @return true si MQTT quedó conectado
+ */
+bool holter_connectMQTT();
+
+/**
+ * Cliente MQTT compartido (AWS IoT). Solo debe usarse desde la tarea de
+ * upload: PubSubClient no es thread-safe
+ */
+PubSubClient& holter_getMQTTClient();
+
 /**
  * Inicia el proceso de upload de un archivo a AWS
+ * El archivo se encola como prioritario y se drena la cola completa
  * @param filename Nombre del archivo a subir (con path completo)
  * @return true si se inició correctamente
  */
 bool holter_startUpload(String filename);
 
+/**
+ * Inicia el drenado de la cola persistente (ver holter_queue.h)
+ * Sube varias sesiones pendientes usando una sola conexión WiFi/MQTT
+ * @return true si había sesiones elegibles y se inició el proceso
+ */
+bool holter_startQueueDrain();
+
 /**
  * Loop de upload - debe ser llamado continuamente durante el upload
- * Maneja la máquina de estados: WiFi → MQTT → S3
+ * Maneja la máquina de estados: WiFi → MQTT → (URL → S3) por cada sesión
  */
 void holter_uploadLoop();
 
+/**
+ * Bloquea la tarea de upload hasta que holter_uploadLoop() tenga trabajo:
+ * mientras se espera la URL duerme sobre el socket MQTT hasta que llegue la
+ * respuesta (o pasen maxMs); en los demás estados cede un tick
+ */
+void holter_uploadWait(unsigned long maxMs);
+
 /**
  * Cancela el upload actual
  */
@@ -97,4 +177,30 @@ bool holter_isMQTTConnected();
  */
 String holter_getLastError();
 
+/**
+ * Obtiene los tiempos de handshake TLS y el número de conexiones reutilizadas
+ */
+TLSStats holter_getTLSStats();
+
+/**
+ * Obtiene el throughput acumulado de subida a S3
+ */
+UploadStats holter_getUploadStats();
+
+/**
+ * Obtiene los tiempos de conexión WiFi/NTP y del inicio del upload al primer byte MQTT
+ */
+ConnectStats holter_getConnectStats();
+
+/**
+ * Obtiene tamaños y tiempos de armado/parseo de los mensajes de control MQTT
+ */
+ControlStats holter_getControlStats();
+
+/**
+ * Publica el snapshot de métricas en TOPIC_TELEMETRY si MQTT está conectado
+ * Llamar desde la tarea de upload (el cliente MQTT no admite otra)
+ */
+bool holter_publishTelemetry();
+
 #endif // HOLTER_UPLOAD_H
@@ -16,6 +16,7 @@ import matplotlib.pyplot as plt
 from io import BytesIO, StringIO
 from scipy import signal
 import csv
+import zlib
 
 # Clientes AWS
 s3_client = boto3.client('s3')
@@ -24,6 +25,10 @@ s3_client = boto3.client('s3')
 OUTPUT_BUCKET = os.environ.get('OUTPUT_BUCKET', 'holter-processed-data')
 REGION = os.environ.get('AWS_REGION', 'us-east-1')
 
+# Claves de equipo para sesiones cifradas: {"<key_id>": "<64 dígitos hex>"}
+# Deben coincidir con DEVICE_KEY_HEX / DEVICE_KEY_ID de cada aws_config.h
+DEVICE_KEYS = json.loads(os.environ.get('DEVICE_KEYS', '{}'))
+
 # Escalas del ESP32
 ECG_SCALE_FACTOR = 6553.6
 ACCEL_SCALE = 16.0 / 32768.0  # Solo acelerómetro
@@ -278,8 +283,96 @@ class SignalProcessor:
         return filtered, preprocessed, heart_rates, motion_mask
 
 
+def decompress_if_needed(file_data):
+    """Descomprime sesiones subidas con compresión zlib (.bin.z)
+    
+    Se detecta por contenido: el archivo sin comprimir empieza con el magic
+    "ECGD" (0x44 en el primer byte) y el stream zlib con CM=8 en el primer byte.
+    """
+    if len(file_data) >= 2 and (file_data[0] & 0x0F) == 8 and \
+            ((file_data[0] << 8) | file_data[1]) % 31 == 0:
+        raw = zlib.decompress(file_data)
+        print(f"[PARSE] Descomprimido: {len(file_data)} -> {len(raw)} bytes")
+        return raw
+    return file_data
+
+
+def strip_session_info(file_data):
+    """Quita la extensión SessionInfo de los headers versión 3
+
+    Después del header de 28 bytes van 24 bytes con los tiempos de arranque
+    del equipo: flags(4) + first_sample_us(4) + first_write_us(4) +
+    ram_samples(4) + sd_mount_ms(4) + segment_start_ms(4). Se registran en el
+    log y se devuelve el archivo equivalente en versión 1, o 2 si el flag 0x01
+    indica que sigue la extensión de cifrado.
+    """
+    header_size = 28
+    info_format = '<IIIIII'
+    info_size = struct.calcsize(info_format)
+
+    if len(file_data) < header_size + info_size:
+        return file_data
+    version = struct.unpack_from('<H', file_data, 4)[0]
+    if version != 3:
+        return file_data
+
+    flags, first_sample_us, first_write_us, ram_samples, sd_mount_ms, segment_start_ms = \
+        struct.unpack_from(info_format, file_data, header_size)
+    print(f"[PARSE] Arranque: primera muestra {first_sample_us / 1000:.1f} ms, "
+          f"primera escritura {first_write_us / 1000:.1f} ms ({ram_samples} muestras en RAM), "
+          f"montaje SD {sd_mount_ms} ms, segmento desde {segment_start_ms} ms")
+
+    header = bytearray(file_data[:header_size])
+    struct.pack_into('<H', header, 4, 2 if flags & 0x01 else 1)
+    return bytes(header) + file_data[header_size + info_size:]
+
+
+def decrypt_if_needed(file_data):
+    """Descifra sesiones guardadas con DEVICE_KEY_HEX (header versión 2)
+    
+    Después del header de 28 bytes va la extensión de cifrado de 64 bytes:
+    magic "ENC1"(4) + algorithm(1) + key_id(1) + reserved(2) + iv(16) +
+    clave de sesión envuelta con la del equipo (RFC 3394, 40).
+    Devuelve el archivo equivalente en versión 1 (header + muestras en claro).
+    """
+    header_size = 28
+    enc_format = '<IBBH16s40s'
+    enc_size = struct.calcsize(enc_format)
+    
+    if len(file_data) < header_size + 2:
+        return file_data
+    version = struct.unpack_from('<H', file_data, 4)[0]
+    if version != 2:
+        return file_data
+    
+    magic, algorithm, key_id, _, iv, wrapped_key = \
+        struct.unpack_from(enc_format, file_data, header_size)
+    if magic != 0x31434E45 or algorithm != 1:
+        raise ValueError(f"Extensión de cifrado no soportada: magic 0x{magic:08X}, algoritmo {algorithm}")
+    
+    device_key = DEVICE_KEYS.get(str(key_id))
+    if device_key is None:
+        raise ValueError(f"Sesión cifrada con la clave {key_id}, que no está en DEVICE_KEYS")
+    
+    # Import diferido: solo las sesiones cifradas necesitan la capa cryptography
+    from cryptography.hazmat.primitives.keywrap import aes_key_unwrap
+    from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+    
+    session_key = aes_key_unwrap(bytes.fromhex(device_key), wrapped_key)
+    decryptor = Cipher(algorithms.AES(session_key), modes.CTR(iv)).decryptor()
+    samples = decryptor.update(file_data[header_size + enc_size:]) + decryptor.finalize()
+    print(f"[PARSE] Descifrado: {len(samples)} bytes (clave {key_id})")
+    
+    header = bytearray(file_data[:header_size])
+    struct.pack_into('<H', header, 4, 1)
+    return bytes(header) + samples
+
+
 def parse_binary_file(file_data):
     """Parsea archivo binario del ESP32 - VERSION SOLO ACELEROMETRO"""
+    file_data = decompress_if_needed(file_data)
+    file_data = strip_session_info(file_data)
+    file_data = decrypt_if_needed(file_data)
     print(f"[PARSE] Archivo de {len(file_data)} bytes")
     
     # Header: magic(4) + version(2) + device_id(2) + session_id(4) + timestamp(4) + 
@@ -663,7 +756,7 @@ def lambda_handler(event, context):
         csv_data = generate_csv_data(ecg_data, ecg_filtered, imu_data, motion_mask_imu)
         
         # Base path
-        base_key = object_key.replace('raw/', 'processed/').replace('.bin', '')
+        base_key = object_key.replace('raw/', 'processed/').replace('.bin.z', '').replace('.bin', '')
         
         uploaded_files = []
         
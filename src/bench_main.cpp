@@ -0,0 +1,337 @@
+// Arnés de microbenchmarks en el ESP32 (env:bench)
+//
+// Firmware aparte, sin main.cpp: corre los kernels de holter_bench.h más los
+// que solo existen en el equipo (AES del periférico, métricas, entrega de
+// buffers al escritor) y los mide con el contador de ciclos de la CPU.
+// Cada kernel corre en lotes de ~BENCH_BATCH_US; se informa la mediana de
+// BENCH_BATCHES lotes (una interrupción no mueve la mediana), el mínimo y los
+// cuartiles, que bench_compare.py usa como dispersión.
+//
+// Por serie sale una tabla legible y después el resultado en el JSON de
+// Google Benchmark, entre "[BENCH] JSON" y "[BENCH] Fin", con los ciclos
+// por iteración además del tiempo:
+//   pio run -e bench -t upload && pio device monitor -e bench | tee esp32.log
+//   python3 tools/bench_compare.py base.log esp32.log
+// Cualquier byte recibido por el puerto serie vuelve a correr la suite.
+
+#include <Arduino.h>
+#include <XSpaceBioV10.h>
+#include "holter_bench.h"
+#include "holter_capture.h"
+#include "holter_crypto.h"
+#include "holter_metrics.h"
+#include "holter_log.h"
+#include <algorithm>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define BENCH_BAUD 921600              // Como OFFLOAD_BAUD
+#define BENCH_BATCHES 31
+#define BENCH_BATCH_US 10000
+#define BENCH_MAX_BATCH 100000         // Iteraciones por lote
+#define BENCH_TASK_PRIORITY 5          // La de la tarea de captura
+#define BENCH_CORE 1
+#define WRITER_STUB_PRIORITY 4         // La del escritor de SD
+#define WRITER_STUB_CORE 0             // Del otro lado: devuelve los buffers enseguida
+#define METRICS_ENCODE_BYTES 1024
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct BenchResult {
+  bool skipped;
+  uint32_t iterations;
+  uint32_t cycles;             // Mediana por iteración
+  uint32_t cycles_min;
+  uint32_t cycles_q1;
+  uint32_t cycles_q3;
+};
+
+// Como WriteJob de holter_capture.cpp
+struct BenchJob {
+  uint8_t* data;
+  uint16_t len;
+  bool sync;
+};
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+XSpaceBioV10Board MyBioBoard;
+
+static TaskHandle_t benchTaskHandle = nullptr;
+static volatile uint32_t sink = 0;
+static uint32_t observed = 0;
+
+static uint8_t cipherBlock[BENCH_BLOCK_SIZE];
+static uint8_t spareBlock[BENCH_BLOCK_SIZE];
+static uint8_t* activeBlock = nullptr;
+static QueueHandle_t writeJobs = nullptr;
+static QueueHandle_t freeBuffers = nullptr;
+static TaskHandle_t writerStubHandle = nullptr;
+static uint8_t* metricsBuffer = nullptr;
+
+// ============================================================================
+// KERNELS DEL EQUIPO
+// ============================================================================
+
+// holter_metrics_observe() del lazo de muestreo (atraso de cada muestra)
+static bool setupMetrics() {
+  return true;
+}
+
+static void runMetrics() {
+  holter_metrics_observe(MH_SAMPLE_LATENESS_US, observed++ & 4095);
+}
+
+// Cifrado de un buffer en el escritor, antes de tomar la SD
+static bool setupEncrypt() {
+  if (!holter_crypto_isEnabled()) return false;
+  EncryptionHeader header;
+  memcpy(cipherBlock, holter_bench_signalBlock(), BENCH_BLOCK_SIZE);
+  return holter_crypto_beginSession(&header);
+}
+
+static void runEncrypt() {
+  holter_crypto_apply(cipherBlock, BENCH_BLOCK_SIZE);
+  sink += cipherBlock[0];
+}
+
+static void teardownEncrypt() {
+  holter_crypto_endSession();
+}
+
+// flushBuffer(): entrega el buffer lleno y toma el libre. El escritor de
+// prueba no escribe, solo devuelve el buffer: se mide la entrega cuando el
+// escritor va al día, sin la SD (esa es sd.write)
+static void writerStub(void* param) {
+  BenchJob job;
+  for (;;) {
+    xQueueReceive(writeJobs, &job, portMAX_DELAY);
+    xQueueSend(freeBuffers, &job.data, portMAX_DELAY);
+  }
+}
+
+static bool setupFlush() {
+  writeJobs = xQueueCreate(2, sizeof(BenchJob));
+  freeBuffers = xQueueCreate(2, sizeof(uint8_t*));
+  if (writeJobs == nullptr || freeBuffers == nullptr) return false;
+  
+  activeBlock = holter_bench_signalBlock();
+  uint8_t* spare = spareBlock;
+  xQueueSend(freeBuffers, &spare, 0);
+  return xTaskCreatePinnedToCore(writerStub, "bench_writer", 2048, nullptr, WRITER_STUB_PRIORITY,
+                                 &writerStubHandle, WRITER_STUB_CORE) == pdPASS;
+}
+
+static void runFlush() {
+  BenchJob job = { activeBlock, BENCH_BLOCK_SIZE, false };
+  xQueueSend(writeJobs, &job, portMAX_DELAY);
+  
+  uint8_t* next = nullptr;
+  if (xQueueReceive(freeBuffers, &next, 0) != pdTRUE) {
+    xQueueReceive(freeBuffers, &next, portMAX_DELAY);
+  }
+  activeBlock = next;
+}
+
+static void teardownFlush() {
+  if (writerStubHandle != nullptr) vTaskDelete(writerStubHandle);
+  writerStubHandle = nullptr;
+  if (writeJobs != nullptr) vQueueDelete(writeJobs);
+  if (freeBuffers != nullptr) vQueueDelete(freeBuffers);
+  writeJobs = nullptr;
+  freeBuffers = nullptr;
+}
+
+// Snapshot de métricas: trailer de cada segmento y telemetría del upload
+static bool setupMetricsEncode() {
+  metricsBuffer = (uint8_t*)malloc(METRICS_ENCODE_BYTES);
+  return metricsBuffer != nullptr;
+}
+
+static void runMetricsEncode() {
+  sink += holter_metrics_encode(metricsBuffer, METRICS_ENCODE_BYTES);
+}
+
+static void teardownMetricsEncode() {
+  free(metricsBuffer);
+  metricsBuffer = nullptr;
+}
+
+static const BenchKernel DEVICE_KERNELS[] = {
+  { "capture.metrics",     BENCH_PER_SAMPLE,  0,                setupMetrics,       runMetrics,       nullptr },
+  { "capture.flushBuffer", BENCH_PER_BLOCK,   0,                setupFlush,         runFlush,         teardownFlush },
+  { "sd.encrypt",          BENCH_PER_BLOCK,   BENCH_BLOCK_SIZE, setupEncrypt,       runEncrypt,       teardownEncrypt },
+  { "metrics.encode",      BENCH_PER_SEGMENT, 0,                setupMetricsEncode, runMetricsEncode, teardownMetricsEncode },
+};
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static uint32_t runBatch(const BenchKernel& kernel, uint32_t iterations) {
+  uint32_t start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < iterations; i++) {
+    kernel.run();
+  }
+  return ESP.getCycleCount() - start;
+}
+
+static BenchResult measure(const BenchKernel& kernel, uint32_t mhz) {
+  BenchResult result = { true, 0, 0, 0, 0, 0 };
+  if (!kernel.setup()) return result;
+  result.skipped = false;
+  
+  // Iteraciones por lote según una primera corrida (sin caché de flash)
+  uint32_t first = runBatch(kernel, 1);
+  uint32_t perBatch = (BENCH_BATCH_US * mhz) / (first > 0 ? first : 1);
+  if (perBatch < 1) perBatch = 1;
+  if (perBatch > BENCH_MAX_BATCH) perBatch = BENCH_MAX_BATCH;
+  runBatch(kernel, perBatch);
+  
+  uint32_t batches[BENCH_BATCHES];
+  for (int b = 0; b < BENCH_BATCHES; b++) {
+    batches[b] = runBatch(kernel, perBatch) / perBatch;
+    vTaskDelay(1);   // Fuera del lote: deja correr al resto del núcleo
+  }
+  std::sort(batches, batches + BENCH_BATCHES);
+  
+  if (kernel.teardown != nullptr) kernel.teardown();
+  result.iterations = perBatch * BENCH_BATCHES;
+  result.cycles = batches[BENCH_BATCHES / 2];
+  result.cycles_min = batches[0];
+  result.cycles_q1 = batches[BENCH_BATCHES / 4];
+  result.cycles_q3 = batches[BENCH_BATCHES * 3 / 4];
+  return result;
+}
+
+static const char* unitName(uint8_t unit) {
+  switch (unit) {
+    case BENCH_PER_SAMPLE: return "sample";
+    case BENCH_PER_BLOCK: return "block";
+    case BENCH_PER_SEGMENT: return "segment";
+    default: return "?";
+  }
+}
+
+static void printRow(const BenchKernel& kernel, const BenchResult& result, uint32_t mhz) {
+  if (result.skipped) {
+    Serial.printf("[BENCH] %-22s no disponible\n", kernel.name);
+    return;
+  }
+  
+  float us = (float)result.cycles / mhz;
+  Serial.printf("[BENCH] %-22s %9lu ciclos %10.2f us (mín %lu)", kernel.name,
+                (unsigned long)result.cycles, us, (unsigned long)result.cycles_min);
+  if (kernel.unit == BENCH_PER_SAMPLE) {
+    Serial.printf(" | %.3f%% de CPU a %d Hz", us * BENCH_SAMPLE_RATE_HZ / 1e4f, BENCH_SAMPLE_RATE_HZ);
+  } else if (kernel.bytes > 0) {
+    Serial.printf(" | %.2f MB/s", kernel.bytes / us);
+  }
+  Serial.println();
+}
+
+// Mismos campos que --benchmark_format=json de Google Benchmark, más los
+// ciclos por iteración
+static void printJson(const BenchKernel* kernels, const BenchResult* results, size_t count,
+                      uint32_t mhz) {
+  Serial.println("[BENCH] JSON");
+  Serial.println("{");
+  Serial.println("  \"context\": {");
+  Serial.println("    \"platform\": \"esp32\",");
+  Serial.println("    \"executable\": \"holter-bench\",");
+  Serial.println("    \"build\": \"" __DATE__ " " __TIME__ "\",");
+  Serial.printf("    \"mhz_per_cpu\": %lu,\n", (unsigned long)mhz);
+  Serial.printf("    \"block_size\": \"%d\",\n", BENCH_BLOCK_SIZE);
+  Serial.printf("    \"batches\": %d\n", BENCH_BATCHES);
+  Serial.println("  },");
+  Serial.println("  \"benchmarks\": [");
+  
+  for (size_t i = 0; i < count; i++) {
+    const BenchKernel& kernel = kernels[i];
+    const BenchResult& result = results[i];
+    Serial.printf("    {\"name\": \"%s\", \"run_type\": \"iteration\", \"label\": \"%s\"",
+                  kernel.name, unitName(kernel.unit));
+    if (result.skipped) {
+      Serial.print(", \"error_occurred\": true, \"error_message\": \"no disponible\"");
+    } else {
+      double ns = result.cycles * 1000.0 / mhz;
+      double perSecond = 1e9 / ns;
+      Serial.printf(", \"iterations\": %lu, \"real_time\": %.3f, \"cpu_time\": %.3f, \"time_unit\": \"ns\""
+                    ", \"cycles\": %lu, \"cycles_min\": %lu, \"cycles_q1\": %lu, \"cycles_q3\": %lu"
+                    ", \"items_per_second\": %.3f",
+                    (unsigned long)result.iterations, ns, ns, (unsigned long)result.cycles,
+                    (unsigned long)result.cycles_min, (unsigned long)result.cycles_q1,
+                    (unsigned long)result.cycles_q3, perSecond);
+      if (kernel.bytes > 0) Serial.printf(", \"bytes_per_second\": %.3f", perSecond * kernel.bytes);
+    }
+    Serial.println(i + 1 < count ? "}," : "}");
+  }
+  
+  Serial.println("  ]");
+  Serial.println("}");
+  Serial.println("[BENCH] Fin");
+}
+
+static void runSuite() {
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  size_t commonCount;
+  const BenchKernel* common = holter_bench_kernels(&commonCount);
+  size_t deviceCount = sizeof(DEVICE_KERNELS) / sizeof(DEVICE_KERNELS[0]);
+  size_t count = commonCount + deviceCount;
+  
+  BenchKernel* kernels = new BenchKernel[count];
+  BenchResult* results = new BenchResult[count];
+  for (size_t i = 0; i < count; i++) {
+    kernels[i] = i < commonCount ? common[i] : DEVICE_KERNELS[i - commonCount];
+  }
+  
+  Serial.printf("[BENCH] %u kernels, CPU a %lu MHz, %d lotes de ~%d us\n",
+                (unsigned)count, (unsigned long)mhz, BENCH_BATCHES, BENCH_BATCH_US);
+  for (size_t i = 0; i < count; i++) {
+    results[i] = measure(kernels[i], mhz);
+    printRow(kernels[i], results[i], mhz);
+  }
+  printJson(kernels, results, count, mhz);
+  sink += holter_bench_sink();
+  
+  delete[] kernels;
+  delete[] results;
+}
+
+static void benchTask(void* param) {
+  for (;;) {
+    runSuite();
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+// ============================================================================
+// SETUP Y LOOP
+// ============================================================================
+
+void setup() {
+  Serial.begin(BENCH_BAUD);
+  holter_log_init(false);
+  
+  // Cifrado, placa, locks y SD como en el firmware; sin SD, sd.write y capture.header se saltean
+  holter_crypto_init();
+  holter_init(&MyBioBoard, nullptr);
+  holter_waitForSD();
+  
+  xTaskCreatePinnedToCore(benchTask, "bench", 8192, nullptr, BENCH_TASK_PRIORITY,
+                          &benchTaskHandle, BENCH_CORE);
+}
+
+void loop() {
+  if (Serial.available()) {
+    while (Serial.available()) Serial.read();
+    xTaskNotifyGive(benchTaskHandle);
+  }
+  delay(100);
+}
@@ -1,4 +1,9 @@
 #include "display_ui.h"
+#include "holter_capture.h"
+#include "holter_events.h"
+#include "holter_hal.h"
+#include "holter_trace.h"
+#include "holter_metrics.h"
 
 // ============================================================================
 // CONFIGURACIÓN HARDWARE
@@ -7,15 +12,127 @@
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 #define OLED_RESET -1
-#define BUTTON_PIN 0
 #define BATTERY_PIN 36
+#define OLED_PAGES (SCREEN_HEIGHT / 8)
+
+// Reloj del I2C. El ADXL345 comparte el bus y admite hasta fast mode
+// (400 kHz). Con OLED_I2C_FAST_PLUS se prueba fast mode plus, solo si
+// ningún ADXL345 contesta en el bus
+#define OLED_I2C_HZ 400000
+#define OLED_I2C_FAST_PLUS false
+#define OLED_I2C_FAST_HZ 1000000
+#define OLED_I2C_PROBE_HZ 100000
+#define ADXL345_ADDRESS 0x53                  // SDO a GND
+#define ADXL345_ALT_ADDRESS 0x1D              // SDO a VCC
+
+// Tarea de dibujo: núcleo 0 y prioridad mínima, nunca le quita CPU a la
+// captura (núcleo 1) ni al upload
+#define DISPLAY_CORE 0
+#define DISPLAY_TASK_PRIORITY 1
+#define DISPLAY_FRAME_BUDGET_US 20000         // Dibujo + envío por frame; lo que no entra sale en el próximo
+
+// La batería se lee del mismo ADC que el ECG: poco y entre muestras
+#define BATTERY_SAMPLE_MS 30000
+
+// Trazo ECG de la pantalla idle: derivación II, una columna (mínimo y máximo)
+// cada 10 muestras = 25 columnas/s a 250 Hz, ~5 s en el ancho de la pantalla
+#define TRACE_SAMPLES_PER_COLUMN 10
+#define TRACE_RING_COLUMNS 128                // Potencia de 2, >= SCREEN_WIDTH
+#define TRACE_RING_MASK (TRACE_RING_COLUMNS - 1)
+#define TRACE_TOP_PAGE 2                      // Páginas 2-5: filas 16 a 47
+#define TRACE_PAGES 4
+#define TRACE_Y (TRACE_TOP_PAGE * 8)
+#define TRACE_HEIGHT (TRACE_PAGES * 8)
+#define TRACE_UNITS_PER_PX 410                // 2 mV en 32 px (6553.6 cuentas por mV)
+#define TRACE_RECENTER_MS 1000                // Recentrado por deriva de línea de base, como mucho 1/s
+
+// ============================================================================
+// ADAPTADORES
+// ============================================================================
+
+// SSD1306 que envía solo lo que cambió. Guarda una copia de lo último que se
+// mandó al panel y, por cada página de 8 filas, manda la ventana de columnas
+// entre el primer y el último byte distinto. Las pantallas se siguen dibujando
+// completas (clearDisplay() + redibujo): la comparación cuesta menos que el
+// bus, y un reloj que cambia 4 dígitos manda ~30 bytes en vez de 1 KB.
+//
+// Con presupuesto, display() deja de enviar al agotarlo: las páginas que
+// faltan siguen distintas de la copia y salen en el próximo frame, que
+// empieza por ellas.
+//
+// display() oculta a la de Adafruit_SSD1306 (no es virtual): el módulo
+// siempre la llama sobre esta clase. El envío es hal_display_write(), que
+// toma el bus por transmisión; el reloj se fija una vez en display_init() y
+// es el mismo para el IMU.
+class DirtySSD1306 : public Adafruit_SSD1306 {
+public:
+  DirtySSD1306(uint8_t w, uint8_t h, TwoWire* twi, int8_t rst, uint32_t clk)
+    : Adafruit_SSD1306(w, h, twi, rst, clk, clk) {}
+  
+  // budgetUs = 0: sin límite
+  void display(uint32_t budgetUs = 0) {
+    unsigned long start = micros();
+    uint32_t sent = 0;
+    uint8_t page = nextPage;
+    
+    lastPartial = false;
+    for (int i = 0; i < OLED_PAGES; i++, page = (page + 1) % OLED_PAGES) {
+      const uint8_t* row = buffer + page * SCREEN_WIDTH;
+      uint8_t* last = shadow + page * SCREEN_WIDTH;
+      
+      int first = 0;
+      int end = SCREEN_WIDTH - 1;
+      if (validPages & (1 << page)) {
+        while (first < SCREEN_WIDTH && row[first] == last[first]) first++;
+        if (first == SCREEN_WIDTH) continue;
+        while (row[end] == last[end]) end--;
+      }
+      
+      if (budgetUs > 0 && sent > 0 && micros() - start >= budgetUs) {
+        lastPartial = true;
+        break;
+      }
+      
+      sent += hal_display_write(page, first, end, row + first);
+      memcpy(last + first, row + first, end - first + 1);
+      validPages |= 1 << page;
+    }
+    
+    nextPage = lastPartial ? page : 0;
+    lastBytes = sent;
+    lastFlushUs = micros() - start;
+  }
+  
+  // El contenido del panel ya no coincide con la copia (reinicio, otro
+  // dibujo fuera de esta clase): el próximo display() manda todo
+  void invalidate() {
+    validPages = 0;
+  }
+  
+  void setBusClock(uint32_t hz) {
+    wireClk = hz;
+    restoreClk = hz;
+  }
+  
+  uint32_t busClock() const { return wireClk; }
+  
+  uint32_t lastBytes = 0;      // Bytes en el bus del último display() (con dirección y control)
+  uint32_t lastFlushUs = 0;
+  bool lastPartial = false;    // Se agotó el presupuesto con páginas pendientes
+
+private:
+  uint8_t shadow[SCREEN_WIDTH * OLED_PAGES];
+  uint8_t validPages = 0;      // Páginas cuya copia coincide con el panel
+  uint8_t nextPage = 0;
+};
 
 // ============================================================================
 // VARIABLES INTERNAS (PRIVADAS)
 // ============================================================================
 
-static Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+static DirtySSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET, OLED_I2C_HZ);
 static XSpaceBioV10Board* g_bioBoard = nullptr;
+static uint8_t oledAddress = 0;
 
 // Estado
 static DisplayMode currentMode = DISP_IDLE;
@@ -23,20 +140,60 @@ static float currentProgress = 0.0;
 static String currentMessage = "";
 static String currentText = "";
 static unsigned long messageTimeout = 0;
+static unsigned long splashUntil = 0;     // Pantalla de bienvenida visible hasta
 
-// Botón
-static byte lastButtonState = HIGH;
-static unsigned long lastDebounceTime = 0;
-static const unsigned long debounceDelay = 50;
+// Botón: los clicks los cuenta la interrupción de holter_events
+static uint32_t lastButtonClicks = 0;
 
 // ECG para display
 static float ecg_I = 0.0;
 static float ecg_II = 0.0;
 static float ecg_III = 0.0;
 
+// Trazo: ring SPSC de columnas. La captura (núcleo 1) solo escribe traceHead;
+// el dibujo lee las últimas SCREEN_WIDTH columnas y nunca la frena (si se
+// atrasa un ancho de pantalla, redibuja el trazo completo)
+struct TraceColumn {
+  int16_t min;
+  int16_t max;
+};
+
+static TraceColumn traceRing[TRACE_RING_COLUMNS];
+static volatile uint32_t traceHead = 0;
+static volatile bool displayReady = false;   // Pantalla inicializada: la captura acumula
+
+// Columna en curso (solo la captura)
+static int16_t pendingMin = 0;
+static int16_t pendingMax = 0;
+static int pendingSamples = 0;
+
+// Dibujo
+static uint32_t traceDrawn = 0;              // traceHead del último frame
+static bool traceStale = true;               // El framebuffer no tiene el trazo
+static int32_t traceCenter = 0;              // Valor en la mitad del alto
+static TraceColumn traceLast = {0, 0};       // Última columna dibujada
+static unsigned long lastRecenter = 0;
+static unsigned long lastHeaderTime = 0;
+
+// Batería: última lectura del ADC (la escribe quien la muestrea, ver display_sampleBattery)
+static volatile uint16_t batteryRaw = 0;
+static volatile unsigned long batteryReadTime = 0;
+static volatile bool batterySampled = false;
+
 // Timing
 static unsigned long lastUpdateTime = 0;
 static const unsigned long UPDATE_INTERVAL = 200; // 200ms = 5fps
+static const unsigned long TRACE_FRAME_MS = 40;   // Pantalla idle: 25fps, una columna por frame
+static const unsigned long SPLASH_MS = 2000;
+
+// Tarea de dibujo. El estado de arriba (modo, textos, progreso) lo cambian
+// otras tareas con stateMutex tomado; el framebuffer es solo de la tarea
+static TaskHandle_t displayTaskHandle = nullptr;
+static SemaphoreHandle_t stateMutex = nullptr;
+static volatile bool clearRequested = false;
+
+// Métricas por modo
+static DisplayStats stats = {};
 
 // ============================================================================
 // FUNCIONES INTERNAS (PRIVADAS)
@@ -49,9 +206,53 @@ static void drawBatteryIconInternal(int x, int y, int percentage) {
   display.fillRect(x + 2, y + 2, fillWidth, 5, SSD1306_WHITE);
 }
 
+static bool i2cAcks(uint8_t address) {
+  Wire.beginTransmission(address);
+  return Wire.endTransmission() == 0;
+}
+
+// Fast mode plus solo si se pidió, con la pantalla sola en el bus (el
+// ADXL345 se busca a velocidad baja en sus dos direcciones) y si la pantalla
+// responde a esa velocidad (con pull-ups débiles no contesta y se queda en
+// 400 kHz)
+static uint32_t selectBusClock() {
+  if (!OLED_I2C_FAST_PLUS) return OLED_I2C_HZ;
+  
+  Wire.setClock(OLED_I2C_PROBE_HZ);
+  bool imuOnBus = i2cAcks(ADXL345_ADDRESS) || i2cAcks(ADXL345_ALT_ADDRESS);
+  if (imuOnBus) {
+    Wire.setClock(OLED_I2C_HZ);
+    return OLED_I2C_HZ;
+  }
+  
+  Wire.setClock(OLED_I2C_FAST_HZ);
+  bool ack = i2cAcks(oledAddress);
+  Wire.setClock(OLED_I2C_HZ);
+  return ack ? OLED_I2C_FAST_HZ : OLED_I2C_HZ;
+}
+
+static void lockState() {
+  if (stateMutex != nullptr) xSemaphoreTake(stateMutex, portMAX_DELAY);
+}
+
+static void unlockState() {
+  if (stateMutex != nullptr) xSemaphoreGive(stateMutex);
+}
+
+// Lee el ADC si pasó BATTERY_SAMPLE_MS desde la última lectura
+static void sampleBattery() {
+  unsigned long now = millis();
+  if (batterySampled && now - batteryReadTime < BATTERY_SAMPLE_MS) return;
+  
+  batteryRaw = analogRead(BATTERY_PIN);
+  batteryReadTime = now;
+  batterySampled = true;
+}
+
+// Desde la última lectura: no toca el ADC
 static BatteryInfo getBatteryStatusInternal() {
   BatteryInfo battery;
-  int rawValue = analogRead(BATTERY_PIN);
+  int rawValue = batteryRaw;
   battery.voltage = (rawValue / 4095.0) * 2.0 * 3.3;
   
   if (battery.voltage >= 4.1) battery.percentage = 100;
@@ -73,34 +274,113 @@ static String obtenerHoraActual() {
   return String(buffer);
 }
 
-static void drawIdleScreen() {
-  display.clearDisplay();
+static int traceY(int32_t value) {
+  int32_t y = TRACE_Y + TRACE_HEIGHT / 2 - (value - traceCenter) / TRACE_UNITS_PER_PX;
+  return constrain(y, TRACE_Y, TRACE_Y + TRACE_HEIGHT - 1);
+}
+
+// Segmento vertical de la columna, estirado hasta la anterior para que el
+// trazo no quede cortado en las pendientes
+static void drawTraceColumn(int x, const TraceColumn& column) {
+  int top = traceY(max(column.max, traceLast.min));
+  int bottom = traceY(min(column.min, traceLast.max));
+  display.drawFastVLine(x, top, bottom - top + 1, SSD1306_WHITE);
+  traceLast = column;
+}
+
+// Trazo completo desde el ring, recentrado en el promedio de lo visible.
+// Solo al entrar a idle, al recentrar o si el dibujo se atrasó una pantalla
+static void redrawTrace(uint32_t head) {
+  uint32_t count = min(head, (uint32_t)SCREEN_WIDTH);
+  uint32_t first = head - count;
   
-  // Hora arriba a la izquierda
-  display.setTextSize(1);
-  display.setCursor(0, 0);
-  display.print(obtenerHoraActual());
+  display.fillRect(0, TRACE_Y, SCREEN_WIDTH, TRACE_HEIGHT, SSD1306_BLACK);
+  if (count > 0) {
+    int32_t sum = 0;
+    for (uint32_t i = first; i < head; i++) {
+      const TraceColumn& column = traceRing[i & TRACE_RING_MASK];
+      sum += ((int32_t)column.min + column.max) / 2;
+    }
+    traceCenter = sum / (int32_t)count;
+    traceLast = traceRing[first & TRACE_RING_MASK];
+  }
   
-  // Batería arriba a la derecha
-  BatteryInfo battery = getBatteryStatusInternal();
-  drawBatteryIconInternal(105, 0, battery.percentage);
+  for (uint32_t i = first; i < head; i++) {
+    drawTraceColumn(SCREEN_WIDTH - (head - i), traceRing[i & TRACE_RING_MASK]);
+  }
+  stats.trace.redraws++;
+}
+
+// Corre las páginas del trazo n columnas a la izquierda en el framebuffer y
+// dibuja solo las n columnas nuevas a la derecha
+static void scrollTrace(uint32_t head) {
+  uint32_t n = head - traceDrawn;
+  uint8_t* buffer = display.getBuffer();
   
-  // ECG en el centro
-  display.setTextSize(1);
-  display.setCursor(0, 20);
-  display.printf("I:  %.2f mV", ecg_I);
-  display.setCursor(0, 32);
-  display.printf("II: %.2f mV", ecg_II);
-  display.setCursor(0, 44);
-  display.printf("III:%.2f mV", ecg_III);
-  
-  // Texto adicional
-  if (currentText.length() > 0) {
-    display.setCursor(0, 56);
-    display.print(currentText);
+  for (int page = TRACE_TOP_PAGE; page < TRACE_TOP_PAGE + TRACE_PAGES; page++) {
+    uint8_t* row = buffer + page * SCREEN_WIDTH;
+    memmove(row, row + n, SCREEN_WIDTH - n);
+    memset(row + SCREEN_WIDTH - n, 0, n);
   }
   
-  display.display();
+  for (uint32_t i = traceDrawn; i < head; i++) {
+    drawTraceColumn(SCREEN_WIDTH - (head - i), traceRing[i & TRACE_RING_MASK]);
+  }
+  stats.trace.columns_drawn += n;
+}
+
+// La línea de base se fue de la ventana (movimiento, electrodos): recentrar
+static bool traceOffCenter(uint32_t head) {
+  if (head == traceDrawn || millis() - lastRecenter < TRACE_RECENTER_MS) return false;
+  
+  const TraceColumn& column = traceRing[(head - 1) & TRACE_RING_MASK];
+  int32_t offset = ((int32_t)column.min + column.max) / 2 - traceCenter;
+  return abs(offset) > TRACE_UNITS_PER_PX * TRACE_HEIGHT * 3 / 8;
+}
+
+// Hora, batería y texto se rehacen a 5fps; el trazo en cada frame
+static void drawIdleScreen() {
+  unsigned long now = millis();
+  uint32_t head = traceHead;
+  
+  bool full = traceStale || head - traceDrawn > SCREEN_WIDTH || traceOffCenter(head);
+  bool header = full || now - lastHeaderTime >= UPDATE_INTERVAL;
+  
+  if (full) {
+    display.clearDisplay();
+    redrawTrace(head);
+    lastRecenter = now;
+    traceStale = false;
+  } else if (head != traceDrawn) {
+    scrollTrace(head);
+  }
+  traceDrawn = head;
+  
+  if (header) {
+    lastHeaderTime = now;
+    display.fillRect(0, 0, SCREEN_WIDTH, TRACE_Y, SSD1306_BLACK);
+    display.fillRect(0, TRACE_Y + TRACE_HEIGHT, SCREEN_WIDTH,
+                     SCREEN_HEIGHT - TRACE_Y - TRACE_HEIGHT, SSD1306_BLACK);
+    
+    // Hora arriba a la izquierda
+    display.setTextSize(1);
+    display.setCursor(0, 0);
+    display.print(obtenerHoraActual());
+    
+    // Batería arriba a la derecha
+    BatteryInfo battery = getBatteryStatusInternal();
+    drawBatteryIconInternal(105, 0, battery.percentage);
+    
+    // Valor de la derivación del trazo
+    display.setCursor(0, 8);
+    display.printf("II: %.2f mV", ecg_II);
+    
+    // Texto adicional
+    if (currentText.length() > 0) {
+      display.setCursor(0, 56);
+      display.print(currentText);
+    }
+  }
 }
 
 static void drawConfirmCaptureScreen() {
@@ -113,7 +393,6 @@ static void drawConfirmCaptureScreen() {
   display.print("Presiona boton");
   display.setCursor(10, 45);
   display.print("para confirmar");
-  display.display();
 }
 
 static void drawConfirmUploadScreen() {
@@ -126,7 +405,6 @@ static void drawConfirmUploadScreen() {
   display.print("Presiona boton");
   display.setCursor(10, 45);
   display.print("para confirmar");
-  display.display();
 }
 
 static void drawCapturingScreen() {
@@ -147,8 +425,6 @@ static void drawCapturingScreen() {
   display.setTextSize(1);
   display.setCursor(50, 50);
   display.printf("%d%%", (int)(currentProgress * 100));
-  
-  display.display();
 }
 
 static void drawUploadingScreen() {
@@ -169,8 +445,6 @@ static void drawUploadingScreen() {
   display.setTextSize(1);
   display.setCursor(50, 50);
   display.printf("%d%%", (int)(currentProgress * 100));
-  
-  display.display();
 }
 
 static void drawMessageScreen() {
@@ -183,8 +457,6 @@ static void drawMessageScreen() {
   display.getTextBounds(currentMessage, 0, 0, &x1, &y1, &w, &h);
   display.setCursor((SCREEN_WIDTH - w) / 2, (SCREEN_HEIGHT - h) / 2);
   display.print(currentMessage);
-  
-  display.display();
 }
 
 static void drawErrorScreen() {
@@ -194,7 +466,107 @@ static void drawErrorScreen() {
   display.print("ERROR:");
   display.setCursor(0, 15);
   display.print(currentMessage);
-  display.display();
+}
+
+static unsigned long frameInterval() {
+  return (currentMode == DISP_IDLE) ? TRACE_FRAME_MS : UPDATE_INTERVAL;
+}
+
+// Dibuja el modo actual con el estado tomado y después lo envía, ya sin
+// él, dentro de lo que quedó del presupuesto del frame
+static void renderFrame(unsigned long now) {
+  unsigned long interval = frameInterval();
+  if (lastUpdateTime != 0) {
+    unsigned long elapsed = now - lastUpdateTime;
+    stats.modes[currentMode].active_ms += elapsed;
+    if (elapsed > 2 * interval) stats.late_frames++;
+  }
+  lastUpdateTime = now;
+  
+  if (splashUntil != 0) {
+    if ((long)(now - splashUntil) < 0) return;
+    splashUntil = 0;
+  }
+  
+  TRACE_SCOPE("display.draw");
+  unsigned long drawStart = micros();
+  lockState();
+  
+  // Verificar timeout de mensaje
+  if (currentMode == DISP_MESSAGE && messageTimeout > 0 && now > messageTimeout) {
+    currentMode = DISP_IDLE;
+  }
+  DisplayMode drawn = currentMode;
+  
+  // Dibujar según modo
+  if (clearRequested) {
+    display.clearDisplay();
+    clearRequested = false;
+    traceStale = true;
+  } else {
+    switch(drawn) {
+      case DISP_IDLE:
+        drawIdleScreen();
+        break;
+      case DISP_CONFIRM_CAPTURE:
+        drawConfirmCaptureScreen();
+        break;
+      case DISP_CAPTURING:
+        drawCapturingScreen();
+        break;
+      case DISP_CONFIRM_UPLOAD:
+        drawConfirmUploadScreen();
+        break;
+      case DISP_UPLOADING:
+        drawUploadingScreen();
+        break;
+      case DISP_MESSAGE:
+        drawMessageScreen();
+        break;
+      case DISP_ERROR:
+        drawErrorScreen();
+        break;
+      default:
+        break;
+    }
+    // Las demás pantallas borran el framebuffer entero
+    if (drawn != DISP_IDLE) traceStale = true;
+  }
+  unlockState();
+  
+  uint32_t renderUs = micros() - drawStart;
+  uint32_t budget = renderUs < DISPLAY_FRAME_BUDGET_US ? DISPLAY_FRAME_BUDGET_US - renderUs : 1;
+  display.display(budget);
+  uint32_t frameUs = micros() - drawStart;
+  holter_metrics_observe(MH_DISPLAY_DRAW_US, frameUs);
+  
+  DisplayModeStats& mode = stats.modes[drawn];
+  mode.frames++;
+  if (display.lastBytes == 0) mode.unchanged++;
+  if (display.lastPartial) mode.partial++;
+  mode.bytes += display.lastBytes;
+  mode.render_us += renderUs;
+  mode.flush_us += display.lastFlushUs;
+  mode.max_us = max(mode.max_us, frameUs);
+}
+
+// Un frame cada frameInterval(); display_forceUpdate() lo adelanta. Con la
+// CPU del núcleo 0 ocupada la tarea corre menos y baja la tasa de frames
+// (late_frames); el trazo se pone al día con varias columnas por frame
+static void displayTask(void* param) {
+  for (;;) {
+    unsigned long interval = frameInterval();
+    unsigned long since = millis() - lastUpdateTime;
+    if (since < interval) {
+      TickType_t wait = pdMS_TO_TICKS(interval - since);
+      ulTaskNotifyTake(pdTRUE, wait > 0 ? wait : 1);
+      continue;
+    }
+    
+    // Durante la captura la batería la lee la captura, entre muestras
+    if (!holter_isCapturing()) sampleBattery();
+    renderFrame(millis());
+  }
 }
 
 // ============================================================================
@@ -203,24 +575,36 @@ static void drawErrorScreen() {
 
 void display_forceUpdate() {
   lastUpdateTime = 0; // Forzar actualización inmediata
+  if (displayTaskHandle != nullptr) xTaskNotifyGive(displayTaskHandle);
 }
 
 void display_init(XSpaceBioV10Board* bioBoard) {
   g_bioBoard = bioBoard;
   
-  pinMode(BUTTON_PIN, INPUT_PULLUP);
+  // Los clicks anteriores a la pantalla no cuentan
+  lastButtonClicks = holter_events_getButtonClicks();
   
   Serial.println("[Display] Inicializando OLED...");
   
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
+  oledAddress = 0x3C;
+  if (!display.begin(SSD1306_SWITCHCAPVCC, oledAddress)) {
     Serial.println(F("[Display] ERROR: No se pudo inicializar OLED en 0x3C"));
     Serial.println(F("[Display] Intentando con 0x3D..."));
-    if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3D)) {
+    oledAddress = 0x3D;
+    if (!display.begin(SSD1306_SWITCHCAPVCC, oledAddress)) {
       Serial.println(F("[Display] ERROR: No se pudo inicializar OLED"));
       return; // No bloquear, continuar sin display
     }
   }
   
+  // begin() no borra la RAM del panel: el primer envío es completo
+  hal_display_begin(oledAddress);
+  display.invalidate();
+  display.setBusClock(selectBusClock());
+  Wire.setClock(display.busClock());
+  stats.bus_hz = display.busClock();
+  sampleBattery();
+  
   display.clearDisplay();
   display.setTextColor(SSD1306_WHITE);
   
@@ -235,53 +619,28 @@ void display_init(XSpaceBioV10Board* bioBoard) {
   display.println("Listo!");
   display.display();
   
-  Serial.println("[Display] Inicializado correctamente");
-  
-  delay(2000); // Mostrar mensaje 2 segundos
+  // El mensaje queda 2 segundos sin bloquear el arranque (ver renderFrame)
+  splashUntil = millis() + SPLASH_MS;
   currentMode = DISP_IDLE;
+  
+  stateMutex = xSemaphoreCreateMutex();
+  displayReady = true;
+  xTaskCreatePinnedToCore(displayTask, "display", 4096, nullptr,
+                          DISPLAY_TASK_PRIORITY, &displayTaskHandle, DISPLAY_CORE);
+  
+  Serial.printf("[Display] Inicializado correctamente (I2C a %lu kHz, tarea en núcleo %d)\n",
+                (unsigned long)(stats.bus_hz / 1000), DISPLAY_CORE);
 }
 
 void display_update() {
-  // Actualizar solo cada UPDATE_INTERVAL
-  unsigned long now = millis();
-  if (now - lastUpdateTime < UPDATE_INTERVAL) {
-    return;
-  }
-  lastUpdateTime = now;
-  
-  // Verificar timeout de mensaje
-  if (currentMode == DISP_MESSAGE && messageTimeout > 0 && now > messageTimeout) {
-    currentMode = DISP_IDLE;
-  }
-  
-  // Dibujar según modo
-  switch(currentMode) {
-    case DISP_IDLE:
-      drawIdleScreen();
-      break;
-    case DISP_CONFIRM_CAPTURE:
-      drawConfirmCaptureScreen();
-      break;
-    case DISP_CAPTURING:
-      drawCapturingScreen();
-      break;
-    case DISP_CONFIRM_UPLOAD:
-      drawConfirmUploadScreen();
-      break;
-    case DISP_UPLOADING:
-      drawUploadingScreen();
-      break;
-    case DISP_MESSAGE:
-      drawMessageScreen();
-      break;
-    case DISP_ERROR:
-      drawErrorScreen();
-      break;
-  }
+  // El dibujo corre en su tarea: solo se la despierta para que revise si toca
+  if (displayTaskHandle != nullptr) xTaskNotifyGive(displayTaskHandle);
 }
 
 void display_setMode(DisplayMode mode) {
+  lockState();
   currentMode = mode;
+  unlockState();
   display_forceUpdate();
 }
 
@@ -290,20 +649,11 @@ DisplayMode display_getMode() {
 }
 
 bool display_checkButton() {
-  byte currentState = digitalRead(BUTTON_PIN);
-  bool buttonPressed = false;
+  uint32_t clicks = holter_events_getButtonClicks();
+  if (clicks == lastButtonClicks) return false;
   
-  if (currentState != lastButtonState) {
-    if ((millis() - lastDebounceTime) > debounceDelay) {
-      if (currentState == LOW) {
-        buttonPressed = true;
-      }
-      lastDebounceTime = millis();
-    }
-  }
-  lastButtonState = currentState;
-  
-  return buttonPressed;
+  lastButtonClicks = clicks;
+  return true;
 }
 
 void display_setProgress(float progress) {
@@ -311,21 +661,25 @@ void display_setProgress(float progress) {
 }
 
 void display_showMessage(String message, unsigned long duration_ms) {
+  lockState();
   currentMessage = message;
   currentMode = DISP_MESSAGE;
   messageTimeout = (duration_ms > 0) ? (millis() + duration_ms) : 0;
+  unlockState();
   display_forceUpdate();
 }
 
 void display_showError(String error) {
+  lockState();
   currentMessage = error;
   currentMode = DISP_ERROR;
+  unlockState();
   display_forceUpdate();
 }
 
 void display_clear() {
-  display.clearDisplay();
-  display.display();
+  clearRequested = true;
+  display_forceUpdate();
 }
 
 BatteryInfo display_getBattery() {
@@ -336,12 +690,85 @@ void display_drawBatteryIcon(int x, int y, int percentage) {
   drawBatteryIconInternal(x, y, percentage);
 }
 
+DisplayStats display_getStats() {
+  return stats;
+}
+
+void display_printStats() {
+  static const char* const NAMES[DISP_MODE_COUNT] = {
+    "idle", "confirmar captura", "capturando", "confirmar upload",
+    "subiendo", "mensaje", "error"
+  };
+  
+  if (!displayReady) return;
+  Serial.printf("[Display] I2C a %lu kHz | frames atrasados: %lu\n",
+                (unsigned long)(stats.bus_hz / 1000), (unsigned long)stats.late_frames);
+  for (int i = 0; i < DISP_MODE_COUNT; i++) {
+    const DisplayModeStats& m = stats.modes[i];
+    if (m.frames == 0) continue;
+    Serial.printf("  %-18s %6lu frames (%lu sin cambios, %lu cortados, %.1f fps) | %5lu B/frame | "
+                  "dibujo %lu us + envío %lu us (máx %lu us)\n",
+                  NAMES[i], (unsigned long)m.frames, (unsigned long)m.unchanged,
+                  (unsigned long)m.partial,
+                  m.active_ms > 0 ? m.frames * 1000.0f / m.active_ms : 0.0f,
+                  (unsigned long)(m.bytes / m.frames),
+                  (unsigned long)(m.render_us / m.frames),
+                  (unsigned long)(m.flush_us / m.frames), (unsigned long)m.max_us);
+  }
+  
+  const DisplayTraceStats& t = stats.trace;
+  if (t.samples > 0) {
+    Serial.printf("  trazo: %lu columnas (%lu desplazadas, %lu redibujos) | "
+                  "captura: %lu ciclos/muestra (máx %lu)\n",
+                  (unsigned long)t.columns, (unsigned long)t.columns_drawn,
+                  (unsigned long)t.redraws, (unsigned long)(t.push_cycles / t.samples),
+                  (unsigned long)t.push_cycles_max);
+  }
+}
+
+void display_sampleBattery() {
+  if (displayReady) sampleBattery();
+}
+
+void display_pushSample(const ECGSample& sample) {
+  if (!displayReady) return;
+  uint32_t start = ESP.getCycleCount();
+  
+  int16_t value = sample.derivation_II;
+  if (pendingSamples == 0) {
+    pendingMin = value;
+    pendingMax = value;
+  } else if (value < pendingMin) {
+    pendingMin = value;
+  } else if (value > pendingMax) {
+    pendingMax = value;
+  }
+  
+  if (++pendingSamples == TRACE_SAMPLES_PER_COLUMN) {
+    uint32_t head = traceHead;
+    traceRing[head & TRACE_RING_MASK].min = pendingMin;
+    traceRing[head & TRACE_RING_MASK].max = pendingMax;
+    traceHead = head + 1;
+    pendingSamples = 0;
+    stats.trace.columns++;
+  }
+  
+  uint32_t cycles = ESP.getCycleCount() - start;
+  stats.trace.samples++;
+  stats.trace.push_cycles += cycles;
+  stats.trace.push_cycles_max = max(stats.trace.push_cycles_max, cycles);
+}
+
 void display_setECGValue(float derivation_I, float derivation_II, float derivation_III) {
+  lockState();
   ecg_I = derivation_I;
   ecg_II = derivation_II;
   ecg_III = derivation_III;
+  unlockState();
 }
 
 void display_setText(String text) {
+  lockState();
   currentText = text;
+  unlockState();
 }
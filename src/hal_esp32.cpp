@@ -0,0 +1,196 @@
+#include "holter_hal_esp32.h"
+#include "holter_capture.h"
+#include <SD.h>
+#include <WiFi.h>
+#include <Wire.h>
+
+// Implementación de holter_hal.h en el ESP32: envoltorios finos sobre el
+// core de Arduino, la placa XSpace, SD, WiFiClient y Wire
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Bytes por transmisión I2C al panel. El bus se toma por transmisión: 32
+// bytes son ~0.8 ms a 400 kHz, lo más que espera el IMU por la pantalla
+#define HAL_I2C_CHUNK 32
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct HalFile {
+  File file;
+};
+
+struct HalSocket {
+  WiFiClient client;
+};
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static XSpaceBioV10Board* g_bioBoard = nullptr;
+static EcgSynth* g_synth = nullptr;
+static uint8_t displayAddress = 0;
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void hal_esp32_setBioBoard(XSpaceBioV10Board* bioBoard) {
+  g_bioBoard = bioBoard;
+}
+
+void hal_esp32_setSynth(EcgSynth* synth) {
+  g_synth = synth;
+}
+
+// --- Reloj ---
+
+uint32_t hal_micros() {
+  return micros();
+}
+
+uint32_t hal_millis() {
+  return millis();
+}
+
+void hal_delayUs(uint32_t us) {
+  if (us >= 1000) vTaskDelay(pdMS_TO_TICKS(us / 1000));
+  delayMicroseconds(us % 1000);
+}
+
+// --- ADC ---
+
+bool hal_adc_begin() {
+  return g_bioBoard != nullptr || g_synth != nullptr;
+}
+
+bool hal_adc_readLeads(float* leadI, float* leadII) {
+  if (g_synth != nullptr) {
+    SynthSample sample;
+    g_synth->next(&sample);
+    *leadI = holter_synth_leadVolts(sample.lead_I_mV);
+    *leadII = holter_synth_leadVolts(sample.lead_II_mV);
+    return true;
+  }
+  if (g_bioBoard == nullptr) return false;
+  *leadI = g_bioBoard->AD8232_GetVoltage(AD8232_XS1);
+  *leadII = g_bioBoard->AD8232_GetVoltage(AD8232_XS2);
+  return true;
+}
+
+// --- Almacenamiento ---
+
+HalFile* hal_file_open(const char* path, const char* mode) {
+  File file = SD.open(path, mode);
+  if (!file) return nullptr;
+  
+  HalFile* handle = new HalFile;
+  handle->file = file;
+  return handle;
+}
+
+size_t hal_file_read(HalFile* file, void* data, size_t len) {
+  return file->file.read((uint8_t*)data, len);
+}
+
+size_t hal_file_write(HalFile* file, const void* data, size_t len) {
+  return file->file.write((const uint8_t*)data, len);
+}
+
+bool hal_file_seek(HalFile* file, uint32_t offset) {
+  return file->file.seek(offset);
+}
+
+uint32_t hal_file_size(HalFile* file) {
+  return file->file.size();
+}
+
+void hal_file_flush(HalFile* file) {
+  file->file.flush();
+}
+
+void hal_file_close(HalFile* file) {
+  if (file == nullptr) return;
+  file->file.close();
+  delete file;
+}
+
+bool hal_fs_remove(const char* path) {
+  return SD.remove(path);
+}
+
+bool hal_fs_rename(const char* from, const char* to) {
+  return SD.rename(from, to);
+}
+
+// --- Red ---
+
+HalSocket* hal_net_connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+  HalSocket* socket = new HalSocket;
+  if (!socket->client.connect(host, port, (int32_t)timeoutMs)) {
+    delete socket;
+    return nullptr;
+  }
+  socket->client.setNoDelay(true);
+  return socket;
+}
+
+bool hal_net_send(HalSocket* socket, const void* data, size_t len) {
+  return socket->client.write((const uint8_t*)data, len) == len;
+}
+
+int hal_net_recv(HalSocket* socket, void* data, size_t len, uint32_t timeoutMs) {
+  unsigned long start = millis();
+  while (socket->client.available() == 0) {
+    if (!socket->client.connected()) return -1;
+    if (millis() - start >= timeoutMs) return 0;
+    vTaskDelay(1);
+  }
+  return socket->client.read((uint8_t*)data, len);
+}
+
+void hal_net_close(HalSocket* socket) {
+  if (socket == nullptr) return;
+  socket->client.stop();
+  delete socket;
+}
+
+// --- Pantalla ---
+
+bool hal_display_begin(uint8_t address) {
+  displayAddress = address;
+  return true;
+}
+
+// Ventana y datos en transmisiones de a HAL_I2C_CHUNK. Si el IMU usa el bus
+// entre la ventana y los datos, el panel no se entera
+uint32_t hal_display_write(uint8_t page, uint8_t first, uint8_t last, const uint8_t* data) {
+  const uint8_t window[] = {
+    0x22, page, page,                          // SSD1306_PAGEADDR
+    0x21, first, last                          // SSD1306_COLUMNADDR
+  };
+  holter_i2cLock();
+  Wire.beginTransmission(displayAddress);
+  Wire.write((uint8_t)0x00);                   // Lo que sigue son comandos
+  Wire.write(window, sizeof(window));
+  Wire.endTransmission();
+  holter_i2cUnlock();
+  uint32_t sent = 2 + sizeof(window);          // Dirección + byte de control + comandos
+  
+  for (int col = first; col <= last; ) {
+    int n = min(last - col + 1, HAL_I2C_CHUNK - 1);
+    holter_i2cLock();
+    Wire.beginTransmission(displayAddress);
+    Wire.write((uint8_t)0x40);                 // Lo que sigue son datos
+    Wire.write(data + (col - first), n);
+    Wire.endTransmission();
+    holter_i2cUnlock();
+    sent += 2 + n;
+    col += n;
+  }
+  return sent;
+}
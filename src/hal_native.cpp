@@ -0,0 +1,325 @@
+#include "holter_hal_native.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+// Implementación de holter_hal.h en Linux (env:native y herramientas del host)
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define PANEL_WIDTH 128
+#define PANEL_PAGES 8
+#define PANEL_I2C_CHUNK 32               // Igual que en el ESP32: mismos bytes por frame
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct HalFile {
+  FILE* file;
+};
+
+struct HalSocket {
+  int fd;
+};
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static AdcSource* adcSource = nullptr;
+static std::string storageRoot = ".";
+
+static bool realtime = false;
+static uint64_t virtualUs = 0;
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+static uint8_t panel[PANEL_WIDTH * PANEL_PAGES];
+static uint64_t panelBytes = 0;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static uint64_t nowUs() {
+  if (!realtime) return virtualUs;
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - bootTime).count();
+}
+
+static std::string hostPath(const char* path) {
+  return storageRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+// ============================================================================
+// FUENTES DEL ADC
+// ============================================================================
+
+bool ReplaySource::open(const char* path, bool loopSignal) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) return false;
+  
+  FileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == SESSION_MAGIC;
+  
+  // Cifradas (versión 2 o SESSION_FLAG_ENCRYPTED): no hay muestras en claro
+  if (ok && header.version == SESSION_VERSION) {
+    SessionInfo info;
+    ok = fread(&info, sizeof(info), 1, file) == 1 && !(info.flags & SESSION_FLAG_ENCRYPTED);
+  } else if (ok) {
+    ok = header.version == 1;
+  }
+  
+  if (ok) {
+    data.resize(header.num_ecg_samples);
+    data.resize(fread(data.data(), sizeof(ECGSample), data.size(), file));
+    ok = !data.empty();
+  }
+  fclose(file);
+  
+  position = 0;
+  loop = loopSignal;
+  return ok;
+}
+
+bool ReplaySource::next(float* leadI, float* leadII) {
+  if (position == data.size()) {
+    if (!loop || data.empty()) return false;
+    position = 0;
+  }
+  
+  const ECGSample& sample = data[position++];
+  *leadI = holter_format_leadVolts(sample.derivation_I);
+  *leadII = holter_format_leadVolts(sample.derivation_II);
+  return true;
+}
+
+bool SynthSource::next(float* leadI, float* leadII) {
+  SynthSample sample;
+  synth.next(&sample);
+  *leadI = holter_synth_leadVolts(sample.lead_I_mV);
+  *leadII = holter_synth_leadVolts(sample.lead_II_mV);
+  return true;
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void hal_native_setAdcSource(AdcSource* source) {
+  adcSource = source;
+}
+
+void hal_native_setStorageRoot(const char* dir) {
+  storageRoot = dir;
+}
+
+void hal_native_setRealtime(bool enabled) {
+  realtime = enabled;
+}
+
+bool hal_native_dumpDisplay(const char* path) {
+  FILE* file = fopen(path, "w");
+  if (file == nullptr) return false;
+  
+  fprintf(file, "P1\n%d %d\n", PANEL_WIDTH, PANEL_PAGES * 8);
+  for (int y = 0; y < PANEL_PAGES * 8; y++) {
+    for (int x = 0; x < PANEL_WIDTH; x++) {
+      bool on = panel[(y / 8) * PANEL_WIDTH + x] & (1 << (y % 8));
+      fputc(on ? '1' : '0', file);
+    }
+    fputc('\n', file);
+  }
+  return fclose(file) == 0;
+}
+
+uint64_t hal_native_displayBytes() {
+  return panelBytes;
+}
+
+// --- Reloj ---
+
+uint32_t hal_micros() {
+  return (uint32_t)nowUs();
+}
+
+uint32_t hal_millis() {
+  return (uint32_t)(nowUs() / 1000);
+}
+
+void hal_delayUs(uint32_t us) {
+  if (realtime) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  } else {
+    virtualUs += us;
+  }
+}
+
+// --- ADC ---
+
+bool hal_adc_begin() {
+  return true;
+}
+
+bool hal_adc_readLeads(float* leadI, float* leadII) {
+  if (adcSource == nullptr) {
+    *leadI = ECG_ADC_OFFSET_V;
+    *leadII = ECG_ADC_OFFSET_V;
+    return true;
+  }
+  return adcSource->next(leadI, leadII);
+}
+
+// --- Almacenamiento ---
+
+HalFile* hal_file_open(const char* path, const char* mode) {
+  const char* hostMode = strcmp(mode, "w") == 0 ? "w+b" : strcmp(mode, "r+") == 0 ? "r+b" : "rb";
+  FILE* file = fopen(hostPath(path).c_str(), hostMode);
+  if (file == nullptr) return nullptr;
+  
+  HalFile* handle = new HalFile;
+  handle->file = file;
+  return handle;
+}
+
+size_t hal_file_read(HalFile* file, void* data, size_t len) {
+  return fread(data, 1, len, file->file);
+}
+
+size_t hal_file_write(HalFile* file, const void* data, size_t len) {
+  return fwrite(data, 1, len, file->file);
+}
+
+bool hal_file_seek(HalFile* file, uint32_t offset) {
+  return fseek(file->file, offset, SEEK_SET) == 0;
+}
+
+uint32_t hal_file_size(HalFile* file) {
+  struct stat st;
+  fflush(file->file);
+  return fstat(fileno(file->file), &st) == 0 ? st.st_size : 0;
+}
+
+void hal_file_flush(HalFile* file) {
+  fflush(file->file);
+}
+
+void hal_file_close(HalFile* file) {
+  if (file == nullptr) return;
+  fclose(file->file);
+  delete file;
+}
+
+bool hal_fs_remove(const char* path) {
+  return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool hal_fs_rename(const char* from, const char* to) {
+  return rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+// --- Red ---
+
+HalSocket* hal_net_connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+  
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  if (getaddrinfo(host, service, &hints, &addresses) != 0) return nullptr;
+  
+  int fd = -1;
+  for (struct addrinfo* a = addresses; a != nullptr && fd < 0; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0) continue;
+    
+    // Connect no bloqueante para poder cortarlo a los timeoutMs
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    bool connected = connect(fd, a->ai_addr, a->ai_addrlen) == 0;
+    if (!connected && errno == EINPROGRESS) {
+      struct pollfd pfd = { fd, POLLOUT, 0 };
+      int error = 0;
+      socklen_t len = sizeof(error);
+      connected = poll(&pfd, 1, timeoutMs) == 1 &&
+                  getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+    }
+    fcntl(fd, F_SETFL, flags);
+    
+    if (!connected) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) return nullptr;
+  
+  HalSocket* handle = new HalSocket;
+  handle->fd = fd;
+  return handle;
+}
+
+bool hal_net_send(HalSocket* socket, const void* data, size_t len) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  while (len > 0) {
+    ssize_t sent = send(socket->fd, bytes, len, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    bytes += sent;
+    len -= sent;
+  }
+  return true;
+}
+
+int hal_net_recv(HalSocket* socket, void* data, size_t len, uint32_t timeoutMs) {
+  struct pollfd pfd = { socket->fd, POLLIN, 0 };
+  int ready = poll(&pfd, 1, timeoutMs);
+  if (ready == 0) return 0;
+  if (ready < 0) return -1;
+  
+  ssize_t received = recv(socket->fd, data, len, 0);
+  return received > 0 ? (int)received : -1;
+}
+
+void hal_net_close(HalSocket* socket) {
+  if (socket == nullptr) return;
+  close(socket->fd);
+  delete socket;
+}
+
+// --- Pantalla ---
+
+bool hal_display_begin(uint8_t address) {
+  memset(panel, 0, sizeof(panel));
+  return true;
+}
+
+uint32_t hal_display_write(uint8_t page, uint8_t first, uint8_t last, const uint8_t* data) {
+  if (page >= PANEL_PAGES || first > last || last >= PANEL_WIDTH) return 0;
+  
+  int count = last - first + 1;
+  memcpy(panel + page * PANEL_WIDTH + first, data, count);
+  
+  // Misma cuenta que el ESP32: ventana (dirección, control y 6 comandos) y
+  // datos en transmisiones de PANEL_I2C_CHUNK - 1 bytes más dirección y control
+  int transfers = (count + PANEL_I2C_CHUNK - 2) / (PANEL_I2C_CHUNK - 1);
+  uint32_t sent = 8 + count + 2 * transfers;
+  panelBytes += sent;
+  return sent;
+}
@@ -0,0 +1,256 @@
+#include "holter_bench.h"
+#include "holter_synth.h"
+#include "holter_hal.h"
+#include "holter_deflate.h"
+#include "holter_offload_proto.h"
+#include <string.h>
+#include <new>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define BENCH_SIGNAL_SEED 1
+#define BENCH_LEAD_TABLE 256           // Pares de tensiones que recorre la conversión
+#define BENCH_BLOCK_SAMPLES (BENCH_BLOCK_SIZE / sizeof(ECGSample))
+#define BENCH_FILE "/bench.bin"        // Se borra al terminar sd.write y capture.header
+#define BENCH_DATA_OFFSET (sizeof(FileHeader) + sizeof(SessionInfo))
+// Bloques de un segmento: sd.write vuelve al principio de los datos después
+// de escribirlos, así el archivo no pasa del tamaño de uno de la captura
+#define BENCH_SEGMENT_BLOCKS \
+  ((SEGMENT_DURATION_SEC * BENCH_SAMPLE_RATE_HZ * sizeof(ECGSample) + BENCH_BLOCK_SIZE - 1) / BENCH_BLOCK_SIZE)
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static volatile uint32_t sink = 0;
+
+static uint8_t signalBlock[BENCH_BLOCK_SIZE];
+static bool signalReady = false;
+
+static float leadTable[BENCH_LEAD_TABLE][2];
+static uint32_t leadIndex = 0;
+
+static uint8_t writeBuffer[BENCH_BLOCK_SIZE];
+static SegmentBlock writeBlock = { writeBuffer, BENCH_BLOCK_SIZE, 0 };
+
+static EcgSynth* synth = nullptr;
+static DeflateEncoder* encoder = nullptr;
+static HalFile* benchFile = nullptr;
+static uint32_t segmentBlocks = 0;     // Bloques escritos desde el último rebobinado
+static SessionInfo benchInfo;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Entradas realistas: la conversión y el deflate dependen de los valores
+static void prepareSignal() {
+  if (signalReady) return;
+  
+  SynthConfig config;
+  config.seed = BENCH_SIGNAL_SEED;
+  EcgSynth generator;
+  generator.begin(config);
+  
+  size_t index = 0;
+  for (uint32_t i = 0; index < BENCH_BLOCK_SIZE; i++) {
+    SynthSample sample;
+    generator.next(&sample);
+    float leadI = holter_synth_leadVolts(sample.lead_I_mV);
+    float leadII = holter_synth_leadVolts(sample.lead_II_mV);
+    if (i < BENCH_LEAD_TABLE) {
+      leadTable[i][0] = leadI;
+      leadTable[i][1] = leadII;
+    }
+    ECGSample ecg = holter_format_ecgSample(leadI, leadII);
+    holter_format_fillBlock(signalBlock, BENCH_BLOCK_SIZE, &index, (const uint8_t*)&ecg, sizeof(ecg));
+  }
+  signalReady = true;
+}
+
+static bool setupSignal() {
+  prepareSignal();
+  return true;
+}
+
+// El flushBuffer() de la captura se reduce a vaciar el bloque
+static void discardBlock(SegmentBlock* block, void* context) {
+  (void)context;
+  block->index = 0;
+}
+
+static void appendSample(const ECGSample& sample) {
+  holter_segment_append(&writeBlock, &sample, sizeof(sample), discardBlock, nullptr);
+}
+
+static ECGSample nextConverted() {
+  const float* leads = leadTable[leadIndex++ & (BENCH_LEAD_TABLE - 1)];
+  return holter_format_ecgSample(leads[0], leads[1]);
+}
+
+static void countSink(const uint8_t* data, size_t len, void* context) {
+  (void)data;
+  *(size_t*)context += len;
+}
+
+// --- Por muestra ---
+
+static bool setupAdc() {
+  return hal_adc_begin();
+}
+
+static void runAdc() {
+  float leadI, leadII;
+  hal_adc_readLeads(&leadI, &leadII);
+  sink += (uint32_t)(leadI * 1000.0f) + (uint32_t)(leadII * 1000.0f);
+}
+
+static void runConvert() {
+  ECGSample sample = nextConverted();
+  sink += (uint16_t)sample.derivation_III;
+}
+
+static void runWriteToBuffer() {
+  ECGSample sample;
+  memcpy(&sample, signalBlock + (leadIndex++ % BENCH_BLOCK_SAMPLES) * sizeof(ECGSample), sizeof(sample));
+  appendSample(sample);
+  sink += writeBlock.index;
+}
+
+// ADC + conversión + buffer: la parte de CPU del lazo de muestreo
+static bool setupSample() {
+  prepareSignal();
+  return hal_adc_begin();
+}
+
+static void runSample() {
+  ECGSample sample;
+  holter_segment_readSample(&sample);
+  appendSample(sample);
+  sink += writeBlock.index;
+}
+
+// Fuente simulada del ADC (SYNTH_ADC_AT_BOOT): lo que cuesta en el lazo
+static bool setupSynth() {
+  synth = new (std::nothrow) EcgSynth;
+  if (synth == nullptr) return false;
+  SynthConfig config;
+  config.seed = BENCH_SIGNAL_SEED;
+  synth->begin(config);
+  return true;
+}
+
+static void runSynth() {
+  SynthSample sample;
+  synth->next(&sample);
+  sink += (uint32_t)(holter_synth_leadVolts(sample.lead_II_mV) * 1000.0f);
+}
+
+static void teardownSynth() {
+  delete synth;
+  synth = nullptr;
+}
+
+// --- Por buffer ---
+
+static void runCrc() {
+  sink += offload_crc32(0, signalBlock, BENCH_BLOCK_SIZE);
+}
+
+// Archivo con los headers de un segmento, posicionado al principio de los datos
+static bool setupFile() {
+  benchFile = hal_file_open(BENCH_FILE, "w");
+  if (benchFile == nullptr) return false;
+  memset(&benchInfo, 0, sizeof(benchInfo));
+  return holter_segment_writeHeaders(benchFile, 1718000000, 1718000000, &benchInfo);
+}
+
+static void teardownFile() {
+  if (benchFile != nullptr) hal_file_close(benchFile);
+  benchFile = nullptr;
+  hal_fs_remove(BENCH_FILE);
+}
+
+static bool setupWrite() {
+  prepareSignal();
+  segmentBlocks = 0;
+  return setupFile();
+}
+
+static void runWrite() {
+  if (segmentBlocks == BENCH_SEGMENT_BLOCKS) {
+    hal_file_seek(benchFile, BENCH_DATA_OFFSET);
+    segmentBlocks = 0;
+  }
+  sink += hal_file_write(benchFile, signalBlock, BENCH_BLOCK_SIZE);
+  segmentBlocks++;
+}
+
+// El upload comprime de a DEFLATE_MAX_WRITE bytes
+static bool setupDeflate() {
+  prepareSignal();
+  encoder = new (std::nothrow) DeflateEncoder;
+  return encoder != nullptr;
+}
+
+static void runDeflate() {
+  size_t out = 0;
+  encoder->begin(countSink, &out);
+  for (size_t offset = 0; offset < BENCH_BLOCK_SIZE; offset += DEFLATE_MAX_WRITE) {
+    encoder->write(signalBlock + offset, DEFLATE_MAX_WRITE);
+  }
+  encoder->finish();
+  sink += out;
+}
+
+static void teardownDeflate() {
+  delete encoder;
+  encoder = nullptr;
+}
+
+// --- Por segmento ---
+
+// Los headers de un segmento por la HAL, como openSessionFile() y
+// holter_stopCapture(): escribirlos al abrir y actualizarlos al cerrar,
+// cada vez con su flush
+static void runHeader() {
+  hal_file_seek(benchFile, 0);
+  benchInfo.segment_start_ms = sink;
+  holter_segment_writeHeaders(benchFile, 1718000000, 1718000000 + sink % 15, &benchInfo);
+  hal_file_flush(benchFile);
+  
+  sink += holter_segment_patchHeaders(benchFile, SEGMENT_DURATION_SEC * BENCH_SAMPLE_RATE_HZ, 0, &benchInfo);
+  hal_file_flush(benchFile);
+}
+
+static const BenchKernel KERNELS[] = {
+  { "capture.adc",           BENCH_PER_SAMPLE,  0,                 setupAdc,     runAdc,           nullptr },
+  { "capture.convert",       BENCH_PER_SAMPLE,  0,                 setupSignal,  runConvert,       nullptr },
+  { "capture.writeToBuffer", BENCH_PER_SAMPLE,  sizeof(ECGSample), setupSignal,  runWriteToBuffer, nullptr },
+  { "capture.sample",        BENCH_PER_SAMPLE,  sizeof(ECGSample), setupSample,  runSample,        nullptr },
+  { "synth.next",            BENCH_PER_SAMPLE,  0,                 setupSynth,   runSynth,         teardownSynth },
+  { "sd.crc",                BENCH_PER_BLOCK,   BENCH_BLOCK_SIZE,  setupSignal,  runCrc,           nullptr },
+  { "sd.write",              BENCH_PER_BLOCK,   BENCH_BLOCK_SIZE,  setupWrite,   runWrite,         teardownFile },
+  { "upload.deflate",        BENCH_PER_BLOCK,   BENCH_BLOCK_SIZE,  setupDeflate, runDeflate,       teardownDeflate },
+  { "capture.header",        BENCH_PER_SEGMENT, 0,                 setupFile,    runHeader,        teardownFile },
+};
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+const BenchKernel* holter_bench_kernels(size_t* count) {
+  *count = sizeof(KERNELS) / sizeof(KERNELS[0]);
+  return KERNELS;
+}
+
+uint32_t holter_bench_sink() {
+  return sink;
+}
+
+uint8_t* holter_bench_signalBlock() {
+  prepareSignal();
+  return signalBlock;
+}
@@ -1,4 +1,14 @@
 #include "holter_capture.h"
+#include "holter_stream.h"
+#include "display_ui.h"
+#include "holter_crypto.h"
+#include "holter_log.h"
+#include "holter_trace.h"
+#include "holter_metrics.h"
+#include "holter_catalog.h"
+#include "holter_offload_proto.h"
+#include "holter_hal_esp32.h"
+#include "holter_segment.h"
 #include <time.h>
 #include <SPI.h>
 
@@ -13,105 +23,274 @@
 #define SD_MISO 19
 #define SD_SCK 18
 
+// Tarea de escritura a SD (mismo núcleo que la captura, prioridad menor que el muestreo)
+#define SD_WRITER_CORE 1
+#define SD_WRITER_PRIORITY 4
+
+// Montaje de la SD al arrancar, en segundo plano en el núcleo del WiFi
+// (todavía libre): el muestreo no lo espera
+#define SD_MOUNT_CORE 0
+#define SD_MOUNT_PRIORITY 3
+
 // ============================================================================
 // VARIABLES INTERNAS (PRIVADAS)
 // ============================================================================
 
-// Punteros a hardware
-static XSpaceBioV10Board* g_bioBoard = nullptr;
-
-// Configuración
-static const int CAPTURE_DURATION_SEC = 15;
-static const int ECG_SAMPLE_RATE_HZ = 250;
-static const float ECG_SCALE_FACTOR = 6553.6;
-static const int BUFFER_SIZE = 8192;
+// Configuración: una grabación larga se guarda como segmentos de
+// CAPTURE_DURATION_SEC que se suben a medida que se cierran
+static const int CAPTURE_DURATION_SEC = SEGMENT_DURATION_SEC;
+static const uint32_t RECORDING_MAX_SEGMENTS = 5760;   // 24 h: luego empieza otra grabación
+static const int ECG_SAMPLE_RATE_HZ = SESSION_ECG_RATE_HZ;
+static const int BUFFER_SIZE = SEGMENT_BLOCK_SIZE;
 
 // Estado
 static bool isCapturing = false;
-static bool sdAvailable = false;
+static volatile bool sdAvailable = false;
+static volatile bool sdMounting = false;       // Montaje inicial en segundo plano
+
+// Segmento que arrancó en RAM con la SD sin montar: lo abre el escritor
+static volatile bool openPending = false;
+static volatile bool openFailed = false;
+static bool ramBacklog = false;                // Volcar lo acumulado apenas se monte la SD
 
 // Archivo actual
-static File dataFile;
+static HalFile* dataFile = nullptr;
 static String currentSessionFile = "";
 static String currentSessionID = "";
+static uint32_t currentTimestamp = 0;
+static uint32_t sessionCrc = 0;                // CRC32 de lo escrito después de los headers
+
+// Grabación en curso (0 = ninguna): los segmentos se numeran de forma
+// consecutiva mientras la captura rota sin interrupciones
+static uint32_t recordingId = 0;
+static uint32_t segmentIndex = 0;
 
 // Contadores
 static unsigned long captureStartTime = 0;
+static unsigned long firstCaptureStart = 0;    // Base del duty cycle
+static unsigned long segmentEndTime = 0;       // Última muestra del segmento anterior
+static unsigned long segmentStartMs = 0;       // Primera muestra de este segmento
 static unsigned long sampleCount = 0;
 
 // Timing
 static unsigned long lastECGSample = 0;
 static const unsigned long ECG_INTERVAL_US = 1000000 / ECG_SAMPLE_RATE_HZ;
 
-// Buffer de escritura
-static uint8_t writeBuffer[BUFFER_SIZE];
-static int bufferIndex = 0;
+// Doble buffer de escritura: el muestreo llena uno mientras el escritor
+// vuelca el otro a la SD, así una escritura lenta no retrasa las muestras
+static const int NUM_WRITE_BUFFERS = 2;
+static uint8_t writeBuffers[NUM_WRITE_BUFFERS][BUFFER_SIZE];
+static SegmentBlock writeBlock = { writeBuffers[0], BUFFER_SIZE, 0 };
 static unsigned long lastFlush = 0;
 
+struct WriteJob {
+  uint8_t* data;
+  uint16_t len;
+  bool sync;        // Además de escribir, hacer hal_file_flush()
+};
+
+static QueueHandle_t writeJobs = nullptr;     // muestreo → escritor
+static QueueHandle_t freeBuffers = nullptr;   // escritor → muestreo
+static TaskHandle_t writerTaskHandle = nullptr;
+
+// Acceso exclusivo a la SD (captura, cola y upload)
+static SemaphoreHandle_t sdMutex = nullptr;
+static SemaphoreHandle_t i2cMutex = nullptr;
+
+// Métricas
+static CaptureStats stats = {0};
+
 // ============================================================================
 // FUNCIONES INTERNAS (PRIVADAS)
 // ============================================================================
 
-static void flushBuffer() {
-  if (!sdAvailable || bufferIndex == 0) {
-    bufferIndex = 0;
-    return;
+static void fillSessionInfo(SessionInfo* info) {
+  memset(info, 0, sizeof(SessionInfo));
+  info->flags = holter_crypto_isEnabled() ? SESSION_FLAG_ENCRYPTED : 0;
+  info->first_sample_us = stats.first_sample_us;
+  info->first_write_us = stats.first_write_us;
+  info->ram_samples = stats.ram_samples;
+  info->sd_mount_ms = stats.sd_mount_ms;
+  info->segment_start_ms = segmentStartMs;
+}
+
+// Crea el archivo del segmento actual y escribe los headers
+// Llamado con la SD tomada
+static bool openSessionFile() {
+  // Primero el registro del catálogo: así todo archivo de sesión que quede
+  // en la SD tras un corte de energía tiene su registro
+  holter_catalog_begin(recordingId, segmentIndex, currentTimestamp);
+  sessionCrc = 0;
+  
+  // El archivo del segmento anterior queda abierto hasta acá
+  hal_file_close(dataFile);
+  
+  LOG_D("SD", "Creando archivo...");
+  dataFile = hal_file_open(currentSessionFile.c_str(), "w");
+  
+  if (dataFile == nullptr) {
+    LOG_E("ERROR", "No se pudo crear archivo en SD");
+    return false;
   }
   
-  if (!dataFile) {
-    Serial.println("[ERROR] Archivo no está abierto!");
-    bufferIndex = 0;
-    return;
-  }
+  LOG_D("SD", "Archivo abierto correctamente");
   
-  size_t written = dataFile.write(writeBuffer, bufferIndex);
+  // Header INICIAL con contadores en 0. Los tiempos que todavía no se
+  // conocen se completan al cerrar el segmento
+  SessionInfo info;
+  fillSessionInfo(&info);
   
-  if (written == 0) {
-    Serial.println("[ERROR] Write failed - SD Card error!");
-  } else if (written != bufferIndex) {
-    Serial.printf("[WARNING] Escritura parcial: %d/%d bytes\n", written, bufferIndex);
+  size_t headerWritten = sizeof(FileHeader) + sizeof(SessionInfo);
+  if (!holter_segment_writeHeaders(dataFile, recordingId, currentTimestamp, &info)) {
+    LOG_E("ERROR", "Header incompleto");
+    hal_file_close(dataFile);
+    dataFile = nullptr;
+    return false;
   }
   
-  bufferIndex = 0;
-}
-
-static void writeToBuffer(uint8_t* data, size_t len) {
-  for (size_t i = 0; i < len; i++) {
-    writeBuffer[bufferIndex++] = data[i];
-    if (bufferIndex >= BUFFER_SIZE) {
-      flushBuffer();
+  // Sesión cifrada: clave nueva, envuelta con la del equipo en el header
+  if (info.flags & SESSION_FLAG_ENCRYPTED) {
+    EncryptionHeader encryption;
+    if (!holter_crypto_beginSession(&encryption) ||
+        hal_file_write(dataFile, &encryption, sizeof(encryption)) != sizeof(encryption)) {
+      LOG_E("ERROR", "No se pudo iniciar el cifrado de la sesión");
+      holter_crypto_endSession();
+      hal_file_close(dataFile);
+      dataFile = nullptr;
+      return false;
     }
+    headerWritten += sizeof(encryption);
   }
+  
+  hal_file_flush(dataFile);
+  LOG_I("SD", "Header inicial escrito: %u bytes", (unsigned)headerWritten);
+  return true;
 }
 
-// ============================================================================
-// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
-// ============================================================================
-
-void holter_init(XSpaceBioV10Board* bioBoard, XSpaceV21Board* v21Board) {
-  g_bioBoard = bioBoard;
-  
-  Serial.println("[INIT] Inicializando módulo de captura...");
-  
-  // Configurar pines SPI explícitamente
-  pinMode(SD_CS_PIN, OUTPUT);
-  digitalWrite(SD_CS_PIN, HIGH);
+// Segmento que arrancó en RAM: esperar el montaje y abrir el archivo antes
+// de escribir (y cifrar) el primer buffer
+static void openPendingSession() {
+  while (sdMounting) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
   
-  delay(100);
+  holter_sdLock();
+  bool opened = sdAvailable && openSessionFile();
+  holter_sdUnlock();
   
-  // Inicializar SPI con pines específicos
-  SPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS_PIN);
+  if (!opened) {
+    LOG_E("ERROR", "No se pudo abrir el segmento que se estaba grabando en RAM");
+    openFailed = true;
+  }
+  openPending = false;
+}
+
+static void sdWriterTask(void* param) {
+  WriteJob job;
   
-  Serial.println("[INIT] SPI inicializado");
-  Serial.printf("[INIT] Pines - CS:%d, MOSI:%d, MISO:%d, SCK:%d\n", 
-                SD_CS_PIN, SD_MOSI, SD_MISO, SD_SCK);
+  for (;;) {
+    xQueueReceive(writeJobs, &job, portMAX_DELAY);
+    
+    if (openPending) {
+      openPendingSession();
+    }
+    
+    // Cifrar antes de tomar la SD: el lock no se retiene más por el cifrado
+    {
+      TRACE_SCOPE("sd.encrypt");
+      holter_crypto_apply(job.data, job.len);
+    }
+    
+    unsigned long waitStart = micros();
+    {
+      TRACE_SCOPE("sd.lock");
+      holter_sdLock();
+    }
+    unsigned long writeStart = micros();
+    holter_metrics_observe(MH_SD_LOCK_WAIT_US, writeStart - waitStart);
+    
+    if (job.len > 0) {
+      if (dataFile == nullptr) {
+        // Si el segmento no se pudo abrir, la captura lo corta sola
+        if (!openFailed) LOG_E("ERROR", "Archivo no está abierto!");
+      } else {
+        TRACE_SCOPE("sd.write");
+        size_t written = hal_file_write(dataFile, job.data, job.len);
+        
+        if (written == 0) {
+          LOG_E("ERROR", "Write failed - SD Card error!");
+          holter_metrics_add(MC_SD_WRITE_ERRORS);
+        } else if (written != job.len) {
+          LOG_W("WARNING", "Escritura parcial: %u/%u bytes", (unsigned)written, (unsigned)job.len);
+          holter_metrics_add(MC_SD_WRITE_ERRORS);
+        }
+        stats.bytes_written += written;
+        sessionCrc = offload_crc32(sessionCrc, job.data, written);
+        
+        if (stats.first_write_us == 0 && written > 0) {
+          stats.first_write_us = micros();
+          stats.ram_samples = sampleCount;
+        }
+      }
+    }
+    
+    if (job.sync && dataFile != nullptr) {
+      TRACE_SCOPE("sd.flush");
+      hal_file_flush(dataFile);
+    }
+    
+    holter_sdUnlock();
+    
+    unsigned long now = micros();
+    stats.sd_wait_max_us = max(stats.sd_wait_max_us, (uint32_t)(writeStart - waitStart));
+    stats.write_max_us = max(stats.write_max_us, (uint32_t)(now - writeStart));
+    holter_metrics_observe(MH_SD_WRITE_US, now - writeStart);
+    
+    xQueueSend(freeBuffers, &job.data, portMAX_DELAY);
+  }
+}
+
+// Entrega el buffer activo al escritor y continúa sobre el siguiente libre
+static void flushBuffer(bool sync = false) {
+  if ((!sdAvailable && !openPending) || writeJobs == nullptr) {
+    writeBlock.index = 0;
+    return;
+  }
+  if (writeBlock.index == 0 && !sync) return;
+  
+  TRACE_SCOPE("capture.flushBuffer");
+  WriteJob job = { writeBlock.data, (uint16_t)writeBlock.index, sync };
+  xQueueSend(writeJobs, &job, portMAX_DELAY);
+  
+  uint8_t* next = nullptr;
+  if (xQueueReceive(freeBuffers, &next, 0) != pdTRUE) {
+    // El escritor va atrasado (SD lenta o retenida por el upload)
+    stats.buffer_waits++;
+    holter_metrics_add(MC_BUFFER_WAITS);
+    xQueueReceive(freeBuffers, &next, portMAX_DELAY);
+  }
   
-  // Intentar montar SD Card
+  writeBlock.data = next;
+  writeBlock.index = 0;
+}
+
+// Espera a que el escritor haya volcado todos los buffers entregados
+static void waitForWriter() {
+  if (freeBuffers == nullptr) return;
+  while (uxQueueMessagesWaiting(freeBuffers) < NUM_WRITE_BUFFERS - 1) {
+    vTaskDelay(1);
+  }
+}
+
+// Bloque lleno en holter_segment_append()
+static void flushFullBlock(SegmentBlock* block, void* context) {
+  flushBuffer();
+}
+
+// Monta la SD con reintentos; deja sdAvailable con el resultado
+static void mountSD() {
   Serial.print("[SD] Inicializando tarjeta SD...");
   
-  SD.end();
-  delay(500);
-  
   bool sdMounted = false;
   for (int i = 0; i < 5 && !sdMounted; i++) {
     if (i > 0) {
@@ -157,83 +336,154 @@ void holter_init(XSpaceBioV10Board* bioBoard, XSpaceV21Board* v21Board) {
       sdAvailable = true;
     }
   }
-  
-  Serial.println("[INIT] Módulo de captura listo");
 }
 
-bool holter_startCapture() {
-  Serial.println("\n========================================");
-  Serial.println("INICIANDO CAPTURA");
-  Serial.println("========================================");
+// Montaje inicial: SPI y SD con sus reintentos, fuera del camino del muestreo
+static void sdMountTask(void* param) {
+  unsigned long start = millis();
   
-  captureStartTime = millis();
+  // Configurar pines SPI explícitamente
+  pinMode(SD_CS_PIN, OUTPUT);
+  digitalWrite(SD_CS_PIN, HIGH);
   
-  // Obtener timestamp Unix real
-  time_t now;
-  time(&now);
-  unsigned long timestamp = (unsigned long)now;
+  delay(100);
   
-  currentSessionID = "session_" + String(timestamp);
-  currentSessionFile = "/" + currentSessionID + ".bin";
+  // Inicializar SPI con pines específicos
+  SPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS_PIN);
   
-  Serial.println("[INFO] Sesión: " + currentSessionID);
-  Serial.println("[INFO] Archivo: " + currentSessionFile);
-  Serial.println("[INFO] Timestamp Unix: " + String(timestamp));
-  Serial.printf("[INFO] Duración configurada: %d segundos\n", CAPTURE_DURATION_SEC);
+  Serial.println("[INIT] SPI inicializado");
+  Serial.printf("[INIT] Pines - CS:%d, MOSI:%d, MISO:%d, SCK:%d\n", 
+                SD_CS_PIN, SD_MOSI, SD_MISO, SD_SCK);
   
-  if (!sdAvailable) {
-    Serial.println("[ERROR] SD Card no disponible - no se puede capturar");
-    sampleCount = 100;
-    isCapturing = false;
-    return false;
+  holter_sdLock();
+  mountSD();
+  holter_sdUnlock();
+  
+  stats.sd_mount_ms = millis() - start;
+  Serial.printf("[SD] Montaje en segundo plano: %lu ms\n", (unsigned long)stats.sd_mount_ms);
+  
+  sdMounting = false;
+  vTaskDelete(nullptr);
+}
+
+// Escritor de SD en segundo plano (una sola vez; espera la SD si hace falta)
+static void startWriter() {
+  if (writerTaskHandle != nullptr) return;
+  
+  writeJobs = xQueueCreate(NUM_WRITE_BUFFERS, sizeof(WriteJob));
+  freeBuffers = xQueueCreate(NUM_WRITE_BUFFERS, sizeof(uint8_t*));
+  for (int i = 1; i < NUM_WRITE_BUFFERS; i++) {
+    uint8_t* buffer = writeBuffers[i];
+    xQueueSend(freeBuffers, &buffer, 0);
   }
+  writeBlock.data = writeBuffers[0];
   
-  if (SD.cardType() == CARD_NONE) {
-    Serial.println("[ERROR] Tarjeta SD removida o no detectada");
-    sdAvailable = false;
-    return false;
+  xTaskCreatePinnedToCore(sdWriterTask, "sd_writer", 4096, nullptr,
+                          SD_WRITER_PRIORITY, &writerTaskHandle, SD_WRITER_CORE);
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_init(XSpaceBioV10Board* bioBoard, XSpaceV21Board* v21Board) {
+  hal_esp32_setBioBoard(bioBoard);
+  hal_adc_begin();
+  
+  Serial.println("[INIT] Inicializando módulo de captura...");
+  
+  if (i2cMutex == nullptr) {
+    i2cMutex = xSemaphoreCreateMutex();
+  }
+  if (sdMutex == nullptr) {
+    sdMutex = xSemaphoreCreateRecursiveMutex();
   }
   
-  Serial.println("[SD] Creando archivo...");
-  dataFile = SD.open(currentSessionFile.c_str(), FILE_WRITE);
+  // El escritor no depende de la SD: un segmento puede arrancar en RAM
+  startWriter();
   
-  if(!dataFile) {
-    Serial.println("[ERROR] No se pudo crear archivo en SD");
-    return false;
+  sdMounting = true;
+  xTaskCreatePinnedToCore(sdMountTask, "sd_mount", 4096, nullptr,
+                          SD_MOUNT_PRIORITY, nullptr, SD_MOUNT_CORE);
+  
+  Serial.println("[INIT] Módulo de captura listo (SD montándose en segundo plano)");
+}
+
+bool holter_waitForSD() {
+  while (sdMounting) {
+    vTaskDelay(pdMS_TO_TICKS(10));
   }
+  return sdAvailable;
+}
+
+bool holter_startCapture() {
+  LOG_I("CAPTURE", "===== Iniciando captura =====");
   
-  Serial.println("[SD] Archivo abierto correctamente");
-  
-  // Escribir header INICIAL con contadores en 0
-  FileHeader header = {0};
-  header.magic = 0x45434744; // "ECGD"
-  header.version = 1;
-  header.device_id = 1;
-  header.session_id = timestamp;
-  header.timestamp_start = timestamp;
-  header.ecg_sample_rate = ECG_SAMPLE_RATE_HZ;
-  header.imu_sample_rate = 0;
-  header.num_ecg_samples = 0;  // Se actualizará al final
-  header.num_imu_samples = 0;
-  
-  size_t headerWritten = dataFile.write((uint8_t*)&header, sizeof(FileHeader));
-  if (headerWritten != sizeof(FileHeader)) {
-    Serial.printf("[ERROR] Header incompleto (%d/%d bytes)\n", 
-                  headerWritten, sizeof(FileHeader));
-    dataFile.close();
-    return false;
+  // Obtener timestamp Unix real
+  time_t now;
+  time(&now);
+  currentTimestamp = (uint32_t)now;
+  
+  if (recordingId == 0 || segmentIndex + 1 >= RECORDING_MAX_SEGMENTS) {
+    recordingId = currentTimestamp;
+    segmentIndex = 0;
+    LOG_I("INFO", "Nueva grabación: %lu", (unsigned long)recordingId);
+  } else {
+    segmentIndex++;
   }
   
-  dataFile.flush();
-  Serial.printf("[SD] Header inicial escrito: %d bytes\n", headerWritten);
+  currentSessionFile = holter_segmentFilename(recordingId, segmentIndex);
+  currentSessionID = currentSessionFile.substring(1, currentSessionFile.length() - 4);
+  
+  LOG_I("INFO", "Sesión: %s", currentSessionID.c_str());
+  LOG_D("INFO", "Archivo: %s", currentSessionFile.c_str());
+  LOG_D("INFO", "Timestamp Unix: %lu", (unsigned long)currentTimestamp);
+  LOG_D("INFO", "Duración configurada: %d segundos", CAPTURE_DURATION_SEC);
+  
+  openFailed = false;
+  
+  if (sdMounting) {
+    // Arranque: muestrear ya y abrir el archivo cuando la SD esté lista
+    LOG_I("SD", "Montaje en curso - muestreando en RAM");
+    openPending = true;
+    ramBacklog = true;
+  } else if (!sdAvailable) {
+    LOG_E("ERROR", "SD Card no disponible - no se puede capturar");
+    sampleCount = 100;
+    isCapturing = false;
+    return false;
+  } else {
+    holter_sdLock();
+    
+    if (SD.cardType() == CARD_NONE) {
+      holter_sdUnlock();
+      LOG_E("ERROR", "Tarjeta SD removida o no detectada");
+      sdAvailable = false;
+      return false;
+    }
+    
+    bool opened = openSessionFile();
+    holter_sdUnlock();
+    if (!opened) return false;
+  }
   
   sampleCount = 0;
-  bufferIndex = 0;
+  writeBlock.index = 0;
+  segmentStartMs = 0;
   lastFlush = millis();
   isCapturing = true;
+  captureStartTime = millis();    // La duración del segmento cuenta desde la primera muestra
   lastECGSample = micros();
   
-  Serial.println("[CAPTURE] Capturando...\n");
+  // Muestreo perdido entre segmentos: de la última muestra a la primera
+  if (firstCaptureStart == 0) {
+    firstCaptureStart = captureStartTime;
+  } else if (segmentEndTime != 0) {
+    stats.gap_last_ms = millis() - segmentEndTime;
+    stats.gap_max_ms = max(stats.gap_max_ms, stats.gap_last_ms);
+  }
+  
+  LOG_I("CAPTURE", "Capturando...");
   return true;
 }
 
@@ -243,7 +493,9 @@ void holter_captureLoop() {
   unsigned long currentTime = micros();
   unsigned long elapsed = (millis() - captureStartTime) / 1000;
   
-  if (elapsed >= CAPTURE_DURATION_SEC) {
+  // El segmento que arrancó en RAM no se pudo abrir: cortarlo para que la
+  // rotación pase a recuperación
+  if (elapsed >= CAPTURE_DURATION_SEC || openFailed) {
     holter_stopCapture();
     return;
   }
@@ -251,44 +503,44 @@ void holter_captureLoop() {
   // Muestreo ECG a 250Hz
   while (currentTime - lastECGSample >= ECG_INTERVAL_US) {
     lastECGSample += ECG_INTERVAL_US;
-    
-    float derivationI = g_bioBoard->AD8232_GetVoltage(AD8232_XS1);
-    float derivationII = g_bioBoard->AD8232_GetVoltage(AD8232_XS2);
-    
-    const float OFFSET = 1.65;
-    const float AD8232_GAIN = 1100.0;
-    
-    float ecgI_mV = ((derivationI - OFFSET) * 1000.0) / AD8232_GAIN;
-    float ecgII_mV = ((derivationII - OFFSET) * 1000.0) / AD8232_GAIN;
-    float derivationIII = ecgII_mV - ecgI_mV;
+    holter_metrics_observe(MH_SAMPLE_LATENESS_US, currentTime - lastECGSample);
     
     ECGSample sample;
-    sample.derivation_I = (int16_t)(ecgI_mV * ECG_SCALE_FACTOR);
-    sample.derivation_II = (int16_t)(ecgII_mV * ECG_SCALE_FACTOR);
-    sample.derivation_III = (int16_t)(derivationIII * ECG_SCALE_FACTOR);
+    {
+      TRACE_SCOPE("capture.adc");
+      holter_segment_readSample(&sample);
+    }
+    holter_segment_append(&writeBlock, &sample, sizeof(ECGSample), flushFullBlock, nullptr);
+    holter_stream_pushSample(sample);
+    display_pushSample(sample);
     
-    writeToBuffer((uint8_t*)&sample, sizeof(ECGSample));
-    sampleCount++;
+    if (sampleCount++ == 0) {
+      segmentStartMs = millis();
+      if (stats.first_sample_us == 0) stats.first_sample_us = micros();
+    }
     
     currentTime = micros();
   }
   
-  // Flush periódico (cada 2 segundos)
-  if (millis() - lastFlush >= 2000) {
-    flushBuffer();
-    if (dataFile) {
-      dataFile.flush();
-    }
+  // Recién tomada una muestra: si toca, la batería se lee ahora, en este
+  // núcleo y lejos de la próxima
+  display_sampleBattery();
+  
+  // Flush periódico (cada 2 segundos) - lo ejecuta el escritor en segundo plano.
+  // Mientras se monta la SD las muestras se acumulan en RAM y se vuelcan
+  // apenas termina el montaje
+  if (!sdMounting && (ramBacklog || millis() - lastFlush >= 2000)) {
+    flushBuffer(true);
     lastFlush = millis();
+    ramBacklog = false;
   }
   
   // Progreso cada 3 segundos
   static unsigned long lastReport = 0;
   if (elapsed > 0 && elapsed % 3 == 0 && elapsed != lastReport) {
     lastReport = elapsed;
-    Serial.printf("[PROGRESS] %lus/%ds | ECG: %lu muestras (%.1f Hz)\n", 
-                  elapsed, CAPTURE_DURATION_SEC, sampleCount,
-                  (float)sampleCount / elapsed);
+    LOG_I("PROGRESS", "%lus/%ds | ECG: %lu muestras (%.1f Hz)",
+          elapsed, CAPTURE_DURATION_SEC, sampleCount, (float)sampleCount / elapsed);
   }
   
   yield();
@@ -297,107 +549,129 @@ void holter_captureLoop() {
 void holter_stopCapture() {
   if (!isCapturing) return;
   
-  Serial.println("\n[CAPTURE] Finalizando captura...");
+  LOG_I("CAPTURE", "Finalizando captura...");
   isCapturing = false;
   
-  if (!sdAvailable || !dataFile) {
-    Serial.println("[WARNING] Captura sin archivo abierto");
+  segmentEndTime = millis();
+  stats.segments++;
+  stats.captured_ms += segmentEndTime - captureStartTime;
+  if (segmentEndTime > segmentStartMs && sampleCount > 0) {
+    stats.last_rate_hz = sampleCount * 1000.0f / (segmentEndTime - segmentStartMs);
+  }
+  holter_metrics_add(MC_SEGMENTS);
+  holter_metrics_set(MG_SEGMENT_RATE_MHZ, (int32_t)(stats.last_rate_hz * 1000));
+  
+  // Flush final de datos (si el segmento arrancó en RAM, el escritor abre
+  // el archivo con este buffer)
+  LOG_D("DEBUG", "Flush final del buffer (%u bytes pendientes)", (unsigned)writeBlock.index);
+  flushBuffer(true);
+  waitForWriter();
+  holter_crypto_endSession();
+  
+  if (!sdAvailable || dataFile == nullptr) {
+    LOG_W("WARNING", "Captura sin archivo abierto");
     return;
   }
   
-  // Flush final de datos
-  Serial.printf("[DEBUG] Flush final del buffer (%d bytes pendientes)\n", bufferIndex);
-  flushBuffer();
-  dataFile.flush();
-  
-  unsigned long fileSize = dataFile.size();
-  Serial.printf("[DEBUG] Tamaño antes de cerrar: %lu bytes\n", fileSize);
-  Serial.printf("[DEBUG] Muestras capturadas: %lu\n", sampleCount);
-  
-  // NO cerrar el archivo, solo hacer seek para actualizar header
-  Serial.println("[DEBUG] Actualizando header sin cerrar archivo...");
-  delay(100);
-
-  const size_t OFFSET_NUM_ECG = 20;
-  const size_t OFFSET_NUM_IMU = 24;
-  
-  // Escribir num_ecg_samples
-  dataFile.seek(OFFSET_NUM_ECG);
-  uint32_t ecg_count = (uint32_t)sampleCount;
-  size_t written1 = dataFile.write((uint8_t*)&ecg_count, sizeof(uint32_t));
+  // El snapshot se arma antes de tomar la SD: el lock no espera al codificador
+  uint8_t snapshot[METRICS_SNAPSHOT_MAX];
+  size_t snapshotSize = holter_metrics_encode(snapshot, sizeof(snapshot));
+  
+  holter_sdLock();
+  
+  LOG_D("DEBUG", "Tamaño antes de cerrar: %lu bytes, %lu muestras",
+        (unsigned long)hal_file_size(dataFile), sampleCount);
+  
+  // Métricas al final del archivo, en claro: el cifrado termina con las muestras
+  bool metricsWritten = false;
+  if (snapshotSize > 0) {
+    MetricsTrailer trailer = { METRICS_TRAILER_MAGIC, (uint16_t)snapshotSize };
+    hal_file_seek(dataFile, hal_file_size(dataFile));
+    size_t trailerWritten = hal_file_write(dataFile, &trailer, sizeof(trailer));
+    trailerWritten += hal_file_write(dataFile, snapshot, snapshotSize);
+    metricsWritten = trailerWritten == sizeof(trailer) + snapshotSize;
+    sessionCrc = offload_crc32(sessionCrc, (uint8_t*)&trailer, sizeof(trailer));
+    sessionCrc = offload_crc32(sessionCrc, snapshot, snapshotSize);
+  }
   
-  // Escribir num_imu_samples (0)
-  dataFile.seek(OFFSET_NUM_IMU);
-  uint32_t imu_count = 0;
-  size_t written2 = dataFile.write((uint8_t*)&imu_count, sizeof(uint32_t));
+  // NO cerrar el archivo: contadores y tiempos de arranque y del segmento,
+  // completos recién ahora
+  SessionInfo info;
+  fillSessionInfo(&info);
+  if (metricsWritten) info.flags |= SESSION_FLAG_METRICS;
   
-  if (written1 != sizeof(uint32_t) || written2 != sizeof(uint32_t)) {
-    Serial.println("[ERROR] No se pudo actualizar contadores en header");
+  if (!holter_segment_patchHeaders(dataFile, (uint32_t)sampleCount, 0, &info)) {
+    LOG_E("ERROR", "No se pudo actualizar contadores en header");
   } else {
-    Serial.println("[DEBUG] Contadores actualizados en header:");
-    Serial.printf("  - num_ecg_samples: %lu\n", sampleCount);
-    Serial.printf("  - num_imu_samples: 0\n");
+    LOG_D("DEBUG", "Header actualizado: num_ecg_samples %lu, primera muestra %lu us, "
+          "primera escritura %lu us (%lu muestras en RAM)", sampleCount,
+          (unsigned long)info.first_sample_us, (unsigned long)info.first_write_us,
+          (unsigned long)info.ram_samples);
   }
   
-  dataFile.flush();
-  
-  // Verificación final
-  delay(100);
+  hal_file_flush(dataFile);
   
-  File checkFile = SD.open(currentSessionFile.c_str(), FILE_READ);
-  if (!checkFile) {
-    Serial.println("[ERROR] No se pudo reabrir para verificación");
+  // Verificación final (sin esperas: el flush ya dejó el header en la SD)
+  HalFile* checkFile = hal_file_open(currentSessionFile.c_str(), "r");
+  if (checkFile == nullptr) {
+    holter_sdUnlock();
+    LOG_E("ERROR", "No se pudo reabrir para verificación");
     return;
   }
   
-  unsigned long finalSize = checkFile.size();
+  unsigned long finalSize = hal_file_size(checkFile);
   
   // Leer y verificar header
   FileHeader verifyHeader;
-  size_t headerRead = checkFile.read((uint8_t*)&verifyHeader, sizeof(FileHeader));
-  checkFile.close();
+  size_t headerRead = hal_file_read(checkFile, &verifyHeader, sizeof(FileHeader));
+  hal_file_close(checkFile);
+  holter_sdUnlock();
+  
+  time_t now;
+  time(&now);
+  holter_catalog_complete(recordingId, segmentIndex, finalSize, sessionCrc, (uint32_t)now);
   
   unsigned long expectedSize = sizeof(FileHeader) + (sampleCount * sizeof(ECGSample));
+  if (verifyHeader.version == 3) expectedSize += sizeof(SessionInfo);
+  if (info.flags & SESSION_FLAG_ENCRYPTED) expectedSize += sizeof(EncryptionHeader);
+  if (info.flags & SESSION_FLAG_METRICS) expectedSize += sizeof(MetricsTrailer) + snapshotSize;
   
-  Serial.println("\n========================================");
-  Serial.println("CAPTURA COMPLETADA");
-  Serial.println("========================================");
-  Serial.printf("[INFO] Archivo: %s\n", currentSessionFile.c_str());
-  Serial.printf("[INFO] Tamaño: %lu bytes (%.2f KB)\n", finalSize, finalSize/1024.0);
-  Serial.printf("[INFO] ECG muestras: %lu\n", sampleCount);
-  Serial.printf("[INFO] Frecuencia real: %.1f Hz\n", 
-                (float)sampleCount / CAPTURE_DURATION_SEC);
+  LOG_I("CAPTURE", "===== Captura completada: %s =====", currentSessionFile.c_str());
+  LOG_I("INFO", "Tamaño: %lu bytes (%.2f KB), %lu muestras ECG (%.1f Hz)", finalSize,
+        finalSize / 1024.0, sampleCount, (float)sampleCount / CAPTURE_DURATION_SEC);
   
   if (headerRead == sizeof(FileHeader)) {
-    Serial.printf("[VERIFY] Header magic: 0x%08X\n", verifyHeader.magic);
-    Serial.printf("[VERIFY] Header num_ecg: %u\n", verifyHeader.num_ecg_samples);
-    Serial.printf("[VERIFY] Header num_imu: %u\n", verifyHeader.num_imu_samples);
+    LOG_D("VERIFY", "Header magic: 0x%08X, num_ecg: %u, num_imu: %u",
+          (unsigned)verifyHeader.magic, (unsigned)verifyHeader.num_ecg_samples,
+          (unsigned)verifyHeader.num_imu_samples);
     
-    if (verifyHeader.num_ecg_samples == sampleCount) {
-      Serial.println("[OK] Header actualizado correctamente ✓");
-    } else {
-      Serial.printf("[WARNING] Header no coincide: esperado %lu, leído %u\n", 
-                    sampleCount, verifyHeader.num_ecg_samples);
+    if (verifyHeader.num_ecg_samples != sampleCount) {
+      LOG_W("WARNING", "Header no coincide: esperado %lu, leído %u",
+            sampleCount, (unsigned)verifyHeader.num_ecg_samples);
     }
   } else {
-    Serial.println("[ERROR] No se pudo leer header para verificar");
+    LOG_E("ERROR", "No se pudo leer header para verificar");
   }
   
-  Serial.printf("[VERIFY] Esperado: %lu bytes | Real: %lu bytes\n", expectedSize, finalSize);
-  
   if (finalSize == expectedSize) {
-    Serial.println("[OK] Archivo completo y válido ✓");
+    LOG_I("OK", "Archivo completo y válido ✓");
   } else {
-    long diff = (long)(finalSize - expectedSize);
-    Serial.printf("[INFO] Diferencia: %ld bytes\n", diff);
+    LOG_W("WARNING", "Tamaño esperado %lu bytes, real %lu (diferencia %ld)",
+          expectedSize, finalSize, (long)(finalSize - expectedSize));
   }
-  Serial.println("========================================\n");
 }
 
 bool holter_isCapturing() {
   return isCapturing;
 }
 
+uint32_t holter_getNextSampleDelayUs() {
+  if (!isCapturing) return 0;
+  
+  unsigned long sinceLast = micros() - lastECGSample;
+  return sinceLast >= ECG_INTERVAL_US ? 0 : ECG_INTERVAL_US - sinceLast;
+}
+
 float holter_getProgress() {
   if (!isCapturing) return 0.0;
   unsigned long elapsed = (millis() - captureStartTime) / 1000;
@@ -422,10 +696,94 @@ unsigned long holter_getIMUSampleCount() {
   return 0;
 }
 
+uint32_t holter_getRecordingID() {
+  return recordingId;
+}
+
+uint32_t holter_getSegmentIndex() {
+  return segmentIndex;
+}
+
+String holter_segmentFilename(uint32_t recording, uint32_t segment) {
+  char name[40];
+  snprintf(name, sizeof(name), "/session_%lu_s%04lu.bin",
+           (unsigned long)recording, (unsigned long)segment);
+  return String(name);
+}
+
+bool holter_parseSegmentFilename(const char* filename, uint32_t* recording, uint32_t* segment) {
+  unsigned long rec;
+  unsigned long seg;
+  int consumed = 0;
+  if (sscanf(filename, "/session_%lu_s%lu.bin%n", &rec, &seg, &consumed) != 2 ||
+      consumed == 0 || filename[consumed] != '\0') {
+    return false;
+  }
+  *recording = rec;
+  *segment = seg;
+  return true;
+}
+
 bool holter_isSDAvailable() {
   return sdAvailable;
 }
 
+bool holter_remountSD() {
+  holter_sdLock();
+  hal_file_close(dataFile);
+  dataFile = nullptr;
+  
+  // Soltar la tarjeta anterior y darle tiempo a reiniciarse (al arrancar no hace falta)
+  SD.end();
+  delay(500);
+  mountSD();
+  holter_sdUnlock();
+  
+  startWriter();
+  return sdAvailable;
+}
+
+void holter_unmountSD() {
+  waitForWriter();
+  
+  holter_sdLock();
+  hal_file_close(dataFile);
+  dataFile = nullptr;
+  SD.end();
+  sdAvailable = false;
+  holter_sdUnlock();
+}
+
 bool holter_isIMUAvailable() {
   return false;
-}
\ No newline at end of file
+}
+
+void holter_sdLock() {
+  if (sdMutex != nullptr) {
+    xSemaphoreTakeRecursive(sdMutex, portMAX_DELAY);
+  }
+}
+
+void holter_sdUnlock() {
+  if (sdMutex != nullptr) {
+    xSemaphoreGiveRecursive(sdMutex);
+  }
+}
+
+void holter_i2cLock() {
+  if (i2cMutex != nullptr) {
+    xSemaphoreTake(i2cMutex, portMAX_DELAY);
+  }
+}
+
+void holter_i2cUnlock() {
+  if (i2cMutex != nullptr) {
+    xSemaphoreGive(i2cMutex);
+  }
+}
+
+CaptureStats holter_getCaptureStats() {
+  CaptureStats result = stats;
+  result.wall_ms = firstCaptureStart > 0 ? millis() - firstCaptureStart : 0;
+  return result;
+}
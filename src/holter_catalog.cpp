@@ -0,0 +1,303 @@
+#include "holter_catalog.h"
+#include "holter_capture.h"
+#include "holter_log.h"
+#include <SD.h>
+#include <time.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define CATALOG_FILE "/catalog.dat"
+#define CATALOG_TEMP_FILE "/catalog.tmp"   // Compactación en curso
+
+// ============================================================================
+// ADAPTADORES
+// ============================================================================
+
+// El archivo se abre por operación (como la cola): un handle abierto no
+// sobrevive a un desmontaje de la SD. Se llama con la SD tomada.
+class SdCatalogFile : public CatalogFile {
+public:
+  explicit SdCatalogFile(const char* path) : path(path) {}
+  
+  // "r+" para actualizar en su lugar; FILE_WRITE crea o trunca
+  bool open(const char* mode) {
+    file = SD.open(path, mode);
+    return (bool)file;
+  }
+  
+  void close() {
+    if (file) file.close();
+  }
+  
+  bool read(uint32_t offset, void* data, size_t len) override {
+    return file && file.seek(offset) && file.read((uint8_t*)data, len) == len;
+  }
+  
+  bool write(uint32_t offset, const void* data, size_t len) override {
+    if (!file || !file.seek(offset)) return false;
+    bool ok = file.write((const uint8_t*)data, len) == len;
+    file.flush();
+    return ok;
+  }
+  
+  uint32_t size() override {
+    return file ? file.size() : 0;
+  }
+
+private:
+  const char* path;
+  File file;
+};
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Protegidas por el lock de la SD: toda operación del catálogo lo necesita
+// igual, y así no hay un segundo lock que ordenar contra el de la SD
+static SdCatalogFile catalogFile(CATALOG_FILE);
+static SessionCatalog catalog(catalogFile);
+static bool valid = false;
+static uint32_t loadMs = 0;
+static uint32_t rebuilds = 0;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static uint32_t nowUnix() {
+  time_t now;
+  time(&now);
+  return (uint32_t)now;
+}
+
+// Toma la SD y abre el catálogo; si devuelve true hay que llamar a endOp()
+static bool beginOp() {
+  holter_sdLock();
+  if (valid && catalogFile.open("r+")) return true;
+  holter_sdUnlock();
+  return false;
+}
+
+static void endOp() {
+  catalogFile.close();
+  holter_sdUnlock();
+}
+
+static bool putRecord(CatalogRecord* record) {
+  if (!beginOp()) return false;
+  bool ok = catalog.put(record) >= 0;
+  endOp();
+  
+  if (!ok) {
+    LOG_E("CATALOG", "No se pudo escribir el registro de %lu/%lu",
+          (unsigned long)record->recording_id, (unsigned long)record->segment);
+  }
+  return ok;
+}
+
+// Reescribe el catálogo sin los registros borrados. El archivo nuevo se arma
+// aparte y reemplaza al viejo recién completo (ver holter_catalog_init)
+// Llamado con la SD tomada y el catálogo cerrado
+static bool compactFile() {
+  uint32_t before = catalog.records();
+  
+  SdCatalogFile temp(CATALOG_TEMP_FILE);
+  if (!temp.open(FILE_WRITE)) return false;
+  bool ok = catalogFile.open(FILE_READ) && catalog.compact(temp, nowUnix());
+  catalogFile.close();
+  temp.close();
+  
+  if (!ok) {
+    SD.remove(CATALOG_TEMP_FILE);
+    return false;
+  }
+  if (!SD.remove(CATALOG_FILE) || !SD.rename(CATALOG_TEMP_FILE, CATALOG_FILE)) {
+    return false;
+  }
+  
+  ok = catalogFile.open(FILE_READ) && catalog.load() == CATALOG_OK;
+  catalogFile.close();
+  LOG_I("CATALOG", "Compactado: %lu -> %lu registros",
+        (unsigned long)before, (unsigned long)catalog.records());
+  return ok;
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+CatalogStatus holter_catalog_init() {
+  unsigned long start = millis();
+  CatalogStatus status = CATALOG_MISSING;
+  
+  holter_sdLock();
+  valid = false;
+  
+  // Sin catálogo pero con la copia compactada: el corte fue entre el borrado
+  // y el rename. (No se pregunta antes por el .tmp: buscar un archivo que no
+  // existe recorre el directorio entero.)
+  bool opened = catalogFile.open(FILE_READ);
+  if (!opened && SD.rename(CATALOG_TEMP_FILE, CATALOG_FILE)) {
+    opened = catalogFile.open(FILE_READ);
+  }
+  if (opened) {
+    status = catalog.load();
+    catalogFile.close();
+  }
+  
+  if (status == CATALOG_OK && catalog.count(CATALOG_DELETED) >= CATALOG_COMPACT_DELETED &&
+      !compactFile()) {
+    LOG_E("CATALOG", "Falló la compactación - se reconstruye");
+    status = CATALOG_CORRUPT;
+  }
+  
+  valid = status == CATALOG_OK;
+  holter_sdUnlock();
+  loadMs = millis() - start;
+  
+  if (status == CATALOG_OK) {
+    LOG_I("CATALOG", "%lu registros cargados en %lu ms",
+          (unsigned long)catalog.records(), (unsigned long)loadMs);
+  } else {
+    LOG_W("CATALOG", "Catálogo %s - hay que reconstruirlo",
+          status == CATALOG_MISSING ? "inexistente" : "corrupto");
+  }
+  return status;
+}
+
+bool holter_catalog_reset() {
+  holter_sdLock();
+  bool ok = catalogFile.open(FILE_WRITE) && catalog.create(nowUnix());
+  catalogFile.close();
+  valid = ok;
+  if (ok) rebuilds++;
+  holter_sdUnlock();
+  
+  if (!ok) LOG_E("CATALOG", "No se pudo crear " CATALOG_FILE);
+  return ok;
+}
+
+bool holter_catalog_begin(uint32_t recordingId, uint32_t segment, uint32_t timeStart) {
+  CatalogRecord record;
+  memset(&record, 0, sizeof(record));
+  record.recording_id = recordingId;
+  record.segment = segment;
+  record.time_start = timeStart;
+  record.state = CATALOG_RECORDING;
+  return putRecord(&record);
+}
+
+bool holter_catalog_complete(uint32_t recordingId, uint32_t segment, uint32_t size,
+                             uint32_t dataCrc, uint32_t timeEnd) {
+  if (!beginOp()) return false;
+  
+  // Si el segmento arrancó antes de cargar el catálogo (montaje en segundo
+  // plano) no tiene registro todavía: se crea ahora
+  CatalogRecord record;
+  if (catalog.find(recordingId, segment, &record) < 0) {
+    memset(&record, 0, sizeof(record));
+    record.recording_id = recordingId;
+    record.segment = segment;
+  }
+  record.size = size;
+  record.data_crc = dataCrc;
+  record.time_end = timeEnd;
+  record.state = CATALOG_COMPLETE;
+  bool ok = catalog.put(&record) >= 0;
+  endOp();
+  
+  if (!ok) {
+    LOG_E("CATALOG", "No se pudo registrar el cierre de %lu/%lu",
+          (unsigned long)recordingId, (unsigned long)segment);
+  }
+  return ok;
+}
+
+bool holter_catalog_addBatch(CatalogRecord* records, size_t count) {
+  if (!beginOp()) return false;
+  
+  bool ok = true;
+  for (size_t i = 0; i < count; i++) {
+    if (catalog.add(&records[i]) < 0) ok = false;
+  }
+  endOp();
+  
+  if (!ok) LOG_E("CATALOG", "No se pudo agregar parte de un lote de %u registros", (unsigned)count);
+  return ok;
+}
+
+bool holter_catalog_setState(const char* filename, CatalogState state) {
+  uint32_t recordingId;
+  uint32_t segment;
+  if (!holter_parseSegmentFilename(filename, &recordingId, &segment)) return false;
+  if (!beginOp()) return false;
+  
+  CatalogRecord record;
+  bool ok = catalog.find(recordingId, segment, &record) >= 0;
+  if (ok && record.state != state) {
+    record.state = state;
+    ok = catalog.put(&record) >= 0;
+  }
+  endOp();
+  return ok;
+}
+
+bool holter_catalog_find(uint32_t recordingId, uint32_t segment, CatalogRecord* record) {
+  if (!beginOp()) return false;
+  bool found = catalog.find(recordingId, segment, record) >= 0;
+  endOp();
+  return found;
+}
+
+bool holter_catalog_next(uint32_t* cursor, uint32_t stateMask, CatalogRecord* record) {
+  if (!beginOp()) return false;
+  bool found = catalog.next(cursor, stateMask, record);
+  endOp();
+  return found;
+}
+
+bool holter_catalog_isValid() {
+  return valid;
+}
+
+CatalogStats holter_catalog_getStats() {
+  CatalogStats stats;
+  memset(&stats, 0, sizeof(stats));
+  
+  holter_sdLock();
+  stats.valid = valid;
+  if (valid) {
+    stats.records = catalog.records();
+    stats.runs = catalog.runs();
+    for (int s = CATALOG_RECORDING; s < CATALOG_STATES; s++) {
+      stats.counts[s] = catalog.count((CatalogState)s);
+      stats.bytes[s] = catalog.bytes((CatalogState)s);
+    }
+  }
+  holter_sdUnlock();
+  
+  stats.load_ms = loadMs;
+  stats.rebuilds = rebuilds;
+  return stats;
+}
+
+void holter_catalog_printStatus() {
+  CatalogStats stats = holter_catalog_getStats();
+  if (!stats.valid) {
+    Serial.println("[CATALOG] Sin catálogo");
+    return;
+  }
+  
+  Serial.printf("[CATALOG] %lu registros (%lu corridas) | grabando: %lu | pendientes: %lu (%.1f KB) | "
+                "subiendo: %lu | subidos: %lu | borrados: %lu\n",
+                (unsigned long)stats.records, (unsigned long)stats.runs,
+                (unsigned long)stats.counts[CATALOG_RECORDING],
+                (unsigned long)stats.counts[CATALOG_COMPLETE],
+                stats.bytes[CATALOG_COMPLETE] / 1024.0,
+                (unsigned long)stats.counts[CATALOG_UPLOADING],
+                (unsigned long)stats.counts[CATALOG_UPLOADED],
+                (unsigned long)stats.counts[CATALOG_DELETED]);
+}
@@ -0,0 +1,272 @@
+#include "holter_catalog_store.h"
+#include "holter_offload_proto.h"
+#include <stddef.h>
+#include <string.h>
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Mismo CRC32 (IEEE) que las tramas de descarga por USB-serie
+static uint32_t recordCrc(const void* data) {
+  return offload_crc32(0, (const uint8_t*)data, CATALOG_RECORD_SIZE - sizeof(uint32_t));
+}
+
+static uint32_t offsetOf(uint32_t index) {
+  return sizeof(CatalogHeader) + index * CATALOG_RECORD_SIZE;
+}
+
+static uint32_t chunkSize(uint32_t from, uint32_t end) {
+  return (end - from < CATALOG_READ_RECORDS) ? end - from : CATALOG_READ_RECORDS;
+}
+
+bool catalog_recordValid(const CatalogRecord& record) {
+  return record.crc == recordCrc(&record) &&
+         record.state >= CATALOG_RECORDING && record.state < CATALOG_STATES;
+}
+
+void SessionCatalog::reset() {
+  recordCount = 0;
+  memset(counts, 0, sizeof(counts));
+  memset(stateBytes, 0, sizeof(stateBytes));
+  liveStart = 0;
+  runCount = 0;
+  indexedFrom = 0;
+}
+
+bool SessionCatalog::readRecords(uint32_t index, CatalogRecord* records, uint32_t count) {
+  return file.read(offsetOf(index), records, count * CATALOG_RECORD_SIZE);
+}
+
+bool SessionCatalog::writeRecord(uint32_t index, CatalogRecord* record) {
+  memset(record->reserved, 0, sizeof(record->reserved));
+  record->crc = recordCrc(record);
+  return file.write(offsetOf(index), record, CATALOG_RECORD_SIZE);
+}
+
+void SessionCatalog::account(const CatalogRecord& record, int direction) {
+  if (direction > 0) {
+    counts[record.state]++;
+    stateBytes[record.state] += record.size;
+  } else {
+    counts[record.state]--;
+    stateBytes[record.state] -= record.size;
+  }
+}
+
+// Extiende la última corrida o abre una nueva. Con la tabla llena se olvida
+// la más vieja: esos registros se siguen encontrando, pero leyendo el archivo
+void SessionCatalog::index(const CatalogRecord& record, uint32_t position) {
+  if (runCount > 0) {
+    CatalogRun& last = runList[runCount - 1];
+    if (last.recording_id == record.recording_id &&
+        last.first_segment + last.count == record.segment &&
+        last.first_index + last.count == position) {
+      last.count++;
+      return;
+    }
+  }
+  
+  if (runCount == CATALOG_MAX_RUNS) {
+    memmove(runList, runList + 1, (CATALOG_MAX_RUNS - 1) * sizeof(CatalogRun));
+    runCount--;
+    indexedFrom = runList[0].first_index;
+  }
+  
+  CatalogRun& run = runList[runCount++];
+  run.recording_id = record.recording_id;
+  run.first_segment = record.segment;
+  run.first_index = position;
+  run.count = 1;
+}
+
+// Búsqueda lineal en [0, end): solo para lo que quedó fuera de las corridas
+int32_t SessionCatalog::scan(uint32_t end, uint32_t recordingId, uint32_t segment,
+                             CatalogRecord* record) {
+  CatalogRecord chunk[CATALOG_READ_RECORDS];
+  for (uint32_t i = 0; i < end; ) {
+    uint32_t n = chunkSize(i, end);
+    if (!readRecords(i, chunk, n)) return -1;
+    for (uint32_t j = 0; j < n; j++) {
+      if (chunk[j].recording_id == recordingId && chunk[j].segment == segment &&
+          catalog_recordValid(chunk[j])) {
+        if (record != nullptr) *record = chunk[j];
+        return i + j;
+      }
+    }
+    i += n;
+  }
+  return -1;
+}
+
+// Corre liveStart sobre los registros borrados
+void SessionCatalog::advanceLive() {
+  CatalogRecord chunk[CATALOG_READ_RECORDS];
+  while (liveStart < recordCount) {
+    uint32_t n = chunkSize(liveStart, recordCount);
+    if (!readRecords(liveStart, chunk, n)) return;
+    for (uint32_t j = 0; j < n; j++) {
+      if (chunk[j].state != CATALOG_DELETED) return;
+      liveStart++;
+    }
+  }
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+CatalogStatus SessionCatalog::load() {
+  reset();
+  
+  uint32_t fileSize = file.size();
+  if (fileSize < sizeof(CatalogHeader)) return CATALOG_MISSING;
+  
+  CatalogHeader header;
+  if (!file.read(0, &header, sizeof(header)) ||
+      header.magic != CATALOG_MAGIC || header.version != CATALOG_VERSION ||
+      header.record_size != CATALOG_RECORD_SIZE || header.crc != recordCrc(&header)) {
+    return CATALOG_CORRUPT;
+  }
+  
+  uint32_t total = (fileSize - sizeof(CatalogHeader)) / CATALOG_RECORD_SIZE;
+  bool liveFound = false;
+  CatalogRecord chunk[CATALOG_READ_RECORDS];
+  
+  for (uint32_t i = 0; i < total; ) {
+    uint32_t n = chunkSize(i, total);
+    if (!readRecords(i, chunk, n)) {
+      reset();
+      return CATALOG_CORRUPT;
+    }
+    
+    for (uint32_t j = 0; j < n; j++) {
+      // Cualquier registro inválido (actualización cortada por un corte de
+      // energía) invalida el catálogo: no se sabe qué sesión tenía
+      if (!catalog_recordValid(chunk[j])) {
+        reset();
+        return CATALOG_CORRUPT;
+      }
+      account(chunk[j], 1);
+      index(chunk[j], i + j);
+      if (!liveFound && chunk[j].state != CATALOG_DELETED) {
+        liveStart = i + j;
+        liveFound = true;
+      }
+    }
+    i += n;
+  }
+  
+  recordCount = total;
+  if (!liveFound) liveStart = total;
+  return CATALOG_OK;
+}
+
+bool SessionCatalog::create(uint32_t now) {
+  reset();
+  
+  CatalogHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = CATALOG_MAGIC;
+  header.version = CATALOG_VERSION;
+  header.record_size = CATALOG_RECORD_SIZE;
+  header.created = now;
+  header.crc = recordCrc(&header);
+  return file.write(0, &header, sizeof(header));
+}
+
+int32_t SessionCatalog::find(uint32_t recordingId, uint32_t segment, CatalogRecord* record) {
+  // De la corrida más nueva a la más vieja: casi siempre se busca lo reciente
+  for (uint32_t r = runCount; r-- > 0; ) {
+    const CatalogRun& run = runList[r];
+    if (run.recording_id != recordingId || segment < run.first_segment ||
+        segment - run.first_segment >= run.count) {
+      continue;
+    }
+    
+    uint32_t position = run.first_index + (segment - run.first_segment);
+    CatalogRecord found;
+    if (!readRecords(position, &found, 1) || !catalog_recordValid(found) ||
+        found.recording_id != recordingId || found.segment != segment) {
+      return -1;
+    }
+    if (record != nullptr) *record = found;
+    return position;
+  }
+  
+  return indexedFrom > 0 ? scan(indexedFrom, recordingId, segment, record) : -1;
+}
+
+int32_t SessionCatalog::put(CatalogRecord* record) {
+  CatalogRecord previous;
+  int32_t position = find(record->recording_id, record->segment, &previous);
+  if (position < 0) return add(record);
+  
+  if (!writeRecord(position, record)) return -1;
+  account(previous, -1);
+  account(*record, 1);
+  
+  if (record->state != CATALOG_DELETED) {
+    if ((uint32_t)position < liveStart) liveStart = position;
+  } else if ((uint32_t)position == liveStart) {
+    advanceLive();
+  }
+  return position;
+}
+
+int32_t SessionCatalog::add(CatalogRecord* record) {
+  uint32_t position = recordCount;
+  if (!writeRecord(position, record)) return -1;
+  
+  recordCount++;
+  index(*record, position);
+  account(*record, 1);
+  if (record->state == CATALOG_DELETED && position == liveStart) liveStart++;
+  return position;
+}
+
+bool SessionCatalog::next(uint32_t* cursor, uint32_t stateMask, CatalogRecord* record) {
+  uint32_t i = (*cursor > liveStart) ? *cursor : liveStart;
+  CatalogRecord chunk[CATALOG_READ_RECORDS];
+  
+  while (i < recordCount) {
+    uint32_t n = chunkSize(i, recordCount);
+    if (!readRecords(i, chunk, n)) break;
+    
+    for (uint32_t j = 0; j < n; j++) {
+      if (catalog_recordValid(chunk[j]) && (stateMask & CATALOG_MASK(chunk[j].state))) {
+        *record = chunk[j];
+        *cursor = i + j + 1;
+        return true;
+      }
+    }
+    i += n;
+  }
+  
+  *cursor = recordCount;
+  return false;
+}
+
+bool SessionCatalog::compact(CatalogFile& out, uint32_t now) {
+  SessionCatalog target(out);
+  if (!target.create(now)) return false;
+  
+  CatalogRecord chunk[CATALOG_READ_RECORDS];
+  uint32_t written = 0;
+  
+  for (uint32_t i = liveStart; i < recordCount; ) {
+    uint32_t n = chunkSize(i, recordCount);
+    if (!readRecords(i, chunk, n)) return false;
+    
+    uint32_t kept = 0;
+    for (uint32_t j = 0; j < n; j++) {
+      if (chunk[j].state != CATALOG_DELETED) chunk[kept++] = chunk[j];
+    }
+    if (kept > 0 && !out.write(offsetOf(written), chunk, kept * CATALOG_RECORD_SIZE)) {
+      return false;
+    }
+    written += kept;
+    i += n;
+  }
+  return true;
+}
@@ -0,0 +1,263 @@
+#include "holter_cbor.h"
+#include <string.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define MAJOR_UINT 0
+#define MAJOR_NEGINT 1
+#define MAJOR_BYTES 2
+#define MAJOR_TEXT 3
+#define MAJOR_ARRAY 4
+#define MAJOR_MAP 5
+#define MAJOR_TAG 6
+#define MAJOR_SIMPLE 7
+
+#define SIMPLE_FALSE 20
+#define SIMPLE_TRUE 21
+
+#define MAX_NESTING 8
+
+// ============================================================================
+// ESCRITURA
+// ============================================================================
+
+CborWriter::CborWriter(uint8_t* buffer, size_t capacity)
+  : buffer(buffer), capacity(capacity), length(0), overflow(false) {}
+
+void CborWriter::put(const uint8_t* data, size_t count) {
+  if (overflow || length + count > capacity) {
+    overflow = true;
+    return;
+  }
+  memcpy(buffer + length, data, count);
+  length += count;
+}
+
+// Cabecera: 3 bits de tipo mayor + valor inmediato o largo de 1/2/4 bytes
+void CborWriter::head(uint8_t major, uint32_t value) {
+  uint8_t bytes[5];
+  size_t count;
+  
+  if (value < 24) {
+    bytes[0] = (major << 5) | value;
+    count = 1;
+  } else if (value <= 0xFF) {
+    bytes[0] = (major << 5) | 24;
+    bytes[1] = value;
+    count = 2;
+  } else if (value <= 0xFFFF) {
+    bytes[0] = (major << 5) | 25;
+    bytes[1] = value >> 8;
+    bytes[2] = value & 0xFF;
+    count = 3;
+  } else {
+    bytes[0] = (major << 5) | 26;
+    bytes[1] = value >> 24;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = (value >> 8) & 0xFF;
+    bytes[4] = value & 0xFF;
+    count = 5;
+  }
+  put(bytes, count);
+}
+
+void CborWriter::map(uint32_t pairs) {
+  head(MAJOR_MAP, pairs);
+}
+
+void CborWriter::array(uint32_t items) {
+  head(MAJOR_ARRAY, items);
+}
+
+void CborWriter::uint(uint32_t value) {
+  head(MAJOR_UINT, value);
+}
+
+void CborWriter::integer(int32_t value) {
+  if (value < 0) {
+    head(MAJOR_NEGINT, (uint32_t)(-1 - value));
+  } else {
+    head(MAJOR_UINT, (uint32_t)value);
+  }
+}
+
+void CborWriter::text(const char* value) {
+  text(value, strlen(value));
+}
+
+void CborWriter::text(const char* value, size_t count) {
+  head(MAJOR_TEXT, count);
+  put((const uint8_t*)value, count);
+}
+
+void CborWriter::boolean(bool value) {
+  uint8_t byte = (MAJOR_SIMPLE << 5) | (value ? SIMPLE_TRUE : SIMPLE_FALSE);
+  put(&byte, 1);
+}
+
+// ============================================================================
+// LECTURA
+// ============================================================================
+
+CborReader::CborReader(const uint8_t* data, size_t length)
+  : data(data), length(length), position(0), error(false) {}
+
+bool CborReader::readHead(uint8_t* major, uint64_t* value) {
+  if (error || position >= length) {
+    error = true;
+    return false;
+  }
+  
+  uint8_t initial = data[position++];
+  *major = initial >> 5;
+  uint8_t info = initial & 0x1F;
+  
+  if (info < 24) {
+    *value = info;
+    return true;
+  }
+  if (info > 27) {
+    // Longitud indefinida (31) o reservado: no se usa en este protocolo
+    error = true;
+    return false;
+  }
+  
+  size_t count = (size_t)1 << (info - 24);
+  if (length - position < count) {
+    error = true;
+    return false;
+  }
+  
+  uint64_t result = 0;
+  for (size_t i = 0; i < count; i++) {
+    result = (result << 8) | data[position++];
+  }
+  *value = result;
+  return true;
+}
+
+CborType CborReader::peekType() const {
+  if (error) return CBOR_INVALID;
+  if (position >= length) return CBOR_END;
+  
+  switch (data[position] >> 5) {
+    case MAJOR_UINT: return CBOR_UINT;
+    case MAJOR_NEGINT: return CBOR_NEGINT;
+    case MAJOR_BYTES: return CBOR_BYTES;
+    case MAJOR_TEXT: return CBOR_TEXT;
+    case MAJOR_ARRAY: return CBOR_ARRAY;
+    case MAJOR_MAP: return CBOR_MAP;
+    case MAJOR_SIMPLE: return CBOR_SIMPLE;
+    default: return CBOR_INVALID;
+  }
+}
+
+bool CborReader::readUint(uint32_t* value) {
+  uint8_t major;
+  uint64_t raw;
+  if (!readHead(&major, &raw)) return false;
+  if (major != MAJOR_UINT || raw > 0xFFFFFFFFull) {
+    error = true;
+    return false;
+  }
+  *value = (uint32_t)raw;
+  return true;
+}
+
+bool CborReader::readBool(bool* value) {
+  uint8_t major;
+  uint64_t raw;
+  if (!readHead(&major, &raw)) return false;
+  if (major != MAJOR_SIMPLE || (raw != SIMPLE_FALSE && raw != SIMPLE_TRUE)) {
+    error = true;
+    return false;
+  }
+  *value = (raw == SIMPLE_TRUE);
+  return true;
+}
+
+bool CborReader::readText(const char** value, size_t* count) {
+  uint8_t major;
+  uint64_t raw;
+  if (!readHead(&major, &raw)) return false;
+  if (major != MAJOR_TEXT || raw > length - position) {
+    error = true;
+    return false;
+  }
+  *value = (const char*)(data + position);
+  *count = (size_t)raw;
+  position += (size_t)raw;
+  return true;
+}
+
+bool CborReader::readMap(uint32_t* pairs) {
+  uint8_t major;
+  uint64_t raw;
+  if (!readHead(&major, &raw)) return false;
+  if (major != MAJOR_MAP || raw > length - position) {
+    error = true;
+    return false;
+  }
+  *pairs = (uint32_t)raw;
+  return true;
+}
+
+bool CborReader::readArray(uint32_t* items) {
+  uint8_t major;
+  uint64_t raw;
+  if (!readHead(&major, &raw)) return false;
+  if (major != MAJOR_ARRAY || raw > length - position) {
+    error = true;
+    return false;
+  }
+  *items = (uint32_t)raw;
+  return true;
+}
+
+bool CborReader::skipItem(int depth) {
+  if (depth > MAX_NESTING) {
+    error = true;
+    return false;
+  }
+  
+  uint8_t major;
+  uint64_t raw;
+  if (!readHead(&major, &raw)) return false;
+  
+  switch (major) {
+    case MAJOR_BYTES:
+    case MAJOR_TEXT:
+      if (raw > length - position) {
+        error = true;
+        return false;
+      }
+      position += (size_t)raw;
+      return true;
+    
+    case MAJOR_ARRAY:
+    case MAJOR_MAP: {
+      uint64_t items = (major == MAJOR_MAP) ? raw * 2 : raw;
+      if (items > length - position) {
+        error = true;
+        return false;
+      }
+      for (uint64_t i = 0; i < items; i++) {
+        if (!skipItem(depth + 1)) return false;
+      }
+      return true;
+    }
+    
+    case MAJOR_TAG:
+      return skipItem(depth + 1);
+    
+    default:
+      // Enteros y simples (incluye floats): la cabecera ya los consumió
+      return true;
+  }
+}
+
+bool CborReader::skip() {
+  return skipItem(0);
+}
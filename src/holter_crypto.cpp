@@ -0,0 +1,266 @@
+#include "holter_crypto.h"
+#include "aws_config.h"
+#include <mbedtls/aes.h>
+#include <mbedtls/ctr_drbg.h>
+#include <esp_system.h>
+#include <bootloader_random.h>
+#include <esp_sleep.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// En el core de Arduino para ESP32, mbedtls usa el periférico AES del chip:
+// el cifrado no ocupa la CPU más que para mover los datos
+
+#ifndef DEVICE_KEY_ID
+#define DEVICE_KEY_ID 1
+#endif
+
+#define KEY_BYTES 32
+#define WRAP_BLOCKS (KEY_BYTES / 8)
+
+// Claves de sesión y nonces: CTR_DRBG sembrado una vez en el arranque
+#define DRBG_PERSONALIZATION "holter-session-keys"
+
+// Benchmark de arranque: buffers del mismo tamaño que los del escritor de SD
+static const size_t BENCH_BLOCK_BYTES = 8192;
+static const int BENCH_ITERATIONS = 16;
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static bool enabled = false;
+static uint8_t deviceKey[KEY_BYTES];
+
+// Estado del CTR de la sesión en curso (lo usa solo el escritor de SD)
+static mbedtls_aes_context sessionCtx;
+static uint8_t counter[16];
+static uint8_t streamBlock[16];
+static size_t streamOffset = 0;
+static bool sessionActive = false;
+
+static mbedtls_ctr_drbg_context drbg;
+static bool drbgReady = false;
+
+static CryptoStats stats = {0};
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static void wipe(void* data, size_t len) {
+  volatile uint8_t* p = (volatile uint8_t*)data;
+  while (len--) *p++ = 0;
+}
+
+// Fuente del DRBG. Con WiFi y BT apagados (la captura arranca antes que el
+// WiFi, y al despertar de deep sleep) esp_fill_random() es pseudoaleatorio
+// salvo con bootloader_random_enable(): la semilla se toma con esa fuente
+// activa. Las resiembras automáticas del DRBG (cada 10000 pedidos, días de
+// segmentos) agregan el RNG sin esa fuente, sobre un estado ya sembrado
+static int hardwareEntropy(void* context, unsigned char* output, size_t len) {
+  esp_fill_random(output, len);
+  return 0;
+}
+
+// Usa el SAR ADC como fuente de ruido: se llama antes de configurar el ADC
+// del ECG, nunca durante el muestreo
+static bool seedRandom() {
+  mbedtls_ctr_drbg_init(&drbg);
+  bootloader_random_enable();
+  int result = mbedtls_ctr_drbg_seed(&drbg, hardwareEntropy, nullptr,
+                                     (const unsigned char*)DRBG_PERSONALIZATION,
+                                     strlen(DRBG_PERSONALIZATION));
+  bootloader_random_disable();
+  return result == 0;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseHexKey(const char* hex, uint8_t* out) {
+  if (strlen(hex) != KEY_BYTES * 2) return false;
+  for (int i = 0; i < KEY_BYTES; i++) {
+    int high = hexValue(hex[2 * i]);
+    int low = hexValue(hex[2 * i + 1]);
+    if (high < 0 || low < 0) return false;
+    out[i] = (high << 4) | low;
+  }
+  return true;
+}
+
+// AES Key Wrap (RFC 3394) de una clave de 256 bits con la clave del equipo
+static bool wrapKey(const uint8_t* key, uint8_t* wrapped) {
+  mbedtls_aes_context kek;
+  mbedtls_aes_init(&kek);
+  if (mbedtls_aes_setkey_enc(&kek, deviceKey, KEY_BYTES * 8) != 0) {
+    mbedtls_aes_free(&kek);
+    return false;
+  }
+  
+  uint8_t a[8];
+  uint8_t r[WRAP_BLOCKS][8];
+  uint8_t block[16];
+  memset(a, 0xA6, sizeof(a));
+  memcpy(r, key, KEY_BYTES);
+  
+  for (int j = 0; j < 6; j++) {
+    for (int i = 0; i < WRAP_BLOCKS; i++) {
+      memcpy(block, a, 8);
+      memcpy(block + 8, r[i], 8);
+      mbedtls_aes_crypt_ecb(&kek, MBEDTLS_AES_ENCRYPT, block, block);
+      
+      uint64_t t = (uint64_t)WRAP_BLOCKS * j + i + 1;
+      for (int k = 0; k < 8; k++) {
+        a[k] = block[k] ^ (uint8_t)(t >> (56 - 8 * k));
+      }
+      memcpy(r[i], block + 8, 8);
+    }
+  }
+  
+  memcpy(wrapped, a, 8);
+  memcpy(wrapped + 8, r, KEY_BYTES);
+  
+  wipe(r, sizeof(r));
+  wipe(block, sizeof(block));
+  mbedtls_aes_free(&kek);
+  return true;
+}
+
+// Costo por buffer del escritor de SD, medido una vez al arrancar
+static void benchmark() {
+  uint8_t* buffer = (uint8_t*)malloc(BENCH_BLOCK_BYTES);
+  if (buffer == nullptr) return;
+  memset(buffer, 0x5A, BENCH_BLOCK_BYTES);
+  
+  mbedtls_aes_context ctx;
+  mbedtls_aes_init(&ctx);
+  mbedtls_aes_setkey_enc(&ctx, deviceKey, KEY_BYTES * 8);
+  uint8_t nonce[16] = {0};
+  uint8_t block[16];
+  size_t offset = 0;
+  
+  uint32_t best = UINT32_MAX;
+  uint32_t total = 0;
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    unsigned long start = micros();
+    mbedtls_aes_crypt_ctr(&ctx, BENCH_BLOCK_BYTES, &offset, nonce, block, buffer, buffer);
+    uint32_t elapsed = micros() - start;
+    total += elapsed;
+    best = min(best, elapsed);
+  }
+  
+  mbedtls_aes_free(&ctx);
+  free(buffer);
+  
+  uint32_t average = total / BENCH_ITERATIONS;
+  Serial.printf("[CRYPTO] Benchmark AES-256-CTR: %u bytes en %lu us (mejor %lu us) = %.2f MB/s\n",
+                (unsigned)BENCH_BLOCK_BYTES, (unsigned long)average, (unsigned long)best,
+                average > 0 ? (float)BENCH_BLOCK_BYTES / average : 0.0f);
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_crypto_init() {
+  mbedtls_aes_init(&sessionCtx);
+
+#ifdef DEVICE_KEY_HEX
+  const char* keyHex = DEVICE_KEY_HEX;
+#else
+  const char* keyHex = nullptr;
+#endif
+  
+  if (keyHex == nullptr) {
+    enabled = false;
+    Serial.println("[CRYPTO] Sin DEVICE_KEY_HEX - sesiones sin cifrar");
+    return;
+  }
+  
+  enabled = parseHexKey(keyHex, deviceKey);
+  if (!enabled) {
+    Serial.println("[CRYPTO] ERROR: DEVICE_KEY_HEX debe tener 64 dígitos hex - sesiones sin cifrar");
+    return;
+  }
+  
+  drbgReady = seedRandom();
+  if (!drbgReady) {
+    enabled = false;
+    Serial.println("[CRYPTO] ERROR: No se pudo sembrar el generador de claves - sesiones sin cifrar");
+    return;
+  }
+  
+  Serial.printf("[CRYPTO] Cifrado de sesiones activo (AES-256-CTR, clave del equipo %d)\n",
+                DEVICE_KEY_ID);
+  
+  // Al despertar de deep sleep no se repite: retrasaría la primera muestra
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED) {
+    benchmark();
+  }
+}
+
+bool holter_crypto_isEnabled() {
+  return enabled;
+}
+
+bool holter_crypto_beginSession(EncryptionHeader* header) {
+  if (!enabled) return false;
+  
+  uint8_t sessionKey[KEY_BYTES];
+  memset(header, 0, sizeof(EncryptionHeader));
+  header->magic = ENCRYPTION_MAGIC;
+  header->algorithm = ENCRYPTION_AES256_CTR;
+  header->key_id = DEVICE_KEY_ID;
+  
+  // Los 8 bytes bajos del contador arrancan en 0
+  bool ok = drbgReady &&
+            mbedtls_ctr_drbg_random(&drbg, sessionKey, sizeof(sessionKey)) == 0 &&
+            mbedtls_ctr_drbg_random(&drbg, header->iv, 8) == 0 &&
+            wrapKey(sessionKey, header->wrapped_key) &&
+            mbedtls_aes_setkey_enc(&sessionCtx, sessionKey, KEY_BYTES * 8) == 0;
+  wipe(sessionKey, sizeof(sessionKey));
+  
+  if (!ok) {
+    Serial.println("[CRYPTO] ERROR: No se pudo preparar la clave de sesión");
+    return false;
+  }
+  
+  memcpy(counter, header->iv, sizeof(counter));
+  streamOffset = 0;
+  sessionActive = true;
+  stats.sessions++;
+  return true;
+}
+
+void holter_crypto_apply(uint8_t* data, size_t len) {
+  if (!sessionActive || len == 0) return;
+  
+  unsigned long start = micros();
+  mbedtls_aes_crypt_ctr(&sessionCtx, len, &streamOffset, counter, streamBlock, data, data);
+  uint32_t elapsed = micros() - start;
+  
+  stats.bytes_encrypted += len;
+  stats.encrypt_us += elapsed;
+  stats.block_max_us = max(stats.block_max_us, elapsed);
+}
+
+void holter_crypto_endSession() {
+  if (!sessionActive) return;
+  
+  mbedtls_aes_free(&sessionCtx);
+  mbedtls_aes_init(&sessionCtx);
+  wipe(counter, sizeof(counter));
+  wipe(streamBlock, sizeof(streamBlock));
+  sessionActive = false;
+}
+
+CryptoStats holter_crypto_getStats() {
+  return stats;
+}
@@ -0,0 +1,578 @@
+#include "holter_deflate.h"
+#include <string.h>
+#include <algorithm>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define WINDOW_MASK (DEFLATE_WINDOW_SIZE - 1)
+#define MAX_CODE_LENGTH 15
+#define MAX_CL_LENGTH 7
+
+// Tablas de RFC 1951 §3.2.5
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Orden de las longitudes del código de longitudes (RFC 1951 §3.2.7)
+static const uint8_t CL_ORDER[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static inline int highestBit(uint32_t value) {
+  return 31 - __builtin_clz(value);
+}
+
+// Largo 3..258 → índice en LENGTH_BASE (código 257 + índice)
+static inline int lengthIndex(int length) {
+  int l = length - MIN_MATCH;
+  if (l < 8) return l;
+  if (l == 255) return 28;
+  int bits = highestBit(l);
+  return 4 * (bits - 1) + ((l >> (bits - 2)) & 3);
+}
+
+// Distancia 1..32768 → código de distancia
+static inline int distIndex(int distance) {
+  int d = distance - 1;
+  if (d < 4) return d;
+  int bits = highestBit(d);
+  return 2 * bits + ((d >> (bits - 1)) & 1);
+}
+
+static inline uint32_t hash3(const uint8_t* p) {
+  uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (value * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+static inline int fixedLitLength(int symbol) {
+  if (symbol < 144) return 8;
+  if (symbol < 256) return 9;
+  if (symbol < 280) return 7;
+  return 8;
+}
+
+static inline uint16_t reverseBits(uint16_t code, int length) {
+  uint16_t reversed = 0;
+  for (int i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  return reversed;
+}
+
+// ============================================================================
+// SALIDA
+// ============================================================================
+
+void DeflateEncoder::flushOutput() {
+  if (outLength > 0) {
+    sink(out, outLength, sinkContext);
+    outTotal += outLength;
+    outLength = 0;
+  }
+}
+
+void DeflateEncoder::putByte(uint8_t value) {
+  out[outLength++] = value;
+  if (outLength == sizeof(out)) {
+    flushOutput();
+  }
+}
+
+// Los bits se empaquetan desde el menos significativo (RFC 1951 §3.1.1)
+void DeflateEncoder::putBits(uint32_t value, int count) {
+  bitBuffer |= value << bitCount;
+  bitCount += count;
+  while (bitCount >= 8) {
+    putByte(bitBuffer & 0xFF);
+    bitBuffer >>= 8;
+    bitCount -= 8;
+  }
+}
+
+void DeflateEncoder::alignToByte() {
+  if (bitCount > 0) {
+    putByte(bitBuffer & 0xFF);
+  }
+  bitBuffer = 0;
+  bitCount = 0;
+}
+
+// ============================================================================
+// HUFFMAN
+// ============================================================================
+
+// Longitudes óptimas (Moffat & Katajainen, in-place) limitadas a maxLength
+// con el ajuste de Kraft; mismo esquema que usan zlib/miniz
+void DeflateEncoder::buildLengths(const uint16_t* freq, int count, uint8_t* lengths, int maxLength) {
+  int used = 0;
+  for (int i = 0; i < count; i++) {
+    lengths[i] = 0;
+    if (freq[i] > 0) {
+      scratch[used].key = freq[i];
+      scratch[used].sym = i;
+      used++;
+    }
+  }
+  
+  if (used == 0) return;
+  if (used == 1) {
+    lengths[scratch[0].sym] = 1;
+    return;
+  }
+  
+  std::sort(scratch, scratch + used, [](const HuffSym& a, const HuffSym& b) {
+    return a.key < b.key;
+  });
+  
+  // Árbol de Huffman sobre el propio arreglo ordenado: primero pesos de
+  // nodos internos, luego profundidades
+  HuffSym* A = scratch;
+  int n = used;
+  int root = 0;
+  int leaf = 2;
+  A[0].key += A[1].key;
+  for (int next = 1; next < n - 1; next++) {
+    if (leaf >= n || A[root].key < A[leaf].key) {
+      A[next].key = A[root].key;
+      A[root++].key = next;
+    } else {
+      A[next].key = A[leaf++].key;
+    }
+    if (leaf >= n || (root < next && A[root].key < A[leaf].key)) {
+      A[next].key += A[root].key;
+      A[root++].key = next;
+    } else {
+      A[next].key += A[leaf++].key;
+    }
+  }
+  A[n - 2].key = 0;
+  for (int next = n - 3; next >= 0; next--) {
+    A[next].key = A[A[next].key].key + 1;
+  }
+  
+  int numCodes[32] = {0};
+  int available = 1;
+  int depth = 0;
+  int usedNodes = 0;
+  root = n - 2;
+  while (available > 0) {
+    while (root >= 0 && A[root].key == depth) {
+      usedNodes++;
+      root--;
+    }
+    while (available > usedNodes) {
+      numCodes[depth]++;
+      available--;
+    }
+    available = 2 * usedNodes;
+    depth++;
+    usedNodes = 0;
+  }
+  
+  // Limitar la profundidad y reequilibrar hasta que la suma de Kraft sea 1
+  for (int i = maxLength + 1; i < 32; i++) {
+    numCodes[maxLength] += numCodes[i];
+    numCodes[i] = 0;
+  }
+  uint32_t total = 0;
+  for (int i = maxLength; i > 0; i--) {
+    total += ((uint32_t)numCodes[i]) << (maxLength - i);
+  }
+  while (total != (1UL << maxLength)) {
+    numCodes[maxLength]--;
+    for (int i = maxLength - 1; i > 0; i--) {
+      if (numCodes[i]) {
+        numCodes[i]--;
+        numCodes[i + 1] += 2;
+        break;
+      }
+    }
+    total--;
+  }
+  
+  // Los códigos más cortos para los símbolos más frecuentes (final del arreglo)
+  int j = used;
+  for (int length = 1; length <= maxLength; length++) {
+    for (int k = numCodes[length]; k > 0; k--) {
+      lengths[scratch[--j].sym] = length;
+    }
+  }
+}
+
+// Códigos canónicos (RFC 1951 §3.2.2), invertidos para emitirlos LSB primero
+void DeflateEncoder::buildCodes(const uint8_t* lengths, int count, uint16_t* codes) {
+  uint16_t lengthCount[MAX_CODE_LENGTH + 1] = {0};
+  uint16_t nextCode[MAX_CODE_LENGTH + 1] = {0};
+  
+  for (int i = 0; i < count; i++) {
+    lengthCount[lengths[i]]++;
+  }
+  lengthCount[0] = 0;
+  
+  uint16_t code = 0;
+  for (int bits = 1; bits <= MAX_CODE_LENGTH; bits++) {
+    code = (code + lengthCount[bits - 1]) << 1;
+    nextCode[bits] = code;
+  }
+  
+  for (int i = 0; i < count; i++) {
+    int length = lengths[i];
+    codes[i] = length ? reverseBits(nextCode[length]++, length) : 0;
+  }
+}
+
+// ============================================================================
+// LZ77
+// ============================================================================
+
+void DeflateEncoder::insertHash(size_t pos) {
+  uint32_t h = hash3(&window[pos]);
+  prev[pos & WINDOW_MASK] = head[h];
+  head[h] = (uint16_t)(pos + 1);
+}
+
+int DeflateEncoder::findMatch(size_t pos, size_t avail, int* distance) {
+  int maxLength = (int)std::min(avail, (size_t)MAX_MATCH);
+  if (maxLength < MIN_MATCH) return 0;
+  
+  int bestLength = 0;
+  const uint8_t* current = &window[pos];
+  uint32_t candidate = head[hash3(current)];
+  int chain = DEFLATE_MAX_CHAIN;
+  
+  while (candidate != 0 && chain-- > 0) {
+    size_t match = candidate - 1;
+    if (match >= pos || pos - match >= DEFLATE_WINDOW_SIZE) break;
+    
+    const uint8_t* p = &window[match];
+    if (p[bestLength] == current[bestLength] && p[0] == current[0] && p[1] == current[1]) {
+      int length = 2;
+      while (length < maxLength && p[length] == current[length]) {
+        length++;
+      }
+      if (length > bestLength) {
+        bestLength = length;
+        *distance = (int)(pos - match);
+        if (length == maxLength) break;
+      }
+    }
+    
+    uint32_t older = prev[match & WINDOW_MASK];
+    if (older >= candidate) break;
+    candidate = older;
+  }
+  
+  return (bestLength >= MIN_MATCH) ? bestLength : 0;
+}
+
+// Descarta la ventana más antigua: las posiciones guardadas bajan una ventana
+void DeflateEncoder::slide() {
+  memmove(window, window + DEFLATE_WINDOW_SIZE, DEFLATE_WINDOW_SIZE);
+  windowEnd -= DEFLATE_WINDOW_SIZE;
+  position -= DEFLATE_WINDOW_SIZE;
+  
+  for (int i = 0; i < DEFLATE_HASH_SIZE; i++) {
+    head[i] = (head[i] > DEFLATE_WINDOW_SIZE) ? head[i] - DEFLATE_WINDOW_SIZE : 0;
+  }
+  for (int i = 0; i < DEFLATE_WINDOW_SIZE; i++) {
+    prev[i] = (prev[i] > DEFLATE_WINDOW_SIZE) ? prev[i] - DEFLATE_WINDOW_SIZE : 0;
+  }
+}
+
+void DeflateEncoder::addLiteral(uint8_t value) {
+  tokenLit[tokenCount] = value;
+  tokenDist[tokenCount] = 0;
+  tokenCount++;
+  litFreq[value]++;
+  blockBytes++;
+}
+
+void DeflateEncoder::addMatch(int length, int distance) {
+  tokenLit[tokenCount] = (uint8_t)(length - MIN_MATCH);
+  tokenDist[tokenCount] = (uint16_t)distance;
+  tokenCount++;
+  litFreq[257 + lengthIndex(length)]++;
+  distFreq[distIndex(distance)]++;
+  blockBytes += length;
+}
+
+// Greedy: sin flush solo avanza mientras quede un match máximo por delante
+void DeflateEncoder::process(bool flush) {
+  for (;;) {
+    size_t avail = windowEnd - position;
+    if (avail == 0 || (!flush && avail < MAX_MATCH)) break;
+    
+    int distance = 0;
+    int length = findMatch(position, avail, &distance);
+    if (avail >= MIN_MATCH) {
+      insertHash(position);
+    }
+    
+    if (length > 0) {
+      addMatch(length, distance);
+      for (int i = 1; i < length; i++) {
+        if (position + i + MIN_MATCH <= windowEnd) {
+          insertHash(position + i);
+        }
+      }
+      position += length;
+    } else {
+      addLiteral(window[position]);
+      position++;
+    }
+    
+    if (blockBytes >= DEFLATE_BLOCK_BYTES) {
+      flushBlock(false);
+    }
+  }
+}
+
+// ============================================================================
+// BLOQUES
+// ============================================================================
+
+void DeflateEncoder::emitTokens() {
+  for (size_t i = 0; i < tokenCount; i++) {
+    if (tokenDist[i] == 0) {
+      uint8_t value = tokenLit[i];
+      putBits(litCodes[value], litLengths[value]);
+      continue;
+    }
+    
+    int length = tokenLit[i] + MIN_MATCH;
+    int li = lengthIndex(length);
+    putBits(litCodes[257 + li], litLengths[257 + li]);
+    if (LENGTH_EXTRA[li]) {
+      putBits(length - LENGTH_BASE[li], LENGTH_EXTRA[li]);
+    }
+    
+    int distance = tokenDist[i];
+    int di = distIndex(distance);
+    putBits(distCodes[di], distLengths[di]);
+    if (DIST_EXTRA[di]) {
+      putBits(distance - DIST_BASE[di], DIST_EXTRA[di]);
+    }
+  }
+  putBits(litCodes[256], litLengths[256]);
+}
+
+// Cierra el bloque con Huffman dinámico o fijo, el que resulte más corto
+void DeflateEncoder::flushBlock(bool final) {
+  litFreq[256]++;  // Fin de bloque
+  
+  // Costo con Huffman dinámico
+  buildLengths(litFreq, 286, litLengths, MAX_CODE_LENGTH);
+  buildLengths(distFreq, 30, distLengths, MAX_CODE_LENGTH);
+  
+  bool anyDistance = false;
+  for (int i = 0; i < 30; i++) {
+    if (distLengths[i]) anyDistance = true;
+  }
+  if (!anyDistance) {
+    distLengths[0] = 1;
+  }
+  
+  int numLit = 286;
+  while (numLit > 257 && litLengths[numLit - 1] == 0) numLit--;
+  int numDist = 30;
+  while (numDist > 1 && distLengths[numDist - 1] == 0) numDist--;
+  
+  // Longitudes de ambos códigos en secuencia, comprimidas con 16/17/18
+  uint8_t allLengths[286 + 30];
+  memcpy(allLengths, litLengths, numLit);
+  memcpy(allLengths + numLit, distLengths, numDist);
+  int total = numLit + numDist;
+  
+  uint8_t rleSymbols[286 + 30];
+  uint8_t rleExtra[286 + 30];
+  int rleCount = 0;
+  uint16_t clFreq[19] = {0};
+  
+  for (int i = 0; i < total;) {
+    uint8_t length = allLengths[i];
+    int run = 1;
+    while (i + run < total && allLengths[i + run] == length) run++;
+    
+    if (length == 0 && run >= 3) {
+      int chunk = std::min(run, 138);
+      rleSymbols[rleCount] = (chunk >= 11) ? 18 : 17;
+      rleExtra[rleCount] = (chunk >= 11) ? chunk - 11 : chunk - 3;
+      clFreq[rleSymbols[rleCount]]++;
+      rleCount++;
+      i += chunk;
+    } else if (length != 0 && run >= 4) {
+      rleSymbols[rleCount] = length;
+      rleExtra[rleCount] = 0;
+      clFreq[length]++;
+      rleCount++;
+      int chunk = std::min(run - 1, 6);
+      rleSymbols[rleCount] = 16;
+      rleExtra[rleCount] = chunk - 3;
+      clFreq[16]++;
+      rleCount++;
+      i += 1 + chunk;
+    } else {
+      rleSymbols[rleCount] = length;
+      rleExtra[rleCount] = 0;
+      clFreq[length]++;
+      rleCount++;
+      i++;
+    }
+  }
+  
+  uint8_t clLengths[19];
+  uint16_t clCodes[19];
+  buildLengths(clFreq, 19, clLengths, MAX_CL_LENGTH);
+  
+  int numCl = 19;
+  while (numCl > 4 && clLengths[CL_ORDER[numCl - 1]] == 0) numCl--;
+  
+  uint32_t dynamicBits = 3 + 5 + 5 + 4 + 3 * numCl;
+  for (int i = 0; i < 19; i++) {
+    dynamicBits += clFreq[i] * clLengths[i];
+  }
+  dynamicBits += 2 * clFreq[16] + 3 * clFreq[17] + 7 * clFreq[18];
+  uint32_t fixedBits = 3;
+  for (int i = 0; i < 286; i++) {
+    dynamicBits += litFreq[i] * litLengths[i];
+    fixedBits += litFreq[i] * fixedLitLength(i);
+  }
+  for (int i = 0; i < 30; i++) {
+    dynamicBits += distFreq[i] * distLengths[i];
+    fixedBits += distFreq[i] * 5;
+  }
+  // Los bits extra de largos y distancias cuestan lo mismo en ambos casos
+  
+  putBits(final ? 1 : 0, 1);
+  
+  if (dynamicBits < fixedBits) {
+    putBits(2, 2);
+    putBits(numLit - 257, 5);
+    putBits(numDist - 1, 5);
+    putBits(numCl - 4, 4);
+    for (int i = 0; i < numCl; i++) {
+      putBits(clLengths[CL_ORDER[i]], 3);
+    }
+    
+    buildCodes(clLengths, 19, clCodes);
+    for (int i = 0; i < rleCount; i++) {
+      uint8_t symbol = rleSymbols[i];
+      putBits(clCodes[symbol], clLengths[symbol]);
+      if (symbol == 16) putBits(rleExtra[i], 2);
+      else if (symbol == 17) putBits(rleExtra[i], 3);
+      else if (symbol == 18) putBits(rleExtra[i], 7);
+    }
+    
+    for (int i = numLit; i < 288; i++) litLengths[i] = 0;
+    for (int i = numDist; i < 30; i++) distLengths[i] = 0;
+  } else {
+    putBits(1, 2);
+    for (int i = 0; i < 288; i++) litLengths[i] = fixedLitLength(i);
+    for (int i = 0; i < 30; i++) distLengths[i] = 5;
+  }
+  
+  buildCodes(litLengths, 288, litCodes);
+  buildCodes(distLengths, 30, distCodes);
+  emitTokens();
+  
+  tokenCount = 0;
+  blockBytes = 0;
+  memset(litFreq, 0, sizeof(litFreq));
+  memset(distFreq, 0, sizeof(distFreq));
+}
+
+// ============================================================================
+// INTERFACE PÚBLICA
+// ============================================================================
+
+void DeflateEncoder::begin(DeflateSink outputSink, void* context) {
+  sink = outputSink;
+  sinkContext = context;
+  
+  windowEnd = 0;
+  position = 0;
+  memset(head, 0, sizeof(head));
+  memset(prev, 0, sizeof(prev));
+  
+  tokenCount = 0;
+  blockBytes = 0;
+  memset(litFreq, 0, sizeof(litFreq));
+  memset(distFreq, 0, sizeof(distFreq));
+  
+  bitBuffer = 0;
+  bitCount = 0;
+  outLength = 0;
+  outTotal = 0;
+  adlerA = 1;
+  adlerB = 0;
+  
+  // Cabecera zlib: deflate con la ventana real, sin diccionario
+  uint8_t cmf = ((DEFLATE_WINDOW_BITS - 8) << 4) | 8;
+  uint8_t flg = 31 - ((cmf << 8) % 31);
+  if (flg == 31) flg = 0;
+  putByte(cmf);
+  putByte(flg);
+}
+
+void DeflateEncoder::write(const uint8_t* data, size_t len) {
+  while (len > 0) {
+    if (windowEnd == sizeof(window)) {
+      slide();
+    }
+    
+    size_t n = std::min(len, sizeof(window) - windowEnd);
+    memcpy(window + windowEnd, data, n);
+    
+    // Adler-32 por tramos cortos para que las sumas no desborden
+    for (size_t i = 0; i < n; i++) {
+      adlerA += data[i];
+      adlerB += adlerA;
+      if ((i & 1023) == 1023) {
+        adlerA %= 65521;
+        adlerB %= 65521;
+      }
+    }
+    adlerA %= 65521;
+    adlerB %= 65521;
+    
+    windowEnd += n;
+    data += n;
+    len -= n;
+    process(false);
+  }
+}
+
+void DeflateEncoder::finish() {
+  process(true);
+  flushBlock(true);
+  alignToByte();
+  
+  uint32_t adler = (adlerB << 16) | adlerA;
+  putByte(adler >> 24);
+  putByte((adler >> 16) & 0xFF);
+  putByte((adler >> 8) & 0xFF);
+  putByte(adler & 0xFF);
+  flushOutput();
+}
@@ -0,0 +1,90 @@
+#include "holter_events.h"
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static QueueHandle_t eventQueue = nullptr;
+static EventStats stats = {0};
+
+// Último click válido (us, esp_timer): lo escribe solo la interrupción
+static volatile int64_t lastClickUs = 0;
+static volatile uint32_t buttonClicks = 0;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Flanco de bajada del botón. El debounce se hace por tiempo: un click por
+// EVENT_BUTTON_DEBOUNCE_MS, los rebotes del contacto solo se cuentan
+static void IRAM_ATTR buttonISR() {
+  int64_t now = esp_timer_get_time();
+  if (lastClickUs != 0 && now - lastClickUs < EVENT_BUTTON_DEBOUNCE_MS * 1000LL) {
+    stats.button_bounces++;
+    return;
+  }
+  lastClickUs = now;
+  buttonClicks++;
+  stats.button_clicks = buttonClicks;
+  
+  HolterEvent event = { EVT_BUTTON, buttonClicks, (uint32_t)now };
+  BaseType_t woken = pdFALSE;
+  if (xQueueSendFromISR(eventQueue, &event, &woken) == pdTRUE) {
+    stats.posted++;
+  } else {
+    stats.dropped++;
+  }
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_events_init() {
+  if (eventQueue != nullptr) return;
+  
+  eventQueue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(HolterEvent));
+  
+  pinMode(EVENT_BUTTON_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(EVENT_BUTTON_PIN), buttonISR, FALLING);
+  
+  Serial.printf("[EVENTS] Bus de eventos listo (%d eventos), botón por interrupción en GPIO%d\n",
+                EVENT_QUEUE_LENGTH, EVENT_BUTTON_PIN);
+}
+
+bool holter_events_post(HolterEventType type, uint32_t param) {
+  if (eventQueue == nullptr) return false;
+  
+  HolterEvent event = { type, param, (uint32_t)micros() };
+  if (xQueueSend(eventQueue, &event, 0) != pdTRUE) {
+    stats.dropped++;
+    return false;
+  }
+  stats.posted++;
+  return true;
+}
+
+bool holter_events_wait(HolterEvent* event, uint32_t timeoutMs) {
+  if (eventQueue == nullptr) {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    return false;
+  }
+  
+  if (xQueueReceive(eventQueue, event, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+    return false;
+  }
+  
+  stats.latency_max_us = max(stats.latency_max_us, (uint32_t)micros() - event->timestamp_us);
+  return true;
+}
+
+uint32_t holter_events_getButtonClicks() {
+  return buttonClicks;
+}
+
+EventStats holter_events_getStats() {
+  return stats;
+}
@@ -0,0 +1,44 @@
+#include "holter_format.h"
+#include <string.h>
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+ECGSample holter_format_ecgSample(float leadI_V, float leadII_V) {
+  float leadI_mV = ((leadI_V - ECG_ADC_OFFSET_V) * 1000.0f) / ECG_FRONTEND_GAIN;
+  float leadII_mV = ((leadII_V - ECG_ADC_OFFSET_V) * 1000.0f) / ECG_FRONTEND_GAIN;
+  float leadIII_mV = leadII_mV - leadI_mV;
+  
+  ECGSample sample;
+  sample.derivation_I = (int16_t)(leadI_mV * ECG_COUNTS_PER_MV);
+  sample.derivation_II = (int16_t)(leadII_mV * ECG_COUNTS_PER_MV);
+  sample.derivation_III = (int16_t)(leadIII_mV * ECG_COUNTS_PER_MV);
+  return sample;
+}
+
+float holter_format_leadVolts(int16_t value) {
+  return ECG_ADC_OFFSET_V + (value / ECG_COUNTS_PER_MV) * ECG_FRONTEND_GAIN / 1000.0f;
+}
+
+void holter_format_initHeader(FileHeader* header, uint32_t sessionId, uint32_t timestampStart) {
+  memset(header, 0, sizeof(FileHeader));
+  header->magic = SESSION_MAGIC;
+  header->version = SESSION_VERSION;       // Sigue un SessionInfo
+  header->device_id = 1;
+  header->session_id = sessionId;          // Todos los segmentos de la grabación
+  header->timestamp_start = timestampStart;
+  header->ecg_sample_rate = SESSION_ECG_RATE_HZ;
+  header->imu_sample_rate = 0;
+  header->num_ecg_samples = 0;             // Se actualiza al cerrar
+  header->num_imu_samples = 0;
+}
+
+size_t holter_format_fillBlock(uint8_t* block, size_t capacity, size_t* index,
+                               const uint8_t* data, size_t len) {
+  size_t space = capacity - *index;
+  size_t count = len < space ? len : space;
+  memcpy(block + *index, data, count);
+  *index += count;
+  return count;
+}
@@ -0,0 +1,325 @@
+#include "holter_log.h"
+#include "holter_offload_proto.h"
+#include <atomic>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Núcleo 0 y la prioridad más baja: formatear y escribir a la UART usa el
+// tiempo que sobra, nunca el del muestreo
+#define LOG_CORE 0
+#define LOG_TASK_PRIORITY 1
+
+// Sin apuro el ring se vacía cada LOG_FLUSH_MS; con más de la mitad ocupada
+// el registro que cruza el umbral despierta a la tarea
+static const unsigned long LOG_FLUSH_MS = 50;
+
+static const int LOG_BENCH_ROUNDS = 32;
+
+#define LOG_LINE_SIZE 256
+
+// Entradas del ring: header(4) = longitud(2) | marca(2), registro, relleno a 4
+#define ENTRY_COMMITTED 0xC0DE
+#define ENTRY_PADDING 0xFADE
+#define ENTRY_HEADER_SIZE 4
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Varios productores (cualquier tarea, cualquier núcleo) reservan espacio con
+// un compare-and-swap sobre writeHead y publican la entrada escribiendo su
+// header al final. Un solo consumidor avanza readTail y pone en cero lo que
+// libera, así un header sin publicar nunca parece válido.
+static uint8_t ring[LOG_RING_SIZE] __attribute__((aligned(4)));
+static std::atomic<uint32_t> writeHead(0);     // Bytes reservados desde el arranque
+static std::atomic<uint32_t> readTail(0);      // Bytes liberados desde el arranque
+static std::atomic<bool> wakePending(false);
+static std::atomic<bool> draining(false);
+
+static TaskHandle_t logTaskHandle = nullptr;
+static bool binaryOutput = false;
+static LogStats stats = {0};
+
+static volatile uint32_t benchSink = 0;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static inline uint32_t entrySize(uint32_t recordLen) {
+  return (ENTRY_HEADER_SIZE + recordLen + 3) & ~3u;
+}
+
+static inline void publishHeader(uint32_t offset, uint16_t len, uint16_t marker) {
+  __atomic_store_n((uint32_t*)(ring + offset), ((uint32_t)marker << 16) | len, __ATOMIC_RELEASE);
+}
+
+// Lee un argumento crudo; false si el registro se cortó antes
+static bool takeArg(const uint8_t** arg, const uint8_t* end, void* out, size_t size) {
+  if (*arg + size > end) return false;
+  memcpy(out, *arg, size);
+  *arg += size;
+  return true;
+}
+
+// Arma el texto de un registro recorriendo las conversiones del formato. Los
+// modificadores de longitud se descartan: el tamaño del argumento ya quedó
+// fijo al registrarlo (4 bytes, 8 con %ll)
+static size_t formatRecord(const uint8_t* record, uint16_t len, char* out, size_t cap) {
+  uint32_t address;
+  memcpy(&address, record, 4);
+  const char* fmt = (const char*)(uintptr_t)address;
+  const uint8_t* arg = record + 9;
+  const uint8_t* end = record + len;
+  
+  size_t pos = 0;
+  bool missing = false;
+  const char* p = fmt;
+  
+  while (*p && pos + 1 < cap) {
+    if (*p != '%') {
+      out[pos++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[pos++] = '%';
+      p += 2;
+      continue;
+    }
+    
+    char spec[16];
+    size_t s = 0;
+    spec[s++] = *p++;
+    while (*p && strchr("-+ #0123456789.", *p) && s < sizeof(spec) - 4) {
+      spec[s++] = *p++;
+    }
+    int longs = 0;
+    while (*p && strchr("hlzjt", *p)) {
+      if (*p == 'l') longs++;
+      p++;
+    }
+    char conv = *p;
+    if (conv == '\0') break;
+    p++;
+    
+    size_t room = cap - pos;
+    int written = 0;
+    
+    if (conv == 's') {
+      uint8_t size = 0;
+      char text[LOG_MAX_STRING + 1];
+      if (takeArg(&arg, end, &size, 1) && takeArg(&arg, end, text, size)) {
+        text[size] = '\0';
+        spec[s++] = 's';
+        spec[s] = '\0';
+        written = snprintf(out + pos, room, spec, text);
+      } else {
+        missing = true;
+      }
+    } else if (strchr("fFeEgG", conv)) {
+      float value;
+      if (takeArg(&arg, end, &value, 4)) {
+        spec[s++] = conv;
+        spec[s] = '\0';
+        written = snprintf(out + pos, room, spec, (double)value);
+      } else {
+        missing = true;
+      }
+    } else if (strchr("diouxXc", conv)) {
+      bool isSigned = (conv == 'd' || conv == 'i');
+      if (longs >= 2) {
+        uint64_t value;
+        if (takeArg(&arg, end, &value, 8)) {
+          spec[s++] = 'l';
+          spec[s++] = 'l';
+          spec[s++] = conv;
+          spec[s] = '\0';
+          written = isSigned ? snprintf(out + pos, room, spec, (long long)value) :
+                               snprintf(out + pos, room, spec, (unsigned long long)value);
+        } else {
+          missing = true;
+        }
+      } else {
+        uint32_t value;
+        if (takeArg(&arg, end, &value, 4)) {
+          spec[s++] = conv;
+          spec[s] = '\0';
+          written = isSigned || conv == 'c' ? snprintf(out + pos, room, spec, (int)value) :
+                                              snprintf(out + pos, room, spec, (unsigned)value);
+        } else {
+          missing = true;
+        }
+      }
+    } else {
+      // Conversión no soportada: queda el texto tal cual
+      written = snprintf(out + pos, room, "%.*s", (int)s, spec);
+      p--;
+    }
+    
+    if (missing) {
+      written = snprintf(out + pos, room, "<?>");
+      missing = false;
+    }
+    if (written > 0) {
+      pos += min((size_t)written, room - 1);
+    }
+  }
+  
+  out[pos] = '\0';
+  return pos;
+}
+
+static void emitRecord(const uint8_t* record, uint16_t len) {
+  if (binaryOutput) {
+    uint8_t frame[4 + LOG_MAX_RECORD + 4];
+    frame[0] = LOG_SYNC0;
+    frame[1] = LOG_SYNC1;
+    memcpy(frame + 2, &len, 2);
+    memcpy(frame + 4, record, len);
+    uint32_t crc = offload_crc32(0, record, len);
+    memcpy(frame + 4 + len, &crc, 4);
+    Serial.write(frame, 4 + len + 4);
+    return;
+  }
+  
+  // Una línea por write(): no se mezcla con las tramas de la descarga por USB
+  char line[LOG_LINE_SIZE];
+  size_t size = formatRecord(record, len, line, sizeof(line) - 1);
+  line[size++] = '\n';
+  Serial.write((const uint8_t*)line, size);
+}
+
+// Vacía el ring hasta la primera entrada reservada que todavía no se publicó.
+// Un solo consumidor a la vez (la tarea o un holter_log_flush())
+static void drainRing() {
+  bool expected = false;
+  if (!draining.compare_exchange_strong(expected, true, std::memory_order_acquire)) return;
+  
+  uint32_t tail = readTail.load(std::memory_order_relaxed);
+  while (tail != writeHead.load(std::memory_order_acquire)) {
+    uint32_t offset = tail & LOG_RING_MASK;
+    uint32_t header = __atomic_load_n((uint32_t*)(ring + offset), __ATOMIC_ACQUIRE);
+    uint16_t marker = header >> 16;
+    uint16_t len = header & 0xFFFF;
+    
+    uint32_t size;
+    if (marker == ENTRY_PADDING) {
+      size = len;
+    } else if (marker == ENTRY_COMMITTED) {
+      emitRecord(ring + offset + ENTRY_HEADER_SIZE, len);
+      size = entrySize(len);
+    } else {
+      break;
+    }
+    
+    memset(ring + offset, 0, size);
+    tail += size;
+    readTail.store(tail, std::memory_order_release);
+  }
+  
+  wakePending.store(false, std::memory_order_relaxed);
+  draining.store(false, std::memory_order_release);
+}
+
+static void logTask(void* param) {
+  for (;;) {
+    drainRing();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_FLUSH_MS));
+  }
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_log_init(bool binary) {
+  if (logTaskHandle != nullptr) return;
+  
+  binaryOutput = binary;
+  xTaskCreatePinnedToCore(logTask, "log", 4096, nullptr,
+                          LOG_TASK_PRIORITY, &logTaskHandle, LOG_CORE);
+  
+  Serial.printf("[LOG] Log diferido: ring de %d bytes, nivel %d, salida %s\n",
+                LOG_RING_SIZE, HOLTER_LOG_LEVEL, binary ? "binaria (tools/log_decode.py)" : "texto");
+}
+
+void holter_log_commit(LogWriter& writer) {
+  uint32_t size = entrySize(writer.len);
+  uint32_t head = writeHead.load(std::memory_order_relaxed);
+  uint32_t offset, pad, used;
+  
+  // Una entrada no se parte en el borde del ring: lo que sobra al final se
+  // reserva junto con ella como relleno
+  do {
+    offset = head & LOG_RING_MASK;
+    pad = offset + size > LOG_RING_SIZE ? LOG_RING_SIZE - offset : 0;
+    used = head + pad + size - readTail.load(std::memory_order_acquire);
+    if (used > LOG_RING_SIZE) {
+      stats.dropped++;
+      return;
+    }
+  } while (!writeHead.compare_exchange_weak(head, head + pad + size,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_relaxed));
+  
+  if (pad > 0) {
+    publishHeader(offset, pad, ENTRY_PADDING);
+    offset = 0;
+  }
+  memcpy(ring + offset + ENTRY_HEADER_SIZE, writer.data, writer.len);
+  publishHeader(offset, writer.len, ENTRY_COMMITTED);
+  
+  uint32_t cycles = ESP.getCycleCount() - writer.startCycles;
+  stats.records++;
+  stats.cycles_total += cycles;
+  stats.cycles_max = max(stats.cycles_max, cycles);
+  stats.ring_max_bytes = max(stats.ring_max_bytes, used);
+  if (writer.data[8] & LOG_RECORD_TRUNCATED) stats.truncated++;
+  
+  if (used > LOG_RING_SIZE / 2 && logTaskHandle != nullptr &&
+      !wakePending.exchange(true, std::memory_order_relaxed)) {
+    xTaskNotifyGive(logTaskHandle);
+  }
+}
+
+void holter_log_flush() {
+  while (readTail.load(std::memory_order_acquire) != writeHead.load(std::memory_order_acquire)) {
+    drainRing();
+    vTaskDelay(1);
+  }
+  Serial.flush();
+}
+
+LogStats holter_log_getStats() {
+  return stats;
+}
+
+void holter_log_benchmark() {
+  const char* fmt = "[PROGRESS] %lus/%ds | ECG: %lu muestras (%.1f Hz)";
+  char line[LOG_LINE_SIZE];
+  
+  uint32_t start = ESP.getCycleCount();
+  for (int i = 0; i < LOG_BENCH_ROUNDS; i++) {
+    LogWriter writer;
+    writer.begin(LOG_LEVEL_INFO, fmt);
+    logArg(writer, (unsigned long)i);
+    logArg(writer, 15);
+    logArg(writer, (unsigned long)i * 250);
+    logArg(writer, 250.0f);
+    benchSink += writer.len;
+  }
+  uint32_t deferred = (ESP.getCycleCount() - start) / LOG_BENCH_ROUNDS;
+  
+  start = ESP.getCycleCount();
+  for (int i = 0; i < LOG_BENCH_ROUNDS; i++) {
+    benchSink += snprintf(line, sizeof(line), fmt, (unsigned long)i, 15,
+                          (unsigned long)i * 250, 250.0);
+  }
+  uint32_t formatted = (ESP.getCycleCount() - start) / LOG_BENCH_ROUNDS;
+  
+  Serial.printf("[LOG] Benchmark: registro diferido %lu ciclos, snprintf %lu ciclos "
+                "(sin contar la UART)\n", (unsigned long)deferred, (unsigned long)formatted);
+}
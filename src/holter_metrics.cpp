@@ -0,0 +1,135 @@
+#include "holter_metrics.h"
+#include "holter_cbor.h"
+#include "aws_config.h"
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Límites superiores (inclusive) de cada histograma, en el orden de
+// MetricHistogram. Lo que pasa el último cae en el bucket de desborde
+static const uint32_t BOUNDS[MH_COUNT][METRICS_BUCKETS - 1] = {
+  { 50, 100, 250, 500, 1000, 2000, 4000, 8000 },                  // Atraso de muestra (us; 4000 = un período)
+  { 1000, 2000, 5000, 10000, 20000, 50000, 100000, 250000 },      // Escritura a SD (us)
+  { 10, 100, 1000, 5000, 10000, 50000, 100000, 500000 },          // Espera del lock de SD (us)
+  { 64, 128, 256, 512, 1024, 2048, 4096, 8192 },                  // PUT (kbps)
+  { 50, 55, 60, 65, 70, 75, 80, 85 },                             // RSSI (-dBm)
+  { 1000, 2000, 5000, 10000, 20000, 30000, 50000, 100000 },       // Dibujo de pantalla (us)
+};
+
+// Claves del snapshot (enteros chicos: un byte cada una en CBOR)
+enum MetricsKey {
+  MK_VERSION = 0,
+  MK_DEVICE_ID = 1,
+  MK_UPTIME = 2,
+  MK_COUNTERS = 3,
+  MK_GAUGES = 4,
+  MK_HISTOGRAMS = 5
+};
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+struct Histogram {
+  uint32_t buckets[METRICS_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+};
+
+static uint32_t counters[MC_COUNT];
+static int32_t gauges[MG_COUNT];
+static Histogram histograms[MH_COUNT];
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_metrics_add(MetricCounter counter, uint32_t amount) {
+  __atomic_fetch_add(&counters[counter], amount, __ATOMIC_RELAXED);
+}
+
+void holter_metrics_set(MetricGauge gauge, int32_t value) {
+  __atomic_store_n(&gauges[gauge], value, __ATOMIC_RELAXED);
+}
+
+void holter_metrics_observe(MetricHistogram histogram, uint32_t value) {
+  const uint32_t* bounds = BOUNDS[histogram];
+  int bucket = 0;
+  while (bucket < METRICS_BUCKETS - 1 && value > bounds[bucket]) {
+    bucket++;
+  }
+  
+  Histogram& h = histograms[histogram];
+  __atomic_fetch_add(&h.buckets[bucket], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h.count, 1, __ATOMIC_RELAXED);
+  
+  uint32_t seen = __atomic_load_n(&h.max, __ATOMIC_RELAXED);
+  while (value > seen &&
+         !__atomic_compare_exchange_n(&h.max, &seen, value, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+uint32_t holter_metrics_getCounter(MetricCounter counter) {
+  return __atomic_load_n(&counters[counter], __ATOMIC_RELAXED);
+}
+
+int32_t holter_metrics_getGauge(MetricGauge gauge) {
+  return __atomic_load_n(&gauges[gauge], __ATOMIC_RELAXED);
+}
+
+MetricsHistogramSnapshot holter_metrics_getHistogram(MetricHistogram histogram) {
+  const Histogram& h = histograms[histogram];
+  MetricsHistogramSnapshot result;
+  for (int i = 0; i < METRICS_BUCKETS; i++) {
+    result.buckets[i] = __atomic_load_n(&h.buckets[i], __ATOMIC_RELAXED);
+  }
+  result.count = __atomic_load_n(&h.count, __ATOMIC_RELAXED);
+  result.max = __atomic_load_n(&h.max, __ATOMIC_RELAXED);
+  return result;
+}
+
+const uint32_t* holter_metrics_getBounds(MetricHistogram histogram) {
+  return BOUNDS[histogram];
+}
+
+size_t holter_metrics_encode(uint8_t* buffer, size_t capacity) {
+  CborWriter writer(buffer, capacity);
+  writer.map(6);
+  
+  writer.uint(MK_VERSION);
+  writer.uint(METRICS_SCHEMA_VERSION);
+  writer.uint(MK_DEVICE_ID);
+  writer.text(DEVICE_ID);
+  writer.uint(MK_UPTIME);
+  writer.uint(millis() / 1000);
+  
+  writer.uint(MK_COUNTERS);
+  writer.array(MC_COUNT);
+  for (int i = 0; i < MC_COUNT; i++) {
+    writer.uint(holter_metrics_getCounter((MetricCounter)i));
+  }
+  
+  writer.uint(MK_GAUGES);
+  writer.array(MG_COUNT);
+  for (int i = 0; i < MG_COUNT; i++) {
+    writer.integer(holter_metrics_getGauge((MetricGauge)i));
+  }
+  
+  // Cada histograma: [bucket 0..8, count, max]. Los buckets se leen uno por
+  // uno, así que count puede adelantarse a su suma por las observaciones en curso
+  writer.uint(MK_HISTOGRAMS);
+  writer.array(MH_COUNT);
+  for (int i = 0; i < MH_COUNT; i++) {
+    MetricsHistogramSnapshot h = holter_metrics_getHistogram((MetricHistogram)i);
+    writer.array(METRICS_BUCKETS + 2);
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+      writer.uint(h.buckets[b]);
+    }
+    writer.uint(h.count);
+    writer.uint(h.max);
+  }
+  
+  return writer.ok() ? writer.size() : 0;
+}
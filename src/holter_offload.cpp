@@ -0,0 +1,229 @@
+#include "holter_offload.h"
+#include "holter_capture.h"
+#include "holter_power.h"
+#include <SD.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Núcleo 0, debajo del upload: la descarga usa el tiempo que sobra
+#define OFFLOAD_CORE 0
+#define OFFLOAD_TASK_PRIORITY 1
+
+// Sin cliente conectado el puerto se revisa con esta frecuencia
+static const unsigned long IDLE_POLL_MS = 20;
+
+// ============================================================================
+// ADAPTADORES
+// ============================================================================
+
+class SerialLink : public OffloadLink {
+public:
+  int read(uint8_t* buffer, size_t len) override {
+    int available = Serial.available();
+    if (available <= 0) return 0;
+    return Serial.read(buffer, min((size_t)available, len));
+  }
+  
+  // Un solo write() por trama: el driver del UART no la mezcla con los logs
+  void write(const uint8_t* data, size_t len) override {
+    Serial.write(data, len);
+  }
+  
+  size_t writable() override {
+    return Serial.availableForWrite();
+  }
+  
+  uint32_t millis() override {
+    return ::millis();
+  }
+};
+
+// Segmentos en la raíz de la SD. Cada operación toma el lock de la SD por
+// separado para no frenar al escritor de la captura durante la transferencia
+class SdStorage : public OffloadStorage {
+public:
+  bool beginList(uint32_t* count) override {
+    close();
+    if (!holter_isSDAvailable()) return false;
+    
+    holter_sdLock();
+    dir = SD.open("/");
+    if (!dir) {
+      holter_sdUnlock();
+      return false;
+    }
+    
+    uint32_t total = 0;
+    File file = dir.openNextFile();
+    while (file) {
+      uint32_t recording, segment;
+      if (!file.isDirectory() && holter_parseSegmentFilename(file.path(), &recording, &segment)) {
+        total++;
+      }
+      file.close();
+      file = dir.openNextFile();
+    }
+    dir.rewindDirectory();
+    cursor = 0;
+    holter_sdUnlock();
+    
+    *count = total;
+    return true;
+  }
+  
+  bool listEntry(uint32_t index, OffloadEntry* entry) override {
+    if (!dir) return false;
+    
+    holter_sdLock();
+    if (index < cursor) {
+      dir.rewindDirectory();
+      cursor = 0;
+    }
+    
+    bool found = false;
+    File file = dir.openNextFile();
+    while (file) {
+      uint32_t recording, segment;
+      if (!file.isDirectory() && holter_parseSegmentFilename(file.path(), &recording, &segment)) {
+        if (cursor++ == index) {
+          fillEntry(file, recording, segment, entry);
+          found = true;
+          file.close();
+          break;
+        }
+      }
+      file.close();
+      file = dir.openNextFile();
+    }
+    holter_sdUnlock();
+    
+    return found;
+  }
+  
+  bool open(uint32_t recording, uint32_t segment, uint32_t* size) override {
+    close();
+    if (!holter_isSDAvailable()) return false;
+    
+    holter_sdLock();
+    file = SD.open(holter_segmentFilename(recording, segment).c_str(), FILE_READ);
+    if (file) *size = file.size();
+    holter_sdUnlock();
+    
+    return (bool)file;
+  }
+  
+  int read(uint32_t offset, uint8_t* buffer, size_t len) override {
+    if (!file) return -1;
+    
+    holter_sdLock();
+    int got = file.seek(offset) ? file.read(buffer, len) : -1;
+    holter_sdUnlock();
+    
+    return got;
+  }
+  
+  void close() override {
+    if (!file && !dir) return;
+    
+    holter_sdLock();
+    if (file) file.close();
+    if (dir) dir.close();
+    holter_sdUnlock();
+  }
+
+private:
+  void fillEntry(File& source, uint32_t recording, uint32_t segment, OffloadEntry* entry) {
+    memset(entry, 0, sizeof(OffloadEntry));
+    entry->recording_id = recording;
+    entry->segment = segment;
+    entry->size = source.size();
+    
+    FileHeader header;
+    if (source.read((uint8_t*)&header, sizeof(header)) == sizeof(header)) {
+      entry->timestamp_start = header.timestamp_start;
+      entry->num_ecg_samples = header.num_ecg_samples;
+      entry->version = header.version;
+      
+      SessionInfo info;
+      if (header.version == 2 ||
+          (header.version == 3 && source.read((uint8_t*)&info, sizeof(info)) == sizeof(info) &&
+           (info.flags & SESSION_FLAG_ENCRYPTED))) {
+        entry->flags |= OFFLOAD_ENTRY_ENCRYPTED;
+      }
+    }
+    
+    if (holter_isCapturing() && recording == holter_getRecordingID() &&
+        segment == holter_getSegmentIndex()) {
+      entry->flags |= OFFLOAD_ENTRY_OPEN;
+    }
+  }
+  
+  File file;
+  File dir;
+  uint32_t cursor = 0;         // Entradas que ya entregó dir desde el último rewind
+};
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static SerialLink serialLink;
+static SdStorage sdStorage;
+static OffloadServer* server = nullptr;
+static TaskHandle_t offloadTaskHandle = nullptr;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static void offloadTask(void* param) {
+  bool holdingAwake = false;
+  
+  for (;;) {
+    server->poll();
+    
+    // Durante una transferencia la UART no puede dormirse: lo que llega en
+    // light sleep se pierde y cada trama se reenviaría
+    if (server->busy() != holdingAwake) {
+      holdingAwake = server->busy();
+      if (holdingAwake) {
+        holter_power_holdAwake();
+      } else {
+        holter_power_release();
+      }
+    }
+    
+    // Durante una transferencia se cede un tick por vuelta (watchdog del idle);
+    // la ventana en vuelo cubre ese tiempo de sobra
+    vTaskDelay(server->busy() ? 1 : pdMS_TO_TICKS(IDLE_POLL_MS));
+  }
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_offload_init() {
+  if (server != nullptr) return;
+  
+  server = new OffloadServer(&sdStorage, &serialLink, OFFLOAD_BAUD);
+  xTaskCreatePinnedToCore(offloadTask, "offload", 4096, nullptr,
+                          OFFLOAD_TASK_PRIORITY, &offloadTaskHandle, OFFLOAD_CORE);
+  
+  Serial.printf("[OFFLOAD] Descarga por USB-serie disponible (%d baud, tramas de %d bytes, ventana %d)\n",
+                OFFLOAD_BAUD, OFFLOAD_MAX_PAYLOAD, OFFLOAD_WINDOW);
+}
+
+bool holter_offload_isActive() {
+  return server != nullptr && server->busy();
+}
+
+OffloadStats holter_offload_getStats() {
+  if (server == nullptr) {
+    OffloadStats empty = {0};
+    return empty;
+  }
+  return server->stats();
+}
@@ -0,0 +1,372 @@
+#include "holter_offload_proto.h"
+#include <string.h>
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Tabla de a 4 bits: 64 bytes en vez de 1 KB, y sobra para el line rate del UART
+static const uint32_t CRC_NIBBLE[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+  0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static void putU16(uint8_t* out, uint16_t value) {
+  out[0] = value & 0xFF;
+  out[1] = value >> 8;
+}
+
+static void putU32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// ============================================================================
+// TRAMAS
+// ============================================================================
+
+uint32_t offload_crc32(uint32_t crc, const uint8_t* data, size_t len) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ CRC_NIBBLE[crc & 0x0F];
+    crc = (crc >> 4) ^ CRC_NIBBLE[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+size_t offload_encodeFrame(uint8_t* out, uint8_t type, uint8_t transfer, uint32_t seq,
+                           const uint8_t* payload, uint16_t len) {
+  out[0] = OFFLOAD_SYNC0;
+  out[1] = OFFLOAD_SYNC1;
+  out[2] = type;
+  out[3] = transfer;
+  putU32(out + 4, seq);
+  putU16(out + 8, len);
+  
+  // El payload puede venir ya escrito en su lugar (lo usa el servidor)
+  if (len > 0 && payload != out + OFFLOAD_HEADER_SIZE) {
+    memcpy(out + OFFLOAD_HEADER_SIZE, payload, len);
+  }
+  
+  uint32_t crc = offload_crc32(0, out + 2, OFFLOAD_HEADER_SIZE - 2 + len);
+  putU32(out + OFFLOAD_HEADER_SIZE + len, crc);
+  return OFFLOAD_HEADER_SIZE + len + OFFLOAD_CRC_SIZE;
+}
+
+OffloadParser::OffloadParser()
+  : state(HUNT_SYNC0), length(0), expected(0), badCrc(0), skipped(0) {
+  memset(&current, 0, sizeof(current));
+}
+
+bool OffloadParser::push(uint8_t byte) {
+  switch (state) {
+    case HUNT_SYNC0:
+      if (byte == OFFLOAD_SYNC0) {
+        state = HUNT_SYNC1;
+      } else {
+        skipped++;
+      }
+      return false;
+    
+    case HUNT_SYNC1:
+      if (byte == OFFLOAD_SYNC1) {
+        state = HEADER;
+        length = 0;
+      } else if (byte != OFFLOAD_SYNC0) {
+        skipped += 2;
+        state = HUNT_SYNC0;
+      } else {
+        skipped++;
+      }
+      return false;
+    
+    case HEADER: {
+      // El buffer guarda desde type: lo que cubre el CRC
+      buffer[length++] = byte;
+      if (length < OFFLOAD_HEADER_SIZE - 2) return false;
+      
+      uint16_t payloadLen = buffer[6] | (buffer[7] << 8);
+      if (payloadLen > OFFLOAD_MAX_PAYLOAD) {
+        skipped += OFFLOAD_HEADER_SIZE;
+        state = HUNT_SYNC0;
+        return false;
+      }
+      expected = OFFLOAD_HEADER_SIZE - 2 + payloadLen + OFFLOAD_CRC_SIZE;
+      state = BODY;
+      return false;
+    }
+    
+    case BODY: {
+      buffer[length++] = byte;
+      if (length < expected) return false;
+      
+      state = HUNT_SYNC0;
+      size_t covered = expected - OFFLOAD_CRC_SIZE;
+      if (offload_crc32(0, buffer, covered) != getU32(buffer + covered)) {
+        badCrc++;
+        return false;
+      }
+      
+      current.type = buffer[0];
+      current.transfer = buffer[1];
+      current.seq = getU32(buffer + 2);
+      current.length = buffer[6] | (buffer[7] << 8);
+      current.payload = buffer + OFFLOAD_HEADER_SIZE - 2;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ============================================================================
+// EQUIPO
+// ============================================================================
+
+OffloadServer::OffloadServer(OffloadStorage* storage, OffloadLink* link, uint32_t baud)
+  : storage(storage), link(link), baud(baud), active(false), listing(false), transfer(0),
+    firstByte(0), totalBytes(0), lastSeq(0), base(0), nextSeq(0), highestSent(0),
+    lastProgress(0), lastAck(0), contentCrc(0), crcUpTo(0) {
+  memset(&counters, 0, sizeof(counters));
+}
+
+void OffloadServer::poll() {
+  uint8_t incoming[64];
+  int received;
+  while ((received = link->read(incoming, sizeof(incoming))) > 0) {
+    for (int i = 0; i < received; i++) {
+      if (parser.push(incoming[i])) handle(parser.frame());
+    }
+  }
+  
+  if (!active) return;
+  
+  uint32_t now = link->millis();
+  if (now - lastAck > OFFLOAD_ABANDON_MS) {
+    finish();
+    return;
+  }
+  
+  // Go-back-N: sin confirmaciones a tiempo se reenvía toda la ventana
+  if (nextSeq > base && now - lastProgress > OFFLOAD_RETRANSMIT_MS) {
+    nextSeq = base;
+    lastProgress = now;
+  }
+  
+  while (active && nextSeq <= lastSeq && nextSeq < base + OFFLOAD_WINDOW) {
+    if (!sendFrame(nextSeq)) break;
+    nextSeq++;
+  }
+}
+
+OffloadStats OffloadServer::stats() const {
+  OffloadStats result = counters;
+  result.crc_errors = parser.crcErrors();
+  return result;
+}
+
+void OffloadServer::handle(const OffloadFrame& frame) {
+  uint32_t now = link->millis();
+  
+  switch (frame.type) {
+    case OFFLOAD_HELLO: {
+      OffloadInfo info;
+      info.version = OFFLOAD_VERSION;
+      info.window = OFFLOAD_WINDOW;
+      info.max_payload = OFFLOAD_MAX_PAYLOAD;
+      info.baud = baud;
+      send(OFFLOAD_INFO, frame.transfer, 0, (const uint8_t*)&info, sizeof(info));
+      break;
+    }
+    
+    case OFFLOAD_LIST:
+      finish();
+      startList(frame.transfer);
+      break;
+    
+    case OFFLOAD_GET: {
+      finish();
+      if (frame.length != sizeof(OffloadGet)) {
+        sendError(frame.transfer, OFFLOAD_ERR_BAD_REQUEST, "GET mal formado");
+        break;
+      }
+      OffloadGet request;
+      memcpy(&request, frame.payload, sizeof(request));
+      startGet(frame.transfer, request);
+      break;
+    }
+    
+    case OFFLOAD_ACK:
+      if (!active || frame.transfer != transfer) break;
+      if (frame.seq > base && frame.seq <= lastSeq + 1) {
+        base = frame.seq;
+        lastProgress = now;
+        lastAck = now;
+        if (nextSeq < base) nextSeq = base;
+      }
+      if (base > lastSeq) {
+        counters.bytes_sent += totalBytes;
+        finish();
+      }
+      break;
+    
+    case OFFLOAD_NAK:
+      if (!active || frame.transfer != transfer) break;
+      if (frame.seq >= base && frame.seq < nextSeq) {
+        base = frame.seq;
+        nextSeq = frame.seq;
+        lastProgress = now;
+        lastAck = now;
+      }
+      break;
+    
+    case OFFLOAD_CANCEL:
+      if (frame.transfer == transfer) finish();
+      break;
+    
+    default:
+      break;
+  }
+}
+
+void OffloadServer::startList(uint8_t id) {
+  uint32_t count = 0;
+  if (!storage->beginList(&count)) {
+    sendError(id, OFFLOAD_ERR_NO_STORAGE, "SD no disponible");
+    return;
+  }
+  startTransfer(id, true, 0, count * sizeof(OffloadEntry));
+}
+
+void OffloadServer::startGet(uint8_t id, const OffloadGet& request) {
+  uint32_t size = 0;
+  if (!storage->open(request.recording_id, request.segment, &size)) {
+    sendError(id, OFFLOAD_ERR_NOT_FOUND, "Segmento no encontrado");
+    return;
+  }
+  if (request.offset > size) {
+    storage->close();
+    sendError(id, OFFLOAD_ERR_BAD_REQUEST, "Offset fuera del archivo");
+    return;
+  }
+  
+  uint32_t available = size - request.offset;
+  uint32_t length = (request.length == 0 || request.length > available) ? available : request.length;
+  startTransfer(id, false, request.offset, length);
+}
+
+void OffloadServer::startTransfer(uint8_t id, bool list, uint32_t first, uint32_t total) {
+  active = true;
+  listing = list;
+  transfer = id;
+  firstByte = first;
+  totalBytes = total;
+  lastSeq = 1 + (total + OFFLOAD_MAX_PAYLOAD - 1) / OFFLOAD_MAX_PAYLOAD;
+  base = 0;
+  nextSeq = 0;
+  highestSent = 0;
+  lastProgress = link->millis();
+  lastAck = lastProgress;
+  contentCrc = 0;
+  crcUpTo = 0;
+  counters.transfers++;
+}
+
+void OffloadServer::finish() {
+  if (!active) return;
+  storage->close();
+  active = false;
+}
+
+void OffloadServer::sendError(uint8_t id, uint8_t code, const char* message) {
+  uint8_t payload[64];
+  size_t len = strlen(message);
+  if (len > sizeof(payload) - 1) len = sizeof(payload) - 1;
+  payload[0] = code;
+  memcpy(payload + 1, message, len);
+  send(OFFLOAD_ERROR, id, 0, payload, len + 1);
+}
+
+bool OffloadServer::sendFrame(uint32_t seq) {
+  uint8_t* payload = frameBuffer + OFFLOAD_HEADER_SIZE;
+  uint8_t type;
+  size_t len;
+  
+  if (seq == 0) {
+    OffloadBegin begin = { totalBytes };
+    type = OFFLOAD_BEGIN;
+    len = sizeof(begin);
+    memcpy(payload, &begin, len);
+  } else if (seq == lastSeq) {
+    OffloadEnd end = { contentCrc };
+    type = OFFLOAD_END;
+    len = sizeof(end);
+    memcpy(payload, &end, len);
+  } else {
+    type = OFFLOAD_DATA;
+    uint32_t offset = (seq - 1) * OFFLOAD_MAX_PAYLOAD;
+    len = totalBytes - offset < OFFLOAD_MAX_PAYLOAD ? totalBytes - offset : OFFLOAD_MAX_PAYLOAD;
+  }
+  
+  // La trama entera o nada: un write() parcial retendría el UART
+  if (link->writable() < OFFLOAD_HEADER_SIZE + len + OFFLOAD_CRC_SIZE) return false;
+  
+  if (type == OFFLOAD_DATA && fillData(seq, payload) != len) {
+    counters.read_errors++;
+    sendError(transfer, OFFLOAD_ERR_READ, "Error leyendo la SD");
+    finish();
+    return false;
+  }
+  
+  size_t frameLen = offload_encodeFrame(frameBuffer, type, transfer, seq, payload, len);
+  link->write(frameBuffer, frameLen);
+  
+  counters.frames_sent++;
+  if (seq < highestSent) {
+    counters.frames_resent++;
+  } else {
+    highestSent = seq + 1;
+  }
+  return true;
+}
+
+size_t OffloadServer::fillData(uint32_t seq, uint8_t* out) {
+  uint32_t offset = (seq - 1) * OFFLOAD_MAX_PAYLOAD;
+  size_t len = totalBytes - offset < OFFLOAD_MAX_PAYLOAD ? totalBytes - offset : OFFLOAD_MAX_PAYLOAD;
+  
+  if (listing) {
+    // Las entradas no caen alineadas con las tramas: se copia solo la parte que toca
+    const size_t ENTRY = sizeof(OffloadEntry);
+    size_t filled = 0;
+    while (filled < len) {
+      uint32_t position = offset + filled;
+      OffloadEntry entry;
+      if (!storage->listEntry(position / ENTRY, &entry)) break;
+      size_t skip = position % ENTRY;
+      size_t chunk = ENTRY - skip < len - filled ? ENTRY - skip : len - filled;
+      memcpy(out + filled, (const uint8_t*)&entry + skip, chunk);
+      filled += chunk;
+    }
+    if (filled != len) return filled;
+  } else {
+    int got = storage->read(firstByte + offset, out, len);
+    if (got != (int)len) return got < 0 ? 0 : got;
+  }
+  
+  // Cada byte entra al CRC de punta a punta una sola vez, en el primer envío
+  if (offset == crcUpTo) {
+    contentCrc = offload_crc32(contentCrc, out, len);
+    crcUpTo += len;
+  }
+  return len;
+}
+
+void OffloadServer::send(uint8_t type, uint8_t id, uint32_t seq, const uint8_t* payload, uint16_t len) {
+  size_t frameLen = offload_encodeFrame(frameBuffer, type, id, seq, payload, len);
+  link->write(frameBuffer, frameLen);
+}
@@ -0,0 +1,135 @@
+#include "holter_power.h"
+#include <sdkconfig.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_freertos_hooks.h>
+#include <driver/uart.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Flancos en RX que despiertan del light sleep: los primeros bytes de una
+// solicitud de descarga se pierden y el cliente la reintenta
+#define POWER_UART_WAKE_THRESHOLD 3
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static bool pmEnabled = false;
+static bool lightSleepEnabled = false;
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t awakeLock = nullptr;
+#endif
+
+// Muestreo de carga: en cada tick se anota si el núcleo estaba en su tarea idle
+static TaskHandle_t idleTasks[2] = {nullptr, nullptr};
+static volatile uint32_t tickSamples[2] = {0, 0};
+static volatile uint32_t idleSamples[2] = {0, 0};
+
+static TickType_t lastTickCount = 0;
+static uint32_t lastTickSamples[2] = {0, 0};
+static uint32_t lastIdleSamples[2] = {0, 0};
+static unsigned long lastStatsMs = 0;
+static uint32_t sleepTicks = 0;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Hook del tick (ISR, en IRAM: corre también con la caché de flash apagada)
+static void IRAM_ATTR sampleTick() {
+  int core = xPortGetCoreID();
+  tickSamples[core]++;
+  if (xTaskGetCurrentTaskHandle() == idleTasks[core]) {
+    idleSamples[core]++;
+  }
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_power_init(bool lightSleep) {
+  for (int core = 0; core < 2; core++) {
+    idleTasks[core] = xTaskGetIdleTaskHandleForCPU(core);
+    esp_register_freertos_tick_hook_for_cpu(sampleTick, core);
+  }
+  lastTickCount = xTaskGetTickCount();
+  lastStatsMs = millis();
+
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t config = {};
+  config.max_freq_mhz = POWER_MAX_FREQ_MHZ;
+  config.min_freq_mhz = POWER_MIN_FREQ_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  config.light_sleep_enable = lightSleep;
+#else
+  if (lightSleep) {
+    Serial.println("[POWER] Sin CONFIG_FREERTOS_USE_TICKLESS_IDLE: solo escalado de frecuencia");
+  }
+#endif
+  
+  esp_err_t err = esp_pm_configure(&config);
+  if (err != ESP_OK) {
+    Serial.printf("[POWER] ERROR: esp_pm_configure falló (%d)\n", err);
+    return;
+  }
+  pmEnabled = true;
+  lightSleepEnabled = config.light_sleep_enable;
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "holter", &awakeLock);
+  
+  if (lightSleepEnabled) {
+    uart_set_wakeup_threshold(UART_NUM_0, POWER_UART_WAKE_THRESHOLD);
+    esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  }
+  
+  Serial.printf("[POWER] CPU %d-%d MHz, light sleep automático: %s\n",
+                POWER_MIN_FREQ_MHZ, POWER_MAX_FREQ_MHZ, lightSleepEnabled ? "sí" : "no");
+#else
+  Serial.println("[POWER] Core compilado sin CONFIG_PM_ENABLE: CPU fija, solo se mide la carga");
+#endif
+}
+
+void holter_power_holdAwake() {
+#if CONFIG_PM_ENABLE
+  if (awakeLock != nullptr) esp_pm_lock_acquire(awakeLock);
+#endif
+}
+
+void holter_power_release() {
+#if CONFIG_PM_ENABLE
+  if (awakeLock != nullptr) esp_pm_lock_release(awakeLock);
+#endif
+}
+
+PowerStats holter_power_getStats() {
+  PowerStats result = {0};
+  result.pm_enabled = pmEnabled;
+  result.light_sleep = lightSleepEnabled;
+  
+  TickType_t now = xTaskGetTickCount();
+  uint32_t elapsed = now - lastTickCount;
+  result.window_ms = millis() - lastStatsMs;
+  
+  for (int core = 0; core < 2; core++) {
+    uint32_t samples = tickSamples[core] - lastTickSamples[core];
+    uint32_t idle = idleSamples[core] - lastIdleSamples[core];
+    lastTickSamples[core] += samples;
+    lastIdleSamples[core] += idle;
+    
+    // Con tickless idle el núcleo dormido no recibe ticks: los que faltan
+    // fueron tiempo en la tarea idle
+    uint32_t skipped = elapsed > samples ? elapsed - samples : 0;
+    if (core == 0) sleepTicks += skipped;
+    
+    result.idle_pct[core] = elapsed > 0 ? 100.0f * min(idle + skipped, elapsed) / elapsed : 0.0f;
+  }
+  result.sleep_ticks = sleepTicks;
+  
+  lastTickCount = now;
+  lastStatsMs = millis();
+  return result;
+}
@@ -0,0 +1,752 @@
+#include "holter_queue.h"
+#include "holter_capture.h"
+#include "holter_catalog.h"
+#include <time.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define QUEUE_FILE "/upload_queue.dat"
+#define QUEUE_RECORD_MAGIC 0x51554531  // "QUE1"
+#define SYNC_FILE "/sync_state.dat"
+#define SYNC_RECORD_MAGIC 0x53594E31   // "SYN1"
+
+// Máximo de segmentos revisados en la SD por cada avance del high-water mark
+static const int SYNC_ADVANCE_MAX = 64;
+
+// Entradas del directorio por cada toma de la cola y la SD al reconstruir el
+// catálogo (cada una: abrir el archivo y leer el header)
+static const int REBUILD_BATCH = 16;
+
+static const uint32_t BACKOFF_BASE_SEC = 30;
+static const uint32_t BACKOFF_MAX_SEC = 3600;
+
+enum QueueSlotState : uint8_t {
+  SLOT_FREE = 0,
+  SLOT_PENDING = 1
+};
+
+// Registro en disco: un slot fijo por entrada, se reescribe en su lugar.
+// El CRC permite descartar un slot a medio escribir tras un corte de energía.
+struct QueueRecord {
+  uint32_t magic;
+  QueueEntry entry;
+  uint32_t crc;
+} __attribute__((packed));
+
+struct SyncRecord {
+  uint32_t magic;
+  RecordingSync sync;
+  uint32_t crc;
+} __attribute__((packed));
+
+static_assert(sizeof(SyncRecord) <= sizeof(QueueRecord), "createSlotFile usa un buffer de QueueRecord");
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static QueueEntry entries[QUEUE_MAX_ENTRIES];
+static RecordingSync recordings[SYNC_MAX_RECORDINGS];
+static bool persistent = false;
+
+// La cola se usa desde la tarea de captura (push) y la de upload (next/mark*).
+// Orden de locks: primero la cola, después la SD.
+static SemaphoreHandle_t queueMutex = nullptr;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static void lockQueue() {
+  if (queueMutex != nullptr) xSemaphoreTakeRecursive(queueMutex, portMAX_DELAY);
+}
+
+static void unlockQueue() {
+  if (queueMutex != nullptr) xSemaphoreGiveRecursive(queueMutex);
+}
+
+static uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static uint32_t nowUnix() {
+  time_t now;
+  time(&now);
+  return (uint32_t)now;
+}
+
+static int findSlot(const char* filename) {
+  for (int i = 0; i < QUEUE_MAX_ENTRIES; i++) {
+    if (entries[i].state == SLOT_PENDING && strcmp(entries[i].filename, filename) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int findFreeSlot() {
+  for (int i = 0; i < QUEUE_MAX_ENTRIES; i++) {
+    if (entries[i].state == SLOT_FREE) return i;
+  }
+  return -1;
+}
+
+// Sobreescribe el registro número slot de un archivo de slots fijos
+static void writeRecord(const char* path, int slot, const void* record, size_t size) {
+  holter_sdLock();
+  
+  // "r+" para sobreescribir en su lugar (FILE_WRITE truncaría el archivo)
+  File file = SD.open(path, "r+");
+  if (!file) {
+    holter_sdUnlock();
+    Serial.printf("[QUEUE] ERROR: No se pudo abrir %s\n", path);
+    return;
+  }
+  
+  file.seek(slot * size);
+  if (file.write((const uint8_t*)record, size) != size) {
+    Serial.printf("[QUEUE] ERROR: Escritura parcial del slot %d de %s\n", slot, path);
+  }
+  file.flush();
+  file.close();
+  holter_sdUnlock();
+}
+
+static void persistSlot(int slot) {
+  if (!persistent) return;
+  
+  QueueRecord record;
+  record.magic = QUEUE_RECORD_MAGIC;
+  record.entry = entries[slot];
+  record.crc = crc32((uint8_t*)&record.entry, sizeof(QueueEntry));
+  writeRecord(QUEUE_FILE, slot, &record, sizeof(record));
+}
+
+static void persistSync(int slot) {
+  if (!persistent) return;
+  
+  SyncRecord record;
+  record.magic = SYNC_RECORD_MAGIC;
+  record.sync = recordings[slot];
+  record.crc = crc32((uint8_t*)&record.sync, sizeof(RecordingSync));
+  writeRecord(SYNC_FILE, slot, &record, sizeof(record));
+}
+
+static bool createSlotFile(const char* path, int slots, size_t size) {
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) return false;
+  
+  uint8_t empty[sizeof(QueueRecord)] = {0};
+  for (int i = 0; i < slots; i++) {
+    file.write(empty, size);
+  }
+  file.close();
+  return true;
+}
+
+// ============================================================================
+// HIGH-WATER MARK DE GRABACIONES SEGMENTADAS
+// ============================================================================
+
+static int findSync(uint32_t recordingId) {
+  for (int i = 0; i < SYNC_MAX_RECORDINGS; i++) {
+    if (recordings[i].recording_id == recordingId) return i;
+  }
+  return -1;
+}
+
+// Slot para una grabación nueva: uno libre, si no la grabación ya sincronizada
+// más antigua, y como último recurso la más antigua (pierde su high-water mark,
+// sus segmentos se siguen subiendo igual)
+static int allocSync(uint32_t recordingId) {
+  int oldestSynced = -1;
+  int oldest = -1;
+  
+  for (int i = 0; i < SYNC_MAX_RECORDINGS; i++) {
+    const RecordingSync& r = recordings[i];
+    if (r.recording_id == 0) {
+      oldest = i;
+      oldestSynced = i;
+      break;
+    }
+    if (r.high_water >= r.segments_sealed &&
+        (oldestSynced < 0 || r.recording_id < recordings[oldestSynced].recording_id)) {
+      oldestSynced = i;
+    }
+    if (oldest < 0 || r.recording_id < recordings[oldest].recording_id) {
+      oldest = i;
+    }
+  }
+  
+  int slot = (oldestSynced >= 0) ? oldestSynced : oldest;
+  if (recordings[slot].recording_id != 0 && oldestSynced < 0) {
+    Serial.printf("[SYNC] WARNING: Se descarta el high-water mark de la grabación %lu\n",
+                  (unsigned long)recordings[slot].recording_id);
+  }
+  
+  memset(&recordings[slot], 0, sizeof(RecordingSync));
+  recordings[slot].recording_id = recordingId;
+  return slot;
+}
+
+// ¿El segmento ya está en S3? Solo se borra de la SD tras la confirmación.
+// El catálogo lo responde sin buscar en el directorio; SD.exists() queda
+// para los segmentos que no tiene (catálogo reconstruyéndose)
+static bool segmentSynced(uint32_t recordingId, uint32_t segment) {
+  String name = holter_segmentFilename(recordingId, segment);
+  if (findSlot(name.c_str()) >= 0) return false;
+  
+  CatalogRecord record;
+  if (holter_catalog_find(recordingId, segment, &record)) {
+    return record.state == CATALOG_UPLOADED || record.state == CATALOG_DELETED;
+  }
+  return !SD.exists(name.c_str());
+}
+
+// Avanza high_water sobre los segmentos que ya no están pendientes ni en la
+// SD: solo se borran tras la confirmación de S3, así que ya son durables
+static bool advanceHighWater(int slot) {
+  RecordingSync& r = recordings[slot];
+  uint32_t start = r.high_water;
+  
+  holter_sdLock();
+  for (int checks = 0; r.high_water < r.segments_sealed && checks < SYNC_ADVANCE_MAX; checks++) {
+    if (!segmentSynced(r.recording_id, r.high_water)) break;
+    r.high_water++;
+  }
+  holter_sdUnlock();
+  
+  return r.high_water != start;
+}
+
+static void noteSealed(const char* filename) {
+  uint32_t recordingId;
+  uint32_t segment;
+  if (!holter_parseSegmentFilename(filename, &recordingId, &segment)) return;
+  
+  int slot = findSync(recordingId);
+  if (slot < 0) slot = allocSync(recordingId);
+  
+  RecordingSync& r = recordings[slot];
+  if (segment + 1 > r.segments_sealed) r.segments_sealed = segment + 1;
+  advanceHighWater(slot);
+  persistSync(slot);
+}
+
+static void noteSynced(const char* filename, uint32_t bytes) {
+  uint32_t recordingId;
+  uint32_t segment;
+  if (!holter_parseSegmentFilename(filename, &recordingId, &segment)) return;
+  
+  int slot = findSync(recordingId);
+  if (slot < 0) return;
+  
+  RecordingSync& r = recordings[slot];
+  r.segments_synced++;
+  r.bytes_synced += bytes;
+  advanceHighWater(slot);
+  persistSync(slot);
+  
+  Serial.printf("[SYNC] Grabación %lu: durable hasta el segmento %lu de %lu\n",
+                (unsigned long)recordingId, (unsigned long)r.high_water,
+                (unsigned long)r.segments_sealed);
+}
+
+// Llamado con la cola y la SD tomadas (ver holter_queue_init)
+static void loadSyncFile() {
+  File file = SD.open(SYNC_FILE, FILE_READ);
+  if (!file || file.size() != SYNC_MAX_RECORDINGS * sizeof(SyncRecord)) {
+    if (file) file.close();
+    if (!createSlotFile(SYNC_FILE, SYNC_MAX_RECORDINGS, sizeof(SyncRecord))) {
+      Serial.println("[SYNC] ERROR: No se pudo crear " SYNC_FILE);
+    }
+    return;
+  }
+  
+  for (int i = 0; i < SYNC_MAX_RECORDINGS; i++) {
+    SyncRecord record;
+    if (file.read((uint8_t*)&record, sizeof(SyncRecord)) != sizeof(SyncRecord)) break;
+    if (record.magic != SYNC_RECORD_MAGIC) continue;
+    if (record.crc != crc32((uint8_t*)&record.sync, sizeof(RecordingSync))) continue;
+    recordings[i] = record.sync;
+  }
+  file.close();
+  
+  // Un corte entre el borrado del segmento y la escritura del registro deja
+  // el high-water mark atrasado: se pone al día contra la SD
+  for (int i = 0; i < SYNC_MAX_RECORDINGS; i++) {
+    if (recordings[i].recording_id == 0) continue;
+    if (advanceHighWater(i)) persistSync(i);
+    Serial.printf("[SYNC] Grabación %lu: %lu/%lu segmentos durables\n",
+                  (unsigned long)recordings[i].recording_id,
+                  (unsigned long)recordings[i].high_water,
+                  (unsigned long)recordings[i].segments_sealed);
+  }
+}
+
+static void loadQueueFile() {
+  File file = SD.open(QUEUE_FILE, FILE_READ);
+  if (!file || file.size() != QUEUE_MAX_ENTRIES * sizeof(QueueRecord)) {
+    if (file) file.close();
+    Serial.println("[QUEUE] Creando cola nueva en SD");
+    persistent = createSlotFile(QUEUE_FILE, QUEUE_MAX_ENTRIES, sizeof(QueueRecord));
+    return;
+  }
+  
+  int loaded = 0;
+  int corrupt = 0;
+  for (int i = 0; i < QUEUE_MAX_ENTRIES; i++) {
+    QueueRecord record;
+    if (file.read((uint8_t*)&record, sizeof(QueueRecord)) != sizeof(QueueRecord)) break;
+    if (record.magic != QUEUE_RECORD_MAGIC) continue;
+    
+    if (record.crc != crc32((uint8_t*)&record.entry, sizeof(QueueEntry))) {
+      // Slot a medio escribir: se descarta, el archivo se recupera como huérfano
+      corrupt++;
+      continue;
+    }
+    
+    if (record.entry.state == SLOT_PENDING && SD.exists(record.entry.filename)) {
+      entries[i] = record.entry;
+      entries[i].filename[QUEUE_FILENAME_LEN - 1] = '\0';
+      loaded++;
+    }
+  }
+  file.close();
+  
+  persistent = true;
+  Serial.printf("[QUEUE] %d sesiones pendientes cargadas", loaded);
+  if (corrupt > 0) Serial.printf(" (%d registros corruptos descartados)", corrupt);
+  Serial.println();
+}
+
+// Registro de un segmento a partir de su archivo (reconstrucción del catálogo)
+static void catalogFromFile(File& file, uint32_t recordingId, uint32_t segment, bool capturing,
+                            CatalogRecord* record) {
+  memset(record, 0, sizeof(CatalogRecord));
+  record->recording_id = recordingId;
+  record->segment = segment;
+  record->size = file.size();
+  record->state = capturing ? CATALOG_RECORDING : CATALOG_COMPLETE;
+  
+  FileHeader header;
+  if (file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+      header.ecg_sample_rate > 0) {
+    record->time_start = header.timestamp_start;
+    if (!capturing) {
+      record->time_end = header.timestamp_start + header.num_ecg_samples / header.ecg_sample_rate;
+    }
+  }
+}
+
+// ¿Lo abrió la captura después de from? (grabación y segmento en curso al
+// vaciar el catálogo) Esos los registra y los encola la propia captura
+static bool openedAfter(uint32_t recordingId, uint32_t segment,
+                        uint32_t fromRecording, uint32_t fromSegment) {
+  if (fromRecording == 0) return false;
+  return recordingId > fromRecording || (recordingId == fromRecording && segment > fromSegment);
+}
+
+// Recorre la raíz de la SD: encola los archivos session_*.bin que no estaban
+// en la cola y vuelve a armar el catálogo con los segmentos (si se pudo
+// vaciar). Con miles de segmentos el recorrido lleva segundos y la captura ya
+// está corriendo: la cola y la SD se toman por lote de REBUILD_BATCH entradas,
+// así el escritor de la SD y la rotación de segmentos no esperan al recorrido.
+// Lo que la captura crea entre lotes puede aparecer o no en el listado: se
+// reconoce por la grabación y el segmento, no por el orden del directorio.
+// Llamado sin la cola ni la SD tomadas (ver holter_queue_init)
+static void recoverOrphans() {
+  lockQueue();
+  holter_sdLock();
+  bool rebuild = holter_catalog_reset();
+  
+  // Lo que la captura abra de acá en adelante lo registra ella (el registro va
+  // antes que el archivo); el segmento en curso puede registrarlo al cerrarlo
+  uint32_t fromRecording = holter_getRecordingID();
+  uint32_t fromSegment = holter_getSegmentIndex();
+  File root = SD.open("/");
+  holter_sdUnlock();
+  unlockQueue();
+  if (!root) return;
+  
+  int recovered = 0;
+  int cataloged = 0;
+  bool done = false;
+  
+  while (!done) {
+    CatalogRecord records[REBUILD_BATCH];
+    int count = 0;
+    
+    lockQueue();
+    holter_sdLock();
+    String current = holter_getCurrentFile();
+    bool capturing = holter_isCapturing();
+    
+    for (int scanned = 0; scanned < REBUILD_BATCH; scanned++) {
+      File file = root.openNextFile();
+      if (!file) {
+        done = true;
+        break;
+      }
+      
+      String name = file.path();
+      bool isSession = !file.isDirectory() &&
+                       name.startsWith("/session_") && name.endsWith(".bin");
+      uint32_t recordingId;
+      uint32_t segment;
+      bool parsed = isSession && holter_parseSegmentFilename(name.c_str(), &recordingId, &segment);
+      bool fromCapture = parsed && openedAfter(recordingId, segment, fromRecording, fromSegment);
+      bool atStart = parsed && recordingId == fromRecording && segment == fromSegment;
+      
+      // El segmento en curso al vaciar el catálogo: si la captura ya lo
+      // cerró, lo registró ella
+      if (parsed && rebuild && !fromCapture &&
+          !(atStart && holter_catalog_find(recordingId, segment, nullptr))) {
+        catalogFromFile(file, recordingId, segment, capturing && name == current, &records[count++]);
+      }
+      file.close();
+      
+      // ...y lo encola la rotación al cerrarlo
+      if (isSession && name != current && !fromCapture && !atStart &&
+          findSlot(name.c_str()) < 0 && findFreeSlot() >= 0) {
+        if (holter_queue_push(name)) recovered++;
+      }
+    }
+    
+    if (count > 0) holter_catalog_addBatch(records, count);
+    cataloged += count;
+    holter_sdUnlock();
+    unlockQueue();
+  }
+  
+  holter_sdLock();
+  root.close();
+  holter_sdUnlock();
+  
+  if (rebuild) {
+    Serial.printf("[CATALOG] Reconstruido desde el directorio: %d segmentos\n", cataloged);
+  }
+  if (recovered > 0) {
+    Serial.printf("[QUEUE] %d sesiones huérfanas recuperadas\n", recovered);
+  }
+}
+
+// ¿El catálogo tiene sesiones pendientes que no entraron en la cola?
+static bool catalogBacklog() {
+  CatalogStats stats = holter_catalog_getStats();
+  uint32_t pending = stats.counts[CATALOG_COMPLETE] + stats.counts[CATALOG_UPLOADING];
+  return stats.valid && pending > (uint32_t)holter_queue_depth();
+}
+
+// Encola lo que el catálogo tiene pendiente y la cola no (cola llena al
+// cerrar el segmento, corte de energía antes de encolarlo), hasta llenarla.
+// Un segmento que quedó grabando o subiendo cuando se cortó vuelve a pendiente
+// Llamado con la cola tomada
+static void recoverFromCatalog() {
+  String capturing = holter_isCapturing() ? holter_getCurrentFile() : "";
+  uint32_t cursor = 0;
+  CatalogRecord record;
+  int recovered = 0;
+  
+  while (findFreeSlot() >= 0 && holter_catalog_next(&cursor, CATALOG_PENDING_MASK, &record)) {
+    String name = holter_segmentFilename(record.recording_id, record.segment);
+    if (name == capturing) continue;
+    
+    if (record.state == CATALOG_UPLOADING) {
+      holter_catalog_setState(name.c_str(), CATALOG_COMPLETE);
+    }
+    if (findSlot(name.c_str()) >= 0) continue;
+    
+    if (record.state == CATALOG_RECORDING) {
+      holter_sdLock();
+      File file = SD.open(name.c_str(), FILE_READ);
+      uint32_t size = file ? file.size() : 0;
+      if (file) file.close();
+      holter_sdUnlock();
+      
+      if (size == 0) {
+        holter_catalog_setState(name.c_str(), CATALOG_DELETED);
+        continue;
+      }
+      holter_catalog_complete(record.recording_id, record.segment, size, 0, 0);
+    }
+    
+    if (holter_queue_push(name)) recovered++;
+  }
+  
+  if (recovered > 0) {
+    Serial.printf("[QUEUE] %d sesiones pendientes recuperadas del catálogo\n", recovered);
+  }
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_queue_init() {
+  if (queueMutex == nullptr) {
+    queueMutex = xSemaphoreCreateRecursiveMutex();
+  }
+  
+  // Con lock: se vuelve a llamar tras remontar la SD, con el upload corriendo
+  lockQueue();
+  memset(entries, 0, sizeof(entries));
+  memset(recordings, 0, sizeof(recordings));
+  persistent = false;
+  
+  if (!holter_isSDAvailable()) {
+    unlockQueue();
+    Serial.println("[QUEUE] SD no disponible - cola solo en RAM");
+    return;
+  }
+  
+  holter_sdLock();
+  loadQueueFile();
+  
+  // Con el catálogo válido no hace falta listar la raíz de la SD
+  bool rebuild = holter_catalog_init() != CATALOG_OK;
+  if (persistent) loadSyncFile();
+  if (!rebuild) recoverFromCatalog();
+  holter_sdUnlock();
+  unlockQueue();
+  
+  if (rebuild) recoverOrphans();
+  
+  // El segmento en curso puede haber arrancado antes de cargar el catálogo
+  holter_sdLock();
+  uint32_t recordingId = holter_getRecordingID();
+  uint32_t segment = holter_getSegmentIndex();
+  if (holter_isCapturing() && !holter_catalog_find(recordingId, segment, nullptr)) {
+    holter_catalog_begin(recordingId, segment, 0);
+  }
+  holter_sdUnlock();
+  
+  holter_queue_printStatus();
+  holter_catalog_printStatus();
+}
+
+bool holter_queue_push(const String& filename, uint8_t flags) {
+  if (filename.length() == 0 || filename.length() >= QUEUE_FILENAME_LEN) {
+    Serial.println("[QUEUE] ERROR: Nombre de archivo inválido: " + filename);
+    return false;
+  }
+  
+  lockQueue();
+  
+  int slot = findSlot(filename.c_str());
+  if (slot >= 0) {
+    entries[slot].flags |= flags;
+    persistSlot(slot);
+    unlockQueue();
+    return true;
+  }
+  
+  slot = findFreeSlot();
+  if (slot < 0) {
+    unlockQueue();
+    // El archivo sigue en la SD y se encola desde el catálogo cuando haya espacio
+    Serial.println("[QUEUE] WARNING: Cola llena, no se encoló " + filename);
+    return false;
+  }
+  
+  uint32_t fileSize = 0;
+  if (holter_isSDAvailable()) {
+    holter_sdLock();
+    File file = SD.open(filename.c_str(), FILE_READ);
+    if (file) {
+      fileSize = file.size();
+      file.close();
+    }
+    holter_sdUnlock();
+  }
+  
+  QueueEntry& entry = entries[slot];
+  memset(&entry, 0, sizeof(QueueEntry));
+  strncpy(entry.filename, filename.c_str(), QUEUE_FILENAME_LEN - 1);
+  entry.file_size = fileSize;
+  entry.created = nowUnix();
+  entry.flags = flags;
+  entry.state = SLOT_PENDING;
+  persistSlot(slot);
+  noteSealed(entry.filename);
+  
+  Serial.printf("[QUEUE] Encolado: %s (%lu bytes) | Pendientes: %d\n",
+                entry.filename, (unsigned long)fileSize, holter_queue_depth());
+  unlockQueue();
+  return true;
+}
+
+// Devuelve el slot elegible de mayor prioridad que no esté en exclude
+static int bestEligible(uint32_t now, const bool* exclude) {
+  int best = -1;
+  
+  for (int i = 0; i < QUEUE_MAX_ENTRIES; i++) {
+    const QueueEntry& e = entries[i];
+    if (e.state != SLOT_PENDING) continue;
+    if (exclude != nullptr && exclude[i]) continue;
+    
+    // Si el reloj retrocedió (p.ej. sin NTP tras un reinicio) no respetar el backoff
+    bool clockWentBack = now < e.last_attempt;
+    if (e.next_attempt > now && !clockWentBack) continue;
+    
+    if (best < 0) {
+      best = i;
+      continue;
+    }
+    
+    const QueueEntry& b = entries[best];
+    bool ePriority = e.flags & QUEUE_FLAG_PRIORITY;
+    bool bPriority = b.flags & QUEUE_FLAG_PRIORITY;
+    if (ePriority != bPriority) {
+      if (ePriority) best = i;
+    } else if (e.created > b.created) {
+      best = i;
+    }
+  }
+  
+  return best;
+}
+
+bool holter_queue_next(QueueEntry* entry) {
+  lockQueue();
+  int best = bestEligible(nowUnix(), nullptr);
+  if (best >= 0) *entry = entries[best];
+  unlockQueue();
+  return best >= 0;
+}
+
+int holter_queue_peek(QueueEntry* out, int maxEntries) {
+  bool taken[QUEUE_MAX_ENTRIES] = {false};
+  uint32_t now = nowUnix();
+  int count = 0;
+  
+  lockQueue();
+  while (count < maxEntries) {
+    int best = bestEligible(now, taken);
+    if (best < 0) break;
+    taken[best] = true;
+    out[count++] = entries[best];
+  }
+  unlockQueue();
+  
+  return count;
+}
+
+void holter_queue_markDone(const String& filename) {
+  lockQueue();
+  int slot = findSlot(filename.c_str());
+  if (slot < 0) {
+    unlockQueue();
+    return;
+  }
+  
+  bool removed = false;
+  if (holter_isSDAvailable()) {
+    holter_sdLock();
+    removed = SD.remove(filename.c_str());
+    if (removed) {
+      Serial.println("[SD] Archivo eliminado (espacio liberado)");
+    }
+    holter_sdUnlock();
+  }
+  holter_catalog_setState(filename.c_str(), removed ? CATALOG_DELETED : CATALOG_UPLOADED);
+  
+  uint32_t bytes = entries[slot].file_size;
+  memset(&entries[slot], 0, sizeof(QueueEntry));
+  persistSlot(slot);
+  noteSynced(filename.c_str(), bytes);
+  
+  // El lugar que se liberó lo ocupa lo que el catálogo tenga pendiente
+  if (catalogBacklog()) recoverFromCatalog();
+  unlockQueue();
+  
+  Serial.printf("[QUEUE] Completado: %s | Pendientes: %d (%lu bytes)\n",
+                filename.c_str(), holter_queue_depth(),
+                (unsigned long)holter_queue_bytesPending());
+}
+
+void holter_queue_markFailed(const String& filename) {
+  lockQueue();
+  int slot = findSlot(filename.c_str());
+  if (slot < 0) {
+    unlockQueue();
+    return;
+  }
+  
+  QueueEntry& entry = entries[slot];
+  uint32_t now = nowUnix();
+  
+  uint32_t backoff = BACKOFF_MAX_SEC;
+  if (entry.retries < 16) {
+    backoff = min(BACKOFF_BASE_SEC << entry.retries, BACKOFF_MAX_SEC);
+  }
+  
+  if (entry.retries < 0xFFFF) entry.retries++;
+  entry.last_attempt = now;
+  entry.next_attempt = now + backoff;
+  persistSlot(slot);
+  holter_catalog_setState(entry.filename, CATALOG_COMPLETE);
+  
+  Serial.printf("[QUEUE] Falló %s (intento %u) - reintento en %lus\n",
+                entry.filename, entry.retries, (unsigned long)backoff);
+  unlockQueue();
+}
+
+bool holter_queue_getSync(uint32_t recordingId, RecordingSync* sync) {
+  if (recordingId == 0) return false;
+  
+  lockQueue();
+  int slot = findSync(recordingId);
+  if (slot >= 0) *sync = recordings[slot];
+  unlockQueue();
+  return slot >= 0;
+}
+
+int holter_queue_depth() {
+  int depth = 0;
+  lockQueue();
+  for (int i = 0; i < QUEUE_MAX_ENTRIES; i++) {
+    if (entries[i].state == SLOT_PENDING) depth++;
+  }
+  unlockQueue();
+  return depth;
+}
+
+uint32_t holter_queue_bytesPending() {
+  uint32_t bytes = 0;
+  lockQueue();
+  for (int i = 0; i < QUEUE_MAX_ENTRIES; i++) {
+    if (entries[i].state == SLOT_PENDING) bytes += entries[i].file_size;
+  }
+  unlockQueue();
+  return bytes;
+}
+
+void holter_queue_printStatus() {
+  uint32_t now = nowUnix();
+  
+  lockQueue();
+  Serial.printf("[QUEUE] Pendientes: %d | %lu bytes (%.1f KB)\n",
+                holter_queue_depth(), (unsigned long)holter_queue_bytesPending(),
+                holter_queue_bytesPending() / 1024.0);
+  
+  for (int i = 0; i < QUEUE_MAX_ENTRIES; i++) {
+    const QueueEntry& e = entries[i];
+    if (e.state != SLOT_PENDING) continue;
+    
+    long wait = (e.next_attempt > now) ? (long)(e.next_attempt - now) : 0;
+    Serial.printf("  %s%s | %lu bytes | reintentos: %u | espera: %lds\n",
+                  e.filename, (e.flags & QUEUE_FLAG_PRIORITY) ? " [*]" : "",
+                  (unsigned long)e.file_size, e.retries, wait);
+  }
+  unlockQueue();
+}
@@ -0,0 +1,245 @@
+#include "holter_schedule.h"
+#include "holter_capture.h"
+#include "holter_queue.h"
+#include "holter_log.h"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <driver/rtc_io.h>
+#include <sys/time.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define SCHEDULE_STATE_MAGIC 0x53434844  // "SCHD"
+
+// Si la grabación y la ventana de WiFi se comieron el periodo, se salta al
+// siguiente inicio en lugar de dormir unos pocos segundos
+static const int64_t MIN_SLEEP_US = 10LL * 1000000;
+
+// Esperar a que suelten el botón antes de dormir (si no, despierta de inmediato)
+static const unsigned long BUTTON_RELEASE_TIMEOUT_MS = 5000;
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Estado que sobrevive al deep sleep (y a ESP.restart, no a un corte de energía)
+struct ScheduleState {
+  uint32_t magic;
+  ScheduleConfig config;
+  ScheduleStats stats;
+  int64_t anchor_us;           // Inicio del primer ciclo: los siguientes caen en anchor + k * period
+  int64_t expected_wake_us;    // Fin del deep sleep programado (0 = no durmió por timer)
+};
+
+RTC_DATA_ATTR static ScheduleState state = {0};
+
+static bool enabled = false;
+static WakeReason wakeReason = WAKE_POWER_ON;
+static bool wakeMeasured = false;
+
+static bool windowOpen = false;
+static unsigned long windowStart = 0;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Hora del sistema en us: el RTC la mantiene durante el deep sleep
+static int64_t nowMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void resetState() {
+  memset(&state, 0, sizeof(state));
+  state.magic = SCHEDULE_STATE_MAGIC;
+  state.config.record_sec = SCHEDULE_RECORD_SEC;
+  state.config.period_sec = SCHEDULE_PERIOD_SEC;
+  state.config.upload_every = SCHEDULE_UPLOAD_EVERY;
+  state.config.upload_bytes = SCHEDULE_UPLOAD_BYTES;
+  state.config.window_ms = SCHEDULE_WINDOW_MS;
+}
+
+// Latencia del despertar a la primera muestra, una vez por arranque. La
+// parte previa a la app (ROM + bootloader) solo se conoce en un despertar
+// por timer; en uno por botón se usa la última estimación
+static void noteFirstSample() {
+  if (wakeMeasured || wakeReason == WAKE_POWER_ON) return;
+  
+  uint32_t firstSampleUs = holter_getCaptureStats().first_sample_us;
+  if (firstSampleUs == 0) return;
+  
+  wakeMeasured = true;
+  state.stats.wake_last_ms = state.stats.boot_last_ms + firstSampleUs / 1000;
+  state.stats.wake_max_ms = max(state.stats.wake_max_ms, state.stats.wake_last_ms);
+  
+  Serial.printf("[SCHEDULE] Despertar -> primera muestra: %lu ms (boot %lu ms + app %lu ms)\n",
+                (unsigned long)state.stats.wake_last_ms, (unsigned long)state.stats.boot_last_ms,
+                (unsigned long)(firstSampleUs / 1000));
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_schedule_init(bool enable) {
+  int64_t appStartUs = esp_timer_get_time();
+  int64_t now = nowMicros();
+  
+  switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_TIMER: wakeReason = WAKE_TIMER; break;
+    case ESP_SLEEP_WAKEUP_EXT0: wakeReason = WAKE_BUTTON; break;
+    default: wakeReason = WAKE_POWER_ON; break;
+  }
+  
+  if (wakeReason != WAKE_POWER_ON) {
+    // El pin quedó en el dominio RTC: devolverlo al GPIO normal (botón de la UI)
+    rtc_gpio_deinit((gpio_num_t)SCHEDULE_BUTTON_PIN);
+  }
+  
+  if (state.magic != SCHEDULE_STATE_MAGIC) {
+    resetState();
+  }
+  
+  enabled = enable;
+  if (!enabled) return;
+  
+  if (wakeReason == WAKE_POWER_ON || now < state.anchor_us) {
+    // Arranque (o reloj corrido hacia atrás): el programa cuenta desde ahora
+    state.anchor_us = now;
+  } else if (wakeReason == WAKE_TIMER) {
+    state.stats.wakes_timer++;
+    if (state.expected_wake_us > 0 && now - appStartUs > state.expected_wake_us) {
+      state.stats.boot_last_ms = (now - appStartUs - state.expected_wake_us) / 1000;
+    }
+  } else {
+    state.stats.wakes_button++;
+  }
+  state.expected_wake_us = 0;
+  
+  const char* reason = wakeReason == WAKE_TIMER ? "timer" :
+                       wakeReason == WAKE_BUTTON ? "botón" : "encendido";
+  Serial.printf("\n[SCHEDULE] Grabaciones programadas: %lu s cada %lu s, WiFi cada %lu "
+                "grabaciones o %lu KB\n",
+                (unsigned long)state.config.record_sec, (unsigned long)state.config.period_sec,
+                (unsigned long)state.config.upload_every,
+                (unsigned long)(state.config.upload_bytes / 1024));
+  Serial.printf("[SCHEDULE] Despertar: %s | ciclo %lu | cola al dormir: %lu sesiones (%lu bytes)\n",
+                reason, (unsigned long)state.stats.cycles + 1,
+                (unsigned long)state.stats.pending_sessions,
+                (unsigned long)state.stats.pending_bytes);
+}
+
+bool holter_schedule_isEnabled() {
+  return enabled;
+}
+
+WakeReason holter_schedule_getWakeReason() {
+  return wakeReason;
+}
+
+bool holter_schedule_recordingDone() {
+  if (!enabled) return false;
+  
+  noteFirstSample();
+  return holter_getCaptureStats().captured_ms >= state.config.record_sec * 1000UL;
+}
+
+bool holter_schedule_uploadDue() {
+  if (!enabled) return false;
+  
+  // El paciente marcó un evento, o es el primer ciclo tras encender
+  if (wakeReason != WAKE_TIMER) return true;
+  
+  return state.stats.cycles_since_upload + 1 >= state.config.upload_every ||
+         holter_queue_bytesPending() >= state.config.upload_bytes;
+}
+
+void holter_schedule_openUploadWindow() {
+  if (!enabled || windowOpen) return;
+  
+  windowOpen = true;
+  windowStart = millis();
+  state.stats.upload_windows++;
+}
+
+bool holter_schedule_uploadAllowed() {
+  return !enabled || windowOpen;
+}
+
+bool holter_schedule_windowExpired() {
+  return windowOpen && millis() - windowStart >= state.config.window_ms;
+}
+
+void holter_schedule_sleep() {
+  noteFirstSample();
+  
+  // Con la cola vacía la ventana cumplió; si no, se reintenta en el próximo ciclo
+  state.stats.cycles++;
+  if (windowOpen && holter_queue_depth() == 0) {
+    state.stats.cycles_since_upload = 0;
+  } else {
+    state.stats.cycles_since_upload++;
+  }
+  state.stats.pending_sessions = holter_queue_depth();
+  state.stats.pending_bytes = holter_queue_bytesPending();
+  state.stats.awake_last_ms = millis();
+  
+  // Próximo inicio alineado al programa (un despertar por botón no lo corre)
+  int64_t now = nowMicros();
+  int64_t period = (int64_t)state.config.period_sec * 1000000;
+  int64_t next = state.anchor_us + ((now - state.anchor_us) / period + 1) * period;
+  while (next - now < MIN_SLEEP_US) {
+    next += period;
+  }
+  
+  state.expected_wake_us = next;
+  state.stats.sleep_last_ms = (next - now) / 1000;
+  
+  // Lo que quedó en el log diferido sale antes: el deep sleep lo borra
+  holter_log_flush();
+  Serial.printf("[SCHEDULE] Ciclo %lu completo: despierto %lu ms, cola %lu sesiones (%lu bytes)\n",
+                (unsigned long)state.stats.cycles, (unsigned long)state.stats.awake_last_ms,
+                (unsigned long)state.stats.pending_sessions,
+                (unsigned long)state.stats.pending_bytes);
+  Serial.printf("[SCHEDULE] Deep sleep por %lu s (o hasta el botón)\n\n",
+                (unsigned long)(state.stats.sleep_last_ms / 1000));
+  Serial.flush();
+  
+  holter_unmountSD();
+  
+  unsigned long releaseStart = millis();
+  pinMode(SCHEDULE_BUTTON_PIN, INPUT_PULLUP);
+  while (digitalRead(SCHEDULE_BUTTON_PIN) == LOW &&
+         millis() - releaseStart < BUTTON_RELEASE_TIMEOUT_MS) {
+    delay(10);
+  }
+  
+  // El desmontaje y la espera del botón ya corrieron el reloj: dormir hasta next exacto
+  esp_sleep_enable_timer_wakeup(max(next - nowMicros(), (int64_t)1000));
+  rtc_gpio_pullup_en((gpio_num_t)SCHEDULE_BUTTON_PIN);
+  rtc_gpio_pulldown_dis((gpio_num_t)SCHEDULE_BUTTON_PIN);
+  esp_sleep_enable_ext0_wakeup((gpio_num_t)SCHEDULE_BUTTON_PIN, 0);
+  esp_deep_sleep_start();
+}
+
+ScheduleConfig holter_schedule_getConfig() {
+  return state.config;
+}
+
+void holter_schedule_setConfig(const ScheduleConfig& config) {
+  if (config.record_sec == 0 || config.period_sec <= config.record_sec) {
+    Serial.println("[SCHEDULE] ERROR: El periodo debe ser mayor que la grabación");
+    return;
+  }
+  state.config = config;
+  if (state.config.upload_every == 0) state.config.upload_every = 1;
+}
+
+ScheduleStats holter_schedule_getStats() {
+  noteFirstSample();
+  return state.stats;
+}
@@ -0,0 +1,46 @@
+#include "holter_segment.h"
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+bool holter_segment_readSample(ECGSample* sample) {
+  float leadI, leadII;
+  if (!hal_adc_readLeads(&leadI, &leadII)) return false;
+  *sample = holter_format_ecgSample(leadI, leadII);
+  return true;
+}
+
+void holter_segment_append(SegmentBlock* block, const void* data, size_t len,
+                           SegmentFlushFn flush, void* context) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  while (len > 0) {
+    size_t copied = holter_format_fillBlock(block->data, block->capacity, &block->index, bytes, len);
+    bytes += copied;
+    len -= copied;
+    if (block->index >= block->capacity) {
+      flush(block, context);
+    }
+  }
+}
+
+bool holter_segment_writeHeaders(HalFile* file, uint32_t recording, uint32_t timestamp,
+                                 const SessionInfo* info) {
+  FileHeader header;
+  holter_format_initHeader(&header, recording, timestamp);
+  
+  size_t written = hal_file_write(file, &header, sizeof(FileHeader));
+  written += hal_file_write(file, info, sizeof(SessionInfo));
+  return written == sizeof(FileHeader) + sizeof(SessionInfo);
+}
+
+bool holter_segment_patchHeaders(HalFile* file, uint32_t ecgSamples, uint32_t imuSamples,
+                                 const SessionInfo* info) {
+  bool ok = hal_file_seek(file, SESSION_OFFSET_NUM_ECG) &&
+            hal_file_write(file, &ecgSamples, sizeof(uint32_t)) == sizeof(uint32_t);
+  ok = ok && hal_file_seek(file, SESSION_OFFSET_NUM_IMU) &&
+       hal_file_write(file, &imuSamples, sizeof(uint32_t)) == sizeof(uint32_t);
+  ok = ok && hal_file_seek(file, sizeof(FileHeader)) &&
+       hal_file_write(file, info, sizeof(SessionInfo)) == sizeof(SessionInfo);
+  return ok;
+}
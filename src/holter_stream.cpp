@@ -0,0 +1,279 @@
+#include "holter_stream.h"
+#include "holter_upload.h"
+#include "aws_config.h"
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#ifndef TOPIC_LIVE
+#define TOPIC_LIVE "holter/live/" DEVICE_ID
+#endif
+
+#define STREAM_RING_SAMPLES 1024          // ~4 s a 250 Hz (potencia de 2)
+#define STREAM_RING_MASK (STREAM_RING_SAMPLES - 1)
+#define STREAM_FRAME_VERSION 1
+#define STREAM_HEADER_SIZE 14
+#define STREAM_NUM_LEADS 3
+
+static const int ECG_SAMPLE_RATE_HZ = 250;
+static const int FRAME_SAMPLES = 50;                  // 200 ms por frame
+static const int MAX_BACKLOG_FRAMES = 5;              // Atraso mayor a 1 s: se descarta lo viejo
+static const int MAX_FRAMES_PER_SERVICE = 2;          // Ponerse al día sin acaparar la tarea
+static const uint32_t MAX_BYTES_PER_SEC = 4096;       // Límite de tasa (token bucket)
+static const unsigned long RECONNECT_INTERVAL_MS = 10000;
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Ring SPSC: la captura (núcleo 1) solo escribe ringHead y el servicio
+// (tarea de upload, núcleo 0) solo escribe ringTail
+static ECGSample ring[STREAM_RING_SAMPLES];
+static volatile uint32_t ringHead = 0;
+static volatile uint32_t ringTail = 0;
+
+static volatile bool enabled = false;
+static volatile bool overflow = false;     // Ring lleno: la captura descarta hasta el resync
+static volatile bool restarting = false;   // Descarte por (re)activación, no se cuenta
+static volatile bool resync = false;       // La próxima muestra fija un nuevo ancla
+
+// Índice absoluto de muestra: first_sample = anchorIndex + (tail - anchorHead)
+static uint32_t sampleIndex = 0;
+static volatile uint32_t anchorHead = 0;
+static volatile uint32_t anchorIndex = 0;
+
+// Publicación
+static uint32_t frameSeq = 0;
+static uint32_t tokens = MAX_BYTES_PER_SEC;
+static unsigned long lastRefill = 0;
+static unsigned long lastConnectAttempt = 0;
+
+// Métricas (samples_dropped lo escribe la captura, el resto el servicio)
+static StreamStats stats = {0};
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static inline uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline size_t varintSize(uint32_t value) {
+  return (value < 0x80) ? 1 : (value < 0x4000) ? 2 : 3;
+}
+
+static inline const ECGSample& ringAt(uint32_t position) {
+  return ring[position & STREAM_RING_MASK];
+}
+
+// Primer recorrido: tamaño exacto del frame (beginPublish necesita el largo)
+static size_t frameSize(uint32_t tail, int count) {
+  size_t size = STREAM_HEADER_SIZE + sizeof(ECGSample);
+  
+  for (int i = 1; i < count; i++) {
+    const ECGSample& prev = ringAt(tail + i - 1);
+    const ECGSample& cur = ringAt(tail + i);
+    size += varintSize(zigzag(cur.derivation_I - prev.derivation_I));
+    size += varintSize(zigzag(cur.derivation_II - prev.derivation_II));
+    size += varintSize(zigzag(cur.derivation_III - prev.derivation_III));
+  }
+  return size;
+}
+
+// Segundo recorrido: codifica desde el ring hacia el cliente MQTT en bloques
+// pequeños (cada write() va directo al socket TLS)
+struct FrameWriter {
+  PubSubClient* mqtt;
+  uint8_t chunk[128];
+  size_t len;
+  size_t written;
+};
+
+static void writerFlush(FrameWriter& w) {
+  if (w.len > 0) {
+    w.written += w.mqtt->write(w.chunk, w.len);
+    w.len = 0;
+  }
+}
+
+static inline void writerPut(FrameWriter& w, uint8_t value) {
+  w.chunk[w.len++] = value;
+  if (w.len == sizeof(w.chunk)) {
+    writerFlush(w);
+  }
+}
+
+static void writerU16(FrameWriter& w, uint16_t value) {
+  writerPut(w, value & 0xFF);
+  writerPut(w, value >> 8);
+}
+
+static void writerU32(FrameWriter& w, uint32_t value) {
+  writerU16(w, value & 0xFFFF);
+  writerU16(w, value >> 16);
+}
+
+static void writerVarint(FrameWriter& w, uint32_t value) {
+  while (value >= 0x80) {
+    writerPut(w, (uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  writerPut(w, (uint8_t)value);
+}
+
+// Frame (little-endian):
+//   u8 version | u8 derivaciones | u16 sample_rate | u32 seq | u32 first_sample | u16 count
+//   i16 x3 primera muestra
+//   (count-1) x 3 deltas respecto a la muestra anterior (zigzag + varint)
+// seq salta cuando se descartan frames; first_sample salta cuando se pierden muestras
+static void publishFrame(uint32_t tail, int count, uint32_t firstSample) {
+  uint32_t seq = frameSeq++;
+  size_t size = frameSize(tail, count);
+  
+  if (size > tokens) {
+    stats.frames_dropped++;
+    return;
+  }
+  
+  PubSubClient& mqtt = holter_getMQTTClient();
+  unsigned long start = micros();
+  
+  if (!mqtt.beginPublish(TOPIC_LIVE, size, false)) {
+    stats.publish_errors++;
+    stats.frames_dropped++;
+    return;
+  }
+  
+  FrameWriter w;
+  w.mqtt = &mqtt;
+  w.len = 0;
+  w.written = 0;
+  
+  writerPut(w, STREAM_FRAME_VERSION);
+  writerPut(w, STREAM_NUM_LEADS);
+  writerU16(w, ECG_SAMPLE_RATE_HZ);
+  writerU32(w, seq);
+  writerU32(w, firstSample);
+  writerU16(w, count);
+  
+  const ECGSample& first = ringAt(tail);
+  writerU16(w, (uint16_t)first.derivation_I);
+  writerU16(w, (uint16_t)first.derivation_II);
+  writerU16(w, (uint16_t)first.derivation_III);
+  
+  for (int i = 1; i < count; i++) {
+    const ECGSample& prev = ringAt(tail + i - 1);
+    const ECGSample& cur = ringAt(tail + i);
+    writerVarint(w, zigzag(cur.derivation_I - prev.derivation_I));
+    writerVarint(w, zigzag(cur.derivation_II - prev.derivation_II));
+    writerVarint(w, zigzag(cur.derivation_III - prev.derivation_III));
+  }
+  writerFlush(w);
+  
+  bool ok = mqtt.endPublish() && w.written == size;
+  
+  stats.publish_max_us = max(stats.publish_max_us, (uint32_t)(micros() - start));
+  if (ok) {
+    tokens -= size;
+    stats.frames_sent++;
+    stats.bytes_sent += size;
+  } else {
+    stats.publish_errors++;
+    stats.frames_dropped++;
+  }
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void holter_stream_setEnabled(bool enable) {
+  if (enable && !enabled) {
+    // Descartar lo que haya en el ring y fijar un ancla nueva en el servicio
+    restarting = true;
+    overflow = true;
+    Serial.println("[LIVE] Streaming activado en " + String(TOPIC_LIVE));
+  } else if (!enable && enabled) {
+    Serial.println("[LIVE] Streaming desactivado");
+  }
+  enabled = enable;
+}
+
+bool holter_stream_isEnabled() {
+  return enabled;
+}
+
+void holter_stream_pushSample(const ECGSample& sample) {
+  uint32_t index = sampleIndex++;
+  if (!enabled) return;
+  
+  uint32_t head = ringHead;
+  if (!overflow && head - ringTail >= STREAM_RING_SAMPLES) {
+    overflow = true;
+  }
+  if (overflow) {
+    if (!restarting) stats.samples_dropped++;
+    return;
+  }
+  
+  if (resync) {
+    anchorHead = head;
+    anchorIndex = index;
+    resync = false;
+  }
+  
+  ring[head & STREAM_RING_MASK] = sample;
+  __sync_synchronize();  // La muestra debe ser visible antes que el nuevo head
+  ringHead = head + 1;
+}
+
+void holter_stream_service() {
+  if (!enabled) return;
+  
+  if (overflow) {
+    // La captura dejó de escribir: vaciar el ring y retomar desde lo más nuevo
+    ringTail = ringHead;
+    resync = true;
+    restarting = false;
+    __sync_synchronize();
+    overflow = false;
+  }
+  
+  unsigned long now = millis();
+  unsigned long elapsed = min(now - lastRefill, 2000UL);
+  tokens = min(tokens + (uint32_t)(elapsed * MAX_BYTES_PER_SEC / 1000), 2 * MAX_BYTES_PER_SEC);
+  lastRefill = now;
+  
+  if (!holter_isMQTTConnected()) {
+    if (lastConnectAttempt != 0 && now - lastConnectAttempt < RECONNECT_INTERVAL_MS) return;
+    lastConnectAttempt = now;
+    if (!holter_connectMQTT()) return;
+  }
+  
+  uint32_t head = ringHead;
+  __sync_synchronize();
+  uint32_t tail = ringTail;
+  
+  // Atrasado (red lenta): descartar frames completos para seguir en vivo
+  while (head - tail > (uint32_t)(MAX_BACKLOG_FRAMES * FRAME_SAMPLES)) {
+    tail += FRAME_SAMPLES;
+    frameSeq++;
+    stats.frames_dropped++;
+  }
+  
+  int sent = 0;
+  while (head - tail >= (uint32_t)FRAME_SAMPLES && sent < MAX_FRAMES_PER_SERVICE) {
+    publishFrame(tail, FRAME_SAMPLES, anchorIndex + (tail - anchorHead));
+    tail += FRAME_SAMPLES;
+    sent++;
+  }
+  ringTail = tail;
+  
+  holter_getMQTTClient().loop();
+}
+
+StreamStats holter_stream_getStats() {
+  return stats;
+}
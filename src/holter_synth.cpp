@@ -0,0 +1,355 @@
+#include "holter_synth.h"
+#include <math.h>
+#include <string.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define TWO_PI_F 6.2831853f
+
+#define SYNTH_LF_HZ 0.1f               // Componente de Mayer del tacograma
+#define SYNTH_SLOW_WANDER_HZ 0.05f
+#define SYNTH_RR_TAU_S 10.0f           // Cambios de FC (taquicardia, caminata)
+#define SYNTH_RR_MIN_S 0.25f
+#define SYNTH_RR_MAX_S 2.0f
+#define SYNTH_FIRST_R_S 0.4f           // Deja ver la P del primer latido
+#define SYNTH_LOOKAHEAD_S 0.5f         // Latidos agendados por delante de la muestra
+#define SYNTH_WAVE_SPAN 4.0f           // Una gaussiana se corta a 4 anchos
+#define SYNTH_PVC_COUPLING 0.6f        // RR de la extrasístole / RR sinusal
+#define SYNTH_WALK_EXTRA_BPM 25.0f
+#define SYNTH_EMG_NOISE_MV 0.02f       // Ruido muscular extra al caminar
+#define SYNTH_AF_WAVE_MV 0.05f         // Ondas f
+#define SYNTH_AF_WAVE_HZ 6.0f
+#define SYNTH_ACCEL_NOISE_G 0.004f
+
+// Una onda del latido: amplitud en la derivación II, ganancia de la I
+// respecto de la II, centro y ancho en segundos desde el pico R (con RR de
+// 1 s). Las de ECGSYN: P -70°, Q -15°, R 0°, S 15°, T 100° del ciclo
+struct Wave {
+  float lead2_mv;
+  float lead1_gain;
+  float offset_s;
+  float width_s;
+  bool scaled;                 // Centro y ancho escalan con √RR (P y T)
+};
+
+static const Wave NORMAL_WAVES[] = {
+  { 0.15f, 0.60f, -0.194f, 0.040f, true },    // P
+  {-0.12f, 0.50f, -0.042f, 0.012f, false },   // Q
+  { 1.30f, 0.55f,  0.000f, 0.014f, false },   // R
+  {-0.30f, 0.30f,  0.042f, 0.014f, false },   // S
+  { 0.35f, 0.70f,  0.278f, 0.064f, true },    // T
+};
+
+// Extrasístole: sin P, QRS ancho con otro eje (negativo en I) y T opuesta
+static const Wave PVC_WAVES[] = {
+  { 1.60f, -0.40f, 0.000f, 0.040f, false },   // R
+  {-0.60f, -0.40f, 0.080f, 0.035f, false },   // S
+  {-0.50f, -0.60f, 0.320f, 0.080f, true },    // T
+};
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static void advance(float* phase, float hz, float dt) {
+  *phase += TWO_PI_F * hz * dt;
+  if (*phase >= TWO_PI_F) *phase -= TWO_PI_F;
+}
+
+static void addWaves(const Wave* waves, int count, float t, float scale, float gain,
+                     bool withP, float* leadI, float* leadII) {
+  for (int i = 0; i < count; i++) {
+    const Wave& wave = waves[i];
+    if (!withP && wave.offset_s < -0.1f) continue;
+    float center = wave.scaled ? wave.offset_s * scale : wave.offset_s;
+    float width = wave.scaled ? wave.width_s * scale : wave.width_s;
+    float x = (t - center) / width;
+    if (x < -SYNTH_WAVE_SPAN || x > SYNTH_WAVE_SPAN) continue;
+    
+    float v = gain * wave.lead2_mv * expf(-0.5f * x * x);
+    *leadII += v;
+    *leadI += v * wave.lead1_gain;
+  }
+}
+
+// xorshift64* sembrado con splitmix64 (la semilla 0 también sirve)
+uint32_t EcgSynth::random() {
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return (uint32_t)((rngState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+float EcgSynth::uniform() {
+  return (random() >> 8) * (1.0f / 16777216.0f);
+}
+
+// Irwin-Hall de 4 uniformes: sin log/sqrt por muestra y con colas cortadas
+// en ±3.5σ (no hay picos de ruido imposibles)
+float EcgSynth::gaussian() {
+  return (uniform() + uniform() + uniform() + uniform() - 2.0f) * 1.7320508f;
+}
+
+bool EcgSynth::episodeActive(uint8_t type, float t, float* param) const {
+  for (int i = 0; i < config.episode_count; i++) {
+    const SynthEpisode& episode = config.episodes[i];
+    if (episode.type == type && t >= episode.start_s &&
+        t < (float)episode.start_s + episode.duration_s) {
+      if (param != nullptr) *param = episode.param;
+      return true;
+    }
+  }
+  return false;
+}
+
+// RR del próximo latido sinusal (o de FA) a t segundos. LF y HF se toman con
+// la fase de la muestra actual: el latido está a menos de SYNTH_LOOKAHEAD_S
+float EcgSynth::nextRR(float t) {
+  float bpm = config.heart_rate_bpm;
+  float param;
+  if (episodeActive(SYNTH_TACHY, t, &param) && param > bpm) bpm = param;
+  if (episodeActive(SYNTH_WALK, t, nullptr)) bpm += SYNTH_WALK_EXTRA_BPM;
+  
+  float target = 60.0f / bpm;
+  float step = rrMean / SYNTH_RR_TAU_S;
+  rrMean += (target - rrMean) * (step < 1.0f ? step : 1.0f);
+  
+  float rr;
+  if (episodeActive(SYNTH_AF, t, nullptr)) {
+    rr = rrMean * (0.7f + 0.6f * uniform());
+  } else {
+    // La variabilidad baja con la FC
+    float sdnn = config.hrv_sdnn_ms / 1000.0f * rrMean * config.heart_rate_bpm / 60.0f;
+    float noise = 0.3f * sdnn;
+    float rest = 2.0f * (sdnn * sdnn - noise * noise);
+    float ratio = config.lf_hf_ratio;
+    float lf = sqrtf(rest * ratio / (1.0f + ratio));
+    float hf = sqrtf(rest / (1.0f + ratio));
+    rr = rrMean + lf * sinf(lfPhase) + hf * sinf(hfPhase) + noise * gaussian();
+  }
+  
+  if (rr < SYNTH_RR_MIN_S) rr = SYNTH_RR_MIN_S;
+  if (rr > SYNTH_RR_MAX_S) rr = SYNTH_RR_MAX_S;
+  return rr;
+}
+
+// Agenda un latido después del último de la ventana
+void EcgSynth::scheduleBeat() {
+  Beat beat;
+  beat.type = SYNTH_BEAT_NORMAL;
+  float rr;
+  
+  if (beatCount == 0) {
+    rr = rrMean;
+    beat.r = (int32_t)(SYNTH_FIRST_R_S * config.sample_rate);
+  } else {
+    const Beat& last = window[beatCount - 1];
+    float t = (float)last.r / config.sample_rate;
+    float fraction;
+    
+    if (pendingCompensation) {
+      // Pausa compensadora: el sinusal siguiente cae a 2 RR del anterior
+      rr = (2.0f - SYNTH_PVC_COUPLING) * rrMean;
+      pendingCompensation = false;
+    } else {
+      rr = nextRR(t);
+      if (episodeActive(SYNTH_PVC, t, &fraction) && uniform() < fraction) {
+        rr *= SYNTH_PVC_COUPLING;
+        beat.type = SYNTH_BEAT_PVC;
+        pendingCompensation = true;
+      }
+    }
+    
+    float samples = rr * config.sample_rate + rrFraction;
+    int32_t steps = (int32_t)(samples + 0.5f);
+    rrFraction = samples - steps;
+    beat.r = last.r + steps;
+  }
+  
+  beat.scale = sqrtf(beat.type == SYNTH_BEAT_PVC ? rrMean : rr);
+  beat.gain = config.amplitude * (1.0f + 0.03f * gaussian()) * (1.0f + 0.05f * sinf(hfPhase));
+  beat.withP = !episodeActive(SYNTH_AF, (float)beat.r / config.sample_rate, nullptr);
+  
+  if (beatCount == BEAT_WINDOW) {
+    memmove(window, window + 1, (BEAT_WINDOW - 1) * sizeof(Beat));
+    beatCount--;
+  }
+  window[beatCount++] = beat;
+}
+
+void EcgSynth::beatWaves(const Beat& beat, int32_t n, float* leadI, float* leadII) const {
+  float t = (float)(n - beat.r) * dt;
+  if (t < -0.5f || t > 1.0f) return;
+  
+  if (beat.type == SYNTH_BEAT_PVC) {
+    addWaves(PVC_WAVES, sizeof(PVC_WAVES) / sizeof(Wave), t, beat.scale, beat.gain,
+             false, leadI, leadII);
+  } else {
+    addWaves(NORMAL_WAVES, sizeof(NORMAL_WAVES) / sizeof(Wave), t, beat.scale, beat.gain,
+             beat.withP, leadI, leadII);
+  }
+}
+
+// Pasos de la caminata: un apoyo por ciclo de stepPhase. Cada apoyo mueve
+// los electrodos (artefacto en mV) y da un golpe vertical en el acelerómetro
+// @param accel nullptr si no toca muestra del IMU
+void EcgSynth::walkStep(float t, float* artifact, float* accel) {
+  float spm = 0;
+  bool walking = episodeActive(SYNTH_WALK, t, &spm) && spm > 0;
+  
+  if (walking) {
+    stepPhase += spm / 60.0f * dt;
+    if (stepPhase >= 1.0f) {
+      stepPhase -= 1.0f;
+      stepAge = 0;
+      stepGain = 0.5f + uniform();
+      leftStep = !leftStep;
+    }
+  }
+  
+  *artifact = 0;
+  if (stepAge < 0.6f) {
+    *artifact = config.motion_mv * stepGain * expf(-stepAge / 0.15f) *
+                sinf(TWO_PI_F * 2.5f * stepAge);
+  }
+  
+  if (accel != nullptr) {
+    // De pie y quieto: solo gravedad y respiración
+    accel[0] = 0;
+    accel[1] = 1.0f;
+    accel[2] = 0.01f * sinf(hfPhase);
+    if (walking) {
+      float p = TWO_PI_F * stepPhase;
+      accel[0] += 0.1f * sinf(0.5f * p + (leftStep ? 3.1415927f : 0.0f));   // Balanceo por zancada
+      accel[1] += 0.12f * sinf(p);
+      accel[2] += 0.08f * sinf(p + 0.5f);
+    }
+    if (stepAge < 0.3f) {
+      accel[1] += 0.35f * stepGain * expf(-stepAge / 0.05f) * cosf(TWO_PI_F * 8.0f * stepAge);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      accel[axis] += SYNTH_ACCEL_NOISE_G * gaussian();
+    }
+  }
+  
+  stepAge += dt;
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+void EcgSynth::begin(const SynthConfig& newConfig) {
+  config = newConfig;
+  if (config.sample_rate == 0) config.sample_rate = SESSION_ECG_RATE_HZ;
+  if (config.heart_rate_bpm < 20.0f) config.heart_rate_bpm = 20.0f;
+  
+  uint64_t z = config.seed + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  rngState = (z ^ (z >> 31)) | 1;
+  
+  dt = 1.0f / config.sample_rate;
+  imuDivider = config.sample_rate / SYNTH_IMU_RATE_HZ;
+  if (imuDivider == 0) imuDivider = 1;
+  lookahead = (int32_t)(SYNTH_LOOKAHEAD_S * config.sample_rate);
+  
+  sampleIndex = 0;
+  rrMean = 60.0f / config.heart_rate_bpm;
+  rrFraction = 0;
+  lfPhase = TWO_PI_F * uniform();
+  hfPhase = TWO_PI_F * uniform();
+  slowPhase = TWO_PI_F * uniform();
+  mainsPhase = TWO_PI_F * uniform();
+  fibPhase = 0;
+  stepPhase = 0;
+  stepAge = 1.0f;
+  stepGain = 1.0f;
+  leftStep = false;
+  pendingCompensation = false;
+  beatCount = 0;
+  normalBeats = 0;
+  pvcBeats = 0;
+}
+
+bool EcgSynth::addEpisode(SynthConfig* config, SynthEpisodeType type,
+                          uint32_t startS, uint32_t durationS, float param) {
+  if (config->episode_count >= SYNTH_MAX_EPISODES) return false;
+  
+  SynthEpisode& episode = config->episodes[config->episode_count++];
+  episode.type = type;
+  episode.start_s = startS;
+  episode.duration_s = durationS;
+  episode.param = param;
+  return true;
+}
+
+void EcgSynth::next(SynthSample* out) {
+  int32_t n = (int32_t)sampleIndex;
+  float t = (float)sampleIndex * dt;
+  
+  while (beatCount == 0 || window[beatCount - 1].r < n + lookahead) {
+    scheduleBeat();
+  }
+  
+  float leadI = 0;
+  float leadII = 0;
+  out->beat = SYNTH_BEAT_NONE;
+  for (int i = 0; i < beatCount; i++) {
+    beatWaves(window[i], n, &leadI, &leadII);
+    if (window[i].r == n) {
+      out->beat = window[i].type;
+      if (window[i].type == SYNTH_BEAT_PVC) pvcBeats++; else normalBeats++;
+    }
+  }
+  
+  if (episodeActive(SYNTH_AF, t, nullptr)) {
+    float f = SYNTH_AF_WAVE_MV * config.amplitude *
+              (sinf(fibPhase) + 0.4f * sinf(1.7f * fibPhase + 1.0f));
+    leadII += f;
+    leadI += 0.4f * f;
+  }
+  
+  float wander = config.wander_mv * (0.7f * sinf(hfPhase) + 0.5f * sinf(slowPhase));
+  leadII += wander;
+  leadI += 0.6f * wander;
+  
+  float hum = config.mains_mv * sinf(mainsPhase);
+  leadII += hum;
+  leadI += 0.8f * hum;
+  
+  out->has_imu = sampleIndex % imuDivider == 0;
+  float artifact;
+  walkStep(t, &artifact, out->has_imu ? out->accel_g : nullptr);
+  leadII += artifact;
+  leadI -= 0.6f * artifact;
+  
+  float noise = config.noise_mv + (stepAge < 1.0f ? SYNTH_EMG_NOISE_MV : 0.0f);
+  out->lead_I_mV = leadI + noise * gaussian();
+  out->lead_II_mV = leadII + noise * gaussian();
+  
+  advance(&lfPhase, SYNTH_LF_HZ, dt);
+  advance(&hfPhase, config.respiration_hz, dt);
+  advance(&slowPhase, SYNTH_SLOW_WANDER_HZ, dt);
+  advance(&mainsPhase, config.mains_hz, dt);
+  advance(&fibPhase, SYNTH_AF_WAVE_HZ + 0.5f * sinf(slowPhase), dt);
+  sampleIndex++;
+}
+
+IMUSample holter_synth_imuSample(const float accel_g[3]) {
+  int16_t counts[3];
+  for (int axis = 0; axis < 3; axis++) {
+    float value = accel_g[axis] * SYNTH_ACCEL_COUNTS_PER_G;
+    if (value > 32767.0f) value = 32767.0f;
+    if (value < -32768.0f) value = -32768.0f;
+    counts[axis] = (int16_t)lrintf(value);
+  }
+  
+  IMUSample sample;
+  sample.accel_x = counts[0];
+  sample.accel_y = counts[1];
+  sample.accel_z = counts[2];
+  return sample;
+}
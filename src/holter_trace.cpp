@@ -0,0 +1,137 @@
+#include "holter_trace.h"
+
+#if HOLTER_TRACE
+
+#include <atomic>
+#include <esp_timer.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+#define TRACE_RING_MASK (TRACE_RING_EVENTS - 1)
+
+// Espera al pausar: que terminen los eventos que ya reservaron su lugar
+static const uint32_t TRACE_SETTLE_US = 50;
+
+// ============================================================================
+// VARIABLES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static TraceEvent ring[TRACE_RING_EVENTS];
+static std::atomic<uint32_t> head(0);          // Eventos registrados desde el arranque
+static std::atomic<bool> recording(true);
+
+// Tablas que crecen solo al registrar un nombre o una tarea nueva: la
+// lectura en el camino caliente no toma el lock
+static portMUX_TYPE tableMux = portMUX_INITIALIZER_UNLOCKED;
+static const char* names[TRACE_MAX_NAMES];
+static std::atomic<uint32_t> nameCount(0);
+static TaskHandle_t tasks[TRACE_MAX_TASKS];
+static char taskNames[TRACE_MAX_TASKS][configMAX_TASK_NAME_LEN];
+static std::atomic<uint32_t> taskCount(0);
+
+static uint32_t dumps = 0;
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+// Índice de la tarea actual. Si la tabla se llena, las demás comparten el último
+static uint8_t taskIndex() {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  uint32_t count = taskCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; i++) {
+    if (tasks[i] == self) return i;
+  }
+  
+  portENTER_CRITICAL(&tableMux);
+  count = taskCount.load(std::memory_order_relaxed);
+  uint32_t index = count;
+  if (count < TRACE_MAX_TASKS) {
+    tasks[count] = self;
+    strncpy(taskNames[count], pcTaskGetTaskName(self), configMAX_TASK_NAME_LEN - 1);
+    taskCount.store(count + 1, std::memory_order_release);
+  } else {
+    index = TRACE_MAX_TASKS - 1;
+  }
+  portEXIT_CRITICAL(&tableMux);
+  return index;
+}
+
+// ============================================================================
+// IMPLEMENTACIÓN DE INTERFACE PÚBLICA
+// ============================================================================
+
+uint8_t holter_trace_name(const char* name) {
+  portENTER_CRITICAL(&tableMux);
+  uint32_t count = nameCount.load(std::memory_order_relaxed);
+  uint32_t index = 0;
+  while (index < count && strcmp(names[index], name) != 0) {
+    index++;
+  }
+  if (index == count) {
+    if (count < TRACE_MAX_NAMES) {
+      names[count] = name;
+      nameCount.store(count + 1, std::memory_order_release);
+    } else {
+      index = TRACE_MAX_NAMES - 1;
+    }
+  }
+  portEXIT_CRITICAL(&tableMux);
+  return index;
+}
+
+void holter_trace_record(uint8_t name, char phase) {
+  if (!recording.load(std::memory_order_relaxed)) return;
+  
+  TraceEvent& event = ring[head.fetch_add(1, std::memory_order_relaxed) & TRACE_RING_MASK];
+  event.timestamp_us = (uint32_t)esp_timer_get_time();
+  event.name = name;
+  event.phase = phase;
+  event.task = taskIndex();
+  event.core = xPortGetCoreID();
+}
+
+uint32_t holter_trace_dump(Print& out, const char* label) {
+  recording.store(false, std::memory_order_relaxed);
+  delayMicroseconds(TRACE_SETTLE_US);
+  
+  uint32_t end = head.load(std::memory_order_acquire);
+  uint32_t start = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+  
+  // Texto: entra igual en un archivo de la SD que mezclado con la consola
+  out.printf("# holter-trace v1 %s\n", label);
+  out.printf("# events %lu of %lu\n", (unsigned long)(end - start), (unsigned long)end);
+  
+  uint32_t count = taskCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; i++) {
+    out.printf("T %lu %s\n", (unsigned long)i, taskNames[i]);
+  }
+  count = nameCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; i++) {
+    out.printf("N %lu %s\n", (unsigned long)i, names[i]);
+  }
+  
+  for (uint32_t i = start; i != end; i++) {
+    const TraceEvent& event = ring[i & TRACE_RING_MASK];
+    out.printf("E %lu %c %u %u %u\n", (unsigned long)event.timestamp_us, event.phase,
+               event.name, event.task, event.core);
+  }
+  out.println("# holter-trace end");
+  
+  dumps++;
+  recording.store(true, std::memory_order_relaxed);
+  return end - start;
+}
+
+TraceStats holter_trace_getStats() {
+  TraceStats stats;
+  stats.events = head.load(std::memory_order_relaxed);
+  stats.names = nameCount.load(std::memory_order_relaxed);
+  stats.tasks = taskCount.load(std::memory_order_relaxed);
+  stats.dumps = dumps;
+  return stats;
+}
+
+#endif // HOLTER_TRACE
@@ -1,8 +1,63 @@
 #include "holter_upload.h"
 #include "aws_config.h"
 #include "holter_capture.h"
+#include "holter_queue.h"
+#include "holter_catalog.h"
+#include "holter_deflate.h"
+#include "holter_cbor.h"
+#include "holter_log.h"
+#include "holter_trace.h"
+#include "holter_metrics.h"
 #include <ArduinoJson.h>
 #include <time.h>
+#include <new>
+#include <esp_sntp.h>
+#include <sys/select.h>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+// Comprimir las sesiones (zlib, ventana de 2 KB) mientras se suben a S3.
+// Conviene cuando el uplink es lento frente al costo de CPU: medirlo con
+// tools/deflate_bench.cpp sobre sesiones reales antes de activarlo.
+// Con DEVICE_KEY_HEX las muestras ya van cifradas y no se comprimen
+static const bool UPLOAD_COMPRESSION = false;
+
+// Formato de las solicitudes de URL por MQTT. CBOR (protocolo v2) ocupa menos
+// y se arma/parsea sin memoria dinámica; JSON (v1) queda para Lambdas que aún
+// no lo entienden. Las respuestas se aceptan en ambos formatos siempre
+static const bool CONTROL_CBOR = true;
+
+// Snapshot de holter_metrics.h (CBOR) que se publica en cada conexión
+#ifndef TOPIC_TELEMETRY
+#define TOPIC_TELEMETRY "holter/telemetry/" DEVICE_ID
+#endif
+
+// Protocolo de control v2: mapas CBOR con claves enteras (ver README)
+#define CONTROL_VERSION 2
+#define CONTROL_BUFFER_SIZE 1536
+
+enum ControlKey {
+  CK_VERSION = 0,
+  CK_TYPE = 1,
+  CK_DEVICE_ID = 2,
+  CK_REQUEST_ID = 3,
+  CK_SESSIONS = 4,                   // [[session_id, file_size], ...]
+  CK_ENCODING = 5,
+  CK_UPTIME = 6,                     // Segundos desde el arranque
+  CK_STATUS = 7,                     // 0 = OK
+  CK_EXPIRES_IN = 8,
+  CK_URLS = 9,                       // {session_id: url}
+  CK_MESSAGE = 10,
+  CK_SYNC = 11                       // [recording_id, high_water, segments_sealed]
+};
+
+enum ControlType {
+  CT_URL_REQUEST = 1,
+  CT_URL_RESPONSE = 2,
+  CT_STATUS = 3                      // Aviso/error de la Lambda sobre una solicitud
+};
 
 // ============================================================================
 // VARIABLES INTERNAS (PRIVADAS)
@@ -11,13 +66,56 @@
 static WiFiClientSecure wifiClient;
 static PubSubClient mqttClient(wifiClient);
 
+// Conexión HTTPS persistente a S3 (keep-alive entre PUTs consecutivos)
+static WiFiClientSecure s3Client;
+static HTTPClient s3Http;
+static String s3Host = "";
+
+// Throughput de subida
+static UploadStats uploadStats = {0};
+
+// Estadísticas de handshakes TLS (en RTC: se acumulan entre ciclos de deep sleep)
+RTC_DATA_ATTR static TLSStats tlsStats = {0};
+
 // Estado
 static UploadState currentState = UPLOAD_IDLE;
 static String currentFilename = "";
 static String uploadURL = "";
-static bool urlReceived = false;
 static String lastError = "";
 static String currentSessionID = "";
+static uint32_t currentFileSize = 0;
+
+// Drenado de la cola
+static const int MAX_UPLOADS_PER_CONNECTION = 8;
+static const int MAX_CONSECUTIVE_FAILURES = 2;
+static int uploadsThisConnection = 0;
+static int consecutiveFailures = 0;
+static bool drainHadFailure = false;
+
+// URLs prefirmadas: se piden por lotes (varias sesiones en una sola solicitud
+// MQTT) y se guardan con su vencimiento para subir una sesión tras otra
+#define MAX_URL_BATCH 6
+#define MQTT_BUFFER_SIZE 10240
+static const unsigned long URL_EXPIRY_MARGIN_MS = 60000;
+
+struct CachedURL {
+  char session_id[QUEUE_FILENAME_LEN];
+  String url;
+  unsigned long expires_at;          // millis() de vencimiento (con margen)
+  bool valid;
+};
+
+static CachedURL urlCache[MAX_URL_BATCH];
+
+// Solicitud en curso: las respuestas se correlacionan por request_id
+static uint32_t nextRequestId = 0;
+static uint32_t pendingRequestId = 0;          // 0 = ninguna
+static String pendingFirstSession = "";        // Para respuestas v1 sin "urls"
+static bool urlRequestRejected = false;        // La Lambda respondió con error o la solicitud no salió
+
+// Tamaños y tiempos de los mensajes de control
+static ControlStats controlStats = {0};
+static uint8_t controlBuffer[CONTROL_BUFFER_SIZE];
 
 // Timing
 static unsigned long uploadStartTime = 0;
@@ -27,101 +125,422 @@ static const unsigned long UPLOAD_TIMEOUT_MS = 60000;
 static const char* ntpServer = "pool.ntp.org";
 static const long gmtOffset_sec = -5 * 3600;
 static const int daylightOffset_sec = 0;
+static const time_t NTP_RESYNC_S = 6 * 3600;        // Con hora reciente no se espera al NTP
+static const time_t MIN_VALID_TIME = 1700000000;    // Antes de esto el RTC no tiene hora
+
+// Conexión rápida: último AP y lease guardados en RTC (sobreviven al deep
+// sleep y a ESP.restart, no a un corte de energía)
+#define WIFI_CACHE_MAGIC 0x57494649  // "WIFI"
+static const unsigned long FAST_CONNECT_TIMEOUT_MS = 3000;
+static const unsigned long FULL_CONNECT_TIMEOUT_MS = 10000;
+static const time_t LEASE_REUSE_MAX_S = 3600;       // Reusar la IP solo con un lease reciente
+
+struct WiFiCache {
+  uint32_t magic;
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  time_t lease_time;                 // Hora Unix del último DHCP (0 = desconocida)
+};
+
+RTC_DATA_ATTR static WiFiCache wifiCache = {0};
+RTC_DATA_ATTR static time_t lastNtpSync = 0;
+RTC_DATA_ATTR static ConnectStats connectStats = {0};
+
+// Inicio del drenado → primer publish MQTT
+static unsigned long drainStartTime = 0;
+static bool firstPublishPending = false;
 
 // ============================================================================
 // FUNCIONES INTERNAS (PRIVADAS)
 // ============================================================================
 
+static void onTimeSync(struct timeval* tv) {
+  lastNtpSync = tv->tv_sec;
+}
+
+// Solo bloquea esperando al NTP si el RTC no tiene hora válida. Con hora
+// válida pero vieja, el SNTP corrige en segundo plano
 static void syncTime() {
-  Serial.println("[NTP] Sincronizando hora...");
+  time_t now = time(nullptr);
+  bool timeValid = now > MIN_VALID_TIME;
+  
+  if (timeValid && lastNtpSync > 0 && now - lastNtpSync < NTP_RESYNC_S) {
+    connectStats.ntp_skipped++;
+    LOG_I("NTP", "Hora del RTC válida (sincronizada hace %lus) - sin NTP",
+          (unsigned long)(now - lastNtpSync));
+    return;
+  }
+  
+  sntp_set_time_sync_notification_cb(onTimeSync);
   configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
   
+  if (timeValid) {
+    LOG_I("NTP", "Resincronizando en segundo plano");
+    return;
+  }
+  
+  LOG_I("NTP", "Sincronizando hora...");
+  connectStats.ntp_syncs++;
+  
   struct tm timeinfo;
   if(!getLocalTime(&timeinfo)){
-    Serial.println("[WARNING] No se pudo obtener hora NTP");
+    LOG_W("WARNING", "No se pudo obtener hora NTP");
     return;
   }
+  lastNtpSync = time(nullptr);
   
-  Serial.printf("[NTP] Hora sincronizada: %02d/%02d/%04d %02d:%02d:%02d\n",
-                timeinfo.tm_mday, timeinfo.tm_mon + 1, timeinfo.tm_year + 1900,
-                timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+  LOG_I("NTP", "Hora sincronizada: %02d/%02d/%04d %02d:%02d:%02d",
+        timeinfo.tm_mday, timeinfo.tm_mon + 1, timeinfo.tm_year + 1900,
+        timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
 }
 
-static void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  Serial.println("\n[MQTT] ========== MENSAJE RECIBIDO ==========");
-  Serial.println("[MQTT] Topic: " + String(topic));
-  Serial.print("[MQTT] Payload: ");
-  for (unsigned int i = 0; i < length; i++) {
-    Serial.print((char)payload[i]);
+static bool waitForWiFi(unsigned long timeoutMs) {
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs) {
+    delay(10);
+  }
+  return WiFi.status() == WL_CONNECTED;
+}
+
+static bool leaseIsFresh() {
+  time_t now = time(nullptr);
+  return wifiCache.ip != 0 && wifiCache.lease_time > MIN_VALID_TIME &&
+         now > MIN_VALID_TIME && now - wifiCache.lease_time < LEASE_REUSE_MAX_S;
+}
+
+// La URL llega como puntero + largo: en CBOR apunta al payload sin terminar en '\0'
+static void cacheURL(const char* sessionID, const char* url, size_t urlLength,
+                     unsigned long expiresInMs) {
+  int slot = -1;
+  for (int i = 0; i < MAX_URL_BATCH; i++) {
+    if (urlCache[i].valid && strcmp(urlCache[i].session_id, sessionID) == 0) {
+      slot = i;
+      break;
+    }
+    if (slot < 0 && (!urlCache[i].valid || (long)(millis() - urlCache[i].expires_at) >= 0)) {
+      slot = i;
+    }
+  }
+  if (slot < 0) {
+    LOG_W("WARNING", "Caché de URLs llena, se descarta URL de %s", sessionID);
+    return;
   }
-  Serial.println();
   
-  DynamicJsonDocument doc(1024);
+  strncpy(urlCache[slot].session_id, sessionID, QUEUE_FILENAME_LEN - 1);
+  urlCache[slot].session_id[QUEUE_FILENAME_LEN - 1] = '\0';
+  urlCache[slot].url = "";
+  urlCache[slot].url.concat(url, urlLength);
+  urlCache[slot].expires_at = millis() + expiresInMs;
+  urlCache[slot].valid = true;
+}
+
+static bool findCachedURL(const String& sessionID, String* url) {
+  for (int i = 0; i < MAX_URL_BATCH; i++) {
+    CachedURL& entry = urlCache[i];
+    if (!entry.valid || sessionID != entry.session_id) continue;
+    
+    if ((long)(millis() - entry.expires_at) >= 0) {
+      entry.valid = false;
+      entry.url = "";
+      return false;
+    }
+    *url = entry.url;
+    return true;
+  }
+  return false;
+}
+
+static void dropCachedURL(const String& sessionID) {
+  for (int i = 0; i < MAX_URL_BATCH; i++) {
+    if (urlCache[i].valid && sessionID == urlCache[i].session_id) {
+      urlCache[i].valid = false;
+      urlCache[i].url = "";
+    }
+  }
+}
+
+static String sessionIDFromFilename(const String& filename) {
+  int lastSlash = filename.lastIndexOf('/');
+  int lastDot = filename.lastIndexOf('.');
+  return filename.substring(lastSlash + 1, lastDot);
+}
+
+// Verifica que la respuesta corresponda a la solicitud pendiente
+static bool acceptResponse(bool hasRequestId, uint32_t requestId) {
+  if (hasRequestId) {
+    if (requestId != pendingRequestId) {
+      LOG_I("MQTT", "Respuesta ignorada: request_id %lu no está pendiente",
+            (unsigned long)requestId);
+      return false;
+    }
+  } else if (pendingRequestId == 0) {
+    LOG_I("MQTT", "Respuesta ignorada: no hay solicitud pendiente");
+    return false;
+  }
+  return true;
+}
+
+// La Lambda no pudo generar las URLs: se falla la sesión sin esperar el timeout
+static void rejectRequest(const String& reason) {
+  LOG_E("ERROR", "Solicitud %lu rechazada: %s",
+        (unsigned long)pendingRequestId, reason.c_str());
+  lastError = "URL request rejected: " + reason;
+  pendingRequestId = 0;
+  urlRequestRejected = true;
+}
+
+static unsigned long urlLifetimeMs(unsigned long expiresIn) {
+  unsigned long expiresInMs = expiresIn * 1000UL;
+  return (expiresInMs > URL_EXPIRY_MARGIN_MS) ? expiresInMs - URL_EXPIRY_MARGIN_MS : 0;
+}
+
+// Respuesta por lotes: {"request_id": N, "expires_in": S, "urls": {"<session_id>": "<url>", ...}}
+// Respuesta v1 (Lambda anterior): {"upload_url": "<url>"} para la primera sesión pedida
+// Devuelve las URLs guardadas en la caché, o -1 si el mensaje no se pudo parsear
+static int handleURLResponseJson(byte* payload, unsigned int length) {
+  DynamicJsonDocument doc(2048);
   DeserializationError error = deserializeJson(doc, payload, length);
   
   if (error) {
-    Serial.println("[ERROR] JSON parsing failed: " + String(error.c_str()));
-    lastError = "JSON parse error";
-    return;
+    LOG_E("ERROR", "JSON parsing failed: %s", error.c_str());
+    return -1;
   }
   
-  Serial.println("[DEBUG] JSON parseado correctamente");
+  if (!acceptResponse(doc.containsKey("request_id"), doc["request_id"] | 0UL)) {
+    return 0;
+  }
+  
+  const char* status = doc["status"] | "success";
+  if (strcmp(status, "success") != 0) {
+    rejectRequest(doc["message"] | status);
+    return 0;
+  }
+  
+  unsigned long expiresInMs = urlLifetimeMs(doc["expires_in"] | 3600UL);
+  
+  int received = 0;
+  if (doc.containsKey("urls")) {
+    for (JsonPair kv : doc["urls"].as<JsonObject>()) {
+      const char* url = kv.value() | "";
+      cacheURL(kv.key().c_str(), url, strlen(url), expiresInMs);
+      received++;
+    }
+  } else if (doc.containsKey("upload_url")) {
+    const char* url = doc["upload_url"] | "";
+    cacheURL(pendingFirstSession.c_str(), url, strlen(url), expiresInMs);
+    received++;
+  }
+  
+  if (received == 0) {
+    LOG_W("WARNING", "JSON no contiene 'urls' ni 'upload_url'");
+    serializeJsonPretty(doc, Serial);
+    Serial.println();
+    lastError = "No upload_url in response";
+    return 0;
+  }
   
-  if (String(topic) == TOPIC_RESPONSE) {
-    Serial.println("[DEBUG] Topic coincide con TOPIC_RESPONSE");
-    if (doc.containsKey("upload_url")) {
-      uploadURL = doc["upload_url"].as<String>();
-      urlReceived = true;
-      Serial.println("[MQTT] URL recibida: " + uploadURL.substring(0, 50) + "...");
+  pendingRequestId = 0;
+  return received;
+}
+
+// Respuesta v2: {0: 2, 1: CT_URL_RESPONSE, 3: request_id, 7: status, 8: expires_in,
+//                9: {"<session_id>": "<url>", ...}, 10: mensaje}
+// Se recorre en el lugar sobre el buffer de PubSubClient; solo se copian las
+// URLs al guardarlas. Las claves desconocidas (versiones futuras) se saltan
+static int handleURLResponseCbor(const uint8_t* payload, size_t length) {
+  CborReader reader(payload, length);
+  uint32_t pairs;
+  if (!reader.readMap(&pairs)) return -1;
+  
+  uint32_t version = 0;
+  uint32_t type = CT_URL_RESPONSE;
+  uint32_t requestId = 0;
+  uint32_t status = 0;
+  uint32_t expiresIn = 3600;
+  bool hasRequestId = false;
+  const char* message = "";
+  size_t messageLength = 0;
+  CborReader urls = reader;
+  bool hasURLs = false;
+  
+  for (uint32_t i = 0; i < pairs && reader.ok(); i++) {
+    uint32_t key;
+    if (reader.peekType() != CBOR_UINT) {
+      reader.skip();
+      reader.skip();
+      continue;
+    }
+    reader.readUint(&key);
+    
+    switch (key) {
+      case CK_VERSION: reader.readUint(&version); break;
+      case CK_TYPE: reader.readUint(&type); break;
+      case CK_REQUEST_ID: hasRequestId = reader.readUint(&requestId); break;
+      case CK_STATUS: reader.readUint(&status); break;
+      case CK_EXPIRES_IN: reader.readUint(&expiresIn); break;
+      case CK_MESSAGE: reader.readText(&message, &messageLength); break;
+      case CK_URLS:
+        urls = reader;
+        hasURLs = true;
+        reader.skip();
+        break;
+      default: reader.skip(); break;
+    }
+  }
+  
+  if (!reader.ok()) return -1;
+  
+  if (version > CONTROL_VERSION) {
+    LOG_I("MQTT", "Respuesta v%lu (se esperaba v%d): se ignoran campos nuevos",
+          (unsigned long)version, CONTROL_VERSION);
+  }
+  
+  if (!acceptResponse(hasRequestId, requestId)) return 0;
+  
+  if (status != 0 || type == CT_STATUS) {
+    String reason = "status " + String((unsigned long)status);
+    if (messageLength > 0) {
+      reason += ": ";
+      reason.concat(message, messageLength);
+    }
+    if (status != 0) {
+      rejectRequest(reason);
     } else {
-      Serial.println("[WARNING] JSON no contiene 'upload_url'");
-      serializeJsonPretty(doc, Serial);
-      Serial.println();
-      lastError = "No upload_url in response";
+      LOG_I("MQTT", "Aviso de la Lambda: %s", reason.c_str());
     }
+    return 0;
+  }
+  
+  unsigned long expiresInMs = urlLifetimeMs(expiresIn);
+  
+  int received = 0;
+  uint32_t count = 0;
+  if (hasURLs && !urls.readMap(&count)) return -1;
+  
+  for (uint32_t i = 0; i < count; i++) {
+    const char* id;
+    const char* url;
+    size_t idLength;
+    size_t urlLength;
+    if (!urls.readText(&id, &idLength) || !urls.readText(&url, &urlLength)) return -1;
+    if (idLength >= QUEUE_FILENAME_LEN) continue;
+    
+    char sessionID[QUEUE_FILENAME_LEN];
+    memcpy(sessionID, id, idLength);
+    sessionID[idLength] = '\0';
+    cacheURL(sessionID, url, urlLength, expiresInMs);
+    received++;
+  }
+  
+  if (received == 0) {
+    LOG_W("WARNING", "Respuesta CBOR sin URLs");
+    lastError = "No upload_url in response";
+    return 0;
+  }
+  
+  pendingRequestId = 0;
+  return received;
+}
+
+static void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  if (strcmp(topic, TOPIC_RESPONSE) != 0) {
+    LOG_W("WARNING", "Mensaje en topic inesperado: %s", topic);
+    return;
+  }
+  
+  // JSON (v1) siempre empieza con '{'; CBOR (v2) con la cabecera de un mapa
+  bool isJson = length > 0 && payload[0] == '{';
+  
+  unsigned long parseStart = micros();
+  int received = isJson ? handleURLResponseJson(payload, length)
+                        : handleURLResponseCbor(payload, length);
+  uint32_t parseUs = micros() - parseStart;
+  
+  if (isJson) {
+    controlStats.responses_json++;
   } else {
-    Serial.println("[WARNING] Topic no coincide. Esperado: " + String(TOPIC_RESPONSE));
+    controlStats.responses_cbor++;
   }
-  Serial.println("[MQTT] ==========================================\n");
+  controlStats.response_last_bytes = length;
+  controlStats.response_parse_us = parseUs;
+  controlStats.response_parse_max_us = max(controlStats.response_parse_max_us, parseUs);
+  
+  if (received < 0) {
+    controlStats.parse_errors++;
+    LOG_E("ERROR", "Respuesta %s inválida (%u bytes)", isJson ? "JSON" : "CBOR", length);
+    lastError = "Control message parse error";
+    return;
+  }
+  
+  if (received > 0) {
+    LOG_I("MQTT", "%d URLs recibidas", received);
+  }
+  LOG_I("PERF", "Respuesta %s: %u bytes, parseo %lu us",
+        isJson ? "JSON" : "CBOR", length, (unsigned long)parseUs);
+}
+
+// Atiende el socket MQTT (keepalive, mensajes entrantes)
+static void serviceMQTT() {
+  TRACE_SCOPE("mqtt.loop");
+  mqttClient.loop();
 }
 
 static bool connectMQTT() {
-  Serial.println("[MQTT] Configurando AWS IoT...");
+  // Reutilizar la sesión MQTT/TLS si sigue viva (ya suscrita a TOPIC_RESPONSE)
+  if (mqttClient.connected()) {
+    tlsStats.mqtt_reuses++;
+    LOG_I("MQTT", "Reutilizando conexión existente (sin handshake)");
+    return true;
+  }
   
-  mqttClient.setBufferSize(4096);
-  Serial.println("[DEBUG] Buffer MQTT configurado: 4096 bytes");
+  LOG_I("MQTT", "Configurando AWS IoT...");
+  
+  // Una respuesta por lotes trae varias URLs prefirmadas (~1.3 KB cada una)
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+  LOG_D("DEBUG", "Buffer MQTT configurado: %d bytes", MQTT_BUFFER_SIZE);
   
   mqttClient.setServer(AWS_IOT_ENDPOINT, AWS_IOT_PORT);
   mqttClient.setCallback(mqttCallback);
   mqttClient.setKeepAlive(60);
   
-  Serial.println("[MQTT] Conectando a AWS IoT Core...");
+  LOG_I("MQTT", "Conectando a AWS IoT Core...");
   
   int attempts = 0;
   while (!mqttClient.connected() && attempts < 3) {
+    unsigned long handshakeStart = millis();
     if (mqttClient.connect(DEVICE_ID, NULL, NULL, NULL, 0, false, NULL, true)) {
-      Serial.println("[MQTT] Conectado a AWS IoT Core");
+      tlsStats.mqtt_handshakes++;
+      holter_metrics_add(MC_MQTT_CONNECTS);
+      tlsStats.mqtt_last_handshake_ms = millis() - handshakeStart;
+      tlsStats.mqtt_total_handshake_ms += tlsStats.mqtt_last_handshake_ms;
+      LOG_I("MQTT", "Conectado a AWS IoT Core");
+      LOG_I("TLS", "Handshake MQTT: %lu ms",
+            (unsigned long)tlsStats.mqtt_last_handshake_ms);
       
       delay(100);
       if (!mqttClient.connected()) {
-        Serial.println("[ERROR] Conexión perdida inmediatamente");
+        LOG_E("ERROR", "Conexión perdida inmediatamente");
         attempts++;
         continue;
       }
       
       if (mqttClient.subscribe(TOPIC_RESPONSE, 1)) {
-        Serial.println("[MQTT] Suscrito a: " + String(TOPIC_RESPONSE) + " (QoS 1)");
+        LOG_I("MQTT", "Suscrito a: %s (QoS 1)", TOPIC_RESPONSE);
       } else {
-        Serial.println("[ERROR] No se pudo suscribir a: " + String(TOPIC_RESPONSE));
+        LOG_E("ERROR", "No se pudo suscribir a: %s", TOPIC_RESPONSE);
         attempts++;
         continue;
       }
       
-      Serial.println("[MQTT] Esperando confirmación de suscripción...");
+      LOG_I("MQTT", "Esperando confirmación de suscripción...");
       for (int i = 0; i < 20; i++) {
-        mqttClient.loop();
+        serviceMQTT();
         if (!mqttClient.connected()) {
-          Serial.println("[ERROR] Conexión perdida durante suscripción");
+          LOG_E("ERROR", "Conexión perdida durante suscripción");
           attempts++;
           break;
         }
@@ -129,145 +548,553 @@ static bool connectMQTT() {
       }
       
       if (mqttClient.connected()) {
-        Serial.println("[MQTT] Listo para recibir mensajes");
+        LOG_I("MQTT", "Listo para recibir mensajes");
         return true;
       }
     } else {
-      Serial.println("[MQTT] Error conectando: " + String(mqttClient.state()));
+      LOG_E("MQTT", "Error conectando: %d", mqttClient.state());
       lastError = "MQTT connect failed: " + String(mqttClient.state());
       attempts++;
       delay(2000);
     }
   }
   
-  Serial.println("[MQTT] Falló después de 3 intentos");
+  LOG_I("MQTT", "Falló después de 3 intentos");
   lastError = "MQTT connection failed after 3 attempts";
   return false;
 }
 
-static void requestUploadURL() {
-  Serial.println("\n[UPLOAD] Solicitando URL de AWS...");
+// Solicitud v1/batch en JSON (Lambdas que no entienden CBOR)
+static size_t buildRequestJson(uint32_t requestId, const String* sessionIDs,
+                               const uint32_t* fileSizes, int count,
+                               const RecordingSync* sync) {
+  DynamicJsonDocument doc(CONTROL_BUFFER_SIZE);
+  doc["device_id"] = DEVICE_ID;
+  doc["request_id"] = requestId;
+  doc["timestamp"] = String(millis() / 1000);
+  doc["ready_for_upload"] = true;
+  if (UPLOAD_COMPRESSION) {
+    doc["encoding"] = "zlib";   // La Lambda genera la clave .bin.z
+  }
   
-  unsigned long fileSize = 0;
+  // Campos v1 con la sesión actual: la Lambda anterior solo lee estos
+  doc["session_id"] = sessionIDs[0];
+  doc["file_size"] = fileSizes[0];
   
-  if (holter_isSDAvailable()) {
-    File file = SD.open(currentFilename.c_str(), FILE_READ);
-    if (!file) {
-      Serial.println("[ERROR] No se pudo abrir archivo");
-      lastError = "Cannot open file";
-      currentState = UPLOAD_ERROR;
-      return;
-    }
-    fileSize = file.size();
-    file.close();
-  } else {
-    fileSize = 1024; // Simulado
-    Serial.printf("[INFO] Tamaño simulado: %lu bytes\n", fileSize);
+  JsonArray sessions = doc.createNestedArray("sessions");
+  for (int i = 0; i < count; i++) {
+    JsonObject item = sessions.createNestedObject();
+    item["session_id"] = sessionIDs[i];
+    item["file_size"] = fileSizes[i];
   }
   
-  // Extraer session ID del filename
-  int lastSlash = currentFilename.lastIndexOf('/');
-  int lastDot = currentFilename.lastIndexOf('.');
-  currentSessionID = currentFilename.substring(lastSlash + 1, lastDot);
+  if (sync != nullptr) {
+    JsonObject progress = doc.createNestedObject("sync");
+    progress["recording_id"] = sync->recording_id;
+    progress["high_water"] = sync->high_water;
+    progress["segments_sealed"] = sync->segments_sealed;
+  }
   
-  DynamicJsonDocument doc(512);
-  doc["device_id"] = DEVICE_ID;
-  doc["session_id"] = currentSessionID;
-  doc["timestamp"] = String(millis() / 1000);
-  doc["file_size"] = fileSize;
-  doc["ready_for_upload"] = true;
+  return serializeJson(doc, (char*)controlBuffer, CONTROL_BUFFER_SIZE);
+}
+
+// Solicitud v2: {0: 2, 1: CT_URL_REQUEST, 2: device_id, 3: request_id,
+//                4: [[session_id, file_size], ...], 5: "zlib", 6: uptime,
+//                11: [recording_id, high_water, segments_sealed]}
+static size_t buildRequestCbor(uint32_t requestId, const String* sessionIDs,
+                               const uint32_t* fileSizes, int count,
+                               const RecordingSync* sync) {
+  CborWriter writer(controlBuffer, CONTROL_BUFFER_SIZE);
+  writer.map(6 + (UPLOAD_COMPRESSION ? 1 : 0) + (sync != nullptr ? 1 : 0));
+  writer.uint(CK_VERSION);
+  writer.uint(CONTROL_VERSION);
+  writer.uint(CK_TYPE);
+  writer.uint(CT_URL_REQUEST);
+  writer.uint(CK_DEVICE_ID);
+  writer.text(DEVICE_ID);
+  writer.uint(CK_REQUEST_ID);
+  writer.uint(requestId);
+  
+  writer.uint(CK_SESSIONS);
+  writer.array(count);
+  for (int i = 0; i < count; i++) {
+    writer.array(2);
+    writer.text(sessionIDs[i].c_str(), sessionIDs[i].length());
+    writer.uint(fileSizes[i]);
+  }
   
-  char jsonBuffer[512];
-  size_t jsonSize = serializeJson(doc, jsonBuffer);
+  if (UPLOAD_COMPRESSION) {
+    writer.uint(CK_ENCODING);
+    writer.text("zlib");
+  }
+  writer.uint(CK_UPTIME);
+  writer.uint(millis() / 1000);
   
-  Serial.println("[MQTT] Publicando solicitud...");
-  Serial.println("[DEBUG] Topic: " + String(TOPIC_REQUEST));
-  Serial.println("[DEBUG] Payload: " + String(jsonBuffer));
+  if (sync != nullptr) {
+    writer.uint(CK_SYNC);
+    writer.array(3);
+    writer.uint(sync->recording_id);
+    writer.uint(sync->high_water);
+    writer.uint(sync->segments_sealed);
+  }
   
-  mqttClient.loop();
+  return writer.ok() ? writer.size() : 0;
+}
+
+// La solicitud no salió: cuenta como fallo de la sesión (backoff en la cola,
+// métricas) igual que un rechazo. Lo resuelve continueDrain(false) en la
+// próxima vuelta de la máquina de estados, no desde acá: así no se anida otra
+// solicitud dentro de esta
+static void failURLRequest(const char* error) {
+  lastError = error;
+  pendingRequestId = 0;
+  urlRequestRejected = true;
+  uploadStartTime = millis();    // No pasa por el timeout con el tiempo de otra sesión
+  currentState = UPLOAD_REQUESTING_URL;
+}
+
+// Pide en una sola solicitud las URLs de la sesión actual y de las siguientes
+// de la cola que aún no tengan una URL vigente en caché
+static void requestUploadURLs() {
+  LOG_I("UPLOAD", "Solicitando URLs de AWS...");
+  
+  QueueEntry upcoming[MAX_URL_BATCH];
+  int upcomingCount = holter_queue_peek(upcoming, MAX_URL_BATCH);
+  
+  uint32_t requestId = ++nextRequestId;
+  if (requestId == 0) requestId = ++nextRequestId;
   
-  bool publishResult = mqttClient.publish(TOPIC_REQUEST, (uint8_t*)jsonBuffer, jsonSize);
+  // La sesión actual va primera (es la que leen las Lambdas v1)
+  String sessionIDs[MAX_URL_BATCH];
+  uint32_t fileSizes[MAX_URL_BATCH];
+  sessionIDs[0] = currentSessionID;
+  fileSizes[0] = holter_isSDAvailable() ? currentFileSize : 1024; // 1024 = simulado
+  int batchSize = 1;
+  
+  String cached;
+  for (int i = 0; i < upcomingCount && batchSize < MAX_URL_BATCH; i++) {
+    String sessionID = sessionIDFromFilename(upcoming[i].filename);
+    if (sessionID == currentSessionID || findCachedURL(sessionID, &cached)) continue;
+    
+    sessionIDs[batchSize] = sessionID;
+    fileSizes[batchSize] = upcoming[i].file_size;
+    batchSize++;
+  }
+  
+  // Avance de la grabación de la sesión actual: la nube sabe hasta dónde
+  // está completa sin listar el bucket
+  RecordingSync sync;
+  uint32_t recordingId;
+  uint32_t segment;
+  const RecordingSync* progress = nullptr;
+  if (holter_parseSegmentFilename(currentFilename.c_str(), &recordingId, &segment) &&
+      holter_queue_getSync(recordingId, &sync)) {
+    progress = &sync;
+  }
+  
+  unsigned long buildStart = micros();
+  size_t payloadSize = CONTROL_CBOR
+      ? buildRequestCbor(requestId, sessionIDs, fileSizes, batchSize, progress)
+      : buildRequestJson(requestId, sessionIDs, fileSizes, batchSize, progress);
+  controlStats.request_build_us = micros() - buildStart;
+  controlStats.request_last_bytes = payloadSize;
+  
+  if (payloadSize == 0) {
+    LOG_E("ERROR", "La solicitud no entra en el buffer de control");
+    failURLRequest("Control message too large");
+    return;
+  }
+  
+  if (CONTROL_CBOR) {
+    controlStats.requests_cbor++;
+  } else {
+    controlStats.requests_json++;
+  }
+  
+  LOG_I("MQTT", "Publicando solicitud %lu (%d sesiones)...",
+        (unsigned long)requestId, batchSize);
+  LOG_D("DEBUG", "Topic: %s", TOPIC_REQUEST);
+  LOG_I("PERF", "Solicitud %s: %u bytes, armado %lu us", CONTROL_CBOR ? "CBOR" : "JSON",
+        (unsigned)payloadSize, (unsigned long)controlStats.request_build_us);
+  
+  serviceMQTT();
+  
+  bool publishResult;
+  {
+    TRACE_SCOPE("mqtt.publish");
+    publishResult = mqttClient.publish(TOPIC_REQUEST, controlBuffer, payloadSize);
+  }
   
   if (publishResult) {
-    Serial.println("[MQTT] Solicitud enviada");
-    Serial.println("[INFO] Esperando respuesta (60s timeout)...");
+    LOG_I("MQTT", "Solicitud enviada");
     
+    if (firstPublishPending) {
+      firstPublishPending = false;
+      connectStats.first_byte_last_ms = millis() - drainStartTime;
+      connectStats.first_byte_max_ms = max(connectStats.first_byte_max_ms,
+                                           connectStats.first_byte_last_ms);
+      LOG_I("PERF", "Inicio del upload -> primer publish MQTT: %lu ms",
+            (unsigned long)connectStats.first_byte_last_ms);
+    }
+    LOG_I("INFO", "Esperando respuesta (60s timeout)...");
+    
+    pendingRequestId = requestId;
+    pendingFirstSession = currentSessionID;
+    urlRequestRejected = false;
     uploadStartTime = millis();
-    urlReceived = false;
     currentState = UPLOAD_REQUESTING_URL;
   } else {
-    Serial.println("[ERROR] No se pudo publicar - Estado: " + String(mqttClient.state()));
-    lastError = "MQTT publish failed";
-    currentState = UPLOAD_ERROR;
+    LOG_E("ERROR", "No se pudo publicar - Estado: %d", mqttClient.state());
+    failURLRequest("MQTT publish failed");
   }
 }
 
-static bool uploadToS3() {
-  Serial.println("\n[S3] Iniciando upload...");
+// Arranca la subida de currentFilename: directo a S3 si ya hay URL vigente,
+// si no pide un lote de URLs
+static void beginSessionUpload() {
+  currentSessionID = sessionIDFromFilename(currentFilename);
   
-  File file = SD.open(currentFilename.c_str(), FILE_READ);
-  if (!file) {
-    Serial.println("[ERROR] No se pudo abrir archivo");
-    lastError = "Cannot open file for upload";
+  if (findCachedURL(currentSessionID, &uploadURL)) {
+    LOG_I("UPLOAD", "URL en caché para %s (sin solicitud MQTT)", currentSessionID.c_str());
+    currentState = UPLOAD_UPLOADING_S3;
+    return;
+  }
+  
+  requestUploadURLs();
+}
+
+static String urlHost(const String& url) {
+  int start = url.indexOf("://");
+  start = (start < 0) ? 0 : start + 3;
+  int end = url.indexOf('/', start);
+  String host = (end < 0) ? url.substring(start) : url.substring(start, end);
+  int colon = host.indexOf(':');
+  return (colon < 0) ? host : host.substring(0, colon);
+}
+
+// Abre (o reutiliza) la conexión TLS al host de S3 antes del PUT,
+// así el handshake se mide por separado de la transferencia
+static bool ensureS3Connection(const String& host) {
+  if (s3Client.connected() && host == s3Host) {
+    tlsStats.s3_reuses++;
+    LOG_I("S3", "Reutilizando conexión keep-alive (sin handshake)");
+    return true;
+  }
+  
+  s3Http.end();
+  s3Client.stop();
+  
+  LOG_I("S3", "Conectando a %s...", host.c_str());
+  unsigned long handshakeStart = millis();
+  if (!s3Client.connect(host.c_str(), 443)) {
+    LOG_E("ERROR", "No se pudo establecer TLS con S3");
+    lastError = "S3 TLS connect failed";
+    s3Host = "";
     return false;
   }
   
-  unsigned long fileSize = file.size();
-  Serial.println("[S3] Archivo: " + currentFilename);
-  Serial.println("[S3] Tamaño: " + String(fileSize / 1024) + " KB");
+  tlsStats.s3_handshakes++;
+  tlsStats.s3_last_handshake_ms = millis() - handshakeStart;
+  tlsStats.s3_total_handshake_ms += tlsStats.s3_last_handshake_ms;
+  LOG_I("TLS", "Handshake S3: %lu ms", (unsigned long)tlsStats.s3_last_handshake_ms);
+  
+  s3Host = host;
+  return true;
+}
+
+// Lectura de un archivo de la SD por bloques, tomando el lock de SD solo
+// durante cada bloque: el upload nunca retiene la SD más de una lectura corta,
+// así la escritura de la captura que corre en paralelo no se demora
+class LockedFileStream : public Stream {
+public:
+  bool open(const char* path) {
+    holter_sdLock();
+    file = SD.open(path, FILE_READ);
+    remaining = file ? file.size() : 0;
+    holter_sdUnlock();
+    return (bool)file;
+  }
   
-  uint8_t* fileData = (uint8_t*)malloc(fileSize);
-  if (!fileData) {
-    Serial.println("[ERROR] No hay memoria suficiente");
+  void close() {
+    holter_sdLock();
     file.close();
-    lastError = "Out of memory";
+    holter_sdUnlock();
+  }
+  
+  size_t size() { return file ? file.size() : 0; }
+  
+  int available() override { return (int)remaining; }
+  
+  size_t readBytes(char* buffer, size_t length) override {
+    TRACE_SCOPE("upload.sdRead");
+    unsigned long waitStart = micros();
+    holter_sdLock();
+    uploadStats.sd_wait_max_us = max(uploadStats.sd_wait_max_us,
+                                     (uint32_t)(micros() - waitStart));
+    size_t n = file.read((uint8_t*)buffer, min(length, remaining));
+    holter_sdUnlock();
+    remaining -= n;
+    return n;
+  }
+  
+  int read() override {
+    uint8_t c;
+    return (readBytes((char*)&c, 1) == 1) ? c : -1;
+  }
+  
+  int peek() override { return -1; }
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  File file;
+  size_t remaining = 0;
+};
+
+// Compresión zlib al vuelo del archivo leído de la SD. El PUT necesita el
+// Content-Length, así que begin() comprime una vez solo para contar bytes y
+// el PUT vuelve a comprimir mientras envía (el encoder es determinista).
+// La memoria de trabajo (~25 KB) se pide al heap solo durante el upload.
+class DeflateFileStream : public Stream {
+public:
+  ~DeflateFileStream() {
+    delete work;
+  }
+  
+  bool begin(const char* path) {
+    work = new (std::nothrow) Work();
+    if (work == nullptr) return false;
+    
+    // Primera pasada: solo medir el tamaño comprimido
+    if (!source.open(path)) return false;
+    work->encoder.begin(discardSink, this);
+    while (pump()) {}
+    source.close();
+    compressedSize = work->encoder.totalOut();
+    
+    // Segunda pasada: la que consume el PUT
+    if (!source.open(path)) return false;
+    finished = false;
+    overflow = false;
+    fifoRead = fifoLength = 0;
+    delivered = 0;
+    work->encoder.begin(fifoSink, this);
+    return true;
+  }
+  
+  void close() { source.close(); }
+  
+  size_t size() { return compressedSize; }
+  
+  // Tiempo de CPU del encoder en ambas pasadas
+  uint32_t cpuMs() { return cpuUs / 1000; }
+  
+  int available() override { return (int)(compressedSize - delivered); }
+  
+  size_t readBytes(char* buffer, size_t length) override {
+    size_t copied = 0;
+    while (copied < length) {
+      if (fifoRead == fifoLength) {
+        fifoRead = fifoLength = 0;
+        if (finished || overflow) break;
+        pump();
+        continue;
+      }
+      size_t n = min(length - copied, fifoLength - fifoRead);
+      memcpy(buffer + copied, work->fifo + fifoRead, n);
+      fifoRead += n;
+      copied += n;
+    }
+    delivered += copied;
+    return copied;
+  }
+  
+  int read() override {
+    uint8_t c;
+    return (readBytes((char*)&c, 1) == 1) ? c : -1;
+  }
+  
+  int peek() override { return -1; }
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  struct Work {
+    DeflateEncoder encoder;
+    uint8_t chunk[DEFLATE_MAX_WRITE];
+    uint8_t fifo[DEFLATE_MAX_BURST];
+  };
+  
+  static void discardSink(const uint8_t*, size_t, void*) {}
+  
+  // Cada pump() entrega a lo sumo DEFLATE_MAX_BURST bytes y solo se llama con la FIFO vacía
+  static void fifoSink(const uint8_t* data, size_t len, void* context) {
+    DeflateFileStream* self = (DeflateFileStream*)context;
+    if (self->fifoLength + len > sizeof(self->work->fifo)) {
+      self->overflow = true;
+      return;
+    }
+    memcpy(self->work->fifo + self->fifoLength, data, len);
+    self->fifoLength += len;
+  }
+  
+  // Pasa un bloque de la SD por el encoder; false cuando ya se cerró el stream
+  bool pump() {
+    if (finished) return false;
+    size_t n = source.readBytes((char*)work->chunk, sizeof(work->chunk));
+    unsigned long start = micros();
+    if (n > 0) {
+      TRACE_SCOPE("upload.deflate");
+      work->encoder.write(work->chunk, n);
+    } else {
+      work->encoder.finish();
+      finished = true;
+    }
+    cpuUs += micros() - start;
+    return !finished;
+  }
+  
+  Work* work = nullptr;
+  LockedFileStream source;
+  size_t compressedSize = 0;
+  size_t delivered = 0;
+  size_t fifoRead = 0;
+  size_t fifoLength = 0;
+  uint32_t cpuUs = 0;
+  bool finished = false;
+  bool overflow = false;
+};
+
+static bool uploadToS3() {
+  LOG_I("S3", "Iniciando upload...");
+  
+  LockedFileStream file;
+  if (!file.open(currentFilename.c_str())) {
+    LOG_E("ERROR", "No se pudo abrir archivo");
+    lastError = "Cannot open file for upload";
     return false;
   }
   
-  Serial.println("[S3] Leyendo archivo...");
-  size_t bytesRead = file.read(fileData, fileSize);
-  file.close();
+  unsigned long fileSize = file.size();
+  LOG_I("S3", "Archivo: %s (%lu KB)", currentFilename.c_str(), (unsigned long)(fileSize / 1024));
+  holter_catalog_setState(currentFilename.c_str(), CATALOG_UPLOADING);
+  
+  // Cuerpo del PUT: el archivo tal cual o comprimido al vuelo
+  Stream* body = &file;
+  unsigned long bodySize = fileSize;
+  DeflateFileStream deflated;
+  if (UPLOAD_COMPRESSION) {
+    if (deflated.begin(currentFilename.c_str())) {
+      body = &deflated;
+      bodySize = deflated.size();
+      LOG_I("S3", "Comprimido: %lu -> %lu bytes (%lu%%)",
+            fileSize, bodySize, fileSize > 0 ? (bodySize * 100) / fileSize : 0);
+    } else {
+      // lambda2 detecta el formato por contenido: subir sin comprimir es válido
+      LOG_W("WARNING", "No se pudo preparar la compresión - se envía sin comprimir");
+    }
+  }
   
-  if (bytesRead != fileSize) {
-    Serial.println("[ERROR] Lectura incompleta");
-    free(fileData);
-    lastError = "Incomplete file read";
+  if (!ensureS3Connection(urlHost(uploadURL))) {
+    file.close();
+    deflated.close();
     return false;
   }
   
-  Serial.println("[S3] Conectando a S3...");
-  HTTPClient http;
-  http.begin(uploadURL);
-  http.addHeader("Content-Type", "application/octet-stream");
-  http.addHeader("Content-Length", String(fileSize));
-  http.setTimeout(30000);
+  s3Http.setReuse(true);
+  s3Http.begin(s3Client, uploadURL);
+  s3Http.addHeader("Content-Type", "application/octet-stream");
+  s3Http.setTimeout(30000);
   
-  Serial.println("[S3] Enviando datos...");
-  int httpCode = http.PUT(fileData, fileSize);
+  // El archivo se envía en streaming desde la SD (sin copiarlo entero a RAM)
+  LOG_I("S3", "Enviando datos...");
+  unsigned long transferStart = millis();
+  int httpCode;
+  {
+    TRACE_SCOPE("upload.httpPut");
+    httpCode = s3Http.sendRequest("PUT", body, bodySize);
+  }
+  unsigned long transferMs = millis() - transferStart;
   
-  free(fileData);
+  file.close();
+  deflated.close();
   
-  Serial.println("[S3] HTTP Code: " + String(httpCode));
+  LOG_I("S3", "HTTP Code: %d", httpCode);
   
   if (httpCode == 200 || httpCode == 204) {
-    Serial.println("[S3] Upload exitoso!");
-    http.end();
+    uploadStats.files_uploaded++;
+    uploadStats.bytes_uploaded += bodySize;
+    uploadStats.bytes_raw += fileSize;
+    uploadStats.deflate_ms += deflated.cpuMs();
+    uploadStats.transfer_ms += transferMs;
+    uploadStats.last_kbps = transferMs > 0 ? (bodySize * 8) / transferMs : 0;
+    holter_metrics_add(MC_UPLOADS_OK);
+    holter_metrics_add(MC_UPLOAD_BYTES, bodySize);
+    holter_metrics_observe(MH_UPLOAD_KBPS, uploadStats.last_kbps);
+    LOG_I("S3", "Upload exitoso! %lu bytes en %lu ms (%lu kbps)",
+          bodySize, transferMs, (unsigned long)uploadStats.last_kbps);
+    // Con setReuse(true), end() deja abierta la conexión para el próximo PUT
+    s3Http.end();
     
-    if (SD.remove(currentFilename.c_str())) {
-      Serial.println("[SD] Archivo eliminado (espacio liberado)");
-    }
+    // La URL prefirmada ya se usó; quitar la sesión de la cola y borrar el archivo
+    dropCachedURL(currentSessionID);
+    holter_queue_markDone(currentFilename);
     
     return true;
   } else {
-    Serial.println("[S3] Error HTTP: " + String(httpCode));
-    String response = http.getString();
+    LOG_E("S3", "Error HTTP: %d", httpCode);
+    String response = s3Http.getString();
+    // El cuerpo del error completo: el log diferido corta los %s
+    holter_log_flush();
     Serial.println("[S3] Response: " + response);
-    http.end();
+    s3Http.end();
     lastError = "S3 upload failed: " + String(httpCode);
     return false;
   }
 }
 
+static bool selectNextQueued() {
+  QueueEntry entry;
+  if (!holter_queue_next(&entry)) return false;
+  
+  currentFilename = entry.filename;
+  currentFileSize = entry.file_size;
+  uploadURL = "";
+  return true;
+}
+
+// Tras terminar (bien o mal) una sesión, sigue con la siguiente de la cola
+// reutilizando la conexión WiFi/MQTT ya establecida
+static void continueDrain(bool lastSucceeded) {
+  if (lastSucceeded) {
+    consecutiveFailures = 0;
+  } else {
+    holter_queue_markFailed(currentFilename);
+    holter_metrics_add(MC_UPLOADS_FAILED);
+    drainHadFailure = true;
+    consecutiveFailures++;
+  }
+  uploadsThisConnection++;
+  
+  bool canContinue = mqttClient.connected() &&
+                     uploadsThisConnection < MAX_UPLOADS_PER_CONNECTION &&
+                     consecutiveFailures < MAX_CONSECUTIVE_FAILURES;
+  
+  if (canContinue && selectNextQueued()) {
+    LOG_I("QUEUE", "Siguiente: %s (%d/%d en esta conexión)",
+          currentFilename.c_str(), uploadsThisConnection + 1,
+          MAX_UPLOADS_PER_CONNECTION);
+    beginSessionUpload();
+    return;
+  }
+  
+  LOG_I("QUEUE", "Drenado terminado: %d sesiones procesadas, %d pendientes (%lu bytes)",
+        uploadsThisConnection, holter_queue_depth(),
+        (unsigned long)holter_queue_bytesPending());
+  LOG_I("TLS", "MQTT: %lu handshakes, %lu reutilizadas | S3: %lu handshakes, %lu reutilizadas",
+        (unsigned long)tlsStats.mqtt_handshakes, (unsigned long)tlsStats.mqtt_reuses,
+        (unsigned long)tlsStats.s3_handshakes, (unsigned long)tlsStats.s3_reuses);
+  currentState = drainHadFailure ? UPLOAD_ERROR : UPLOAD_COMPLETE;
+}
+
 // ============================================================================
 // IMPLEMENTACIÓN DE INTERFACE PÚBLICA
 // ============================================================================
@@ -277,29 +1104,79 @@ void holter_initUpload() {
   wifiClient.setCertificate(AWS_CERT_CRT);
   wifiClient.setPrivateKey(AWS_CERT_PRIVATE);
   
-  Serial.println("[Upload] Módulo inicializado");
+  // Las URLs prefirmadas ya autentican el PUT; igual que http.begin(url) sin CA
+  s3Client.setInsecure();
+  
+  LOG_I("Upload", "Módulo inicializado");
 }
 
 bool holter_connectWiFi() {
-  Serial.println("\n[WiFi] Conectando a: " + String(WIFI_SSID));
+  if (WiFi.status() == WL_CONNECTED) {
+    LOG_I("WiFi", "Ya conectado - reutilizando");
+    return true;
+  }
+  
+  unsigned long start = millis();
+  LOG_I("WiFi", "Conectando a: %s", WIFI_SSID);
+  WiFi.persistent(false);  // No reescribir las credenciales en flash en cada conexión
   WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
   
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
+  bool connected = false;
+  bool fast = false;
+  bool reusedIP = false;
+  
+  // Camino rápido: BSSID y canal conocidos (sin escaneo) y, si el lease es
+  // reciente, la misma IP sin DHCP
+  if (wifiCache.magic == WIFI_CACHE_MAGIC) {
+    reusedIP = leaseIsFresh();
+    if (reusedIP) {
+      WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway),
+                  IPAddress(wifiCache.subnet), IPAddress(wifiCache.dns));
+    }
+    LOG_I("WiFi", "Conexión directa: canal %ld%s",
+          (long)wifiCache.channel, reusedIP ? ", IP del último lease" : "");
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifiCache.channel, wifiCache.bssid);
+    connected = fast = waitForWiFi(FAST_CONNECT_TIMEOUT_MS);
+    
+    if (!connected) {
+      LOG_I("WiFi", "Conexión directa falló - escaneo completo");
+      connectStats.wifi_fast_failures++;
+      wifiCache.magic = 0;
+      reusedIP = false;
+      WiFi.disconnect();
+    }
+  }
+  
+  if (!connected) {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // DHCP
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    connected = waitForWiFi(FULL_CONNECT_TIMEOUT_MS);
   }
   
-  bool connected = (WiFi.status() == WL_CONNECTED);
   if (connected) {
-    Serial.println("\n[WiFi] Conectado");
-    Serial.println("[WiFi] IP: " + WiFi.localIP().toString());
-    Serial.println("[WiFi] RSSI: " + String(WiFi.RSSI()) + " dBm");
+    connectStats.wifi_last_ms = millis() - start;
+    if (fast) connectStats.wifi_fast_joins++;
+    else connectStats.wifi_full_joins++;
+    holter_metrics_add(MC_WIFI_JOINS);
+    
+    LOG_I("WiFi", "Conectado en %lu ms (%s)", (unsigned long)connectStats.wifi_last_ms,
+          fast ? "directa" : "escaneo + DHCP");
+    LOG_I("WiFi", "IP: %s, RSSI: %d dBm", WiFi.localIP().toString().c_str(), (int)WiFi.RSSI());
     syncTime();
+    
+    memcpy(wifiCache.bssid, WiFi.BSSID(), sizeof(wifiCache.bssid));
+    wifiCache.channel = WiFi.channel();
+    if (!reusedIP) {
+      wifiCache.ip = WiFi.localIP();
+      wifiCache.gateway = WiFi.gatewayIP();
+      wifiCache.subnet = WiFi.subnetMask();
+      wifiCache.dns = WiFi.dnsIP();
+      time_t now = time(nullptr);
+      wifiCache.lease_time = (now > MIN_VALID_TIME) ? now : 0;
+    }
+    wifiCache.magic = WIFI_CACHE_MAGIC;
   } else {
-    Serial.println("\n[WiFi] ERROR: No se pudo conectar");
+    LOG_I("WiFi", "ERROR: No se pudo conectar");
     lastError = "WiFi connection failed";
   }
   
@@ -307,20 +1184,58 @@ bool holter_connectWiFi() {
 }
 
 void holter_disconnectWiFi() {
+  s3Http.end();
+  s3Client.stop();
+  s3Host = "";
+  if (mqttClient.connected()) {
+    mqttClient.disconnect();
+  }
+  
   WiFi.disconnect(true);
   WiFi.mode(WIFI_OFF);
-  Serial.println("[WiFi] Desconectado (ahorro energía)");
+  LOG_I("WiFi", "Desconectado (ahorro energía)");
+}
+
+bool holter_connectMQTT() {
+  if (mqttClient.connected()) return true;
+  if (!holter_connectWiFi()) return false;
+  return connectMQTT();
+}
+
+PubSubClient& holter_getMQTTClient() {
+  return mqttClient;
 }
 
 bool holter_startUpload(String filename) {
-  currentFilename = filename;
+  // La sesión indicada se marca prioritaria para que sea la primera en subir
+  if (!holter_queue_push(filename, QUEUE_FLAG_PRIORITY)) {
+    lastError = "Cannot enqueue " + filename;
+    return false;
+  }
+  
+  LOG_I("Upload", "Iniciando proceso de upload para: %s", filename.c_str());
+  return holter_startQueueDrain();
+}
+
+bool holter_startQueueDrain() {
+  lastError = "";
+  uploadsThisConnection = 0;
+  consecutiveFailures = 0;
+  drainHadFailure = false;
+  
+  if (!selectNextQueued()) {
+    LOG_I("QUEUE", "Nada pendiente para subir");
+    currentState = UPLOAD_COMPLETE;
+    return false;
+  }
+  
   currentState = UPLOAD_CONNECTING_WIFI;
   uploadStartTime = millis();
-  urlReceived = false;
-  lastError = "";
-  uploadURL = "";
+  drainStartTime = uploadStartTime;
+  firstPublishPending = true;
   
-  Serial.println("[Upload] Iniciando proceso de upload para: " + filename);
+  LOG_I("Upload", "Drenando cola: %d sesiones (%lu bytes) pendientes",
+        holter_queue_depth(), (unsigned long)holter_queue_bytesPending());
   return true;
 }
 
@@ -340,40 +1255,42 @@ void holter_uploadLoop() {
       
     case UPLOAD_CONNECTING_MQTT:
       if (connectMQTT()) {
-        requestUploadURL();
-        // requestUploadURL cambia el estado
+        beginSessionUpload();
+        // beginSessionUpload cambia el estado
       } else {
         currentState = UPLOAD_ERROR;
       }
       break;
       
     case UPLOAD_REQUESTING_URL:
-      mqttClient.loop();
+      serviceMQTT();
       
-      if (urlReceived) {
+      if (findCachedURL(currentSessionID, &uploadURL)) {
         currentState = UPLOAD_UPLOADING_S3;
       } else if (millis() - uploadStartTime > UPLOAD_TIMEOUT_MS) {
-        Serial.println("[ERROR] Timeout esperando URL");
+        LOG_E("ERROR", "Timeout esperando URL");
         lastError = "Timeout waiting for upload URL";
-        currentState = UPLOAD_ERROR;
+        pendingRequestId = 0;
+        continueDrain(false);
+      } else if (urlRequestRejected) {
+        urlRequestRejected = false;
+        continueDrain(false);
       }
       
       // Log cada 5 segundos
       static unsigned long lastLog = 0;
       if (millis() - lastLog > 5000) {
-        Serial.printf("[WAIT] Esperando URL... (%lus)\n", (millis() - uploadStartTime) / 1000);
+        LOG_I("WAIT", "Esperando URL... (%lus)", (millis() - uploadStartTime) / 1000);
         lastLog = millis();
       }
       break;
       
     case UPLOAD_UPLOADING_S3:
       if (uploadToS3()) {
-        Serial.println("\n========================================");
-        Serial.println("UPLOAD COMPLETADO EXITOSAMENTE");
-        Serial.println("========================================\n");
-        currentState = UPLOAD_COMPLETE;
+        LOG_I("UPLOAD", "===== Upload completado exitosamente =====");
+        continueDrain(true);
       } else {
-        currentState = UPLOAD_ERROR;
+        continueDrain(false);
       }
       break;
       
@@ -384,14 +1301,36 @@ void holter_uploadLoop() {
   }
   
   if (mqttClient.connected()) {
-    mqttClient.loop();
+    serviceMQTT();
+  }
+}
+
+void holter_uploadWait(unsigned long maxMs) {
+  if (currentState != UPLOAD_REQUESTING_URL || !mqttClient.connected()) {
+    vTaskDelay(1);
+    return;
+  }
+  
+  // Lo que mbedTLS ya descifró no se ve en el socket
+  if (wifiClient.available() > 0) return;
+  
+  int fd = wifiClient.fd();
+  if (fd < 0) {
+    vTaskDelay(pdMS_TO_TICKS(maxMs));
+    return;
   }
+  
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(fd, &readable);
+  struct timeval timeout = { (time_t)(maxMs / 1000), (suseconds_t)((maxMs % 1000) * 1000) };
+  select(fd + 1, &readable, nullptr, nullptr, &timeout);
 }
 
 void holter_cancelUpload() {
   currentState = UPLOAD_IDLE;
   holter_disconnectWiFi();
-  Serial.println("[Upload] Cancelado");
+  LOG_I("Upload", "Cancelado");
 }
 
 bool holter_isUploading() {
@@ -441,3 +1380,39 @@ bool holter_isMQTTConnected() {
 String holter_getLastError() {
   return lastError;
 }
+
+TLSStats holter_getTLSStats() {
+  return tlsStats;
+}
+
+UploadStats holter_getUploadStats() {
+  return uploadStats;
+}
+
+ConnectStats holter_getConnectStats() {
+  return connectStats;
+}
+
+bool holter_publishTelemetry() {
+  if (!mqttClient.connected()) return false;
+  
+  // El buffer de control está libre fuera de requestUploadURLs() (misma tarea)
+  size_t size = holter_metrics_encode(controlBuffer, sizeof(controlBuffer));
+  if (size == 0) return false;
+  
+  bool published;
+  {
+    TRACE_SCOPE("mqtt.publish");
+    published = mqttClient.publish(TOPIC_TELEMETRY, controlBuffer, size);
+  }
+  if (published) {
+    LOG_I("TELEMETRY", "Snapshot publicado: %u bytes en %s", (unsigned)size, TOPIC_TELEMETRY);
+  } else {
+    LOG_W("TELEMETRY", "No se pudo publicar el snapshot");
+  }
+  return published;
+}
+
+ControlStats holter_getControlStats() {
+  return controlStats;
+}
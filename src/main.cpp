@@ -3,221 +3,764 @@
 #include <XSpaceV21.h>
 #include "holter_capture.h"
 #include "holter_upload.h"
+#include "holter_queue.h"
+#include "holter_stream.h"
+#include "holter_crypto.h"
+#include "holter_offload.h"
+#include "holter_schedule.h"
+#include "holter_events.h"
+#include "holter_power.h"
+#include "holter_log.h"
+#include "holter_trace.h"
+#include "holter_metrics.h"
+#include "holter_hal_esp32.h"
+#include "holter_synth.h"
+#include "display_ui.h"
 
 // ============================================================================
 // OBJETOS PRINCIPALES
 // ============================================================================
 XSpaceBioV10Board MyBioBoard;
 XSpaceV21Board XSBoard; // Mantener por compatibilidad, pero no se usa
+static EcgSynth synth;
+
+// ============================================================================
+// TAREAS
+// ============================================================================
+// La captura corre en el núcleo 1 (APP) y el upload en el núcleo 0 (PRO),
+// junto a la pila WiFi. Así se sigue grabando mientras las sesiones
+// anteriores se suben a S3. Requiere que las derivaciones estén en ADC1
+// (ADC2 no se puede leer con el WiFi encendido).
+#define CAPTURE_CORE 1
+#define UPLOAD_CORE 0
+#define CAPTURE_TASK_PRIORITY 5
+#define UPLOAD_TASK_PRIORITY 2
+
+// Cada cuánto revisar la cola aunque no lleguen sesiones nuevas (reintentos con backoff)
+static const unsigned long QUEUE_POLL_MS = 30000;
+
+// Streaming en vivo por MQTT (ver holter_stream.h). Con el streaming activo
+// la tarea de upload despierta cada STREAM_SERVICE_MS y el WiFi queda encendido
+#define LIVE_STREAM_AT_BOOT false
+static const unsigned long STREAM_SERVICE_MS = 50;
+
+// Grabaciones programadas con deep sleep entre ellas (ver holter_schedule.h).
+// En false el equipo graba de forma continua
+#define SCHEDULE_AT_BOOT false
+
+// Recuperación de errores en el lugar (SD, sesión que no abre): reintentar
+// cada RECOVERY_INTERVAL_MS sin perder WiFi, TLS ni reloj. ESP.restart()
+// queda como último recurso
+static const unsigned long RECOVERY_INTERVAL_MS = 10000;
+static const int MAX_RECOVERY_ATTEMPTS = 6;
+static const unsigned long UPLOAD_GRACE_MS = 120000;   // Upload en curso antes de recuperar
+
+// Light sleep automático entre ráfagas de muestras (ver holter_power.h).
+// Requiere un core de Arduino con CONFIG_PM_ENABLE y tickless idle
+#define LIGHT_SLEEP_AT_BOOT true
+
+// Log diferido (ver holter_log.h). En true la consola emite tramas binarias
+// que se leen con tools/log_decode.py en lugar de texto
+#define LOG_BINARY_AT_BOOT false
+
+// Con HOLTER_TRACE=1 (ver holter_trace.h), un segmento que sale por debajo
+// de esta frecuencia deja la traza de sus últimos eventos en la SD
+#define TRACE_DUMP_BELOW_HZ 249.5f
+static const int TRACE_MAX_DUMPS = 8;                  // Por arranque: no llenar la SD
+
+// ECG sintético (ver holter_synth.h) en lugar de los AD8232: prueba de carga
+// de captura, upload y pantalla sin electrodos. Los segmentos son iguales
+// a los del equipo; el acelerómetro sintético no se graba
+#define SYNTH_ADC_AT_BOOT false
+static const uint32_t SYNTH_SEED = 1;
+
+// El loop duerme en la cola de eventos; estos plazos solo cubren lo que no
+// publica eventos (reporte periódico, fin de la ventana de WiFi, descarga USB)
+static const unsigned long STATUS_LOG_MS = 5000;
+static const unsigned long SLEEP_POLL_MS = 1000;
+
+// Telemetría (ver holter_metrics.h): se publica al final de cada drenado,
+// o cada TELEMETRY_INTERVAL_MS mientras el streaming mantiene el WiFi
+static const unsigned long TELEMETRY_INTERVAL_MS = 60000;
+
+// Espera máxima sobre el socket MQTT mientras llega la URL
+static const unsigned long URL_WAIT_MS = 1000;
+
+static TaskHandle_t captureTaskHandle = nullptr;
+static TaskHandle_t uploadTaskHandle = nullptr;
 
 // ============================================================================
 // ESTADOS DEL SISTEMA
 // ============================================================================
 enum SystemState {
   STATE_INIT,              // Inicialización
-  STATE_CAPTURING,         // Capturando datos ECG
-  STATE_UPLOADING,         // Subiendo a AWS S3
-  STATE_COMPLETE,          // Completado exitosamente
+  STATE_CAPTURING,         // Capturando (y subiendo en segundo plano)
+  STATE_SLEEP_PENDING,     // Grabación programada completa: ventana de WiFi y deep sleep
   STATE_ERROR              // Error en el sistema
 };
 
-SystemState currentState = STATE_INIT;
+volatile SystemState currentState = STATE_INIT;
 String currentFilename = "";
 unsigned long stateStartTime = 0;
 
+// Segmento en el que el paciente apretó el botón: se sube antes que el resto
+static const uint32_t NO_MARKED_SEGMENT = 0xFFFFFFFF;
+static volatile uint32_t markedSegment = NO_MARKED_SEGMENT;
+
+// ============================================================================
+// TAREA DE CAPTURA (núcleo 1)
+// ============================================================================
+
+// Cierra la sesión terminada, arranca la siguiente de inmediato y
+// entrega la terminada a la cola de upload
+static void rotateSession() {
+  uint32_t finishedSegment = holter_getSegmentIndex();
+  holter_stopCapture();
+  String finished = currentFilename;
+  
+  // En modo programado la grabación termina al cumplir su duración
+  bool scheduledEnd = holter_schedule_recordingDone();
+  
+  // Primero reanudar la grabación: la continuidad del registro tiene prioridad
+  bool started = !scheduledEnd && holter_startCapture();
+  if (started) {
+    currentFilename = holter_getCurrentFile();
+  }
+  
+  if (finished.length() > 0) {
+    holter_queue_push(finished, finishedSegment == markedSegment ? QUEUE_FLAG_PRIORITY : 0);
+    if (uploadTaskHandle != nullptr) {
+      xTaskNotifyGive(uploadTaskHandle);
+    }
+  }
+  holter_events_post(EVT_SEGMENT_CLOSED, finishedSegment);
+  
+  if (scheduledEnd) {
+    LOG_I("SCHEDULE", "Grabación programada completa");
+    currentFilename = "";
+    currentState = STATE_SLEEP_PENDING;
+    stateStartTime = millis();
+    holter_events_post(EVT_CAPTURE_STOPPED);
+    return;
+  }
+  
+  if (!started) {
+    LOG_E("ERROR", "No se pudo iniciar la siguiente sesión");
+    currentState = STATE_ERROR;
+    stateStartTime = millis();
+    holter_events_post(EVT_CAPTURE_STOPPED);
+  }
+}
+
+// Abre un segmento y pasa a capturar (arranque y recuperación de errores)
+static bool startSession() {
+  if (!holter_startCapture()) {
+    LOG_E("ERROR", "No se pudo iniciar captura");
+    LOG_E("ERROR", "Revisa los mensajes anteriores para más detalles");
+    return false;
+  }
+  
+  currentFilename = holter_getCurrentFile();
+  LOG_I("OK", "Captura iniciada exitosamente");
+  LOG_I("INFO", "Archivo: %s", currentFilename.c_str());
+  currentState = STATE_CAPTURING;
+  
+  if (captureTaskHandle != nullptr) {
+    xTaskNotifyGive(captureTaskHandle);
+  }
+  return true;
+}
+
+static void captureTask(void* param) {
+  for (;;) {
+    if (currentState != STATE_CAPTURING) {
+      // Nada que muestrear hasta que startSession() despierte la tarea
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    
+    holter_captureLoop();
+    
+    if (!holter_isCapturing()) {
+      LOG_I("CAPTURE", "¡Sesión completada! Iniciando la siguiente...");
+      rotateSession();
+      continue;
+    }
+    
+    // Dormir hasta la próxima muestra (al menos un tick: el escritor de SD y
+    // el watchdog del idle). Entre ráfagas el núcleo queda en idle y puede
+    // entrar en light sleep; el muestreo recupera el atraso en la siguiente vuelta
+    TickType_t ticks = pdMS_TO_TICKS(holter_getNextSampleDelayUs() / 1000);
+    vTaskDelay(max(ticks, (TickType_t)1));
+  }
+}
+
+// ============================================================================
+// TAREA DE UPLOAD (núcleo 0)
+// ============================================================================
+
+static void uploadTask(void* param) {
+  unsigned long lastQueueCheck = 0;
+  unsigned long lastTelemetry = 0;
+  
+  for (;;) {
+    if (!holter_isUploading()) {
+      // Esperar una sesión nueva, el siguiente chequeo de reintentos o el siguiente frame en vivo
+      unsigned long waitMs = holter_stream_isEnabled() ? STREAM_SERVICE_MS : QUEUE_POLL_MS;
+      bool notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs)) > 0;
+      
+      holter_stream_service();
+      
+      if (holter_stream_isEnabled() && millis() - lastTelemetry >= TELEMETRY_INTERVAL_MS &&
+          holter_publishTelemetry()) {
+        lastTelemetry = millis();
+      }
+      
+      if (!notified && millis() - lastQueueCheck < QUEUE_POLL_MS) {
+        continue;
+      }
+      lastQueueCheck = millis();
+      
+      // En modo programado la cola se drena solo dentro de una ventana de WiFi
+      QueueEntry next;
+      if (holter_schedule_uploadAllowed() && holter_queue_next(&next)) {
+        LOG_I("UPLOAD", "Iniciando drenado de la cola...");
+        holter_startQueueDrain();
+      }
+      continue;
+    }
+    
+    holter_uploadLoop();
+    holter_stream_service();
+    
+    if (!holter_isUploading()) {
+      bool drained = holter_getUploadState() == UPLOAD_COMPLETE;
+      holter_events_post(EVT_UPLOAD_DONE, drained ? 1 : 0);
+      
+      if (drained) {
+        LOG_I("UPLOAD", "¡Cola drenada exitosamente!");
+      } else {
+        // Completo, como el banner de error: el log diferido corta los %s
+        holter_log_flush();
+        Serial.println("[UPLOAD] Error en upload: " + holter_getLastError());
+        LOG_I("INFO", "%d sesiones quedan en cola para reintento",
+              holter_queue_depth());
+      }
+      
+      ConnectStats conn = holter_getConnectStats();
+      LOG_I("PERF", "Conexión: WiFi %lu ms (directas %lu, completas %lu), "
+            "NTP omitido %lu/%lu, inicio -> primer byte MQTT %lu ms (max %lu)",
+            (unsigned long)conn.wifi_last_ms, (unsigned long)conn.wifi_fast_joins,
+            (unsigned long)conn.wifi_full_joins, (unsigned long)conn.ntp_skipped,
+            (unsigned long)(conn.ntp_skipped + conn.ntp_syncs),
+            (unsigned long)conn.first_byte_last_ms, (unsigned long)conn.first_byte_max_ms);
+      
+      ControlStats ctrl = holter_getControlStats();
+      LOG_I("PERF", "Control: solicitud %lu bytes (%lu us), respuesta %lu bytes "
+            "(parseo %lu us, max %lu), CBOR %lu/%lu, errores %lu",
+            (unsigned long)ctrl.request_last_bytes, (unsigned long)ctrl.request_build_us,
+            (unsigned long)ctrl.response_last_bytes, (unsigned long)ctrl.response_parse_us,
+            (unsigned long)ctrl.response_parse_max_us, (unsigned long)ctrl.responses_cbor,
+            (unsigned long)(ctrl.responses_cbor + ctrl.responses_json),
+            (unsigned long)ctrl.parse_errors);
+      
+      if (holter_publishTelemetry()) {
+        lastTelemetry = millis();
+      }
+      
+      // Desconectar WiFi para ahorrar energía hasta el próximo drenado
+      // (salvo que el streaming en vivo lo esté usando)
+      if (!holter_stream_isEnabled()) {
+        holter_disconnectWiFi();
+      }
+      continue;
+    }
+    
+    // Esperando la URL la tarea duerme sobre el socket MQTT en vez de girar
+    holter_uploadWait(holter_stream_isEnabled() ? STREAM_SERVICE_MS : URL_WAIT_MS);
+  }
+}
+
+// ============================================================================
+// MÉTRICAS DE THROUGHPUT
+// ============================================================================
+
+static void logThroughput() {
+  static unsigned long lastTime = 0;
+  static unsigned long lastSamples = 0;
+  static uint32_t lastWritten = 0;
+  static uint32_t lastUploaded = 0;
+  
+  unsigned long now = millis();
+  unsigned long samples = holter_getECGSampleCount();
+  CaptureStats capture = holter_getCaptureStats();
+  UploadStats upload = holter_getUploadStats();
+  
+  // Gauges que nadie actualiza por evento: se muestrean con el reporte
+  holter_metrics_set(MG_HEAP_FREE, ESP.getFreeHeap());
+  holter_metrics_set(MG_HEAP_MIN, ESP.getMinFreeHeap());
+  holter_metrics_set(MG_QUEUE_DEPTH, holter_queue_depth());
+  int rssi = holter_isWiFiConnected() ? WiFi.RSSI() : 0;
+  holter_metrics_set(MG_WIFI_RSSI, rssi);
+  if (rssi < 0) {
+    holter_metrics_observe(MH_WIFI_RSSI, -rssi);
+  }
+  
+  // El contador de muestras se reinicia con cada sesión
+  if (samples < lastSamples) {
+    lastSamples = 0;
+  }
+  
+  if (lastTime > 0 && now > lastTime) {
+    float dt = (now - lastTime) / 1000.0;
+    LOG_I("PERF", "Captura: %.1f Hz, SD %.0f B/s (escritura max %lu us, "
+          "espera SD max %lu us, buffers esperados %lu)",
+          (samples - lastSamples) / dt,
+          (capture.bytes_written - lastWritten) / dt,
+          (unsigned long)capture.write_max_us,
+          (unsigned long)capture.sd_wait_max_us,
+          (unsigned long)capture.buffer_waits);
+    static bool bootReported = false;
+    if (!bootReported && capture.first_write_us > 0) {
+      bootReported = true;
+      LOG_I("PERF", "Arranque: primera muestra %lu ms, primera escritura a SD %lu ms "
+            "(%lu muestras en RAM), montaje SD %lu ms",
+            (unsigned long)(capture.first_sample_us / 1000),
+            (unsigned long)(capture.first_write_us / 1000),
+            (unsigned long)capture.ram_samples, (unsigned long)capture.sd_mount_ms);
+    }
+    if (capture.segments > 0) {
+      LOG_I("PERF", "Duty cycle: %.2f%% (%lu segmentos, %lu ms grabados de %lu ms), "
+            "hueco entre segmentos %lu ms (max %lu ms)",
+            capture.wall_ms > 0 ? 100.0 * capture.captured_ms / capture.wall_ms : 0.0,
+            (unsigned long)capture.segments, (unsigned long)capture.captured_ms,
+            (unsigned long)capture.wall_ms, (unsigned long)capture.gap_last_ms,
+            (unsigned long)capture.gap_max_ms);
+    }
+    LOG_I("PERF", "Upload: %s | %.0f B/s en la ventana, último PUT %lu kbps, "
+          "espera SD max %lu us | Cola: %d (%lu bytes)",
+          holter_getUploadStateString().c_str(),
+          (upload.bytes_uploaded - lastUploaded) / dt,
+          (unsigned long)upload.last_kbps,
+          (unsigned long)upload.sd_wait_max_us,
+          holter_queue_depth(), (unsigned long)holter_queue_bytesPending());
+    
+    if (upload.bytes_raw != upload.bytes_uploaded) {
+      LOG_I("PERF", "Compresión: %lu -> %lu bytes, CPU %lu ms",
+            (unsigned long)upload.bytes_raw, (unsigned long)upload.bytes_uploaded,
+            (unsigned long)upload.deflate_ms);
+    }
+    
+    RecordingSync sync;
+    if (holter_queue_getSync(holter_getRecordingID(), &sync)) {
+      LOG_I("PERF", "Sync: grabación %lu, segmento %lu, durable hasta %lu "
+            "(%lu segmentos detrás), %lu confirmados (%lu bytes)",
+            (unsigned long)sync.recording_id, (unsigned long)holter_getSegmentIndex(),
+            (unsigned long)sync.high_water,
+            (unsigned long)(holter_getSegmentIndex() - sync.high_water),
+            (unsigned long)sync.segments_synced, (unsigned long)sync.bytes_synced);
+    }
+    
+    if (holter_crypto_isEnabled()) {
+      CryptoStats crypto = holter_crypto_getStats();
+      LOG_I("PERF", "Cifrado: %lu sesiones, %lu bytes, %.2f MB/s, buffer max %lu us",
+            (unsigned long)crypto.sessions, (unsigned long)crypto.bytes_encrypted,
+            crypto.encrypt_us > 0 ? (float)crypto.bytes_encrypted / crypto.encrypt_us : 0.0f,
+            (unsigned long)crypto.block_max_us);
+    }
+    
+    if (holter_schedule_isEnabled()) {
+      ScheduleStats schedule = holter_schedule_getStats();
+      LOG_I("PERF", "Schedule: ciclo %lu, despertar -> primera muestra %lu ms (max %lu, "
+            "boot %lu ms), último ciclo despierto %lu ms / dormido %lu s, "
+            "ventanas WiFi %lu",
+            (unsigned long)schedule.cycles + 1, (unsigned long)schedule.wake_last_ms,
+            (unsigned long)schedule.wake_max_ms, (unsigned long)schedule.boot_last_ms,
+            (unsigned long)schedule.awake_last_ms,
+            (unsigned long)(schedule.sleep_last_ms / 1000),
+            (unsigned long)schedule.upload_windows);
+    }
+    
+    PowerStats power = holter_power_getStats();
+    EventStats events = holter_events_getStats();
+    LOG_I("PERF", "CPU: idle núcleo 0 %.1f%%, núcleo 1 %.1f%% | light sleep %s "
+          "(%lu ticks dormidos) | eventos %lu (perdidos %lu, latencia max %lu us), "
+          "botón %lu (rebotes %lu)",
+          power.idle_pct[0], power.idle_pct[1], power.light_sleep ? "sí" : "no",
+          (unsigned long)power.sleep_ticks, (unsigned long)events.posted,
+          (unsigned long)events.dropped, (unsigned long)events.latency_max_us,
+          (unsigned long)events.button_clicks, (unsigned long)events.button_bounces);
+    
+    OffloadStats offload = holter_offload_getStats();
+    if (offload.transfers > 0) {
+      LOG_I("PERF", "Offload: %lu transferencias, %lu bytes confirmados, "
+            "tramas %lu (reenviadas %lu), CRC %lu, lectura %lu",
+            (unsigned long)offload.transfers, (unsigned long)offload.bytes_sent,
+            (unsigned long)offload.frames_sent, (unsigned long)offload.frames_resent,
+            (unsigned long)offload.crc_errors, (unsigned long)offload.read_errors);
+    }
+    
+    if (holter_stream_isEnabled()) {
+      StreamStats live = holter_stream_getStats();
+      LOG_I("PERF", "Live: %lu frames (%lu bytes), descartados %lu frames / %lu muestras, "
+            "publish max %lu us, errores %lu",
+            (unsigned long)live.frames_sent, (unsigned long)live.bytes_sent,
+            (unsigned long)live.frames_dropped, (unsigned long)live.samples_dropped,
+            (unsigned long)live.publish_max_us, (unsigned long)live.publish_errors);
+    }
+    
+    MetricsHistogramSnapshot lateness = holter_metrics_getHistogram(MH_SAMPLE_LATENESS_US);
+    MetricsHistogramSnapshot sdWrite = holter_metrics_getHistogram(MH_SD_WRITE_US);
+    LOG_I("PERF", "Métricas: heap libre %ld (mínimo %ld), RSSI %ld dBm | atraso de muestra "
+          "max %lu us, escritura SD max %lu us | uploads %lu ok, %lu fallidos",
+          (long)holter_metrics_getGauge(MG_HEAP_FREE), (long)holter_metrics_getGauge(MG_HEAP_MIN),
+          (long)rssi, (unsigned long)lateness.max, (unsigned long)sdWrite.max,
+          (unsigned long)holter_metrics_getCounter(MC_UPLOADS_OK),
+          (unsigned long)holter_metrics_getCounter(MC_UPLOADS_FAILED));
+    
+    LogStats logs = holter_log_getStats();
+    LOG_I("PERF", "Log: %lu registros, %lu ciclos promedio (max %lu), perdidos %lu, "
+          "cortados %lu, ring max %lu bytes",
+          (unsigned long)logs.records,
+          (unsigned long)(logs.records > 0 ? logs.cycles_total / logs.records : 0),
+          (unsigned long)logs.cycles_max, (unsigned long)logs.dropped,
+          (unsigned long)logs.truncated, (unsigned long)logs.ring_max_bytes);
+    
+    // Por modo, en varias líneas: va directo a Serial
+    display_printStats();
+
+#if HOLTER_TRACE
+    TraceStats trace = holter_trace_getStats();
+    LOG_I("PERF", "Trace: %lu eventos, %lu puntos de traza, %lu tareas, %lu volcados",
+          (unsigned long)trace.events, (unsigned long)trace.names,
+          (unsigned long)trace.tasks, (unsigned long)trace.dumps);
+#endif
+  }
+  
+  lastTime = now;
+  lastSamples = samples;
+  lastWritten = capture.bytes_written;
+  lastUploaded = upload.bytes_uploaded;
+}
+
 // ============================================================================
 // SETUP
 // ============================================================================
 void setup() {
-  Serial.begin(115200);
-  delay(2000); // Delay más largo para estabilizar Serial
- 
-  Serial.println("\n\n========================================");
-  Serial.println("HOLTER ECG SYSTEM v2.0");
-  Serial.println("========================================");
-  Serial.println("[INFO] ESP32 Holter Monitoring System");
-  Serial.println("[INFO] ECG 3-lead @ 250Hz");
-  Serial.println("[INFO] Auto-capture y auto-upload a AWS");
-  Serial.println("========================================\n");
+  // Mismo puerto para los logs y la descarga por USB (ver holter_offload.h)
+  Serial.setRxBufferSize(OFFLOAD_RX_BUFFER);
+  Serial.setTxBufferSize(OFFLOAD_TX_BUFFER);
+  Serial.begin(OFFLOAD_BAUD);
+  holter_log_init(LOG_BINARY_AT_BOOT);
+  
+  // Primero el estado en RTC. Sin esperas por el monitor serie: cada una
+  // retrasa la primera muestra (el buffer de TX guarda los logs)
+  holter_schedule_init(SCHEDULE_AT_BOOT);
+  bool wokeUp = holter_schedule_getWakeReason() != WAKE_POWER_ON;
+  
+  if (!wokeUp) {
+    Serial.println("\n\n========================================");
+    Serial.println("HOLTER ECG SYSTEM v2.0");
+    Serial.println("========================================");
+    Serial.println("[INFO] ESP32 Holter Monitoring System");
+    Serial.println("[INFO] ECG 3-lead @ 250Hz");
+    Serial.println("[INFO] Captura continua y upload en paralelo a AWS");
+    Serial.println("========================================\n");
+    holter_log_benchmark();
+  }
   
   // Inicializar módulos
-  Serial.println("[SETUP] Inicializando módulos...");
+  LOG_I("SETUP", "Inicializando módulos...");
+  
+  // Bus de eventos y botón por interrupción (el pin ya salió del dominio
+  // RTC), antes de las tareas que publican
+  holter_events_init();
+  holter_power_init(LIGHT_SLEEP_AT_BOOT);
+  
+  // Clave del equipo para cifrar las sesiones. Antes que la captura: la
+  // semilla de las claves de sesión usa el SAR ADC que después lee el ECG
+  holter_crypto_init();
   
-  // Primero inicializar captura (SD Card)
+  // Después inicializar captura (la SD se monta en segundo plano)
   holter_init(&MyBioBoard, nullptr); // nullptr porque IMU no se usa
+  if (SYNTH_ADC_AT_BOOT) {
+    SynthConfig config;
+    config.seed = SYNTH_SEED;
+    synth.begin(config);
+    hal_esp32_setSynth(&synth);
+    LOG_W("SETUP", "ECG sintético (semilla %lu) en lugar de los AD8232", (unsigned long)SYNTH_SEED);
+  }
   
-  // Luego inicializar upload (WiFi/MQTT)
-  holter_initUpload();
+  // La captura arranca en RAM sin esperar a la SD, y antes que la cola, el
+  // upload y la descarga por USB: nada de eso hace falta para la primera muestra
+  LOG_I("SYSTEM", "Iniciando captura automática...");
+  if (!startSession()) {
+    currentState = STATE_ERROR;
+  }
+  stateStartTime = millis();
+  
+  xTaskCreatePinnedToCore(captureTask, "capture", 6144, nullptr,
+                          CAPTURE_TASK_PRIORITY, &captureTaskHandle, CAPTURE_CORE);
   
-  Serial.println("[SETUP] Sistema inicializado\n");
+  // Pantalla con la captura ya corriendo: la prueba del panel y el splash no
+  // retrasan la primera muestra. Sin panel sigue sin pantalla
+  display_init(&MyBioBoard);
   
-  // Verificar si SD está disponible
-  if (!holter_isSDAvailable()) {
+  // Unirse al montaje: la cola necesita la SD. Si falla, el segmento en RAM
+  // se corta solo y la rotación pasa a STATE_ERROR
+  if (!holter_waitForSD()) {
     Serial.println("[ERROR] SD Card no disponible");
     Serial.println("[ERROR] El sistema requiere SD Card para funcionar");
     Serial.println("[INFO] Por favor:");
     Serial.println("  1. Verifica que la tarjeta SD esté insertada");
     Serial.println("  2. Verifica que esté formateada en FAT32");
     Serial.println("  3. Verifica las conexiones SPI");
-    Serial.println("  4. Presiona RESET para reintentar");
-    currentState = STATE_ERROR;
-    stateStartTime = millis();
-    return;
+    Serial.println("[INFO] Se reintentará montarla sin reiniciar");
   }
   
-  // Pequeño delay antes de iniciar captura
-  Serial.println("[INFO] Iniciando captura en 3 segundos...");
-  delay(3000);
+  // Cola persistente de uploads (requiere SD montada; no toca el segmento en curso)
+  holter_queue_init();
   
-  // Iniciar captura automáticamente
-  Serial.println("[SYSTEM] Iniciando captura automática...\n");
+  // Luego inicializar upload (WiFi/MQTT)
+  holter_initUpload();
   
-  if (holter_startCapture()) {
-    currentFilename = holter_getCurrentFile();
-    Serial.println("[OK] Captura iniciada exitosamente");
-    Serial.println("[INFO] Archivo: " + currentFilename + "\n");
-    currentState = STATE_CAPTURING;
-  } else {
-    Serial.println("[ERROR] No se pudo iniciar captura");
-    Serial.println("[ERROR] Revisa los mensajes anteriores para más detalles");
-    currentState = STATE_ERROR;
-  }
+  // Descarga por USB-serie cuando no hay WiFi
+  holter_offload_init();
   
-  stateStartTime = millis();
+  LOG_I("SETUP", "Sistema inicializado");
+  
+  // El streaming en vivo necesita el WiFi siempre encendido
+  holter_stream_setEnabled(LIVE_STREAM_AT_BOOT && !holter_schedule_isEnabled());
+  
+  xTaskCreatePinnedToCore(uploadTask, "upload", 12288, nullptr,
+                          UPLOAD_TASK_PRIORITY, &uploadTaskHandle, UPLOAD_CORE);
+  
+  // Subir de inmediato lo que haya quedado pendiente de sesiones anteriores
+  xTaskNotifyGive(uploadTaskHandle);
 }
 
 // ============================================================================
 // LOOP PRINCIPAL
 // ============================================================================
+// La captura y el upload corren en sus propias tareas; el loop solo
+// supervisa, reporta throughput y maneja el estado de error. Duerme en la
+// cola de eventos hasta que algo cambia o vence el plazo que fija cada estado
+
+#if HOLTER_TRACE
+// Escribe a la SD tomando el lock en cada write(): el volcado no frena al
+// escritor de la captura más que una línea por vez
+class LockedFilePrint : public Print {
+public:
+  explicit LockedFilePrint(File& file) : file(file) {}
+  
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+  
+  size_t write(const uint8_t* buffer, size_t size) override {
+    holter_sdLock();
+    size_t written = file.write(buffer, size);
+    holter_sdUnlock();
+    return written;
+  }
+
+private:
+  File& file;
+};
+
+// Un segmento lento deja la traza de lo que le quitó tiempo al muestreo:
+// en la SD junto a las sesiones, o en la consola si no hay SD
+static void dumpSlowSegmentTrace(uint32_t segment) {
+  static int dumps = 0;
+  CaptureStats capture = holter_getCaptureStats();
+  if (capture.last_rate_hz >= TRACE_DUMP_BELOW_HZ || dumps >= TRACE_MAX_DUMPS) return;
+  dumps++;
+  
+  char label[64];
+  snprintf(label, sizeof(label), "recording %lu segment %lu %.1f Hz",
+           (unsigned long)holter_getRecordingID(), (unsigned long)segment, capture.last_rate_hz);
+  
+  if (holter_isSDAvailable()) {
+    char path[48];
+    snprintf(path, sizeof(path), "/trace_%lu_%lu.txt",
+             (unsigned long)holter_getRecordingID(), (unsigned long)segment);
+    holter_sdLock();
+    File file = SD.open(path, FILE_WRITE);
+    holter_sdUnlock();
+    if (file) {
+      LockedFilePrint out(file);
+      uint32_t events = holter_trace_dump(out, label);
+      holter_sdLock();
+      file.close();
+      holter_sdUnlock();
+      LOG_W("TRACE", "Segmento %lu a %.1f Hz: %lu eventos en %s", (unsigned long)segment,
+            capture.last_rate_hz, (unsigned long)events, path);
+      return;
+    }
+  }
+  
+  holter_log_flush();
+  holter_trace_dump(Serial, label);
+}
+#endif
+
+static void handleEvent(const HolterEvent& event) {
+  switch (event.type) {
+    case EVT_BUTTON:
+      // Evento del paciente: el segmento en curso se sube antes que el resto
+      if (currentState == STATE_CAPTURING && holter_isCapturing()) {
+        markedSegment = holter_getSegmentIndex();
+        LOG_I("EVENT", "Botón: segmento %lu marcado como prioritario",
+              (unsigned long)markedSegment);
+      }
+      break;
+    
+    case EVT_SEGMENT_CLOSED:
+#if HOLTER_TRACE
+      dumpSlowSegmentTrace(event.param);
+#endif
+      break;
+    
+    case EVT_CAPTURE_STOPPED:
+    case EVT_UPLOAD_DONE:
+      // Solo despiertan al loop: la máquina de estados corre a continuación
+      break;
+  }
+}
+
 void loop() {
+  static unsigned long waitMs = 0;
+  
+  HolterEvent event;
+  if (holter_events_wait(&event, waitMs)) {
+    handleEvent(event);
+  }
+  waitMs = 0;
+  
   switch(currentState) {
     
     // ========================================================================
     // ESTADO: CAPTURING
     // ========================================================================
     case STATE_CAPTURING: {
-      // Ejecutar loop de captura
-      holter_captureLoop();
-      
-      // Verificar si terminó
-      if (!holter_isCapturing()) {
-        Serial.println("\n[CAPTURE] ¡Captura completada!");
-        
-        // Asegurar cierre
-        holter_stopCapture();
-        
-        // Verificar que el archivo existe y tiene datos
-        if (currentFilename.length() == 0) {
-          Serial.println("[ERROR] No hay archivo para subir");
-          currentState = STATE_ERROR;
-          break;
-        }
-        
-        Serial.println("[SYSTEM] Preparando para upload...\n");
-        delay(1000);
-        
-        // Iniciar upload
-        Serial.println("[UPLOAD] Iniciando proceso de upload...");
-        if (holter_startUpload(currentFilename)) {
-          Serial.println("[OK] Upload iniciado");
-          currentState = STATE_UPLOADING;
-        } else {
-          Serial.println("[ERROR] No se pudo iniciar upload");
-          currentState = STATE_ERROR;
-        }
-        
-        stateStartTime = millis();
+      static unsigned long lastStatusLog = 0;
+      unsigned long sinceLog = millis() - lastStatusLog;
+      if (sinceLog >= STATUS_LOG_MS) {
+        logThroughput();
+        lastStatusLog = millis();
+        sinceLog = 0;
       }
+      waitMs = STATUS_LOG_MS - sinceLog;
       break;
     }
-   
+    
     // ========================================================================
-    // ESTADO: UPLOADING
+    // ESTADO: SLEEP_PENDING
     // ========================================================================
-    case STATE_UPLOADING: {
-      // Ejecutar loop de upload
-      holter_uploadLoop();
+    case STATE_SLEEP_PENDING: {
+      static bool windowChecked = false;
       
-      // Mostrar estado periódicamente
-      static unsigned long lastStatusLog = 0;
-      if (millis() - lastStatusLog > 5000) {
-        String status = holter_getUploadStateString();
-        float progress = holter_getUploadProgress();
-        Serial.printf("[STATUS] %s (%.0f%%)\n", status.c_str(), progress * 100);
-        lastStatusLog = millis();
+      if (!windowChecked) {
+        windowChecked = true;
+        if (holter_schedule_uploadDue()) {
+          LOG_I("SCHEDULE", "Ventana de WiFi: %d sesiones en cola (%lu bytes)",
+                holter_queue_depth(), (unsigned long)holter_queue_bytesPending());
+          holter_schedule_openUploadWindow();
+          xTaskNotifyGive(uploadTaskHandle);
+        }
       }
       
-      // Verificar si terminó
-      if (!holter_isUploading()) {
-        UploadState uploadState = holter_getUploadState();
-        
-        if (uploadState == UPLOAD_COMPLETE) {
-          Serial.println("\n[UPLOAD] ¡Upload completado exitosamente!");
-          currentState = STATE_COMPLETE;
-        } else if (uploadState == UPLOAD_ERROR) {
-          Serial.println("\n[UPLOAD] Error en upload");
-          String error = holter_getLastError();
-          if (error.length() > 0) {
-            Serial.println("[ERROR] " + error);
-          }
-          currentState = STATE_ERROR;
-        }
-        
-        stateStartTime = millis();
+      // Drenar mientras queden sesiones elegibles (las que fallan esperan su
+      // backoff al próximo ciclo) y no se agote la ventana
+      QueueEntry next;
+      bool draining = holter_isUploading() ||
+                      (holter_schedule_uploadAllowed() && holter_queue_next(&next));
+      if (draining && !holter_schedule_windowExpired()) {
+        waitMs = SLEEP_POLL_MS;     // EVT_UPLOAD_DONE despierta antes
+        break;
       }
+      if (holter_isUploading()) {
+        LOG_I("SCHEDULE", "Ventana de WiFi agotada: lo pendiente sigue en cola");
+      }
+      
+      // Una descarga por USB en curso posterga el deep sleep
+      if (holter_offload_isActive()) {
+        waitMs = SLEEP_POLL_MS;
+        break;
+      }
+      
+      holter_schedule_sleep();
       break;
     }
-   
-    // ========================================================================
-    // ESTADO: COMPLETE
-    // ========================================================================
-    case STATE_COMPLETE: {
-      // Desconectar WiFi para ahorrar energía
-      holter_disconnectWiFi();
-      
-      Serial.println("\n========================================");
-      Serial.println("✓ SESIÓN COMPLETADA EXITOSAMENTE");
-      Serial.println("========================================");
-      Serial.println("[INFO] Archivo capturado y subido a AWS S3");
-      Serial.println("[INFO] El sistema se reiniciará en 10 segundos");
-      Serial.println("[INFO] para iniciar una nueva sesión...");
-      Serial.println("========================================\n");
-      
-      delay(10000);
-      
-      Serial.println("[SYSTEM] Reiniciando ESP32...\n");
-      delay(1000);
-      ESP.restart();
-      break;
-    }
-   
+    
     // ========================================================================
     // ESTADO: ERROR
     // ========================================================================
     case STATE_ERROR: {
-      // Desconectar WiFi si estaba conectado
-      if (holter_isWiFiConnected()) {
-        holter_disconnectWiFi();
+      static int recoveryAttempts = 0;
+      static unsigned long reportedAt = 0;
+      
+      // Dejar terminar un upload en curso: las sesiones ya grabadas no se
+      // pierden. EVT_UPLOAD_DONE despierta al loop cuando termina
+      unsigned long inState = millis() - stateStartTime;
+      if (holter_isUploading() && inState < UPLOAD_GRACE_MS) {
+        waitMs = UPLOAD_GRACE_MS - inState;
+        break;
+      }
+      
+      if (recoveryAttempts == 0 && reportedAt != stateStartTime) {
+        reportedAt = stateStartTime;
+        
+        Serial.println("\n========================================");
+        Serial.println("✗ ERROR EN EL SISTEMA");
+        Serial.println("========================================");
+        
+        String error = holter_getLastError();
+        if (error.length() > 0) {
+          Serial.println("[ERROR] " + error);
+        }
+        
+        if (holter_queue_depth() > 0) {
+          Serial.printf("[INFO] %d sesiones quedan en cola para reintento\n",
+                        holter_queue_depth());
+        }
+        
+        Serial.printf("[INFO] Reintento de la captura en %lu segundos (sin reiniciar)\n",
+                      RECOVERY_INTERVAL_MS / 1000);
+        Serial.println("========================================\n");
       }
       
-      Serial.println("\n========================================");
-      Serial.println("✗ ERROR EN EL SISTEMA");
-      Serial.println("========================================");
+      if (inState < RECOVERY_INTERVAL_MS) {
+        waitMs = RECOVERY_INTERVAL_MS - inState;
+        break;
+      }
+      
+      // Recuperar en el lugar: la SD se vuelve a montar solo si hace falta
+      recoveryAttempts++;
+      LOG_I("SYSTEM", "Recuperación %d/%d...", recoveryAttempts, MAX_RECOVERY_ATTEMPTS);
       
-      String error = holter_getLastError();
-      if (error.length() > 0) {
-        Serial.println("[ERROR] " + error);
+      if (!holter_isSDAvailable() && holter_remountSD()) {
+        holter_queue_init();    // Recargar la cola y recuperar lo que quedó en la SD
       }
       
-      Serial.println("\n[INFO] El sistema se reiniciará en 30 segundos");
-      Serial.println("[INFO] para intentar recuperarse...");
-      Serial.println("========================================\n");
+      if (holter_isSDAvailable() && startSession()) {
+        LOG_I("SYSTEM", "Captura recuperada sin reiniciar");
+        recoveryAttempts = 0;
+        stateStartTime = millis();
+        break;
+      }
       
-      delay(30000);
+      if (recoveryAttempts >= MAX_RECOVERY_ATTEMPTS) {
+        LOG_I("SYSTEM", "Sin recuperación posible, reiniciando ESP32...");
+        if (holter_isWiFiConnected()) {
+          holter_disconnectWiFi();
+        }
+        holter_log_flush();
+        delay(1000);
+        ESP.restart();
+      }
       
-      Serial.println("[SYSTEM] Reiniciando ESP32...\n");
-      delay(1000);
-      ESP.restart();
+      stateStartTime = millis();
       break;
     }
     
@@ -226,13 +769,10 @@ void loop() {
     // ========================================================================
     case STATE_INIT:
     default: {
-      Serial.println("[WARNING] Estado inválido, reiniciando...");
-      delay(1000);
-      ESP.restart();
+      LOG_W("WARNING", "Estado inválido, pasando a recuperación...");
+      currentState = STATE_ERROR;
+      stateStartTime = millis();
       break;
     }
   }
-  
-  // Yield para el watchdog
-  yield();
-}
\ No newline at end of file
+}
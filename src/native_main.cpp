@@ -0,0 +1,322 @@
+// Captura en el host (env:native)
+//
+// Corre el núcleo de la captura del firmware (src/holter_segment.cpp, el
+// mismo que llama holter_capture.cpp) sobre la HAL de Linux
+// (src/hal_native.cpp): la muestra, el llenado de bloques y los headers al
+// abrir y cerrar cada segmento, con el mismo formato y nombre que en la SD.
+// El reloj del muestreo y la escritura de cada bloque son propios: en el
+// equipo van por la tarea de captura y el escritor de SD (FreeRTOS), que
+// no se portan, igual que el cifrado, el catálogo y el trailer de
+// métricas. Con el reloj virtual no espera entre muestras: sirve para
+// perfilar y para comparar corridas sin hardware.
+//
+// Compilar y ejecutar:
+//   pio run -e native && .pio/build/native/program [opciones]
+// o sin PlatformIO (desde la raíz del repo):
+//   g++ -O2 -Iinclude src/native_main.cpp src/hal_native.cpp src/holter_segment.cpp src/holter_format.cpp src/holter_synth.cpp -o holter_native
+//
+// Opciones:
+//   --seconds N        segundos de señal a capturar (por defecto 60)
+//   --replay FILE      reproduce las muestras de una sesión en claro (sin fuente: línea de base)
+//   --loop             con --replay, vuelve a empezar al terminar el archivo
+//   --synth SEED       ECG sintético de holter_synth.h con esa semilla
+//   --hr BPM           con --synth, FC de base (por defecto 70)
+//   --out DIR          directorio que hace de SD (por defecto el actual)
+//   --start UNIX       timestamp de la grabación (por defecto la hora actual)
+//   --realtime         reloj real: una muestra cada 4 ms, como el equipo
+//   --upload HOST:PORT PUT por HTTP de cada segmento cerrado a un servidor local
+
+#include "holter_hal_native.h"
+#include "holter_segment.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <string>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+static const int SEGMENT_SECONDS = SEGMENT_DURATION_SEC;
+static const int BUFFER_SIZE = SEGMENT_BLOCK_SIZE;
+static const uint32_t SAMPLE_INTERVAL_US = 1000000 / SESSION_ECG_RATE_HZ;
+static const uint32_t UPLOAD_TIMEOUT_MS = 5000;
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct Options {
+  uint32_t seconds = 60;
+  const char* replay = nullptr;
+  bool loop = false;
+  bool synth = false;
+  SynthConfig synthConfig;
+  const char* out = ".";
+  uint32_t start = 0;
+  bool realtime = false;
+  std::string uploadHost;
+  uint16_t uploadPort = 0;
+};
+
+// Tiempo de CPU por etapa (reloj real, aunque la captura use el virtual)
+struct Profile {
+  uint64_t samples = 0;
+  uint64_t bytes = 0;
+  uint32_t segments = 0;
+  uint32_t uploads = 0;
+  double sampleNs = 0;         // ADC y conversión
+  double appendNs = 0;         // Llenado del bloque, sin la escritura
+  double writeNs = 0;
+  double closeNs = 0;
+};
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point since) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - since).count();
+}
+
+// Mismo nombre que holter_segmentFilename()
+static std::string segmentPath(uint32_t recording, uint32_t segment) {
+  char name[40];
+  snprintf(name, sizeof(name), "/session_%lu_s%04lu.bin",
+           (unsigned long)recording, (unsigned long)segment);
+  return name;
+}
+
+// PUT del archivo completo; devuelve el código HTTP (0 = sin respuesta)
+static int uploadSegment(const Options& options, const std::string& path) {
+  HalFile* file = hal_file_open(path.c_str(), "r");
+  if (file == nullptr) return 0;
+  uint32_t size = hal_file_size(file);
+  
+  HalSocket* socket = hal_net_connect(options.uploadHost.c_str(), options.uploadPort, UPLOAD_TIMEOUT_MS);
+  if (socket == nullptr) {
+    hal_file_close(file);
+    return 0;
+  }
+  
+  char request[256];
+  int len = snprintf(request, sizeof(request),
+                     "PUT %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/octet-stream\r\n"
+                     "Content-Length: %lu\r\nConnection: close\r\n\r\n",
+                     path.c_str(), options.uploadHost.c_str(), (unsigned long)size);
+  bool ok = hal_net_send(socket, request, len);
+  
+  uint8_t chunk[BUFFER_SIZE];
+  size_t n;
+  while (ok && (n = hal_file_read(file, chunk, sizeof(chunk))) > 0) {
+    ok = hal_net_send(socket, chunk, n);
+  }
+  hal_file_close(file);
+  
+  int status = 0;
+  char response[64];
+  int received = ok ? hal_net_recv(socket, response, sizeof(response) - 1, UPLOAD_TIMEOUT_MS) : -1;
+  if (received > 0) {
+    response[received] = '\0';
+    sscanf(response, "HTTP/%*s %d", &status);
+  }
+  hal_net_close(socket);
+  return status;
+}
+
+// Destino de los bloques llenos (el escritor de SD en el equipo)
+struct BlockWriter {
+  HalFile* file;
+  Profile* profile;
+};
+
+static void writeBlock(SegmentBlock* block, void* context) {
+  BlockWriter* writer = (BlockWriter*)context;
+  Clock::time_point t0 = Clock::now();
+  hal_file_write(writer->file, block->data, block->index);
+  writer->profile->writeNs += elapsedNs(t0);
+  block->index = 0;
+}
+
+// Un segmento: headers, muestras a SESSION_ECG_RATE_HZ hasta completar
+// SEGMENT_SECONDS (o hasta que se termine la señal) y contador al cerrar
+// @return false si se terminó la señal
+static bool captureSegment(const Options& options, uint32_t recording, uint32_t segment,
+                           uint32_t samplesLeft, Profile* profile) {
+  std::string path = segmentPath(recording, segment);
+  HalFile* file = hal_file_open(path.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "No se pudo crear %s en %s\n", path.c_str(), options.out);
+    exit(1);
+  }
+  
+  SessionInfo info;
+  memset(&info, 0, sizeof(info));
+  info.segment_start_ms = hal_millis();
+  if (!holter_segment_writeHeaders(file, recording, recording + segment * SEGMENT_SECONDS, &info)) {
+    fprintf(stderr, "No se pudieron escribir los headers de %s\n", path.c_str());
+    exit(1);
+  }
+  
+  static uint8_t buffer[BUFFER_SIZE];
+  SegmentBlock block = { buffer, BUFFER_SIZE, 0 };
+  BlockWriter writer = { file, profile };
+  uint32_t count = 0;
+  uint32_t target = SESSION_ECG_RATE_HZ * SEGMENT_SECONDS;
+  if (samplesLeft < target) target = samplesLeft;
+  bool signal = true;
+  uint32_t due = hal_micros();
+  
+  while (count < target) {
+    int32_t wait = (int32_t)(due - hal_micros());
+    if (wait > 0) hal_delayUs(wait);
+    due += SAMPLE_INTERVAL_US;
+    
+    Clock::time_point t0 = Clock::now();
+    ECGSample sample;
+    signal = holter_segment_readSample(&sample);
+    profile->sampleNs += elapsedNs(t0);
+    if (!signal) break;
+    
+    count++;
+    
+    // Como en la captura del equipo; el tiempo de escritura de los bloques
+    // llenos se descuenta aparte
+    double writeBefore = profile->writeNs;
+    t0 = Clock::now();
+    holter_segment_append(&block, &sample, sizeof(sample), writeBlock, &writer);
+    profile->appendNs += elapsedNs(t0) - (profile->writeNs - writeBefore);
+  }
+  
+  Clock::time_point t0 = Clock::now();
+  if (block.index > 0) hal_file_write(file, block.data, block.index);
+  holter_segment_patchHeaders(file, count, 0, &info);
+  hal_file_flush(file);
+  hal_file_close(file);
+  profile->closeNs += elapsedNs(t0);
+  
+  // La señal terminó justo en el borde del segmento anterior
+  if (count == 0) {
+    hal_fs_remove(path.c_str());
+    return false;
+  }
+  
+  profile->samples += count;
+  profile->bytes += sizeof(FileHeader) + sizeof(SessionInfo) + count * sizeof(ECGSample);
+  profile->segments++;
+  
+  if (options.uploadPort != 0) {
+    int status = uploadSegment(options, path);
+    if (status >= 200 && status < 300) {
+      profile->uploads++;
+    } else {
+      fprintf(stderr, "Upload de %s: %s %d\n", path.c_str(), status ? "HTTP" : "sin respuesta", status);
+    }
+  }
+  return signal;
+}
+
+static void usage(const char* program) {
+  fprintf(stderr, "Uso: %s [--seconds N] [--replay FILE [--loop] | --synth SEED [--hr BPM]]\n"
+                  "          [--out DIR] [--start UNIX] [--realtime] [--upload HOST:PORT]\n", program);
+  exit(2);
+}
+
+static Options parseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(arg, "--seconds") && hasValue) {
+      options.seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(arg, "--replay") && hasValue) {
+      options.replay = argv[++i];
+    } else if (!strcmp(arg, "--loop")) {
+      options.loop = true;
+    } else if (!strcmp(arg, "--synth") && hasValue) {
+      options.synth = true;
+      options.synthConfig.seed = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(arg, "--hr") && hasValue) {
+      options.synthConfig.heart_rate_bpm = atof(argv[++i]);
+    } else if (!strcmp(arg, "--out") && hasValue) {
+      options.out = argv[++i];
+    } else if (!strcmp(arg, "--start") && hasValue) {
+      options.start = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(arg, "--realtime")) {
+      options.realtime = true;
+    } else if (!strcmp(arg, "--upload") && hasValue) {
+      std::string target = argv[++i];
+      size_t colon = target.rfind(':');
+      if (colon == std::string::npos) usage(argv[0]);
+      options.uploadHost = target.substr(0, colon);
+      options.uploadPort = (uint16_t)atoi(target.c_str() + colon + 1);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (options.start == 0) options.start = (uint32_t)time(nullptr);
+  return options;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+  
+  hal_native_setStorageRoot(options.out);
+  hal_native_setRealtime(options.realtime);
+  
+  ReplaySource replay;
+  SynthSource synth;
+  if (options.replay != nullptr) {
+    if (!replay.open(options.replay, options.loop)) {
+      fprintf(stderr, "No se pudo leer %s (¿cifrada o sin muestras?)\n", options.replay);
+      return 1;
+    }
+    hal_native_setAdcSource(&replay);
+    printf("Reproduciendo %s: %u muestras\n", options.replay, replay.samples());
+  } else if (options.synth) {
+    synth.begin(options.synthConfig);
+    hal_native_setAdcSource(&synth);
+    printf("ECG sintético: semilla %u, %.0f lpm\n", options.synthConfig.seed,
+           options.synthConfig.heart_rate_bpm);
+  }
+  hal_adc_begin();
+  
+  Profile profile;
+  Clock::time_point start = Clock::now();
+  uint32_t samplesLeft = options.seconds * SESSION_ECG_RATE_HZ;
+  
+  for (uint32_t segment = 0; samplesLeft > 0; segment++) {
+    uint64_t before = profile.samples;
+    bool signal = captureSegment(options, options.start, segment, samplesLeft, &profile);
+    samplesLeft -= (uint32_t)(profile.samples - before);
+    if (!signal) break;
+  }
+  
+  double wallS = elapsedNs(start) / 1e9;
+  double signalS = (double)profile.samples / SESSION_ECG_RATE_HZ;
+  double perSample = profile.samples > 0 ? 1.0 / profile.samples : 0;
+  
+  printf("%u segmentos, %llu muestras (%.1f s de señal) en %.3f s: %.0fx tiempo real\n",
+         profile.segments, (unsigned long long)profile.samples, signalS, wallS,
+         wallS > 0 ? signalS / wallS : 0.0);
+  printf("Por muestra: ADC y conversión %.1f ns | bloque %.1f ns | escritura %.1f ns | cierre %.1f ns\n",
+         profile.sampleNs * perSample, profile.appendNs * perSample,
+         profile.writeNs * perSample, profile.closeNs * perSample);
+  printf("%.1f KB escritos en %s", profile.bytes / 1024.0, options.out);
+  if (options.uploadPort != 0) {
+    printf(" | %u/%u segmentos subidos a %s:%u", profile.uploads, profile.segments,
+           options.uploadHost.c_str(), options.uploadPort);
+  }
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+Compara dos corridas de los microbenchmarks (ver include/holter_bench.h)
+
+Cada archivo puede ser el JSON de tools/kernel_bench (--benchmark_format=json)
+o la captura de la consola del arnés del ESP32 (env:bench), de la que se toma
+el documento que sigue a "[BENCH] JSON". Si las dos corridas traen ciclos por
+iteración se comparan los ciclos (no dependen de la frecuencia de la CPU); si
+no, el tiempo.
+
+Cada kernel se compara por su mediana, y la dispersión decide si el cambio es
+real: en el host, la de las repeticiones (--benchmark_repetitions, al menos
+MIN_REPETITIONS); en el ESP32, la de los lotes. Un kernel empeoró si:
+  - la mediana subió más que --threshold,
+  - el primer cuartil nuevo quedó por encima del tercero de la base (las
+    mitades centrales no se superponen), y
+  - la mejor repetición también subió más que --threshold (la carga de la
+    máquina solo agrega tiempo: el mínimo es lo menos ruidoso).
+Sin repeticiones no hay dispersión: el cambio se muestra, pero no cuenta
+como empeoramiento. El umbral por defecto es 10%: entre dos procesos del
+mismo binario en el host, los kernels de pocos ns corren todas sus
+repeticiones hasta un 5% más lentos o más rápidos (alineación, frecuencia),
+y eso las repeticiones de una corrida no lo ven.
+
+Sale con código 1 si algún kernel empeoró.
+
+Uso:
+  ./kernel_bench --benchmark_format=json --benchmark_repetitions=10 > base.json
+  python3 tools/bench_compare.py base.json nuevo.json
+  python3 tools/bench_compare.py --threshold 3 base.log esp32.log
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+JSON_MARKER = '[BENCH] JSON'
+MIN_REPETITIONS = 3
+TIME_UNITS = {'ns': 1.0, 'us': 1e3, 'ms': 1e6, 's': 1e9}
+
+
+def load(path):
+    with open(path, encoding='utf-8', errors='replace') as f:
+        text = f.read()
+
+    # Captura de la consola: el último documento de la suite
+    marker = text.rfind(JSON_MARKER)
+    if marker >= 0:
+        text = text[marker + len(JSON_MARKER):]
+    start = text.find('{')
+    if start < 0:
+        raise ValueError(f"{path}: no tiene resultados")
+    document, _ = json.JSONDecoder().raw_decode(text[start:])
+    return document
+
+
+def spread(values):
+    """{mediana, mínimo, cuartiles}; sin dispersión con pocas repeticiones"""
+    if len(values) < MIN_REPETITIONS:
+        return {'median': statistics.median(values)}
+    q1, _, q3 = statistics.quantiles(values, n=4)
+    return {'median': statistics.median(values), 'min': min(values), 'q1': q1, 'q3': q3}
+
+
+def regressed(before, after, threshold):
+    """True/False según la regla del encabezado; None si falta dispersión"""
+    if 'q1' not in before or 'q1' not in after:
+        return None
+    return (after['median'] > before['median'] * (1 + threshold / 100.0) and
+            after['q1'] > before['q3'] and
+            after['min'] > before['min'] * (1 + threshold / 100.0))
+
+
+def results(document):
+    """nombre -> {'ns': spread, 'cycles': spread o None}; None si el kernel se salteó"""
+    runs = {}
+    medians = {}
+    for entry in document.get('benchmarks', []):
+        name = entry.get('run_name', entry['name'])
+        if entry.get('error_occurred'):
+            runs[name] = None
+            continue
+        ns = entry['real_time'] * TIME_UNITS.get(entry.get('time_unit', 'ns'), 1.0)
+        if entry.get('run_type') == 'aggregate':
+            # Con --benchmark_report_aggregates_only solo queda la mediana
+            if entry.get('aggregate_name') == 'median':
+                medians[name] = ns
+            continue
+        if name in runs and runs[name] is None:
+            continue
+        runs.setdefault(name, []).append(entry)
+
+    merged = {name: None for name, entries in runs.items() if entries is None}
+    for name, median in medians.items():
+        if name not in runs:
+            merged[name] = {'ns': {'median': median}, 'cycles': None}
+    for name, entries in runs.items():
+        if entries is None:
+            continue
+        result = {'ns': spread([e['real_time'] * TIME_UNITS.get(e.get('time_unit', 'ns'), 1.0)
+                                for e in entries]),
+                  'cycles': None}
+        if all('cycles' in e for e in entries):
+            e = entries[0]
+            if len(entries) == 1 and 'cycles_q1' in e:
+                # Arnés del ESP32: mediana, mínimo y cuartiles de los lotes
+                result['cycles'] = {'median': e['cycles'], 'min': e['cycles_min'],
+                                    'q1': e['cycles_q1'], 'q3': e['cycles_q3']}
+            else:
+                result['cycles'] = spread([e['cycles'] for e in entries])
+        merged[name] = result
+    return merged
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('base', help='corrida de referencia (JSON o captura de la consola)')
+    parser.add_argument('new', help='corrida a comparar')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='cambio mínimo de la mediana en %% (por defecto 10)')
+    args = parser.parse_args()
+
+    try:
+        documents = [load(args.base), load(args.new)]
+    except (OSError, ValueError) as e:
+        sys.exit(str(e))
+    base, new = (results(d) for d in documents)
+
+    platforms = [d.get('context', {}).get('platform', '?') for d in documents]
+    if platforms[0] != platforms[1]:
+        print(f"Aviso: plataformas distintas ({platforms[0]} / {platforms[1]})", file=sys.stderr)
+
+    regressions = []
+    ungated = []
+    print(f"{'kernel':24} {'base':>12} {'nuevo':>12} {'cambio':>9}")
+    for name in sorted(set(base) | set(new)):
+        before = base.get(name)
+        after = new.get(name)
+        if before is None or after is None:
+            state = 'no disponible' if name in base and name in new else \
+                    ('solo en base' if name in base else 'solo en nuevo')
+            print(f"{name:24} {state:>35}")
+            continue
+
+        if before['cycles'] is not None and after['cycles'] is not None:
+            old, value, unit = before['cycles'], after['cycles'], 'ciclos'
+        else:
+            old, value, unit = before['ns'], after['ns'], 'ns'
+        change = (value['median'] - old['median']) / old['median'] * 100.0 if old['median'] > 0 else 0.0
+
+        flag = ''
+        worse = regressed(old, value, args.threshold)
+        if worse is None:
+            if abs(change) > args.threshold:
+                flag = '  (sin repeticiones)'
+                ungated.append(name)
+        elif worse:
+            flag = '  <- peor'
+            regressions.append(name)
+        elif regressed(value, old, args.threshold):
+            flag = '  mejor'
+        print(f"{name:24} {old['median']:12.1f} {value['median']:12.1f} {change:+8.1f}% {unit}{flag}")
+
+    if ungated:
+        print(f"\nSin dispersión para {', '.join(ungated)}: correr con --benchmark_repetitions=N "
+              f"(N >= {MIN_REPETITIONS}) para que cuenten", file=sys.stderr)
+    if regressions:
+        print(f"\n{len(regressions)} kernels empeoraron más de {args.threshold:g}% "
+              f"y por encima de la dispersión: " + ', '.join(regressions))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,351 @@
+// Benchmark en el host del catálogo de sesiones (src/holter_catalog_store.cpp)
+//
+// Arma en un directorio temporal N segmentos con los nombres del firmware y
+// su catálogo, y resuelve las mismas consultas que hace el firmware de las
+// dos formas: con el catálogo y recorriendo el directorio como antes.
+//   - buscar un segmento que existe y uno que no (SD.exists / high-water mark)
+//   - listar los pendientes para recuperar la cola (openNextFile abre cada entrada)
+//   - cargar el catálogo al arrancar y reconstruirlo desde el directorio
+//
+// El directorio del host está en la page cache y su readdir es mucho más
+// rápido que el de FAT por SPI, así que además del tiempo se informan los
+// bytes que cada forma tiene que leer de la tarjeta: en FAT cada nombre
+// largo del firmware ocupa 4 entradas de 32 bytes en el directorio.
+//
+// Compilar y ejecutar (desde la raíz del repo):
+//   g++ -O2 -Iinclude tools/catalog_bench.cpp src/holter_catalog_store.cpp src/holter_offload_proto.cpp -o catalog_bench
+//   ./catalog_bench [--sessions 10000] [--lookups 2000] [--dir /ruta/vacía]
+
+#include "holter_catalog_store.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+static const uint32_t SEGMENTS_PER_RECORDING = 5760;   // Como RECORDING_MAX_SEGMENTS
+static const uint32_t SEGMENT_SECONDS = 15;
+static const uint32_t FAT_ENTRY_BYTES = 4 * 32;        // LFN de 28 caracteres + entrada 8.3
+static const uint32_t FIRST_RECORDING = 1718000000;
+
+static uint32_t sessions = 10000;
+static uint32_t lookups = 2000;
+static std::string dir;                 // Por defecto uno nuevo en /tmp
+
+// ============================================================================
+// ADAPTADORES
+// ============================================================================
+
+// El archivo del catálogo en el host. Cuenta lo leído para compararlo con
+// lo que recorre un listado del directorio
+class PosixCatalogFile : public CatalogFile {
+public:
+  bool open(const std::string& path, bool truncate) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    return fd >= 0;
+  }
+  
+  void close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+  }
+  
+  bool read(uint32_t offset, void* data, size_t len) override {
+    reads++;
+    bytesRead += len;
+    return pread(fd, data, len, offset) == (ssize_t)len;
+  }
+  
+  bool write(uint32_t offset, const void* data, size_t len) override {
+    return pwrite(fd, data, len, offset) == (ssize_t)len;
+  }
+  
+  uint32_t size() override {
+    struct stat st;
+    return fstat(fd, &st) == 0 ? (uint32_t)st.st_size : 0;
+  }
+  
+  uint64_t reads = 0;
+  uint64_t bytesRead = 0;
+
+private:
+  int fd = -1;
+};
+
+// ============================================================================
+// FUNCIONES INTERNAS
+// ============================================================================
+
+static double nowMs() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string segmentPath(uint32_t recording, uint32_t segment) {
+  char name[64];
+  snprintf(name, sizeof(name), "/session_%lu_s%04lu.bin",
+           (unsigned long)recording, (unsigned long)segment);
+  return dir + name;
+}
+
+static void keyOf(uint32_t n, uint32_t* recording, uint32_t* segment) {
+  uint32_t r = n / SEGMENTS_PER_RECORDING;
+  *recording = FIRST_RECORDING + r * SEGMENTS_PER_RECORDING * SEGMENT_SECONDS;
+  *segment = n % SEGMENTS_PER_RECORDING;
+}
+
+static bool parseName(const char* name, uint32_t* recording, uint32_t* segment) {
+  unsigned long rec;
+  unsigned long seg;
+  int consumed = 0;
+  if (sscanf(name, "session_%lu_s%lu.bin%n", &rec, &seg, &consumed) != 2 ||
+      consumed == 0 || name[consumed] != '\0') {
+    return false;
+  }
+  *recording = rec;
+  *segment = seg;
+  return true;
+}
+
+// Lo que hace SD.exists() en FAT: recorrer las entradas hasta dar con el nombre
+static bool scanExists(const char* wanted, uint64_t* entries) {
+  DIR* d = opendir(dir.c_str());
+  bool found = false;
+  struct dirent* e;
+  while (!found && (e = readdir(d)) != nullptr) {
+    (*entries)++;
+    found = strcmp(e->d_name, wanted) == 0;
+  }
+  closedir(d);
+  return found;
+}
+
+// Lo que hacía recoverOrphans(): openNextFile() abre cada entrada
+static uint32_t scanList(uint64_t* entries) {
+  DIR* d = opendir(dir.c_str());
+  uint32_t count = 0;
+  struct dirent* e;
+  while ((e = readdir(d)) != nullptr) {
+    (*entries)++;
+    std::string path = dir + "/" + e->d_name;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    struct stat st;
+    uint32_t recording;
+    uint32_t segment;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && parseName(e->d_name, &recording, &segment)) {
+      count++;
+    }
+    ::close(fd);
+  }
+  closedir(d);
+  return count;
+}
+
+static bool makeSessions(PosixCatalogFile& file) {
+  mkdir(dir.c_str(), 0755);
+  SessionCatalog catalog(file);
+  if (!catalog.create(FIRST_RECORDING)) return false;
+  
+  uint8_t header[64] = {0};
+  for (uint32_t n = 0; n < sessions; n++) {
+    uint32_t recording;
+    uint32_t segment;
+    keyOf(n, &recording, &segment);
+    
+    int fd = ::open(segmentPath(recording, segment).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ::write(fd, header, sizeof(header)) != (ssize_t)sizeof(header)) return false;
+    ::close(fd);
+    
+    // Como la captura: se registra al abrir y se completa al cerrar
+    CatalogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.recording_id = recording;
+    record.segment = segment;
+    record.time_start = recording + segment * SEGMENT_SECONDS;
+    record.state = CATALOG_RECORDING;
+    if (catalog.put(&record) < 0) return false;
+    
+    record.size = 45000;
+    record.time_end = record.time_start + SEGMENT_SECONDS;
+    record.state = n + 1 < sessions ? CATALOG_COMPLETE : CATALOG_RECORDING;
+    if (catalog.put(&record) < 0) return false;
+  }
+  return true;
+}
+
+static void removeSessions() {
+  for (uint32_t n = 0; n < sessions; n++) {
+    uint32_t recording;
+    uint32_t segment;
+    keyOf(n, &recording, &segment);
+    unlink(segmentPath(recording, segment).c_str());
+  }
+  unlink((dir + "/catalog.dat").c_str());
+  rmdir(dir.c_str());
+}
+
+static void printRow(const char* name, double ms, uint32_t ops, uint64_t bytes) {
+  printf("  %-34s %10.4f ms/op  %12.0f bytes/op\n", name, ms / ops, (double)bytes / ops);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--sessions") && i + 1 < argc) {
+      sessions = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--lookups") && i + 1 < argc) {
+      lookups = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--dir") && i + 1 < argc) {
+      dir = argv[++i];
+    } else {
+      fprintf(stderr, "Uso: %s [--sessions N] [--lookups N] [--dir RUTA]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (sessions < 2 || lookups == 0) return 1;
+  if (dir.empty()) {
+    char temp[] = "/tmp/catalog_bench.XXXXXX";
+    if (mkdtemp(temp) == nullptr) return 1;
+    dir = temp;
+  }
+  
+  PosixCatalogFile file;
+  std::string catalogPath = dir + "/catalog.dat";
+  mkdir(dir.c_str(), 0755);
+  if (!file.open(catalogPath, true) || !makeSessions(file)) {
+    fprintf(stderr, "[ERROR] No se pudieron crear las sesiones en %s\n", dir.c_str());
+    removeSessions();
+    return 1;
+  }
+  printf("[BENCH] %u sesiones en %s, catálogo de %u bytes\n\n",
+         sessions, dir.c_str(), file.size());
+  
+  // Carga (arranque del equipo)
+  SessionCatalog catalog(file);
+  file.bytesRead = 0;
+  double start = nowMs();
+  CatalogStatus status = catalog.load();
+  double loadMs = nowMs() - start;
+  if (status != CATALOG_OK || catalog.records() != sessions) {
+    fprintf(stderr, "[ERROR] Catálogo inválido (%d, %u registros)\n", status, catalog.records());
+    removeSessions();
+    return 2;
+  }
+  printf("  %-34s %10.3f ms     %12llu bytes (%u corridas en RAM)\n", "carga del catálogo",
+         loadMs, (unsigned long long)file.bytesRead, catalog.runs());
+  
+  std::mt19937 random(1);
+  std::vector<uint32_t> targets(lookups);
+  for (uint32_t& t : targets) t = random() % sessions;
+  
+  // Búsqueda de un segmento que existe
+  printf("\n  %-34s %13s  %18s\n", "búsqueda de un segmento", "tiempo", "leído de la SD");
+  file.bytesRead = 0;
+  uint32_t hits = 0;
+  start = nowMs();
+  for (uint32_t t : targets) {
+    uint32_t recording;
+    uint32_t segment;
+    keyOf(t, &recording, &segment);
+    CatalogRecord record;
+    if (catalog.find(recording, segment, &record) >= 0 && record.segment == segment) hits++;
+  }
+  printRow("catálogo", nowMs() - start, lookups, file.bytesRead);
+  
+  uint64_t entries = 0;
+  uint32_t dirLookups = lookups < 200 ? lookups : 200;
+  start = nowMs();
+  for (uint32_t i = 0; i < dirLookups; i++) {
+    uint32_t recording;
+    uint32_t segment;
+    keyOf(targets[i], &recording, &segment);
+    std::string path = segmentPath(recording, segment);
+    scanExists(path.c_str() + dir.size() + 1, &entries);
+  }
+  printRow("directorio (SD.exists)", nowMs() - start, dirLookups, entries * FAT_ENTRY_BYTES);
+  
+  // Un segmento que ya no está (high-water mark sobre lo subido)
+  printf("\n  %-34s\n", "búsqueda de un segmento borrado");
+  file.bytesRead = 0;
+  start = nowMs();
+  for (uint32_t i = 0; i < lookups; i++) {
+    catalog.find(FIRST_RECORDING - 1, i, nullptr);
+  }
+  printRow("catálogo", nowMs() - start, lookups, file.bytesRead);
+  
+  entries = 0;
+  start = nowMs();
+  for (uint32_t i = 0; i < dirLookups; i++) {
+    scanExists("session_1_s0000.bin", &entries);
+  }
+  printRow("directorio (SD.exists)", nowMs() - start, dirLookups, entries * FAT_ENTRY_BYTES);
+  
+  // Pendientes para llenar la cola: el catálogo se detiene a los 64
+  printf("\n  %-34s\n", "pendientes para la cola (64)");
+  file.bytesRead = 0;
+  start = nowMs();
+  uint32_t cursor = 0;
+  uint32_t pending = 0;
+  CatalogRecord record;
+  while (pending < 64 && catalog.next(&cursor, CATALOG_PENDING_MASK, &record)) pending++;
+  printRow("catálogo", nowMs() - start, 1, file.bytesRead);
+  
+  entries = 0;
+  start = nowMs();
+  uint32_t listed = scanList(&entries);
+  printRow("directorio (openNextFile)", nowMs() - start, 1, entries * FAT_ENTRY_BYTES);
+  
+  // Reconstrucción: lo que cuesta un catálogo corrupto. FAT lista en orden
+  // de creación y el readdir del host no: se ordena como saldría de la SD
+  PosixCatalogFile rebuilt;
+  rebuilt.open(dir + "/catalog.rebuild", true);
+  SessionCatalog fresh(rebuilt);
+  fresh.create(FIRST_RECORDING);
+  start = nowMs();
+  std::vector<std::pair<uint32_t, uint32_t>> found;
+  DIR* d = opendir(dir.c_str());
+  struct dirent* e;
+  while ((e = readdir(d)) != nullptr) {
+    uint32_t recording;
+    uint32_t segment;
+    if (parseName(e->d_name, &recording, &segment)) found.push_back(std::make_pair(recording, segment));
+  }
+  closedir(d);
+  std::sort(found.begin(), found.end());
+  for (const auto& key : found) {
+    memset(&record, 0, sizeof(record));
+    record.recording_id = key.first;
+    record.segment = key.second;
+    record.state = CATALOG_COMPLETE;
+    fresh.add(&record);
+  }
+  double rebuildMs = nowMs() - start;
+  rebuilt.close();
+  unlink((dir + "/catalog.rebuild").c_str());
+  printf("\n  %-34s %10.3f ms     (%u registros, %u corridas)\n", "reconstrucción desde el directorio",
+         rebuildMs, fresh.records(), fresh.runs());
+  
+  bool ok = hits == lookups && listed == sessions && fresh.records() == sessions;
+  printf("\n[BENCH] %s\n", ok ? "Resultados consistentes" : "FALLA: el catálogo y el directorio no coinciden");
+  
+  file.close();
+  removeSessions();
+  return ok ? 0 : 2;
+}
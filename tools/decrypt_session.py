@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""
+Descifra sesiones copiadas directamente de la SD (header versión 2, o 3 cifrado)
+
+Deja al lado de cada archivo un .plain.bin en versión 1, que se puede
+analizar con las mismas herramientas que las sesiones sin cifrar. El
+snapshot de métricas del final del segmento (si lo tiene) no se copia.
+
+Uso (requiere: pip install cryptography):
+  python3 tools/decrypt_session.py --key <DEVICE_KEY_HEX> /ruta/session_*.bin
+"""
+
+import argparse
+import struct
+import sys
+
+from cryptography.hazmat.primitives.keywrap import aes_key_unwrap
+from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+
+HEADER_SIZE = 28
+INFO_SIZE = 24              # SessionInfo de la versión 3
+SESSION_FLAG_ENCRYPTED = 0x01
+SESSION_FLAG_METRICS = 0x02   # Snapshot de métricas en claro después de las muestras
+SAMPLE_SIZE = 6
+ENC_FORMAT = '<IBBH16s40s'
+ENC_SIZE = struct.calcsize(ENC_FORMAT)
+ENC_MAGIC = 0x31434E45  # "ENC1"
+
+
+def decrypt(data, device_key):
+    version = struct.unpack_from('<H', data, 4)[0]
+    flags = struct.unpack_from('<I', data, HEADER_SIZE)[0] if version == 3 else 0
+    if flags & SESSION_FLAG_ENCRYPTED:
+        enc_offset = HEADER_SIZE + INFO_SIZE
+    elif version == 2:
+        enc_offset = HEADER_SIZE
+    else:
+        raise ValueError(f"no está cifrado (versión {version})")
+
+    magic, algorithm, key_id, _, iv, wrapped_key = struct.unpack_from(ENC_FORMAT, data, enc_offset)
+    if magic != ENC_MAGIC or algorithm != 1:
+        raise ValueError(f"extensión de cifrado no soportada (magic 0x{magic:08X}, algoritmo {algorithm})")
+
+    # Falla con InvalidUnwrap si la clave no es la del equipo
+    session_key = aes_key_unwrap(device_key, wrapped_key)
+    decryptor = Cipher(algorithms.AES(session_key), modes.CTR(iv)).decryptor()
+    start = enc_offset + ENC_SIZE
+    end = len(data)
+    if flags & SESSION_FLAG_METRICS:
+        num_ecg, num_imu = struct.unpack_from('<II', data, 20)
+        end = start + (num_ecg + num_imu) * SAMPLE_SIZE
+    samples = decryptor.update(data[start:end]) + decryptor.finalize()
+
+    header = bytearray(data[:HEADER_SIZE])
+    struct.pack_into('<H', header, 4, 1)
+    return key_id, bytes(header) + samples
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--key', required=True, help='DEVICE_KEY_HEX del equipo (64 dígitos hex)')
+    parser.add_argument('files', nargs='+')
+    args = parser.parse_args()
+
+    device_key = bytes.fromhex(args.key)
+    if len(device_key) != 32:
+        sys.exit("La clave debe tener 64 dígitos hex")
+
+    failures = 0
+    for path in args.files:
+        try:
+            with open(path, 'rb') as f:
+                key_id, plain = decrypt(f.read(), device_key)
+        except Exception as e:
+            print(f"{path}: ERROR {type(e).__name__} {e}")
+            failures += 1
+            continue
+
+        out = path[:-4] + '.plain.bin' if path.endswith('.bin') else path + '.plain.bin'
+        with open(out, 'wb') as f:
+            f.write(plain)
+        print(f"{path}: clave {key_id}, {len(plain) - HEADER_SIZE} bytes de muestras -> {out}")
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,196 @@
+// Benchmark en el host del compresor de uploads (src/holter_deflate.cpp)
+//
+// Mide, sobre sesiones reales copiadas de la SD, la razón de compresión y el
+// tiempo de CPU, y lo compara con zlib. Con esos datos estima desde qué
+// velocidad de subida la compresión deja de pagar frente al tiempo de aire WiFi.
+//
+// Compilar y ejecutar (desde la raíz del repo):
+//   g++ -O2 -Iinclude tools/deflate_bench.cpp src/holter_deflate.cpp -lz -o deflate_bench
+//   ./deflate_bench [--slowdown F] [--uplink KBPS] /ruta/session_*.bin
+//
+// --slowdown: cuántas veces más lento es el ESP32 que este host para el
+// encoder. Calibrarlo con el deflate_ms que reporta el log [PERF] del equipo
+// para una sesión conocida (por defecto 25).
+// --uplink: throughput típico del PUT a S3 (log [S3] ... kbps), por defecto 1000.
+//
+// Los tamaños de ventana y bloque se pueden variar sin tocar el código:
+//   g++ -O2 -DDEFLATE_WINDOW_BITS=10 -DDEFLATE_BLOCK_BYTES=4096 ...
+
+#include "holter_deflate.h"
+#include <zlib.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+static const int ITERATIONS = 20;
+static double slowdown = 25.0;
+static double uplinkKbps = 1000.0;
+
+// ============================================================================
+// FUNCIONES INTERNAS
+// ============================================================================
+
+static DeflateEncoder encoder;
+
+static void appendSink(const uint8_t* data, size_t len, void* context) {
+  std::vector<uint8_t>* out = (std::vector<uint8_t>*)context;
+  out->insert(out->end(), data, data + len);
+}
+
+static double nowMs() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>* data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + n);
+  }
+  fclose(f);
+  return true;
+}
+
+// Igual que el upload: la entrada llega en bloques de DEFLATE_MAX_WRITE
+static void compressHolter(const std::vector<uint8_t>& input, std::vector<uint8_t>* out) {
+  out->clear();
+  encoder.begin(appendSink, out);
+  for (size_t i = 0; i < input.size(); i += DEFLATE_MAX_WRITE) {
+    size_t n = input.size() - i;
+    if (n > DEFLATE_MAX_WRITE) n = DEFLATE_MAX_WRITE;
+    encoder.write(input.data() + i, n);
+  }
+  encoder.finish();
+}
+
+static void compressZlib(const std::vector<uint8_t>& input, std::vector<uint8_t>* out,
+                         int level, int windowBits) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  deflateInit2(&zs, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+  out->resize(deflateBound(&zs, input.size()));
+  zs.next_in = (Bytef*)input.data();
+  zs.avail_in = input.size();
+  zs.next_out = out->data();
+  zs.avail_out = out->size();
+  deflate(&zs, Z_FINISH);
+  out->resize(zs.total_out);
+  deflateEnd(&zs);
+}
+
+static bool verify(const std::vector<uint8_t>& input, const std::vector<uint8_t>& compressed) {
+  std::vector<uint8_t> back(input.size() + 1);
+  uLongf backSize = back.size();
+  int result = uncompress(back.data(), &backSize, compressed.data(), compressed.size());
+  return result == Z_OK && backSize == input.size() &&
+         memcmp(back.data(), input.data(), input.size()) == 0;
+}
+
+// Mejor tiempo de ITERATIONS corridas (ms)
+template <typename F>
+static double timeBest(F run) {
+  double best = 1e30;
+  for (int i = 0; i < ITERATIONS; i++) {
+    double start = nowMs();
+    run();
+    double elapsed = nowMs() - start;
+    if (elapsed < best) best = elapsed;
+  }
+  return best;
+}
+
+static void printRow(const char* name, size_t raw, size_t compressed, double ms) {
+  double mbps = ms > 0 ? (raw / 1e6) / (ms / 1e3) : 0;
+  printf("  %-22s %8zu  %6.3f  %8.3f ms  %7.1f MB/s\n",
+         name, compressed, (double)compressed / raw, ms, mbps);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  std::vector<const char*> files;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--slowdown") && i + 1 < argc) {
+      slowdown = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--uplink") && i + 1 < argc) {
+      uplinkKbps = atof(argv[++i]);
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  
+  if (files.empty()) {
+    fprintf(stderr, "Uso: %s [--slowdown F] [--uplink KBPS] session_*.bin...\n", argv[0]);
+    return 1;
+  }
+  
+  printf("[BENCH] Encoder: ventana %d B, bloque %d B, cadena %d, memoria %zu B\n",
+         DEFLATE_WINDOW_SIZE, DEFLATE_BLOCK_BYTES, DEFLATE_MAX_CHAIN, sizeof(DeflateEncoder));
+  printf("[BENCH] ESP32 = host x%.1f, uplink %.0f kbps\n\n", slowdown, uplinkKbps);
+  
+  size_t totalRaw = 0;
+  size_t totalCompressed = 0;
+  double totalMs = 0;
+  bool allOk = true;
+  
+  for (const char* path : files) {
+    std::vector<uint8_t> input;
+    if (!readFile(path, &input) || input.empty()) {
+      fprintf(stderr, "[ERROR] No se pudo leer %s\n", path);
+      allOk = false;
+      continue;
+    }
+    
+    std::vector<uint8_t> out;
+    printf("%s (%zu bytes)\n", path, input.size());
+    printf("  %-22s %8s  %6s  %11s  %12s\n", "", "bytes", "ratio", "CPU", "velocidad");
+    
+    double holterMs = timeBest([&] { compressHolter(input, &out); });
+    bool ok = verify(input, out);
+    allOk &= ok;
+    printRow(ok ? "holter_deflate" : "holter_deflate (FALLA)", input.size(), out.size(), holterMs);
+    size_t holterSize = out.size();
+    
+    double ms = timeBest([&] { compressZlib(input, &out, 1, DEFLATE_WINDOW_BITS); });
+    printRow("zlib -1 (misma ventana)", input.size(), out.size(), ms);
+    ms = timeBest([&] { compressZlib(input, &out, 6, 15); });
+    printRow("zlib -6 (32 KB)", input.size(), out.size(), ms);
+    
+    totalRaw += input.size();
+    totalCompressed += holterSize;
+    totalMs += holterMs;
+    printf("\n");
+  }
+  
+  if (totalRaw == 0) return 1;
+  
+  // El upload comprime dos veces: una para el Content-Length y otra al enviar
+  double cpuMs = 2 * totalMs * slowdown;
+  double savedBytes = (double)totalRaw - (double)totalCompressed;
+  double airtimeSavedMs = savedBytes * 8 / uplinkKbps;
+  double breakEvenKbps = cpuMs > 0 ? savedBytes * 8 / cpuMs : 0;
+  
+  printf("[BENCH] Total: %zu -> %zu bytes (%.3f)\n",
+         totalRaw, totalCompressed, (double)totalCompressed / totalRaw);
+  printf("[BENCH] ESP32 estimado: %.1f ms de CPU vs %.1f ms de aire ahorrados a %.0f kbps\n",
+         cpuMs, airtimeSavedMs, uplinkKbps);
+  if (savedBytes <= 0) {
+    printf("[BENCH] La compresión no reduce estos archivos: no conviene\n");
+  } else {
+    printf("[BENCH] Conviene comprimir si el uplink es menor a %.0f kbps -> %s\n",
+           breakEvenKbps, uplinkKbps < breakEvenKbps ? "SÍ" : "NO");
+  }
+  
+  return allOk ? 0 : 2;
+}
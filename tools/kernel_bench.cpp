@@ -0,0 +1,87 @@
+// Microbenchmarks en el host de los kernels de captura y upload (src/holter_bench.cpp)
+//
+// Corre la tabla de holter_bench.h con Google Benchmark, sobre la HAL de
+// Linux: capture.adc mide solo la llamada a la HAL (el ADC del host es una
+// constante) y sd.write escribe en la page cache. Los números del ESP32
+// salen del arnés del equipo (env:bench) con el mismo JSON.
+//
+// Compilar y ejecutar (desde la raíz del repo):
+//   g++ -O2 -Iinclude tools/kernel_bench.cpp src/holter_bench.cpp src/holter_segment.cpp src/holter_format.cpp src/holter_synth.cpp src/holter_deflate.cpp src/holter_offload_proto.cpp src/hal_native.cpp -lbenchmark -lpthread -o kernel_bench
+//   ./kernel_bench [--dir /tmp] --benchmark_format=json --benchmark_repetitions=10 > host.json
+//
+// --dir: directorio para el archivo de sd.write y capture.header (por defecto /tmp).
+// El resto de las opciones son las de Google Benchmark (--benchmark_filter,
+// --benchmark_repetitions, --benchmark_out=FILE --benchmark_out_format=json, ...).
+// Comparar dos corridas: python3 tools/bench_compare.py base.json nuevo.json (con las
+// repeticiones, que dan la dispersión con la que decide si un cambio es real)
+
+#include "holter_bench.h"
+#include "holter_hal_native.h"
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static const char* unitName(uint8_t unit) {
+  switch (unit) {
+    case BENCH_PER_SAMPLE: return "sample";
+    case BENCH_PER_BLOCK: return "block";
+    case BENCH_PER_SEGMENT: return "segment";
+    default: return "?";
+  }
+}
+
+// La preparación queda fuera del lazo medido
+static void runKernel(benchmark::State& state, const BenchKernel* kernel) {
+  if (!kernel->setup()) {
+    state.SkipWithError("no disponible");
+    return;
+  }
+  
+  for (auto _ : state) {
+    kernel->run();
+  }
+  
+  if (kernel->teardown != nullptr) kernel->teardown();
+  state.SetItemsProcessed(state.iterations());
+  if (kernel->bytes > 0) state.SetBytesProcessed(state.iterations() * kernel->bytes);
+  state.SetLabel(unitName(kernel->unit));
+  benchmark::DoNotOptimize(holter_bench_sink());
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  const char* dir = "/tmp";
+  int kept = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--dir") && i + 1 < argc) {
+      dir = argv[++i];
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argc = kept;
+  hal_native_setStorageRoot(dir);
+  
+  size_t count;
+  const BenchKernel* kernels = holter_bench_kernels(&count);
+  for (size_t i = 0; i < count; i++) {
+    benchmark::RegisterBenchmark(kernels[i].name, runKernel, &kernels[i]);
+  }
+  
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::AddCustomContext("platform", "host");
+  benchmark::AddCustomContext("block_size", std::to_string(BENCH_BLOCK_SIZE));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
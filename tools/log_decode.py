@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""
+Decodifica el log binario del equipo (LOG_BINARY_AT_BOOT true, ver holter_log.h)
+
+Cada trama trae la dirección del formato en flash en lugar del texto: se
+busca en el firmware.elf del mismo build. Lo que no es una trama (el banner
+de arranque, los logs que siguen siendo Serial) pasa tal cual.
+
+Uso:
+  python3 tools/log_decode.py --elf .pio/build/esp32dev/firmware.elf captura.bin
+  python3 tools/log_decode.py --elf .pio/build/esp32dev/firmware.elf /dev/ttyUSB0
+  cat captura.bin | python3 tools/log_decode.py --elf firmware.elf -
+
+Con un puerto serie hay que fijar antes la velocidad (stty -F /dev/ttyUSB0 921600 raw).
+"""
+
+import argparse
+import re
+import struct
+import sys
+import zlib
+
+LOG_SYNC = b'\xB7\x7B'
+LOG_MAX_RECORD = 96
+RECORD_HEADER = '<IIB'          # fmt(4) | timestamp_us(4) | level(1)
+RECORD_HEADER_SIZE = struct.calcsize(RECORD_HEADER)
+LOG_RECORD_TRUNCATED = 0x80
+LEVELS = {1: 'E', 2: 'W', 3: 'I', 4: 'D'}
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+# Conversión de printf: flags, ancho, precisión, longitud, tipo
+SPEC = re.compile(r'%(%|[-+ #0]*\d*(?:\.\d*)?)([hlzjt]*)([diouxXcsfFeEgG]?)')
+
+
+class Elf:
+    """Lee cadenas en las secciones cargadas de un ELF (32 o 64 bits, little endian)"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError(f"{path} no es un ELF")
+        is64 = self.data[4] == 2
+        if is64:
+            shoff, = struct.unpack_from('<Q', self.data, 0x28)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x3A)
+            section = '<IIQQQQ'
+        else:
+            shoff, = struct.unpack_from('<I', self.data, 0x20)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2E)
+            section = '<IIIIII'
+
+        self.sections = []
+        for i in range(shnum):
+            _, kind, flags, addr, offset, size = struct.unpack_from(section, self.data, shoff + i * shentsize)
+            if flags & SHF_ALLOC and kind != SHT_NOBITS and size > 0:
+                self.sections.append((addr, offset, size))
+        self.cache = {}
+
+    def string(self, address):
+        if address in self.cache:
+            return self.cache[address]
+        text = None
+        for addr, offset, size in self.sections:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.find(b'\0', start, offset + size)
+                if end >= 0:
+                    text = self.data[start:end].decode('utf-8', errors='replace')
+                break
+        self.cache[address] = text
+        return text
+
+
+def format_record(fmt, args):
+    """Arma el texto recorriendo las conversiones del formato, como holter_log.cpp"""
+    pos = 0
+
+    def take(size):
+        nonlocal pos
+        if pos + size > len(args):
+            raise IndexError
+        value = args[pos:pos + size]
+        pos += size
+        return value
+
+    def convert(match):
+        flags, length, conv = match.groups()
+        if flags == '%':
+            return '%'
+        if not conv:
+            return match.group(0)
+        try:
+            if conv == 's':
+                size = take(1)[0]
+                return ('%' + flags + 's') % take(size).decode('utf-8', errors='replace')
+            if conv in 'fFeEgG':
+                return ('%' + flags + conv) % struct.unpack('<f', take(4))[0]
+            wide = length.count('l') >= 2
+            signed = conv in 'di'
+            code = ('<q' if signed else '<Q') if wide else ('<i' if signed else '<I')
+            value = struct.unpack(code, take(8 if wide else 4))[0]
+            return ('%' + flags + ('d' if conv in 'iu' else conv)) % value
+        except IndexError:
+            return '<?>'
+
+    return SPEC.sub(convert, fmt)
+
+
+def decode(stream, elf, out):
+    buffer = b''
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buffer += chunk
+
+        while True:
+            start = buffer.find(LOG_SYNC)
+            if start < 0:
+                # Puede haber quedado el primer byte del sync al final
+                keep = 1 if buffer.endswith(LOG_SYNC[:1]) else 0
+                out.write(buffer[:len(buffer) - keep].decode('utf-8', errors='replace'))
+                buffer = buffer[len(buffer) - keep:]
+                break
+
+            out.write(buffer[:start].decode('utf-8', errors='replace'))
+            buffer = buffer[start:]
+            if len(buffer) < 4:
+                break
+            length, = struct.unpack_from('<H', buffer, 2)
+            if not RECORD_HEADER_SIZE <= length <= LOG_MAX_RECORD:
+                out.write(buffer[:1].decode('latin-1'))
+                buffer = buffer[1:]
+                continue
+            if len(buffer) < 4 + length + 4:
+                break
+
+            record = buffer[4:4 + length]
+            crc, = struct.unpack_from('<I', buffer, 4 + length)
+            if zlib.crc32(record) != crc:
+                # No era una trama (o llegó corrupta): se resincroniza un byte más adelante
+                out.write(buffer[:1].decode('latin-1'))
+                buffer = buffer[1:]
+                continue
+            buffer = buffer[4 + length + 4:]
+
+            address, timestamp, level = struct.unpack_from(RECORD_HEADER, record)
+            fmt = elf.string(address)
+            if fmt is None:
+                text = f"<formato 0x{address:08X} no está en el ELF: ¿es el mismo build?>"
+            else:
+                text = format_record(fmt, record[RECORD_HEADER_SIZE:])
+            mark = ' (cortado)' if level & LOG_RECORD_TRUNCATED else ''
+            out.write(f"{timestamp / 1e6:12.6f} {LEVELS.get(level & 0x7F, '?')} {text}{mark}\n")
+            out.flush()
+
+    out.write(buffer.decode('utf-8', errors='replace'))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--elf', required=True, help='firmware.elf del build que corre en el equipo')
+    parser.add_argument('input', help="captura del puerto serie, el puerto mismo o '-' para stdin")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    try:
+        if args.input == '-':
+            decode(sys.stdin.buffer, elf, sys.stdout)
+        else:
+            with open(args.input, 'rb', buffering=0) as stream:
+                decode(stream, elf, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,528 @@
+// Cliente de Linux para descargar sesiones por USB-serie, sin WiFi ni SD a mano
+//
+// Habla con el firmware (src/holter_offload.cpp) o con el simulador
+// (tools/offload_sim.cpp) usando el protocolo de include/holter_offload_proto.h.
+// Los logs del equipo que llegan entre tramas se ignoran (se muestran con -v).
+//
+// Compilar (desde la raíz del repo):
+//   g++ -O2 -Iinclude tools/offload_client.cpp src/holter_offload_proto.cpp -o offload_client
+//
+// Uso:
+//   ./offload_client [-p /dev/ttyUSB0] [-b 921600] [-o DIR] [-v] COMANDO
+//
+//   list                              Segmentos en la SD del equipo
+//   pull                              Todo el backlog: los segmentos cerrados que falten en DIR
+//   get GRABACION SEGMENTO            Un segmento completo
+//   range GRABACION DESDE HASTA       Muestras entre dos Unix timestamps, en un solo .bin
+//
+// Los archivos quedan con el nombre de la SD (session_<grabación>_sNNNN.bin) y
+// se pueden procesar igual que los que sube el equipo. range arma un archivo
+// versión 1 con el header del primer segmento; no aplica a sesiones cifradas
+// (versión 2, o 3 con SESSION_FLAG_ENCRYPTED): para esas usar get o pull.
+
+#include "holter_offload_proto.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+static const int ECG_SAMPLE_RATE_HZ = 250;
+static const int ECG_SAMPLE_SIZE = 6;
+static const int FILE_HEADER_SIZE = 28;
+static const int SESSION_INFO_SIZE = 24;         // Versión 3: sigue al FileHeader
+static const int OFFSET_VERSION = 4;
+static const int OFFSET_TIMESTAMP_START = 12;
+static const int OFFSET_NUM_ECG = 20;
+
+// Sin ninguna trama válida en este tiempo se reenvía la confirmación
+static const int RESEND_MS = 500;
+static const int GIVE_UP_MS = 8000;
+
+static bool verbose = false;
+
+static double nowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ============================================================================
+// PUERTO SERIE
+// ============================================================================
+
+static speed_t baudConstant(uint32_t baud) {
+  switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    default: return 0;
+  }
+}
+
+static int openPort(const char* path, uint32_t baud) {
+  int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+  
+  struct termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    perror("tcgetattr");
+    close(fd);
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~CRTSCTS;
+  cfsetispeed(&tio, baudConstant(baud));
+  cfsetospeed(&tio, baudConstant(baud));
+  tcsetattr(fd, TCSANOW, &tio);
+  
+  // DTR/RTS controlan EN e IO0 en las placas ESP32: soltarlos juntos para no
+  // reiniciar el equipo (en un pty el ioctl falla y no importa)
+  int lines = TIOCM_DTR | TIOCM_RTS;
+  ioctl(fd, TIOCMBIC, &lines);
+  
+  tcflush(fd, TCIOFLUSH);
+  return fd;
+}
+
+// ============================================================================
+// SESIÓN CON EL EQUIPO
+// ============================================================================
+
+typedef std::function<bool(const uint8_t* data, size_t len)> ContentSink;
+
+class Session {
+public:
+  explicit Session(int fd) : fd(fd), transferId(0) {}
+  
+  bool hello(OffloadInfo* info) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+      uint8_t id = ++transferId;
+      send(OFFLOAD_HELLO, id, 0, nullptr, 0);
+      
+      double deadline = nowSeconds() + 1.0;
+      OffloadFrame frame;
+      while (nextFrame(&frame, deadline)) {
+        if (frame.type == OFFLOAD_INFO && frame.transfer == id && frame.length >= sizeof(OffloadInfo)) {
+          memcpy(info, frame.payload, sizeof(OffloadInfo));
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  
+  /**
+   * Ejecuta LIST o GET y entrega el contenido en orden a sink
+   */
+  bool transfer(uint8_t command, const uint8_t* request, uint16_t requestLen, ContentSink sink) {
+    uint8_t id = ++transferId;
+    send(command, id, 0, request, requestLen);
+    
+    uint32_t expected = 0;
+    uint32_t lastNak = UINT32_MAX;
+    uint32_t crc = 0;
+    double lastValid = nowSeconds();
+    double started = lastValid;
+    
+    for (;;) {
+      OffloadFrame frame;
+      if (!nextFrame(&frame, nowSeconds() + RESEND_MS / 1000.0)) {
+        if ((nowSeconds() - lastValid) * 1000 > GIVE_UP_MS) {
+          fprintf(stderr, "Sin respuesta del equipo\n");
+          return false;
+        }
+        // Nada llegó: el comando o la última confirmación se perdieron
+        if (expected == 0) {
+          send(command, id, 0, request, requestLen);
+        } else {
+          send(OFFLOAD_ACK, id, expected, nullptr, 0);
+        }
+        continue;
+      }
+      if (frame.transfer != id) continue;
+      lastValid = nowSeconds();
+      
+      if (frame.type == OFFLOAD_ERROR) {
+        fprintf(stderr, "Error del equipo (%d): %.*s\n", frame.length > 0 ? frame.payload[0] : 0,
+                frame.length > 1 ? frame.length - 1 : 0, (const char*)frame.payload + 1);
+        return false;
+      }
+      
+      if (frame.seq > expected) {
+        // Hueco: pedir una sola vez que reenvíe desde la primera faltante
+        if (lastNak != expected) {
+          send(OFFLOAD_NAK, id, expected, nullptr, 0);
+          lastNak = expected;
+        }
+        continue;
+      }
+      if (frame.seq < expected) {
+        send(OFFLOAD_ACK, id, expected, nullptr, 0);
+        continue;
+      }
+      
+      if (frame.type == OFFLOAD_BEGIN && frame.length >= sizeof(OffloadBegin)) {
+        memcpy(&total, frame.payload, sizeof(uint32_t));
+      } else if (frame.type == OFFLOAD_DATA) {
+        crc = offload_crc32(crc, frame.payload, frame.length);
+        if (!sink(frame.payload, frame.length)) return false;
+      } else if (frame.type == OFFLOAD_END && frame.length >= sizeof(OffloadEnd)) {
+        uint32_t deviceCrc;
+        memcpy(&deviceCrc, frame.payload, sizeof(deviceCrc));
+        send(OFFLOAD_ACK, id, expected + 1, nullptr, 0);
+        elapsed = nowSeconds() - started;
+        if (deviceCrc != crc) {
+          fprintf(stderr, "CRC del contenido no coincide (equipo %08X, recibido %08X)\n", deviceCrc, crc);
+          return false;
+        }
+        return true;
+      } else {
+        continue;
+      }
+      
+      expected++;
+      send(OFFLOAD_ACK, id, expected, nullptr, 0);
+    }
+  }
+  
+  uint32_t lastTotal() const { return total; }
+  double lastElapsed() const { return elapsed; }
+  uint32_t crcErrors() const { return parser.crcErrors(); }
+
+private:
+  void send(uint8_t type, uint8_t id, uint32_t seq, const uint8_t* payload, uint16_t len) {
+    uint8_t frame[OFFLOAD_MAX_FRAME];
+    size_t frameLen = offload_encodeFrame(frame, type, id, seq, payload, len);
+    size_t done = 0;
+    while (done < frameLen) {
+      ssize_t n = write(fd, frame + done, frameLen - done);
+      if (n > 0) {
+        done += n;
+      } else if (errno == EAGAIN) {
+        struct pollfd p = { fd, POLLOUT, 0 };
+        poll(&p, 1, 10);
+      } else {
+        return;
+      }
+    }
+  }
+  
+  bool nextFrame(OffloadFrame* frame, double deadline) {
+    for (;;) {
+      while (pending < filled) {
+        uint8_t byte = buffer[pending++];
+        if (parser.push(byte)) {
+          *frame = parser.frame();
+          return true;
+        }
+        if (verbose && parser.skippedBytes() != lastSkipped) {
+          fputc(byte, stderr);
+          lastSkipped = parser.skippedBytes();
+        }
+      }
+      
+      double remaining = deadline - nowSeconds();
+      if (remaining <= 0) return false;
+      
+      struct pollfd p = { fd, POLLIN, 0 };
+      if (poll(&p, 1, (int)(remaining * 1000) + 1) <= 0) continue;
+      ssize_t n = read(fd, buffer, sizeof(buffer));
+      pending = 0;
+      filled = n > 0 ? n : 0;
+    }
+  }
+  
+  int fd;
+  uint8_t transferId;
+  OffloadParser parser;
+  uint8_t buffer[4096];
+  size_t pending = 0;
+  size_t filled = 0;
+  uint32_t lastSkipped = 0;
+  uint32_t total = 0;
+  double elapsed = 0;
+};
+
+// ============================================================================
+// COMANDOS
+// ============================================================================
+
+static std::string segmentName(uint32_t recording, uint32_t segment) {
+  char name[64];
+  snprintf(name, sizeof(name), "session_%lu_s%04lu.bin", (unsigned long)recording, (unsigned long)segment);
+  return name;
+}
+
+static bool fetchList(Session& session, std::vector<OffloadEntry>* entries) {
+  std::vector<uint8_t> raw;
+  bool ok = session.transfer(OFFLOAD_LIST, nullptr, 0, [&](const uint8_t* data, size_t len) {
+    raw.insert(raw.end(), data, data + len);
+    return true;
+  });
+  if (!ok) return false;
+  
+  entries->resize(raw.size() / sizeof(OffloadEntry));
+  memcpy(entries->data(), raw.data(), entries->size() * sizeof(OffloadEntry));
+  std::sort(entries->begin(), entries->end(), [](const OffloadEntry& a, const OffloadEntry& b) {
+    return a.recording_id != b.recording_id ? a.recording_id < b.recording_id : a.segment < b.segment;
+  });
+  return true;
+}
+
+static bool fetchRange(Session& session, uint32_t recording, uint32_t segment, uint32_t offset,
+                       uint32_t length, ContentSink sink) {
+  OffloadGet request = { recording, segment, offset, length };
+  return session.transfer(OFFLOAD_GET, (const uint8_t*)&request, sizeof(request), sink);
+}
+
+// Descarga a un .part y lo renombra al terminar: un corte nunca deja un archivo a medias
+static bool fetchFile(Session& session, uint32_t recording, uint32_t segment, const std::string& path) {
+  std::string partial = path + ".part";
+  FILE* out = fopen(partial.c_str(), "wb");
+  if (out == nullptr) {
+    perror(partial.c_str());
+    return false;
+  }
+  
+  bool ok = fetchRange(session, recording, segment, 0, 0, [&](const uint8_t* data, size_t len) {
+    return fwrite(data, 1, len, out) == len;
+  });
+  fclose(out);
+  
+  if (!ok || rename(partial.c_str(), path.c_str()) != 0) {
+    unlink(partial.c_str());
+    return false;
+  }
+  return true;
+}
+
+static void printRate(const char* what, uint64_t bytes, double seconds, uint32_t baud) {
+  double rate = seconds > 0 ? bytes / seconds : 0;
+  double lineRate = baud / 10.0;
+  printf("%s: %llu bytes en %.2f s = %.1f KB/s (%.0f%% del line rate de %u baud)\n",
+         what, (unsigned long long)bytes, seconds, rate / 1024, 100 * rate / lineRate, baud);
+}
+
+static int commandList(Session& session) {
+  std::vector<OffloadEntry> entries;
+  if (!fetchList(session, &entries)) return 1;
+  
+  printf("%-12s %-8s %10s %12s %9s %4s %s\n", "grabacion", "segmento", "bytes", "inicio", "muestras", "ver", "");
+  for (const OffloadEntry& e : entries) {
+    printf("%-12u %-8u %10u %12u %9u %4u %s\n", e.recording_id, e.segment, e.size, e.timestamp_start,
+           e.num_ecg_samples, e.version, (e.flags & OFFLOAD_ENTRY_OPEN) ? "grabando" : "");
+  }
+  printf("%zu segmentos\n", entries.size());
+  return 0;
+}
+
+static int commandPull(Session& session, const std::string& dir, uint32_t baud) {
+  std::vector<OffloadEntry> entries;
+  if (!fetchList(session, &entries)) return 1;
+  
+  int fetched = 0, skipped = 0, failed = 0;
+  uint64_t bytes = 0;
+  double started = nowSeconds();
+  
+  for (const OffloadEntry& e : entries) {
+    // El segmento abierto todavía crece: se baja en el próximo pull
+    if (e.flags & OFFLOAD_ENTRY_OPEN) continue;
+    
+    std::string path = dir + "/" + segmentName(e.recording_id, e.segment);
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && (uint32_t)st.st_size == e.size) {
+      skipped++;
+      continue;
+    }
+    
+    if (fetchFile(session, e.recording_id, e.segment, path)) {
+      fetched++;
+      bytes += e.size;
+      if (verbose) printRate(path.c_str(), e.size, session.lastElapsed(), baud);
+    } else {
+      fprintf(stderr, "No se pudo descargar %s\n", path.c_str());
+      failed++;
+    }
+  }
+  
+  printf("Descargados %d, ya estaban %d, fallidos %d\n", fetched, skipped, failed);
+  if (fetched > 0) printRate("Backlog", bytes, nowSeconds() - started, baud);
+  return failed > 0 ? 1 : 0;
+}
+
+static int commandGet(Session& session, const std::string& dir, uint32_t recording, uint32_t segment,
+                      uint32_t baud) {
+  std::string path = dir + "/" + segmentName(recording, segment);
+  if (!fetchFile(session, recording, segment, path)) return 1;
+  printRate(path.c_str(), session.lastTotal(), session.lastElapsed(), baud);
+  return 0;
+}
+
+static int commandRange(Session& session, const std::string& dir, uint32_t recording,
+                        uint32_t from, uint32_t to, uint32_t baud) {
+  std::vector<OffloadEntry> entries;
+  if (!fetchList(session, &entries)) return 1;
+  
+  std::vector<OffloadEntry> overlapping;
+  for (const OffloadEntry& e : entries) {
+    uint32_t end = e.timestamp_start + (e.num_ecg_samples + ECG_SAMPLE_RATE_HZ - 1) / ECG_SAMPLE_RATE_HZ;
+    if (e.recording_id == recording && e.timestamp_start < to && end > from) overlapping.push_back(e);
+  }
+  if (overlapping.empty()) {
+    fprintf(stderr, "Ningún segmento de la grabación %u cubre [%u, %u)\n", recording, from, to);
+    return 1;
+  }
+  for (const OffloadEntry& e : overlapping) {
+    if ((e.flags & OFFLOAD_ENTRY_ENCRYPTED) || (e.version != 1 && e.version != 3)) {
+      fprintf(stderr, "El segmento %u está cifrado (versión %u): usar get o pull\n", e.segment, e.version);
+      return 1;
+    }
+  }
+  
+  char name[96];
+  snprintf(name, sizeof(name), "/session_%u_%u-%u.bin", recording, from, to);
+  std::string path = dir + name;
+  FILE* out = fopen(path.c_str(), "wb");
+  if (out == nullptr) {
+    perror(path.c_str());
+    return 1;
+  }
+  
+  // Header del primer segmento; inicio y cantidad se corrigen al final. El
+  // resultado es siempre versión 1: los tiempos de arranque del SessionInfo
+  // no corresponden a un archivo armado con varios segmentos
+  std::vector<uint8_t> header;
+  bool ok = fetchRange(session, recording, overlapping[0].segment, 0, FILE_HEADER_SIZE,
+                       [&](const uint8_t* data, size_t len) {
+    header.insert(header.end(), data, data + len);
+    return true;
+  });
+  uint16_t version = 1;
+  if (ok && header.size() == FILE_HEADER_SIZE) memcpy(&header[OFFSET_VERSION], &version, sizeof(version));
+  ok = ok && header.size() == FILE_HEADER_SIZE && fwrite(header.data(), 1, FILE_HEADER_SIZE, out) == FILE_HEADER_SIZE;
+  
+  uint32_t samples = 0;
+  double started = nowSeconds();
+  for (size_t i = 0; ok && i < overlapping.size(); i++) {
+    const OffloadEntry& e = overlapping[i];
+    uint32_t first = from > e.timestamp_start ? (from - e.timestamp_start) * ECG_SAMPLE_RATE_HZ : 0;
+    uint32_t last = std::min<uint64_t>(e.num_ecg_samples, (uint64_t)(to - e.timestamp_start) * ECG_SAMPLE_RATE_HZ);
+    if (first >= last) continue;
+    
+    uint32_t dataOffset = FILE_HEADER_SIZE + (e.version == 3 ? SESSION_INFO_SIZE : 0);
+    ok = fetchRange(session, recording, e.segment, dataOffset + first * ECG_SAMPLE_SIZE,
+                    (last - first) * ECG_SAMPLE_SIZE, [&](const uint8_t* data, size_t len) {
+      return fwrite(data, 1, len, out) == len;
+    });
+    samples += last - first;
+  }
+  
+  uint32_t start = std::max(from, overlapping[0].timestamp_start);
+  if (ok) {
+    fseek(out, OFFSET_TIMESTAMP_START, SEEK_SET);
+    fwrite(&start, 1, sizeof(start), out);
+    fseek(out, OFFSET_NUM_ECG, SEEK_SET);
+    fwrite(&samples, 1, sizeof(samples), out);
+  }
+  fclose(out);
+  
+  if (!ok) {
+    unlink(path.c_str());
+    return 1;
+  }
+  printf("%s: %u muestras de %zu segmentos\n", path.c_str(), samples, overlapping.size());
+  printRate("Rango", (uint64_t)samples * ECG_SAMPLE_SIZE, nowSeconds() - started, baud);
+  return 0;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Uso: %s [-p PUERTO] [-b BAUD] [-o DIR] [-v] list | pull | get GRAB SEG | range GRAB DESDE HASTA\n",
+          argv0);
+}
+
+int main(int argc, char** argv) {
+  std::string port = "/dev/ttyUSB0";
+  std::string dir = ".";
+  uint32_t baud = 921600;
+  
+  int opt;
+  while ((opt = getopt(argc, argv, "p:b:o:v")) != -1) {
+    switch (opt) {
+      case 'p': port = optarg; break;
+      case 'b': baud = strtoul(optarg, nullptr, 10); break;
+      case 'o': dir = optarg; break;
+      case 'v': verbose = true; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (baudConstant(baud) == 0) {
+    fprintf(stderr, "Velocidad no soportada: %u\n", baud);
+    return 1;
+  }
+  std::string command = argv[optind];
+  char** args = argv + optind + 1;
+  int nargs = argc - optind - 1;
+  
+  int fd = openPort(port.c_str(), baud);
+  if (fd < 0) return 1;
+  
+  Session session(fd);
+  OffloadInfo info;
+  if (!session.hello(&info)) {
+    fprintf(stderr, "El equipo no responde en %s\n", port.c_str());
+    return 1;
+  }
+  if (info.version != OFFLOAD_VERSION) {
+    fprintf(stderr, "Versión de protocolo %u, se esperaba %u\n", info.version, OFFLOAD_VERSION);
+    return 1;
+  }
+  if (info.baud != baud) {
+    fprintf(stderr, "Aviso: el equipo informa %u baud\n", info.baud);
+  }
+  
+  int rc;
+  if (command == "list" && nargs == 0) {
+    rc = commandList(session);
+  } else if (command == "pull" && nargs == 0) {
+    rc = commandPull(session, dir, baud);
+  } else if (command == "get" && nargs == 2) {
+    rc = commandGet(session, dir, strtoul(args[0], nullptr, 10), strtoul(args[1], nullptr, 10), baud);
+  } else if (command == "range" && nargs == 3) {
+    rc = commandRange(session, dir, strtoul(args[0], nullptr, 10), strtoul(args[1], nullptr, 10),
+                      strtoul(args[2], nullptr, 10), baud);
+  } else {
+    usage(argv[0]);
+    rc = 1;
+  }
+  
+  if (verbose) fprintf(stderr, "Tramas descartadas por CRC: %u\n", session.crcErrors());
+  close(fd);
+  return rc;
+}
@@ -0,0 +1,369 @@
+// Simulador del equipo para probar la descarga por USB-serie sin hardware
+//
+// Crea un pseudo-terminal y atiende en él al cliente (tools/offload_client.cpp)
+// con el mismo OffloadServer del firmware (src/holter_offload_proto.cpp),
+// sirviendo los segmentos de un directorio como si fuera la SD. Puede limitar
+// el enlace a la velocidad de un UART real e inyectar los problemas que el
+// protocolo tiene que tolerar: tramas perdidas, bytes corruptos y logs
+// intercalados entre tramas.
+//
+// Compilar (desde la raíz del repo):
+//   g++ -O2 -Iinclude tools/offload_sim.cpp src/holter_offload_proto.cpp -o offload_sim
+//   ./offload_sim --dir /ruta/sd [--make N] [--baud 921600] [--drop P] [--corrupt P] [--noise]
+//
+// La primera línea de stdout es la ruta del pty (/dev/pts/N) para el cliente.
+// --make N: crea en el directorio N segmentos sintéticos de 15 s de una grabación.
+// --baud: 0 = sin límite (lo que dé el pty).
+// --drop / --corrupt: probabilidad por trama enviada (por ejemplo 0.02).
+
+#include "holter_offload_proto.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+// Mismo formato que el firmware (include/holter_capture.h)
+struct FileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t device_id;
+  uint32_t session_id;
+  uint32_t timestamp_start;
+  uint16_t ecg_sample_rate;
+  uint16_t imu_sample_rate;
+  uint32_t num_ecg_samples;
+  uint32_t num_imu_samples;
+} __attribute__((packed));
+
+struct SessionInfo {
+  uint32_t flags;
+  uint32_t first_sample_us;
+  uint32_t first_write_us;
+  uint32_t ram_samples;
+  uint32_t sd_mount_ms;
+  uint32_t segment_start_ms;
+} __attribute__((packed));
+
+static const uint32_t SESSION_FLAG_ENCRYPTED = 0x01;
+
+static const int ECG_SAMPLE_RATE_HZ = 250;
+static const int SEGMENT_SECONDS = 15;
+
+static std::mt19937 rng(12345);
+
+static double randomUnit() {
+  return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+}
+
+static bool parseSegmentName(const char* name, uint32_t* recording, uint32_t* segment) {
+  unsigned long rec, seg;
+  int consumed = 0;
+  if (sscanf(name, "session_%lu_s%lu.bin%n", &rec, &seg, &consumed) != 2 ||
+      consumed == 0 || name[consumed] != '\0') {
+    return false;
+  }
+  *recording = rec;
+  *segment = seg;
+  return true;
+}
+
+static std::string segmentPath(const std::string& dir, uint32_t recording, uint32_t segment) {
+  char name[64];
+  snprintf(name, sizeof(name), "/session_%lu_s%04lu.bin", (unsigned long)recording, (unsigned long)segment);
+  return dir + name;
+}
+
+// ============================================================================
+// SD SIMULADA
+// ============================================================================
+
+class DirStorage : public OffloadStorage {
+public:
+  explicit DirStorage(const std::string& dir) : dir(dir), file(nullptr) {}
+  
+  bool beginList(uint32_t* count) override {
+    close();
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) return false;
+    
+    listing.clear();
+    while (struct dirent* e = readdir(d)) {
+      uint32_t recording, segment;
+      if (parseSegmentName(e->d_name, &recording, &segment)) {
+        listing.push_back(std::make_pair(recording, segment));
+      }
+    }
+    closedir(d);
+    
+    // En la SD el orden es el del directorio; acá se ordena para que sea repetible
+    std::sort(listing.begin(), listing.end());
+    *count = listing.size();
+    return true;
+  }
+  
+  bool listEntry(uint32_t index, OffloadEntry* entry) override {
+    if (index >= listing.size()) return false;
+    
+    memset(entry, 0, sizeof(OffloadEntry));
+    entry->recording_id = listing[index].first;
+    entry->segment = listing[index].second;
+    
+    FILE* f = fopen(segmentPath(dir, entry->recording_id, entry->segment).c_str(), "rb");
+    if (f == nullptr) return false;
+    FileHeader header;
+    if (fread(&header, 1, sizeof(header), f) == sizeof(header)) {
+      entry->timestamp_start = header.timestamp_start;
+      entry->num_ecg_samples = header.num_ecg_samples;
+      entry->version = header.version;
+      
+      SessionInfo info;
+      if (header.version == 2 ||
+          (header.version == 3 && fread(&info, 1, sizeof(info), f) == sizeof(info) &&
+           (info.flags & SESSION_FLAG_ENCRYPTED))) {
+        entry->flags |= OFFLOAD_ENTRY_ENCRYPTED;
+      }
+    }
+    fseek(f, 0, SEEK_END);
+    entry->size = ftell(f);
+    fclose(f);
+    return true;
+  }
+  
+  bool open(uint32_t recording, uint32_t segment, uint32_t* size) override {
+    close();
+    file = fopen(segmentPath(dir, recording, segment).c_str(), "rb");
+    if (file == nullptr) return false;
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    return true;
+  }
+  
+  int read(uint32_t offset, uint8_t* buffer, size_t len) override {
+    if (file == nullptr || fseek(file, offset, SEEK_SET) != 0) return -1;
+    return fread(buffer, 1, len, file);
+  }
+  
+  void close() override {
+    if (file != nullptr) fclose(file);
+    file = nullptr;
+  }
+
+private:
+  std::string dir;
+  FILE* file;
+  std::vector<std::pair<uint32_t, uint32_t>> listing;
+};
+
+// ============================================================================
+// ENLACE SOBRE EL PTY
+// ============================================================================
+
+class PtyLink : public OffloadLink {
+public:
+  PtyLink(int fd, uint32_t baud, double drop, double corrupt, bool noise)
+    : fd(fd), baud(baud), drop(drop), corrupt(corrupt), noise(noise),
+      start(std::chrono::steady_clock::now()), dropped(0), corrupted(0) {}
+  
+  int read(uint8_t* buffer, size_t len) override {
+    ssize_t got = ::read(fd, buffer, len);
+    return got > 0 ? (int)got : 0;
+  }
+  
+  void write(const uint8_t* data, size_t len) override {
+    if (noise && randomUnit() < 0.05) {
+      char line[96];
+      int n = snprintf(line, sizeof(line), "[PROGRESS] %lus | ECG: %lu muestras (250.0 Hz)\n",
+                       (unsigned long)millis() / 1000, (unsigned long)millis() / 4);
+      writeAll((const uint8_t*)line, n);
+    }
+    
+    if (randomUnit() < drop) {
+      dropped++;
+      pace(len);
+      return;
+    }
+    
+    std::vector<uint8_t> copy(data, data + len);
+    if (randomUnit() < corrupt) {
+      copy[std::uniform_int_distribution<size_t>(0, len - 1)(rng)] ^= 0x10;
+      corrupted++;
+    }
+    writeAll(copy.data(), len);
+  }
+  
+  size_t writable() override {
+    struct pollfd p = { fd, POLLOUT, 0 };
+    return poll(&p, 1, 0) > 0 && (p.revents & POLLOUT) ? OFFLOAD_MAX_FRAME : 0;
+  }
+  
+  uint32_t millis() override {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+  
+  uint32_t droppedFrames() const { return dropped; }
+  uint32_t corruptedFrames() const { return corrupted; }
+
+private:
+  void writeAll(const uint8_t* data, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+      ssize_t n = ::write(fd, data + done, len - done);
+      if (n > 0) {
+        done += n;
+      } else {
+        struct pollfd p = { fd, POLLOUT, 0 };
+        poll(&p, 1, 10);
+      }
+    }
+    pace(len);
+  }
+  
+  // 10 bits por byte en el cable (8N1)
+  void pace(size_t len) {
+    if (baud > 0) usleep((useconds_t)(len * 10ULL * 1000000ULL / baud));
+  }
+  
+  int fd;
+  uint32_t baud;
+  double drop;
+  double corrupt;
+  bool noise;
+  std::chrono::steady_clock::time_point start;
+  uint32_t dropped;
+  uint32_t corrupted;
+};
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+static void makeSessions(const std::string& dir, int count) {
+  const uint32_t recording = 1700000000;
+  const uint32_t samples = ECG_SAMPLE_RATE_HZ * SEGMENT_SECONDS;
+  
+  for (int seg = 0; seg < count; seg++) {
+    FileHeader header = {0};
+    header.magic = 0x45434744;
+    header.version = 3;
+    header.device_id = 1;
+    header.session_id = recording;
+    header.timestamp_start = recording + seg * SEGMENT_SECONDS;
+    header.ecg_sample_rate = ECG_SAMPLE_RATE_HZ;
+    header.num_ecg_samples = samples;
+    
+    FILE* f = fopen(segmentPath(dir, recording, seg).c_str(), "wb");
+    if (f == nullptr) {
+      perror("fopen");
+      exit(1);
+    }
+    fwrite(&header, 1, sizeof(header), f);
+    
+    SessionInfo info = {0};
+    info.first_sample_us = 41000;
+    info.first_write_us = 262000;
+    info.ram_samples = 55;
+    info.sd_mount_ms = 230;
+    info.segment_start_ms = 41 + seg * SEGMENT_SECONDS * 1000;
+    fwrite(&info, 1, sizeof(info), f);
+    for (uint32_t i = 0; i < samples; i++) {
+      double t = (double)(seg * samples + i) / ECG_SAMPLE_RATE_HZ;
+      int16_t lead = (int16_t)(3000 * sin(2 * M_PI * 1.2 * t) + (rng() % 64));
+      int16_t sample[3] = { lead, (int16_t)(lead + 500), 500 };
+      fwrite(sample, 1, sizeof(sample), f);
+    }
+    fclose(f);
+  }
+  
+  // Lo que no es un segmento no debe aparecer en el listado
+  FILE* other = fopen((dir + "/queue.dat").c_str(), "wb");
+  if (other != nullptr) fclose(other);
+}
+
+static volatile bool running = true;
+
+static void onSignal(int) {
+  running = false;
+}
+
+int main(int argc, char** argv) {
+  std::string dir;
+  int make = 0;
+  uint32_t baud = 921600;
+  double drop = 0;
+  double corrupt = 0;
+  bool noise = false;
+  
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--dir" && i + 1 < argc) dir = argv[++i];
+    else if (arg == "--make" && i + 1 < argc) make = atoi(argv[++i]);
+    else if (arg == "--baud" && i + 1 < argc) baud = strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--drop" && i + 1 < argc) drop = atof(argv[++i]);
+    else if (arg == "--corrupt" && i + 1 < argc) corrupt = atof(argv[++i]);
+    else if (arg == "--noise") noise = true;
+    else {
+      fprintf(stderr, "Uso: %s --dir DIR [--make N] [--baud B] [--drop P] [--corrupt P] [--noise]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (dir.empty()) {
+    fprintf(stderr, "Falta --dir\n");
+    return 1;
+  }
+  if (make > 0) makeSessions(dir, make);
+  
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  
+  // Se mantiene abierto el lado esclavo: el pty sobrevive entre clientes y
+  // queda en modo raw (sin eco ni traducción de fin de línea) desde el inicio
+  const char* slaveName = ptsname(master);
+  int slave = open(slaveName, O_RDWR | O_NOCTTY);
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  
+  printf("%s\n", slaveName);
+  fflush(stdout);
+  
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  
+  DirStorage storage(dir);
+  PtyLink link(master, baud, drop, corrupt, noise);
+  OffloadServer server(&storage, &link, baud);
+  
+  while (running) {
+    server.poll();
+    usleep(server.busy() ? 100 : 1000);
+  }
+  
+  OffloadStats stats = server.stats();
+  fprintf(stderr, "[SIM] transferencias %u, tramas %u (reenviadas %u), perdidas %u, corruptas %u, "
+          "CRC del host %u, bytes confirmados %u\n",
+          stats.transfers, stats.frames_sent, stats.frames_resent, link.droppedFrames(),
+          link.corruptedFrames(), stats.crc_errors, stats.bytes_sent);
+  
+  close(slave);
+  close(master);
+  return 0;
+}
@@ -0,0 +1,248 @@
+// Genera sesiones sintéticas con el generador del firmware (src/holter_synth.cpp)
+//
+// Escribe segmentos con el nombre y el formato de la SD (versión 3, en
+// claro): ECG a 250 Hz y, a continuación, el acelerómetro a 50 Hz como los
+// lee lambda2.py. Con --annotations deja además un CSV con cada pico R
+// (muestra, segundo, tipo N/V) y los episodios, para medir detectores.
+// Mucho más rápido que tiempo real: 24 h de señal en pocos segundos.
+//
+// Compilar y ejecutar (desde la raíz del repo):
+//   g++ -O2 -Iinclude tools/synth_sessions.cpp src/holter_synth.cpp src/holter_format.cpp -o synth_sessions
+//   ./synth_sessions --seconds 3600 --seed 7 --out /tmp/sd --pvc 600:300:0.1 --walk 1200:600:110
+//
+// Opciones:
+//   --seconds N           segundos de señal (por defecto 60)
+//   --segment N           segundos por segmento (por defecto 15, como CAPTURE_DURATION_SEC)
+//   --seed N              semilla (por defecto 1)
+//   --hr BPM              FC de base (70)
+//   --sdnn MS             variabilidad de los RR (40)
+//   --mains HZ            zumbido de red, 50 o 60 (50); --hum MV su amplitud (0.02)
+//   --wander MV           deriva de línea de base (0.1)
+//   --noise MV            ruido blanco (0.01)
+//   --motion MV           artefacto por paso al caminar (0.3)
+//   --no-imu              sin muestras del acelerómetro
+//   --af START:DUR        fibrilación auricular
+//   --pvc START:DUR:FRAC  extrasístoles en esa fracción de los latidos
+//   --tachy START:DUR:BPM taquicardia sinusal
+//   --walk START:DUR:SPM  caminata a SPM pasos por minuto
+//   --out DIR             directorio de salida (por defecto el actual)
+//   --start UNIX          timestamp de la grabación (por defecto 1718000000)
+//   --annotations FILE    CSV de latidos y episodios
+
+#include "holter_synth.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct Options {
+  uint32_t seconds = 60;
+  uint32_t segmentSeconds = 15;
+  bool imu = true;
+  std::string out = ".";
+  uint32_t start = 1718000000;
+  const char* annotations = nullptr;
+  SynthConfig synth;
+};
+
+// ============================================================================
+// FUNCIONES INTERNAS (PRIVADAS)
+// ============================================================================
+
+static const char* episodeName(uint8_t type) {
+  switch (type) {
+    case SYNTH_AF: return "AF";
+    case SYNTH_PVC: return "PVC";
+    case SYNTH_TACHY: return "TACHY";
+    case SYNTH_WALK: return "WALK";
+    default: return "?";
+  }
+}
+
+static void usage(const char* program) {
+  fprintf(stderr, "Uso: %s [--seconds N] [--segment N] [--seed N] [--hr BPM] [--sdnn MS]\n"
+                  "          [--mains HZ] [--hum MV] [--wander MV] [--noise MV] [--motion MV] [--no-imu]\n"
+                  "          [--af S:D] [--pvc S:D:FRAC] [--tachy S:D:BPM] [--walk S:D:SPM]\n"
+                  "          [--out DIR] [--start UNIX] [--annotations FILE]\n", program);
+  exit(2);
+}
+
+// START:DUR[:PARAM]
+static void parseEpisode(const char* program, SynthConfig* config, SynthEpisodeType type,
+                         const char* spec, bool needsParam) {
+  unsigned long start = 0;
+  unsigned long duration = 0;
+  float param = 0;
+  int fields = sscanf(spec, "%lu:%lu:%f", &start, &duration, &param);
+  if (fields < (needsParam ? 3 : 2)) usage(program);
+  if (!EcgSynth::addEpisode(config, type, start, duration, param)) {
+    fprintf(stderr, "Máximo %d episodios\n", SYNTH_MAX_EPISODES);
+    exit(2);
+  }
+}
+
+static Options parseOptions(int argc, char** argv) {
+  Options options;
+  SynthConfig& synth = options.synth;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(arg, "--no-imu")) {
+      options.imu = false;
+      continue;
+    }
+    if (!hasValue) usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(arg, "--seconds")) {
+      options.seconds = strtoul(value, nullptr, 10);
+    } else if (!strcmp(arg, "--segment")) {
+      options.segmentSeconds = strtoul(value, nullptr, 10);
+    } else if (!strcmp(arg, "--seed")) {
+      synth.seed = strtoul(value, nullptr, 10);
+    } else if (!strcmp(arg, "--hr")) {
+      synth.heart_rate_bpm = atof(value);
+    } else if (!strcmp(arg, "--sdnn")) {
+      synth.hrv_sdnn_ms = atof(value);
+    } else if (!strcmp(arg, "--mains")) {
+      synth.mains_hz = atof(value);
+    } else if (!strcmp(arg, "--hum")) {
+      synth.mains_mv = atof(value);
+    } else if (!strcmp(arg, "--wander")) {
+      synth.wander_mv = atof(value);
+    } else if (!strcmp(arg, "--noise")) {
+      synth.noise_mv = atof(value);
+    } else if (!strcmp(arg, "--motion")) {
+      synth.motion_mv = atof(value);
+    } else if (!strcmp(arg, "--af")) {
+      parseEpisode(argv[0], &synth, SYNTH_AF, value, false);
+    } else if (!strcmp(arg, "--pvc")) {
+      parseEpisode(argv[0], &synth, SYNTH_PVC, value, true);
+    } else if (!strcmp(arg, "--tachy")) {
+      parseEpisode(argv[0], &synth, SYNTH_TACHY, value, true);
+    } else if (!strcmp(arg, "--walk")) {
+      parseEpisode(argv[0], &synth, SYNTH_WALK, value, true);
+    } else if (!strcmp(arg, "--out")) {
+      options.out = value;
+    } else if (!strcmp(arg, "--start")) {
+      options.start = strtoul(value, nullptr, 10);
+    } else if (!strcmp(arg, "--annotations")) {
+      options.annotations = value;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (options.segmentSeconds == 0) usage(argv[0]);
+  return options;
+}
+
+// Un segmento completo en memoria: headers, ECG y acelerómetro. Los latidos
+// van al CSV con la muestra desde el inicio de la grabación
+static uint64_t writeSegment(const Options& options, EcgSynth& synth, uint32_t segment,
+                             uint32_t samples, FILE* annotations) {
+  std::vector<ECGSample> ecg;
+  std::vector<IMUSample> imu;
+  ecg.reserve(samples);
+  imu.reserve(samples / (SESSION_ECG_RATE_HZ / SYNTH_IMU_RATE_HZ) + 1);
+  
+  SynthSample sample;
+  for (uint32_t i = 0; i < samples; i++) {
+    synth.next(&sample);
+    ecg.push_back(holter_format_ecgSample(holter_synth_leadVolts(sample.lead_I_mV),
+                                          holter_synth_leadVolts(sample.lead_II_mV)));
+    if (options.imu && sample.has_imu) imu.push_back(holter_synth_imuSample(sample.accel_g));
+    if (annotations != nullptr && sample.beat != SYNTH_BEAT_NONE) {
+      uint32_t index = synth.samples() - 1;
+      fprintf(annotations, "%u,%.3f,%c\n", index, (double)index / SESSION_ECG_RATE_HZ, sample.beat);
+    }
+  }
+  
+  FileHeader header;
+  holter_format_initHeader(&header, options.start, options.start + segment * options.segmentSeconds);
+  header.num_ecg_samples = ecg.size();
+  header.num_imu_samples = imu.size();
+  header.imu_sample_rate = imu.empty() ? 0 : SYNTH_IMU_RATE_HZ;
+  SessionInfo info;
+  memset(&info, 0, sizeof(info));
+  info.segment_start_ms = segment * options.segmentSeconds * 1000;
+  
+  char name[40];
+  snprintf(name, sizeof(name), "/session_%lu_s%04lu.bin",
+           (unsigned long)options.start, (unsigned long)segment);
+  std::string path = options.out + name;
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "No se pudo crear %s\n", path.c_str());
+    exit(1);
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(&info, sizeof(info), 1, file);
+  fwrite(ecg.data(), sizeof(ECGSample), ecg.size(), file);
+  fwrite(imu.data(), sizeof(IMUSample), imu.size(), file);
+  bool ok = ferror(file) == 0;
+  if (fclose(file) != 0 || !ok) {
+    fprintf(stderr, "Error escribiendo %s\n", path.c_str());
+    exit(1);
+  }
+  return sizeof(header) + sizeof(info) + ecg.size() * sizeof(ECGSample) + imu.size() * sizeof(IMUSample);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+  
+  FILE* annotations = nullptr;
+  if (options.annotations != nullptr) {
+    annotations = fopen(options.annotations, "w");
+    if (annotations == nullptr) {
+      fprintf(stderr, "No se pudo crear %s\n", options.annotations);
+      return 1;
+    }
+    fprintf(annotations, "sample,time_s,type\n");
+  }
+  
+  EcgSynth synth;
+  synth.begin(options.synth);
+  
+  auto start = std::chrono::steady_clock::now();
+  uint64_t bytes = 0;
+  uint32_t segments = 0;
+  uint32_t samplesLeft = options.seconds * SESSION_ECG_RATE_HZ;
+  uint32_t perSegment = options.segmentSeconds * SESSION_ECG_RATE_HZ;
+  
+  for (uint32_t segment = 0; samplesLeft > 0; segment++) {
+    uint32_t samples = samplesLeft < perSegment ? samplesLeft : perSegment;
+    bytes += writeSegment(options, synth, segment, samples, annotations);
+    samplesLeft -= samples;
+    segments++;
+  }
+  
+  if (annotations != nullptr) {
+    // Episodios al final, con tipo en lugar de símbolo de latido
+    fprintf(annotations, "# episode,start_s,duration_s,param\n");
+    for (int i = 0; i < options.synth.episode_count; i++) {
+      const SynthEpisode& episode = options.synth.episodes[i];
+      fprintf(annotations, "# %s,%u,%u,%g\n", episodeName(episode.type),
+              episode.start_s, episode.duration_s, episode.param);
+    }
+    fclose(annotations);
+  }
+  
+  double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%u segmentos (%u s, semilla %u) en %.3f s: %.0fx tiempo real | %.1f KB en %s\n",
+         segments, options.seconds, options.synth.seed, wallS,
+         wallS > 0 ? options.seconds / wallS : 0.0, bytes / 1024.0, options.out.c_str());
+  printf("Latidos: %u normales, %u extrasístoles\n",
+         synth.beats(SYNTH_BEAT_NORMAL), synth.beats(SYNTH_BEAT_PVC));
+  return 0;
+}
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+Convierte volcados de holter_trace (HOLTER_TRACE=1) a JSON de Chrome trace
+
+Acepta los /trace_*.txt de la SD o una captura de la consola: las líneas que
+no son de la traza se ignoran. Cada volcado del archivo sale como un proceso
+aparte y cada tarea del ESP32 como un hilo. El resultado se abre en
+https://ui.perfetto.dev o en chrome://tracing.
+
+Uso:
+  python3 tools/trace_to_chrome.py /sd/trace_1718000000_12.txt -o trace.json
+"""
+
+import argparse
+import json
+import sys
+
+WRAP = 1 << 32          # Las marcas de tiempo del equipo son us en 32 bits
+
+
+def parse_dumps(lines):
+    """Separa los volcados de un archivo: [(label, tasks, names, events)]"""
+    dumps = []
+    current = None
+    for line in lines:
+        line = line.rstrip('\r\n')
+        if line.startswith('# holter-trace v1'):
+            current = (line[len('# holter-trace v1'):].strip(), {}, {}, [])
+            continue
+        if current is None:
+            continue
+        if line.startswith('# holter-trace end'):
+            dumps.append(current)
+            current = None
+            continue
+
+        fields = line.split(' ', 2)
+        try:
+            if fields[0] == 'T':
+                current[1][int(fields[1])] = fields[2]
+            elif fields[0] == 'N':
+                current[2][int(fields[1])] = fields[2]
+            elif fields[0] == 'E':
+                timestamp, phase, name, task, core = line.split()[1:]
+                current[3].append((int(timestamp), phase, int(name), int(task), int(core)))
+        except (IndexError, ValueError):
+            # Línea cortada o mezclada con el log: se descarta
+            continue
+
+    if current is not None:
+        dumps.append(current)   # Volcado sin cierre (la captura se cortó)
+    return dumps
+
+
+def convert(dumps):
+    trace = []
+    for pid, (label, tasks, names, events) in enumerate(dumps, start=1):
+        trace.append({'ph': 'M', 'name': 'process_name', 'pid': pid, 'args': {'name': label or f'volcado {pid}'}})
+        for tid, task in tasks.items():
+            trace.append({'ph': 'M', 'name': 'thread_name', 'pid': pid, 'tid': tid, 'args': {'name': task}})
+
+        # El ring sale en orden de registro; los us de 32 bits se desenrollan
+        # contra el evento anterior
+        offset = 0
+        previous = None
+        base = None
+        open_scopes = {}
+        last_ts = 0
+        for timestamp, phase, name, task, core in events:
+            if previous is not None and timestamp + offset < previous - WRAP // 2:
+                offset += WRAP
+            previous = timestamp + offset
+            if base is None:
+                base = previous
+            ts = previous - base
+            last_ts = max(last_ts, ts)
+
+            stack = open_scopes.setdefault(task, [])
+            if phase == 'E':
+                # El inicio se pisó en el ring o cayó durante un volcado
+                if name not in stack:
+                    continue
+                while stack and stack[-1] != name:
+                    stack.pop()
+                stack.pop()
+            elif phase == 'B':
+                stack.append(name)
+
+            event = {
+                'name': names.get(name, f'traza {name}'),
+                'ph': phase,
+                'ts': ts,
+                'pid': pid,
+                'tid': task,
+                'args': {'core': core},
+            }
+            if phase == 'I':
+                event['s'] = 't'
+            trace.append(event)
+
+        # Lo que seguía abierto al volcar termina en el último evento
+        for task, stack in open_scopes.items():
+            for name in reversed(stack):
+                trace.append({'name': names.get(name, f'traza {name}'), 'ph': 'E',
+                              'ts': last_ts, 'pid': pid, 'tid': task})
+    return trace
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('files', nargs='+', help="volcados de la SD o capturas de la consola ('-' para stdin)")
+    parser.add_argument('-o', '--output', default='-', help='archivo JSON (por defecto stdout)')
+    args = parser.parse_args()
+
+    dumps = []
+    for path in args.files:
+        if path == '-':
+            dumps += parse_dumps(sys.stdin)
+        else:
+            with open(path, encoding='utf-8', errors='replace') as f:
+                dumps += parse_dumps(f)
+
+    if not dumps:
+        sys.exit("No se encontró ningún volcado de holter-trace")
+
+    result = {'traceEvents': convert(dumps), 'displayTimeUnit': 'ms'}
+    if args.output == '-':
+        json.dump(result, sys.stdout)
+    else:
+        with open(args.output, 'w') as f:
+            json.dump(result, f)
+        events = sum(len(d[3]) for d in dumps)
+        print(f"{len(dumps)} volcados, {events} eventos -> {args.output}", file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()